@@ -1,12 +1,20 @@
+#include <errno.h>
 #include <iostream>
 #include <map>
+#include <netinet/in.h>
+#include <poll.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
 #include <vector>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 
 #include <gflags/gflags.h>
@@ -18,6 +26,9 @@
 #include "common.hpp">
 #include "utils.hpp"
 #include "varz.hpp"
+#include "ib/backplane.hpp"
+#include "ib/quote_stream.hpp"
+#include "ib/quote_table.hpp"
 
 
 using namespace std;
@@ -27,6 +38,11 @@ using namespace lab616::utils;
 DEFINE_string(endpoint, "tcp://localhost:5555", "Publisher end point.");
 DEFINE_string(symbol, "AAPL", "Symbol to subscribe");
 DEFINE_bool(dumpmessage, false, "True to dump message.");
+DEFINE_int32(http_threads, 3, "Httpd threads.");
+DEFINE_int32(ws_port, 8081,
+             "Port of the WebSocket quote stream, ws://host:port/quotes"
+             "?symbols=A,B,...");
+DEFINE_int32(ws_max_fps, 10, "Max frames a second to a WebSocket client.");
 
 DEFINE_VARZ_int64(start_ts, now_micros(), "Start real timestamp in micros.");
 DEFINE_VARZ_int64(data_start, 0, "Start event timestamp in micros.");
@@ -37,6 +53,21 @@ DEFINE_VARZ_double(message_rate, 0., "Message rate");
 DEFINE_VARZ_int32(bid, 0, "bid");
 DEFINE_VARZ_int32(ask, 0, "ask");
 DEFINE_VARZ_int32(mid, 0, "mid");
+DEFINE_VARZ_int32(ws_clients, 0, "Streaming WebSocket clients.");
+
+// Latest quotes, written by the subscriber through the BackPlane and
+// read by the WebSocket sender.
+static ib::QuoteTable QUOTES(4096);
+
+// Sends to every WebSocket client, on its own thread.  Owned by main,
+// which joins the acceptor before it goes.
+static ib::QuoteSender* SENDER = NULL;
+
+// Set by main before it shuts the listener, to stop the acceptor.
+static volatile bool STOPPING = false;
+
+// Micros a client has for its whole handshake request.
+static const int64_t HANDSHAKE_MICROS = 1000000;
 
 struct Instrument;
 static map<int, Instrument*> TICKERS;
@@ -78,9 +109,10 @@ static bool receive(zmq::socket_t & socket, std::string* output) {
 //////////////////////////////////////////////
 class Subscriber {
  public:
-  Subscriber(zmq::context_t *context) :
+  Subscriber(zmq::context_t *context, ib::BackPlane* backplane) :
       context(context),
-      socket(*context, ZMQ_SUB) {
+      socket(*context, ZMQ_SUB),
+      backplane(backplane) {
 
     socket.connect(FLAGS_endpoint.c_str());
     VLOG(1) << "Subscriber connected @ " << FLAGS_endpoint << endl;
@@ -151,12 +183,17 @@ class Subscriber {
         uint64_t receiveTs = now_micros();
         uint64_t latencyMicros = receiveTs - ts;
 
+        const int id = ib::signal::GetTickerId(symbol);
         if (type.compare("BID") == 0) {
           VARZ_bid = (int)(price * 100.);
           VARZ_mid = VARZ_bid + (VARZ_ask - VARZ_bid) / 2;
+          backplane->OnBid(ts, id, price);
         } else if (type.compare("ASK") == 0) {
           VARZ_ask = (int)(price * 100.);
           VARZ_mid = VARZ_bid + (VARZ_ask - VARZ_bid) / 2;
+          backplane->OnAsk(ts, id, price);
+        } else if (type.compare("LAST") == 0) {
+          backplane->OnLast(ts, id, price);
         }
         LOG(INFO) << messages << ' '
                   << symbol << ' '
@@ -185,17 +222,11 @@ class Subscriber {
  private:
   zmq::context_t *context;
   zmq::socket_t socket;
+  ib::BackPlane* backplane;
 };
 
 
 
-static const char *mongoose_options[] = {
-  "document_root", "www",
-  "listening_ports", "8080",
-  "num_threads", "3",
-  NULL
-};
-
 static void get_qsvar(const struct mg_request_info *request_info,
                       const char *name, char *dst, size_t dst_len) {
   const char *qs = request_info->query_string;
@@ -209,6 +240,89 @@ static const char * HTTP_200 =
   "Content-Type: application/json; charset=utf-8\r\n"
   "\r\n";
 
+// Takes a WebSocket client through the handshake and hands it to the
+// sender with the quotes of ?symbols=A,B,...  Returns false, and the
+// socket is to be closed, if it is not one.
+static bool accept_quotes(int fd) {
+  // A client that does not send its request soon is not waited for,
+  // however it trickles it in: the acceptor serves one at a time.
+  const int64_t deadline = now_micros() + HANDSHAKE_MICROS;
+  string request;
+  char buffer[1024];
+  while (request.find("\r\n\r\n") == string::npos &&
+         request.size() < 8192) {
+    const int64_t left = deadline - now_micros();
+    struct pollfd readable = { fd, POLLIN, 0 };
+    if (left <= 0 || poll(&readable, 1, (left + 999) / 1000) <= 0) {
+      return false;
+    }
+    const ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) return false;
+    request.append(buffer, n);
+  }
+  string target, key;
+  if (!ib::websocket::ParseUpgrade(request, &target, &key) ||
+      target.compare(0, 7, "/quotes") != 0) {
+    static const string bad = "HTTP/1.1 400 Bad Request\r\n\r\n";
+    send(fd, bad.data(), bad.size(), MSG_NOSIGNAL);
+    return false;
+  }
+  const size_t query = target.find('?');
+  char symbols[1024] = "";
+  if (query != string::npos) {
+    mg_get_var(target.c_str() + query + 1, target.size() - query - 1,
+               "symbols", symbols, sizeof(symbols));
+  }
+  vector<string> list;
+  split(list, symbols, is_any_of(","), token_compress_on);
+  ib::ConflatedQuotes* quotes = new ib::ConflatedQuotes(&QUOTES);
+  for (vector<string>::iterator s = list.begin(); s != list.end(); ++s) {
+    if (!s->empty()) quotes->Subscribe(*s);
+  }
+  const string response = ib::websocket::HandshakeResponse(key);
+  if (send(fd, response.data(), response.size(), MSG_NOSIGNAL) !=
+      static_cast<ssize_t>(response.size())) {
+    delete quotes;
+    return false;
+  }
+  LOG(INFO) << "Streaming " << quotes->size() << " symbols." << endl;
+  SENDER->Add(fd, quotes);
+  return true;
+}
+
+// Accepts WebSocket clients on --ws_port until STOPPING.  The httpd
+// threads are not held by them.
+static void serve_quotes(int listener) {
+  while (true) {
+    const int fd = accept(listener, NULL, NULL);
+    if (fd < 0) {
+      if (STOPPING) return;
+      if (errno == EINTR) continue;
+      PLOG(ERROR) << "Cannot accept WebSocket clients";
+      return;
+    }
+    if (!accept_quotes(fd)) close(fd);
+  }
+}
+
+static int listen_quotes(int port) {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+  const int on = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (::bind(fd, reinterpret_cast<struct sockaddr*>(&address),
+             sizeof(address)) != 0 || listen(fd, 16) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
 
 static void *event_handler(enum mg_event event,
                            struct mg_connection *conn,
@@ -236,6 +350,7 @@ static void *event_handler(enum mg_event event,
     } else if (strcmp(request_info->uri, "/varz") == 0) {
 
       VLOG(20) << "varz request" << endl;
+      VARZ_ws_clients = SENDER->clients();
       mg_printf(conn, "%s", HTTP_200);
       mg_printf(conn, "%s", "{");
 
@@ -273,18 +388,53 @@ int main(int argc, char** argv)
   google::ParseCommandLineFlags(&argc, &argv, true);
   google::InitGoogleLogging(argv[0]);
 
+  // Quotes to the table through the BackPlane.
+  scoped_ptr<ib::BackPlane> backplane(ib::BackPlane::Create());
+  ib::QuoteTableReceiver quote_table(&QUOTES);
+  backplane->Register(static_cast<ib::Receiver<BidAsk>*>(&quote_table));
+  backplane->Register(static_cast<ib::Receiver<Last>*>(&quote_table));
+
   // Start Httpd
+  const string threads = lexical_cast<string>(FLAGS_http_threads);
+  const char *mongoose_options[] = {
+    "document_root", "www",
+    "listening_ports", "8080",
+    "num_threads", threads.c_str(),
+    NULL
+  };
   struct mg_context *ctx;
   ctx = mg_start(&event_handler, mongoose_options);
   assert(ctx != NULL);
 
   LOG(INFO) << "httpd started." << endl;
 
+  // WebSocket quotes, apart from the httpd.
+  ib::QuoteSender sender(FLAGS_ws_max_fps);
+  SENDER = &sender;
+  sender.Start();
+  const int listener = listen_quotes(FLAGS_ws_port);
+  scoped_ptr<boost::thread> acceptor;
+  if (listener < 0) {
+    PLOG(ERROR) << "Cannot listen on " << FLAGS_ws_port
+                << ". No WebSocket quotes.";
+  } else {
+    acceptor.reset(new boost::thread(boost::bind(&serve_quotes, listener)));
+  }
+
   // ZMQ Subscriber
   zmq::context_t context(1);
-  Subscriber subscriber(&context);
+  Subscriber subscriber(&context, backplane.get());
   subscriber.Run();
 
+  // The acceptor hands clients to the sender, so it goes first:
+  // shutting the listener fails its accept.
+  if (acceptor) {
+    STOPPING = true;
+    shutdown(listener, SHUT_RDWR);
+    acceptor->join();
+    close(listener);
+  }
+
   LOG(INFO) << "Stopping httpd." << endl;
 
   // Stop httpd
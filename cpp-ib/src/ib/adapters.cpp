@@ -41,6 +41,12 @@ inline boost::posix_time::time_duration utc_micros()
 namespace ib {
 namespace adapter {
 
+// A name interned by the wire decoder, or empty.
+static string Name(const wire::Interner& names, int id)
+{
+  return id == wire::Interner::NONE ? string() : names.Name(id).str();
+}
+
 LoggingEWrapper::LoggingEWrapper(const string host,
                                  const unsigned int port,
                                  const unsigned int connection_id)
@@ -218,6 +224,39 @@ void LoggingEWrapper::contractDetails(int reqId,
       << __f__(&contractDetails)
       << PrintContract(contractDetails);
 }
+void LoggingEWrapper::contractDetailsView(
+    int reqId, const wire::ContractDetailsView& details,
+    const wire::Interner& names) {
+  ContractDetails copy;
+  Contract& summary = copy.summary;
+  summary.symbol = details.symbol.str();
+  summary.secType = Name(names, details.sec_type);
+  summary.expiry = details.expiry.str();
+  summary.strike = details.strike;
+  summary.right = details.right.str();
+  summary.exchange = Name(names, details.exchange);
+  summary.currency = Name(names, details.currency);
+  summary.localSymbol = details.local_symbol.str();
+  summary.conId = details.con_id;
+  summary.multiplier = details.multiplier.str();
+  summary.primaryExchange = Name(names, details.primary_exchange);
+  copy.marketName = details.market_name.str();
+  copy.tradingClass = details.trading_class.str();
+  copy.minTick = details.min_tick;
+  copy.orderTypes = details.order_types.str();
+  copy.validExchanges = details.valid_exchanges.str();
+  copy.priceMagnifier = details.price_magnifier;
+  copy.underConId = details.under_con_id;
+  copy.longName = details.long_name.str();
+  copy.contractMonth = details.contract_month.str();
+  copy.industry = details.industry.str();
+  copy.category = details.category.str();
+  copy.subcategory = details.subcategory.str();
+  copy.timeZoneId = Name(names, details.time_zone_id);
+  copy.tradingHours = details.trading_hours.str();
+  copy.liquidHours = details.liquid_hours.str();
+  contractDetails(reqId, copy);
+}
 void LoggingEWrapper::bondContractDetails(
     int reqId, const ContractDetails& contractDetails) {
   LOG_EVENT
@@ -298,7 +337,7 @@ void LoggingEWrapper::historicalData(TickerId reqId, const IBString& date,
 }
 void LoggingEWrapper::scannerParameters(const IBString &xml) {
   LOG_EVENT
-      << __f__(xml);
+      << ",xml_bytes=" << xml.size();  // Megabytes at times.
 }
 void LoggingEWrapper::scannerData(int reqId, int rank,
                                   const ContractDetails &contractDetails,
@@ -337,7 +376,7 @@ void LoggingEWrapper::realtimeBar(TickerId reqId, long time,
 void LoggingEWrapper::fundamentalData(TickerId reqId, const IBString& data) {
   LOG_EVENT
       << __f__(reqId)
-      << __f__(data);
+      << ",data_bytes=" << data.size();
 }
 void LoggingEWrapper::deltaNeutralValidation(int reqId,
                                              const UnderComp& underComp) {
@@ -402,9 +441,12 @@ typedef boost::unique_lock<boost::mutex> write_lock;
 
 LoggingEClientSocket::LoggingEClientSocket(
     unsigned int connection_id,
-    EWrapper* e_wrapper)
+    LoggingEWrapper* e_wrapper)
     : EPosixClientSocket::EPosixClientSocket(e_wrapper)
-    , connection_id_(connection_id) {
+    , connection_id_(connection_id)
+    , views_(e_wrapper)
+    , decoder_(&views_) {
+  views_.set_names(decoder_.names());
 }
 
 LoggingEClientSocket::~LoggingEClientSocket() {
@@ -415,6 +457,14 @@ const unsigned int LoggingEClientSocket::get_connection_id()
   return connection_id_;
 }
 
+int LoggingEClientSocket::decodeMsg(const char* ptr, const char* endPtr) {
+  return decoder_.Decode(ptr, endPtr);
+}
+
+wire::Encoder<wire::CurrentApi> LoggingEClientSocket::encoder() {
+  return wire::Encoder<wire::CurrentApi>(EPosixClientSocket::serverVersion());
+}
+
 bool LoggingEClientSocket::eConnect(const char *host,
                                     unsigned int port, int clientId) {
   LOG_START <<
@@ -453,13 +503,26 @@ void LoggingEClientSocket::reqMktData(TickerId id, const Contract &contract,
       << __f__(genericTicks)
       << __f__(snapshot);
   write_lock lock(socket_write_mutex_);
-  EPosixClientSocket::reqMktData(id, contract, genericTicks, snapshot);
+  string msg;
+  // Otherwise EClientSocketBase reports why the request cannot be sent.
+  if (isConnected() &&
+      encoder().ReqMktData(id, contract, genericTicks, snapshot, &msg)) {
+    bufferedSend(msg);
+  } else {
+    EPosixClientSocket::reqMktData(id, contract, genericTicks, snapshot);
+  }
   LOG_END;
 }
 void LoggingEClientSocket::cancelMktData(TickerId id) {
   LOG_START;
   write_lock lock(socket_write_mutex_);
-  EPosixClientSocket::cancelMktData(id);
+  if (isConnected()) {
+    string msg;
+    encoder().CancelMktData(id, &msg);
+    bufferedSend(msg);
+  } else {
+    EPosixClientSocket::cancelMktData(id);
+  }
   LOG_END;
 }
 void LoggingEClientSocket::placeOrder(OrderId id, const Contract &contract,
@@ -526,14 +589,26 @@ void LoggingEClientSocket::reqMktDepth(TickerId id,
       << __f__(&contract)
       << __f__(numRows);
   write_lock lock(socket_write_mutex_);
-  EPosixClientSocket::reqMktDepth(id, contract, numRows);
+  if (isConnected()) {
+    string msg;
+    encoder().ReqMktDepth(id, contract, numRows, &msg);
+    bufferedSend(msg);
+  } else {
+    EPosixClientSocket::reqMktDepth(id, contract, numRows);
+  }
   LOG_END;
 }
 void LoggingEClientSocket::cancelMktDepth(TickerId id) {
   LOG_START
       << __f__(id);
   write_lock lock(socket_write_mutex_);
-  EPosixClientSocket::cancelMktDepth(id);
+  if (isConnected()) {
+    string msg;
+    encoder().CancelMktDepth(id, &msg);
+    bufferedSend(msg);
+  } else {
+    EPosixClientSocket::cancelMktDepth(id);
+  }
   LOG_END;
 }
 void LoggingEClientSocket::reqNewsBulletins(bool allMsgs) {
@@ -685,7 +760,13 @@ void LoggingEClientSocket::reqScannerSubscription(
 void LoggingEClientSocket::reqCurrentTime() {
   LOG_START;
   write_lock lock(socket_write_mutex_);
-  EPosixClientSocket::reqCurrentTime();
+  if (isConnected()) {
+    string msg;
+    encoder().ReqCurrentTime(&msg);
+    bufferedSend(msg);
+  } else {
+    EPosixClientSocket::reqCurrentTime();
+  }
   LOG_END;
 }
 void LoggingEClientSocket::reqFundamentalData(
@@ -26,6 +26,10 @@
 #include <Shared/Order.h>
 #include <PosixSocketClient/EPosixClientSocket.h>
 
+#include "ib/wire/api_traits.hpp"
+#include "ib/wire/decoder.hpp"
+#include "ib/wire/encoder.hpp"
+
 using namespace std;
 
 namespace ib {
@@ -152,20 +156,132 @@ class LoggingEWrapper : public EWrapper {
   void fundamentalData(TickerId reqId, const IBString& data);
   void deltaNeutralValidation(int reqId, const UnderComp& underComp);
   void tickSnapshotEnd(int reqId);
+
+ public:
+
+  // Contract details as LoggingEClientSocket decodes them: views into
+  // its buffer, valid during the call, and ids of names.  Copied into
+  // a ContractDetails for contractDetails unless overridden.
+  virtual void contractDetailsView(int reqId,
+                                   const wire::ContractDetailsView& details,
+                                   const wire::Interner& names);
+};
+
+
+// The handler of LoggingEClientSocket's wire::Decoder: contract details
+// go to the wrapper as views, the strings of the other messages are
+// copied for their EWrapper calls.
+class ViewForwarder {
+ public:
+
+  explicit ViewForwarder(LoggingEWrapper* wrapper)
+      : wrapper_(wrapper), names_(NULL) {}
+
+  // The decoder's.
+  void set_names(const wire::Interner* names) { names_ = names; }
+
+  void tickPrice(TickerId tickerId, TickType field, double price,
+                 int canAutoExecute) {
+    wrapper_->tickPrice(tickerId, field, price, canAutoExecute);
+  }
+  void tickSize(TickerId tickerId, TickType field, int size) {
+    wrapper_->tickSize(tickerId, field, size);
+  }
+  void tickOptionComputation(TickerId tickerId, TickType tickType,
+                             double impliedVol,
+                             double delta, double optPrice, double pvDividend,
+                             double gamma, double vega,
+                             double theta, double undPrice) {
+    wrapper_->tickOptionComputation(tickerId, tickType, impliedVol, delta,
+                                    optPrice, pvDividend, gamma, vega, theta,
+                                    undPrice);
+  }
+  void tickGeneric(TickerId tickerId, TickType tickType, double value) {
+    wrapper_->tickGeneric(tickerId, tickType, value);
+  }
+  void tickString(TickerId tickerId, TickType tickType,
+                  const wire::StringRef& value) {
+    wrapper_->tickString(tickerId, tickType, value.str());
+  }
+  void orderStatus(OrderId orderId, const wire::StringRef& status,
+                   int filled, int remaining, double avgFillPrice,
+                   int permId, int parentId, double lastFillPrice,
+                   int clientId, const wire::StringRef& whyHeld) {
+    wrapper_->orderStatus(orderId, status.str(), filled, remaining,
+                          avgFillPrice, permId, parentId, lastFillPrice,
+                          clientId, whyHeld.str());
+  }
+  void error(int id, int errorCode, const wire::StringRef& errorString) {
+    wrapper_->error(id, errorCode, errorString.str());
+  }
+  void nextValidId(OrderId orderId) {
+    wrapper_->nextValidId(orderId);
+  }
+  void updateMktDepth(TickerId id, int position, int operation, int side,
+                      double price, int size) {
+    wrapper_->updateMktDepth(id, position, operation, side, price, size);
+  }
+  void updateMktDepthL2(TickerId id, int position, int marketMaker,
+                        int operation, int side, double price, int size) {
+    wrapper_->updateMktDepthL2(
+        id, position,
+        marketMaker == wire::Interner::NONE ?
+        IBString() : names_->Name(marketMaker).str(),
+        operation, side, price, size);
+  }
+  void contractDetails(int reqId, const wire::ContractDetailsView& details) {
+    wrapper_->contractDetailsView(reqId, details, *names_);
+  }
+  void contractDetailsEnd(int reqId) {
+    wrapper_->contractDetailsEnd(reqId);
+  }
+  void realtimeBar(TickerId reqId, long time, double open, double high,
+                   double low, double close,
+                   long volume, double wap, int count) {
+    wrapper_->realtimeBar(reqId, time, open, high, low, close, volume, wap,
+                          count);
+  }
+  void currentTime(long time) {
+    wrapper_->currentTime(time);
+  }
+  void tickSnapshotEnd(int reqId) {
+    wrapper_->tickSnapshotEnd(reqId);
+  }
+
+ private:
+
+  LoggingEWrapper* const wrapper_;
+  const wire::Interner* names_;
 };
 
 
+// Market data requests are encoded, and market data, order status,
+// contract details and the other messages in
+// //cpp-ib/src/ib/wire/messages.hpp decoded, by ib::wire for the
+// release the tree is built against; the rest is left to
+// EClientSocketBase.  Strings are decoded in place (wire::ViewStrings)
+// and the names of contract details interned.
 class LoggingEClientSocket : public EPosixClientSocket {
  public:
 
-  LoggingEClientSocket(unsigned int connection_id, EWrapper* e_wrapper);
+  LoggingEClientSocket(unsigned int connection_id, LoggingEWrapper* e_wrapper);
   ~LoggingEClientSocket();
 
+ protected:
+
+  // From EClientSocketBase
+  int decodeMsg(const char* ptr, const char* endPtr);
+
  private:
 
+  // Only once connected, when the server version is known.
+  wire::Encoder<wire::CurrentApi> encoder();
+
   boost::mutex socket_write_mutex_;  // For outbound messages only.
   const unsigned int connection_id_;
   uint64_t call_start_;
+  ViewForwarder views_;
+  wire::Decoder<wire::CurrentApi, ViewForwarder, wire::ViewStrings> decoder_;
 
  public:
 
@@ -1712,6 +1712,20 @@ int EClientSocketBase::bufferedRead()
 	return nResult;
 }
 
+int EClientSocketBase::decodeMsg(const char* ptr, const char* endPtr)
+{
+	return -1;
+}
+
+int EClientSocketBase::processAnyMsg(const char*& ptr, const char* endPtr)
+{
+	int processed = decodeMsg( ptr, endPtr);
+	if( processed < 0)
+		return processMsg( ptr, endPtr);
+	ptr += processed;
+	return processed;
+}
+
 bool EClientSocketBase::checkMessages()
 {
 	if( !isSocketOK())
@@ -1726,7 +1740,7 @@ bool EClientSocketBase::checkMessages()
 	const char*	endPtr = ptr + m_inBuffer.size();
 
 	try {
-		while( (m_connected ? processMsg( ptr, endPtr)
+		while( (m_connected ? processAnyMsg( ptr, endPtr)
 			                : processConnectAck( ptr, endPtr)) > 0) {
 			if( (ptr - beginPtr) >= (int)m_inBuffer.size())
 				break;
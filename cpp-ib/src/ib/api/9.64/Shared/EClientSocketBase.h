@@ -95,11 +95,15 @@ protected:
 
 	int sendBufferedData();
 
-private:
-
 	int bufferedSend(const char* buf, size_t sz);
 	int bufferedSend(const std::string& msg);
 
+	// try to decode a single msg ahead of processMsg; return number of
+	// bytes consumed, 0 if incomplete or -1 to leave it to processMsg
+	virtual int decodeMsg(const char* ptr, const char* endPtr);
+
+private:
+
 	// read and buffer what's available
 	int bufferedRead();
 
@@ -109,6 +113,9 @@ private:
 	// try to process single msg
 	int processMsg(const char*& ptr, const char* endPtr);
 
+	// try decodeMsg, then processMsg
+	int processAnyMsg(const char*& ptr, const char* endPtr);
+
 	static bool CheckOffset(const char* ptr, const char* endPtr);
 	static const char* FindFieldEnd(const char* ptr, const char* endPtr);
 
@@ -0,0 +1,171 @@
+
+#include <math.h>
+#include <algorithm>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "ib/asof_join.hpp"
+
+using namespace std;
+
+namespace ib {
+namespace history {
+
+bool FieldFromName(const string& name, QuoteTable::Field* field)
+{
+  static const char* NAMES[] = {
+    "BID", "BID_SIZE", "ASK", "ASK_SIZE", "LAST", "LAST_SIZE"
+  };
+  for (int i = 0; i < 6; ++i) {
+    if (name == NAMES[i]) {
+      *field = static_cast<QuoteTable::Field>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+static inline int64_t ColumnKey(int id, QuoteTable::Field field)
+{
+  return (static_cast<int64_t>(id) << 3) | field;
+}
+
+size_t JoinColumns::Add(int id, QuoteTable::Field field)
+{
+  int64_t key = ColumnKey(id, field);
+  map<int64_t, int>::iterator found = columns_.find(key);
+  if (found != columns_.end()) return found->second;
+  columns_[key] = keys_.size();
+  keys_.push_back(key);
+  return keys_.size() - 1;
+}
+
+size_t JoinColumns::Add(const string& symbol, QuoteTable::Field field)
+{
+  return Add(signal::GetTickerId(symbol), field);
+}
+
+int JoinColumns::Find(int id, QuoteTable::Field field) const
+{
+  map<int64_t, int>::const_iterator found =
+      columns_.find(ColumnKey(id, field));
+  return found == columns_.end() ? -1 : found->second;
+}
+
+AsOfIndex::AsOfIndex(const JoinColumns& columns)
+    : columns_(columns)
+    , series_(columns.size())
+    , sealed_(false)
+{
+}
+
+bool AsOfIndex::Add(int64_t ts, int id, QuoteTable::Field field, double value)
+{
+  CHECK(!sealed_);
+  int column = columns_.Find(id, field);
+  if (column < 0) return false;
+  series_[column].ts.push_back(ts);
+  series_[column].values.push_back(value);
+  return true;
+}
+
+namespace {
+
+struct EarlierTick
+{
+  bool operator()(const pair<int64_t, double>& a,
+                  const pair<int64_t, double>& b) const
+  {
+    return a.first < b.first;
+  }
+};
+
+} // namespace
+
+void AsOfIndex::Seal()
+{
+  for (size_t c = 0; c < series_.size(); ++c) {
+    Series& s = series_[c];
+    // Usually recorded in order already.
+    bool sorted = true;
+    for (size_t i = 1; sorted && i < s.ts.size(); ++i) {
+      sorted = s.ts[i - 1] <= s.ts[i];
+    }
+    if (!sorted) {
+      vector<pair<int64_t, double> > ticks(s.ts.size());
+      for (size_t i = 0; i < ticks.size(); ++i) {
+        ticks[i] = make_pair(s.ts[i], s.values[i]);
+      }
+      // Stable, so ticks at the same time keep their order.
+      stable_sort(ticks.begin(), ticks.end(), EarlierTick());
+      for (size_t i = 0; i < ticks.size(); ++i) {
+        s.ts[i] = ticks[i].first;
+        s.values[i] = ticks[i].second;
+      }
+    }
+  }
+  sealed_ = true;
+}
+
+void AsOfIndex::Fill(int64_t ts, double* row, size_t* cursors) const
+{
+  DCHECK(sealed_);
+  for (size_t c = 0; c < series_.size(); ++c) {
+    const vector<int64_t>& times = series_[c].ts;
+    const size_t n = times.size();
+    // The cursor is the number of ticks at or before the previous ts.
+    size_t i = min(cursors[c], n);
+    if (i < n && times[i] <= ts) {
+      // Forward: gallop from the cursor, then binary search.
+      size_t step = 1;
+      while (i + step < n && times[i + step] <= ts) step <<= 1;
+      i = upper_bound(times.begin() + i + step / 2,
+                      times.begin() + min(i + step, n), ts) - times.begin();
+    } else if (i > 0 && times[i - 1] > ts) {
+      i = upper_bound(times.begin(), times.begin() + i, ts) - times.begin();
+    }
+    cursors[c] = i;
+    row[c] = i > 0 ? series_[c].values[i - 1] : NAN;
+  }
+}
+
+size_t AsOfIndex::ticks() const
+{
+  size_t n = 0;
+  for (size_t c = 0; c < series_.size(); ++c) n += series_[c].ts.size();
+  return n;
+}
+
+AsOfJoin::AsOfJoin(const JoinColumns& columns, const signal::SymbolSet& left,
+                   const AsOfIndex* history, Receiver<JoinedTick>* out)
+    : columns_(columns)
+    , left_(left)
+    , history_(history)
+    , out_(out)
+    , row_(columns.size(), NAN)
+    , cursors_(columns.size(), 0)
+    , joined_(0)
+{
+  CHECK(out_);
+}
+
+void AsOfJoin::OnField(int64_t ts, int id, Field field, double value)
+{
+  if (history_ == NULL) {
+    int column = columns_.Find(id, field);
+    if (column >= 0) row_[column] = value;
+  }
+  if (!left_.Contains(id)) return;
+  if (history_ != NULL && !row_.empty()) {
+    history_->Fill(ts, &row_[0], &cursors_[0]);
+  }
+  JoinedTick joined = {
+    ts, id, field, value, row_.empty() ? NULL : &row_[0], row_.size()
+  };
+  (*out_)(joined);
+  ++joined_;
+}
+
+} // namespace history
+} // namespace ib
@@ -0,0 +1,128 @@
+#ifndef IB_ASOF_JOIN_H_
+#define IB_ASOF_JOIN_H_
+
+// As-of join of ticks against the latest values of a few other
+// series, e.g. every option quote with the underlying's bid and ask at
+// that moment, or one leg of a pair with the other.
+//
+// The right side is a fixed list of columns, each one field of one
+// id.  Every tick of an id on the left side is passed on as a
+// JoinedTick, with the value of each column at or before its time
+// (NaN before the column's first tick).  The right side comes either
+//
+//   from history   an AsOfIndex holds the recorded ticks of each
+//                  column in time order and is searched per column
+//                  (the previous position first, then binary search),
+//   live           the join keeps the latest value of each column as
+//                  the ticks go by.
+//
+// A tick may be on both sides; its column is updated before it is
+// joined.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+#include "ib/backplane.hpp"
+#include "ib/quote_table.hpp"
+#include "ib/symbol_set.hpp"
+
+namespace ib {
+namespace history {
+
+// The field named as in the logger output (BID, ASK_SIZE, ...).
+// Returns false for fields that are not quote fields.
+bool FieldFromName(const std::string& name, QuoteTable::Field* field);
+
+struct JoinedTick
+{
+  int64_t ts;
+  int id;
+  QuoteTable::Field field;
+  double value;
+  const double* right;  // One value per column.
+  size_t columns;
+};
+
+// The right-side columns of a join, in order.
+class JoinColumns
+{
+ public:
+  // Returns the index of the column.
+  size_t Add(int id, QuoteTable::Field field);
+  size_t Add(const std::string& symbol, QuoteTable::Field field);
+
+  // Column of the id and field, or -1.
+  int Find(int id, QuoteTable::Field field) const;
+
+  size_t size() const { return keys_.size(); }
+
+ private:
+  std::vector<int64_t> keys_;
+  std::map<int64_t, int> columns_;
+};
+
+// Recorded ticks of the columns, for joins over history.
+class AsOfIndex : NoCopyAndAssign
+{
+ public:
+  explicit AsOfIndex(const JoinColumns& columns);
+
+  // Keeps the tick if it belongs to a column; returns false otherwise.
+  // Ticks need not arrive in time order.
+  bool Add(int64_t ts, int id, QuoteTable::Field field, double value);
+
+  // Sorts the columns by time.  Must be called after the last Add and
+  // before the first Fill.
+  void Seal();
+
+  // Writes the value of every column as of ts to row.  cursors holds
+  // one position per column, zero to start with; it makes a scan of
+  // nondecreasing ts close to linear.
+  void Fill(int64_t ts, double* row, size_t* cursors) const;
+
+  size_t ticks() const;
+
+ private:
+  struct Series
+  {
+    std::vector<int64_t> ts;
+    std::vector<double> values;
+  };
+
+  const JoinColumns& columns_;
+  std::vector<Series> series_;
+  bool sealed_;
+};
+
+class AsOfJoin : public FieldReceiver
+{
+ public:
+  // Joins the ticks of the left ids.  With a NULL history the columns
+  // are the live values of the ticks seen by the join.  The columns,
+  // history and out must outlive the join.
+  AsOfJoin(const JoinColumns& columns, const signal::SymbolSet& left,
+           const AsOfIndex* history, Receiver<JoinedTick>* out);
+
+  // One tick, from the BackPlane or a log.
+  virtual void OnField(int64_t ts, int id, Field field, double value);
+
+  uint64_t joined() const { return joined_; }
+
+ private:
+  const JoinColumns& columns_;
+  const signal::SymbolSet left_;
+  const AsOfIndex* history_;
+  Receiver<JoinedTick>* out_;
+  std::vector<double> row_;
+  std::vector<size_t> cursors_;
+  uint64_t joined_;
+};
+
+} // namespace history
+} // namespace ib
+
+#endif // IB_ASOF_JOIN_H_
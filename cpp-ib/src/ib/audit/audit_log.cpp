@@ -0,0 +1,436 @@
+#include <string.h>
+
+#include <sqlite3.h>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "utils.hpp"
+#include "ib/audit/audit_log.hpp"
+
+#define VLOG_LEVEL 2
+
+using namespace std;
+
+namespace ib {
+namespace audit {
+
+DEFINE_int32(audit_queue_size, 1 << 14,
+             "Max records waiting for the audit writer. Power of 2.");
+DEFINE_int32(audit_batch_size, 512,
+             "Max records committed in one audit transaction.");
+DEFINE_int32(audit_idle_micros, 2000,
+             "Audit writer sleep in micros when there is nothing to write.");
+
+static const char* SCHEMA =
+    "CREATE TABLE IF NOT EXISTS orders ("
+    "  ts INTEGER, order_id INTEGER, client_id INTEGER, perm_id INTEGER,"
+    "  symbol TEXT, sec_type TEXT, action TEXT, order_type TEXT,"
+    "  quantity INTEGER, limit_price REAL, aux_price REAL, account TEXT);"
+    "CREATE TABLE IF NOT EXISTS order_status ("
+    "  ts INTEGER, order_id INTEGER, perm_id INTEGER, client_id INTEGER,"
+    "  status TEXT, filled INTEGER, remaining INTEGER,"
+    "  avg_fill_price REAL, last_fill_price REAL, why_held TEXT);"
+    "CREATE TABLE IF NOT EXISTS executions ("
+    "  ts INTEGER, exec_id TEXT, exec_time TEXT, order_id INTEGER,"
+    "  perm_id INTEGER, client_id INTEGER, symbol TEXT, sec_type TEXT,"
+    "  side TEXT, shares INTEGER, price REAL, cum_qty INTEGER,"
+    "  avg_price REAL, account TEXT, exchange TEXT);"
+    "CREATE TABLE IF NOT EXISTS trades ("
+    "  ts INTEGER, trade_id INTEGER, trade_ts INTEGER, date TEXT,"
+    "  order_type INTEGER, cusip TEXT, security TEXT, description TEXT,"
+    "  quantity INTEGER, price REAL, commission REAL, net REAL);"
+    "CREATE TABLE IF NOT EXISTS gain_loss ("
+    "  ts INTEGER, id INTEGER, symbol TEXT, quantity INTEGER,"
+    "  open_date TEXT, open_price REAL, open_net REAL, order_type INTEGER,"
+    "  closing_date TEXT, closing_price REAL, closing_net REAL,"
+    "  gain_loss REAL);"
+    "CREATE INDEX IF NOT EXISTS orders_id ON orders (order_id);"
+    "CREATE INDEX IF NOT EXISTS order_status_id ON order_status (order_id);"
+    "CREATE INDEX IF NOT EXISTS executions_id ON executions (order_id);"
+    "CREATE INDEX IF NOT EXISTS executions_ts ON executions (ts);";
+
+// Indexed by Record::Kind.
+static const char* INSERTS[Record::NUM_KINDS] = {
+  "INSERT INTO orders VALUES (?,?,?,?,?,?,?,?,?,?,?,?)",
+  "INSERT INTO order_status VALUES (?,?,?,?,?,?,?,?,?,?)",
+  "INSERT INTO executions VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)",
+  "INSERT INTO trades VALUES (?,?,?,?,?,?,?,?,?,?,?,?)",
+  "INSERT INTO gain_loss VALUES (?,?,?,?,?,?,?,?,?,?,?,?)",
+};
+
+static bool Exec(sqlite3* db, const char* sql)
+{
+  char* error = NULL;
+  if (sqlite3_exec(db, sql, NULL, NULL, &error) != SQLITE_OK) {
+    LOG(ERROR) << "SQLite error: " << (error ? error : "?") << " in " << sql;
+    sqlite3_free(error);
+    return false;
+  }
+  return true;
+}
+
+// Callback for reading back the result of a PRAGMA.
+static int FirstColumn(void* out, int columns, char** values, char** names)
+{
+  if (columns > 0 && values[0]) static_cast<string*>(out)->assign(values[0]);
+  return 0;
+}
+
+AuditLog::AuditLog(const string& path)
+    : path_(path)
+    , queue_(FLAGS_audit_queue_size)
+    , writer_(NULL)
+    , reader_(NULL)
+    , stop_requested_(false)
+    , enqueued_(0)
+    , committed_(0)
+    , failed_(0)
+    , dropped_(0)
+    , batches_(0)
+{
+  memset(inserts_, 0, sizeof(inserts_));
+  batch_.reserve(FLAGS_audit_batch_size);
+}
+
+AuditLog::~AuditLog()
+{
+  if (writer_thread_) Stop();
+  for (int i = 0; i < Record::NUM_KINDS; ++i) {
+    if (inserts_[i]) sqlite3_finalize(inserts_[i]);
+  }
+  if (writer_) sqlite3_close(writer_);
+  if (reader_) sqlite3_close(reader_);
+}
+
+bool AuditLog::OpenWriter()
+{
+  if (sqlite3_open_v2(path_.c_str(), &writer_,
+                      SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                      NULL) != SQLITE_OK) {
+    LOG(ERROR) << "Cannot open audit db " << path_ << ": "
+               << sqlite3_errmsg(writer_);
+    return false;
+  }
+
+  // Write-ahead logging lets readers proceed while the writer commits.
+  // Older SQLite (< 3.7) does not have it, in which case keep the
+  // journal file around between transactions to save the create and
+  // unlink on every batch.
+  string mode;
+  sqlite3_exec(writer_, "PRAGMA journal_mode=WAL", FirstColumn, &mode, NULL);
+  if (mode != "wal") {
+    sqlite3_exec(writer_, "PRAGMA journal_mode=PERSIST", FirstColumn, &mode,
+                 NULL);
+  }
+  LOG(INFO) << "Audit db " << path_ << " journal_mode=" << mode;
+
+  if (!Exec(writer_, "PRAGMA synchronous=NORMAL")) return false;
+  if (!Exec(writer_, SCHEMA)) return false;
+
+  for (int i = 0; i < Record::NUM_KINDS; ++i) {
+    if (sqlite3_prepare_v2(writer_, INSERTS[i], -1, &inserts_[i],
+                           NULL) != SQLITE_OK) {
+      LOG(ERROR) << "Cannot prepare " << INSERTS[i] << ": "
+                 << sqlite3_errmsg(writer_);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool AuditLog::OpenReader()
+{
+  if (reader_) return true;
+  if (sqlite3_open_v2(path_.c_str(), &reader_, SQLITE_OPEN_READONLY,
+                      NULL) != SQLITE_OK) {
+    LOG(ERROR) << "Cannot open audit db " << path_ << " for reading: "
+               << sqlite3_errmsg(reader_);
+    sqlite3_close(reader_);
+    reader_ = NULL;
+    return false;
+  }
+  sqlite3_busy_timeout(reader_, 1000);
+  return true;
+}
+
+bool AuditLog::Start()
+{
+  CHECK(!writer_thread_);
+  if (!OpenWriter()) return false;
+  stop_requested_ = false;
+  writer_thread_.reset(
+      new boost::thread(boost::bind(&AuditLog::WriterLoop, this)));
+  return true;
+}
+
+void AuditLog::Stop()
+{
+  if (!writer_thread_) return;
+  stop_requested_ = true;
+  writer_thread_->join();
+  writer_thread_.reset();
+  LOG(INFO) << "Audit log stopped: committed=" << committed_
+            << ",failed=" << failed_ << ",dropped=" << dropped_
+            << ",batches=" << batches_;
+}
+
+void AuditLog::Flush()
+{
+  int64_t target = enqueued_;
+  while (committed_ + failed_ < target && writer_thread_) {
+    lab616::utils::sleep_micros(FLAGS_audit_idle_micros);
+  }
+}
+
+bool AuditLog::Enqueue(const Record& record)
+{
+  if (!queue_.Push(record)) {
+    __sync_fetch_and_add(&dropped_, 1);
+    LOG_EVERY_N(WARNING, 1000) << "Audit queue full; dropped " << dropped_;
+    return false;
+  }
+  __sync_fetch_and_add(&enqueued_, 1);
+  return true;
+}
+
+static void InitRecord(Record::Kind kind, Record* r)
+{
+  memset(r, 0, sizeof(Record));
+  r->kind = kind;
+  r->ts = lab616::utils::now_micros();
+}
+
+bool AuditLog::RecordOrder(OrderId id, const Contract& contract,
+                           const Order& order)
+{
+  Record r;
+  InitRecord(Record::ORDER, &r);
+  r.id = id;
+  r.client_id = order.clientId;
+  r.perm_id = order.permId;
+  r.quantity = order.totalQuantity;
+  r.price = order.lmtPrice;
+  r.aux_price = order.auxPrice;
+  CopyText(r.symbol, contract.symbol);
+  CopyText(r.sec_type, contract.secType);
+  CopyText(r.action, order.action);
+  CopyText(r.status, order.orderType);
+  CopyText(r.account, order.account);
+  return Enqueue(r);
+}
+
+bool AuditLog::RecordOrderStatus(OrderId id, const IBString& status,
+                                 int filled, int remaining,
+                                 double avg_fill_price, int perm_id,
+                                 double last_fill_price, int client_id,
+                                 const IBString& why_held)
+{
+  Record r;
+  InitRecord(Record::ORDER_STATUS, &r);
+  r.id = id;
+  r.perm_id = perm_id;
+  r.client_id = client_id;
+  r.filled = filled;
+  r.remaining = remaining;
+  r.avg_price = avg_fill_price;
+  r.aux_price = last_fill_price;
+  CopyText(r.status, status);
+  CopyText(r.text, why_held);
+  return Enqueue(r);
+}
+
+bool AuditLog::RecordExecution(const Contract& contract,
+                               const Execution& execution)
+{
+  Record r;
+  InitRecord(Record::EXECUTION, &r);
+  r.id = execution.orderId;
+  r.perm_id = execution.permId;
+  r.client_id = execution.clientId;
+  r.quantity = execution.shares;
+  r.filled = execution.cumQty;
+  r.price = execution.price;
+  r.avg_price = execution.avgPrice;
+  CopyText(r.exec_id, execution.execId);
+  CopyText(r.date, execution.time);
+  CopyText(r.symbol, contract.symbol);
+  CopyText(r.sec_type, contract.secType);
+  CopyText(r.action, execution.side);
+  CopyText(r.account, execution.acctNumber);
+  CopyText(r.status, execution.exchange);
+  return Enqueue(r);
+}
+
+bool AuditLog::RecordTrade(const trading::Trade& trade)
+{
+  Record r;
+  InitRecord(Record::TRADE, &r);
+  r.id = trade.tradeid();
+  r.event_ts = trade.timestamp();
+  r.order_type = trade.ordertype();
+  r.quantity = trade.quantity();
+  r.price = trade.price();
+  r.aux_price = trade.commission();
+  r.net = trade.net();
+  CopyText(r.date, trade.date());
+  CopyText(r.exec_id, trade.cusip());
+  CopyText(r.symbol, trade.security());
+  CopyText(r.text, trade.description());
+  return Enqueue(r);
+}
+
+bool AuditLog::RecordGainLoss(const trading::GainLoss& gain_loss)
+{
+  Record r;
+  InitRecord(Record::GAIN_LOSS, &r);
+  r.id = gain_loss.id();
+  r.quantity = gain_loss.quantity();
+  r.order_type = gain_loss.order_type();
+  r.price = gain_loss.open_price();
+  r.avg_price = gain_loss.open_net();
+  r.aux_price = gain_loss.closing_price();
+  r.net = gain_loss.closing_net();
+  r.gain_loss = gain_loss.gain_loss();
+  CopyText(r.symbol, gain_loss.symbol());
+  CopyText(r.date, gain_loss.open_date());
+  CopyText(r.date2, gain_loss.closing_date());
+  return Enqueue(r);
+}
+
+// Bind helpers.  Text is bound SQLITE_STATIC: the batch buffer outlives
+// the step and reset of the statement.
+namespace {
+
+struct Binder
+{
+  Binder(sqlite3_stmt* s) : stmt(s), index(0) {}
+  sqlite3_stmt* stmt;
+  int index;
+
+  inline Binder& operator<<(int64_t v)
+  { sqlite3_bind_int64(stmt, ++index, v); return *this; }
+
+  inline Binder& operator<<(int v)
+  { sqlite3_bind_int(stmt, ++index, v); return *this; }
+
+  inline Binder& operator<<(double v)
+  { sqlite3_bind_double(stmt, ++index, v); return *this; }
+
+  inline Binder& operator<<(const char* v)
+  { sqlite3_bind_text(stmt, ++index, v, -1, SQLITE_STATIC); return *this; }
+};
+
+} // namespace
+
+bool AuditLog::Insert(const Record& r)
+{
+  sqlite3_stmt* stmt = inserts_[r.kind];
+  Binder b(stmt);
+  switch (r.kind) {
+    case Record::ORDER:
+      b << r.ts << r.id << r.client_id << r.perm_id << r.symbol
+        << r.sec_type << r.action << r.status << r.quantity << r.price
+        << r.aux_price << r.account;
+      break;
+    case Record::ORDER_STATUS:
+      b << r.ts << r.id << r.perm_id << r.client_id << r.status << r.filled
+        << r.remaining << r.avg_price << r.aux_price << r.text;
+      break;
+    case Record::EXECUTION:
+      b << r.ts << r.exec_id << r.date << r.id << r.perm_id << r.client_id
+        << r.symbol << r.sec_type << r.action << r.quantity << r.price
+        << r.filled << r.avg_price << r.account << r.status;
+      break;
+    case Record::TRADE:
+      b << r.ts << r.id << r.event_ts << r.date << r.order_type << r.exec_id
+        << r.symbol << r.text << r.quantity << r.price << r.aux_price
+        << r.net;
+      break;
+    case Record::GAIN_LOSS:
+      b << r.ts << r.id << r.symbol << r.quantity << r.date << r.price
+        << r.avg_price << r.order_type << r.date2 << r.aux_price << r.net
+        << r.gain_loss;
+      break;
+    default:
+      LOG(ERROR) << "Unknown audit record kind " << r.kind;
+      return false;
+  }
+  bool ok = sqlite3_step(stmt) == SQLITE_DONE;
+  LOG_IF(ERROR, !ok) << "Audit insert failed: " << sqlite3_errmsg(writer_);
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+  return ok;
+}
+
+// Returns the number of records taken off the queue.
+int AuditLog::WriteBatch()
+{
+  batch_.clear();
+  Record r;
+  while (batch_.size() < (size_t)FLAGS_audit_batch_size && queue_.Pop(&r)) {
+    batch_.push_back(r);
+  }
+  if (batch_.empty()) return 0;
+
+  uint64_t start = lab616::utils::now_micros();
+  int ok = 0;
+  bool in_transaction = Exec(writer_, "BEGIN");
+  for (vector<Record>::const_iterator itr = batch_.begin();
+       itr != batch_.end(); ++itr) {
+    if (Insert(*itr)) ++ok;
+  }
+  if (in_transaction && !Exec(writer_, "COMMIT")) {
+    Exec(writer_, "ROLLBACK");
+    ok = 0;
+  }
+  __sync_fetch_and_add(&committed_, ok);
+  __sync_fetch_and_add(&failed_, batch_.size() - ok);
+  __sync_fetch_and_add(&batches_, 1);
+
+  VLOG(VLOG_LEVEL) << "Audit batch of " << batch_.size() << " in "
+                   << (lab616::utils::now_micros() - start) << " micros.";
+  return batch_.size();
+}
+
+void AuditLog::WriterLoop()
+{
+  VLOG(VLOG_LEVEL) << "Audit writer started for " << path_;
+  while (!stop_requested_) {
+    if (WriteBatch() == 0) {
+      lab616::utils::sleep_micros(FLAGS_audit_idle_micros);
+    }
+  }
+  // Drain whatever was queued before Stop().
+  while (WriteBatch() > 0) {}
+  VLOG(VLOG_LEVEL) << "Audit writer stopped.";
+}
+
+bool AuditLog::Query(const string& sql, vector<Row>* rows)
+{
+  boost::unique_lock<boost::mutex> lock(reader_mutex_);
+  if (!OpenReader()) return false;
+
+  sqlite3_stmt* stmt = NULL;
+  if (sqlite3_prepare_v2(reader_, sql.c_str(), -1, &stmt, NULL) != SQLITE_OK) {
+    LOG(ERROR) << "Bad audit query " << sql << ": " << sqlite3_errmsg(reader_);
+    return false;
+  }
+  int columns = sqlite3_column_count(stmt);
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    rows->push_back(Row(columns));
+    Row& row = rows->back();
+    for (int i = 0; i < columns; ++i) {
+      const unsigned char* text = sqlite3_column_text(stmt, i);
+      if (text) row[i].assign(reinterpret_cast<const char*>(text));
+    }
+  }
+  bool ok = (rc == SQLITE_DONE);
+  LOG_IF(ERROR, !ok) << "Audit query failed: " << sqlite3_errmsg(reader_);
+  sqlite3_finalize(stmt);
+  return ok;
+}
+
+} // namespace audit
+} // namespace ib
@@ -0,0 +1,170 @@
+#ifndef IB_AUDIT_LOG_H_
+#define IB_AUDIT_LOG_H_
+
+// Durable, queryable audit store for orders, executions and the
+// Trade / GainLoss records from //common-protos/trading.
+//
+// Callers on the order path only copy a fixed-size record into a
+// lock-free queue; a dedicated writer thread drains the queue and
+// writes batches to SQLite inside a single transaction using
+// prepared statements.  A full queue drops the record (and counts it)
+// rather than block the caller.
+//
+// Ad-hoc queries run on a separate read connection so they do not
+// serialize behind the writer.  Example:
+//
+//   sqlite3 audit.db "select symbol, sum(shares) from executions
+//                     where ts > strftime('%s','now','start of day')*1e6
+//                     group by symbol"
+
+#ifndef IB_USE_STD_STRING
+#define IB_USE_STD_STRING
+#endif
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <Shared/CommonDefs.h>
+#include <Shared/Contract.h>
+#include <Shared/Execution.h>
+#include <Shared/Order.h>
+
+#include "common.hpp"
+#include "lockfree.hpp"
+#include "trading/trades.pb.h"
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace ib {
+namespace audit {
+
+// A single audit record.  Plain data with fixed-size text fields so
+// that queueing one never touches the heap.  Text longer than the
+// field is truncated.  Fields are shared between kinds; see the
+// Record* methods in AuditLog for which column each one lands in.
+struct Record
+{
+  enum Kind {
+    ORDER = 0,
+    ORDER_STATUS,
+    EXECUTION,
+    TRADE,
+    GAIN_LOSS,
+    NUM_KINDS
+  };
+
+  Kind kind;
+  int64_t ts;          // Micros since epoch when recorded.
+  int64_t event_ts;    // Timestamp carried by the record itself, if any.
+  int64_t id;          // Order id, trade id or gain/loss id.
+  int perm_id;
+  int client_id;
+  int quantity;
+  int filled;
+  int remaining;
+  int order_type;      // trading::OrderType for TRADE / GAIN_LOSS.
+  double price;
+  double aux_price;
+  double avg_price;
+  double net;
+  double gain_loss;
+
+  char symbol[16];
+  char sec_type[8];
+  char action[16];
+  char status[16];
+  char account[16];
+  char exec_id[32];
+  char date[24];
+  char date2[24];
+  char text[64];
+};
+
+// Copies at most sizeof(dest) - 1 characters.
+template <size_t N> inline void CopyText(char (&dest)[N], const std::string& s)
+{
+  size_t n = s.length() < N - 1 ? s.length() : N - 1;
+  s.copy(dest, n);
+  dest[n] = '\0';
+}
+
+class AuditLog : NoCopyAndAssign
+{
+ public:
+  // Opens (or creates) the database at path.  ":memory:" is not
+  // useful here since reads use their own connection.
+  explicit AuditLog(const std::string& path);
+  ~AuditLog();
+
+  // Starts the writer thread.  Returns false if the database could
+  // not be opened or the schema could not be created.
+  bool Start();
+
+  // Drains what is queued, commits and stops the writer thread.
+  void Stop();
+
+  // Blocks until every record queued before the call is committed.
+  // For tests and orderly shutdown; never call this on the order path.
+  void Flush();
+
+  // The methods below copy their arguments and return immediately.
+  // They return false if the record was dropped because the queue
+  // was full.
+  bool RecordOrder(OrderId id, const Contract& contract, const Order& order);
+  bool RecordOrderStatus(OrderId id, const IBString& status,
+                         int filled, int remaining, double avg_fill_price,
+                         int perm_id, double last_fill_price,
+                         int client_id, const IBString& why_held);
+  bool RecordExecution(const Contract& contract, const Execution& execution);
+  bool RecordTrade(const trading::Trade& trade);
+  bool RecordGainLoss(const trading::GainLoss& gain_loss);
+
+  bool Enqueue(const Record& record);
+
+  // Runs an ad-hoc query on the read connection.  Each row is
+  // returned as strings; NULLs come back empty.  Returns false and
+  // logs the SQLite error on failure.
+  typedef std::vector<std::string> Row;
+  bool Query(const std::string& sql, std::vector<Row>* rows);
+
+  // Counters, for /varz style reporting.
+  int64_t committed() const { return committed_; }
+  int64_t failed() const { return failed_; }
+  int64_t dropped() const { return dropped_; }
+  int64_t batches() const { return batches_; }
+
+ private:
+  void WriterLoop();
+  int WriteBatch();
+  bool Insert(const Record& r);
+  bool OpenWriter();
+  bool OpenReader();
+
+  const std::string path_;
+  lab616::lockfree::BoundedQueue<Record> queue_;
+
+  sqlite3* writer_;
+  sqlite3* reader_;
+  sqlite3_stmt* inserts_[Record::NUM_KINDS];
+  boost::mutex reader_mutex_;
+  std::vector<Record> batch_;
+
+  boost::scoped_ptr<boost::thread> writer_thread_;
+  volatile bool stop_requested_;
+
+  volatile int64_t enqueued_;
+  volatile int64_t committed_;
+  volatile int64_t failed_;
+  volatile int64_t dropped_;
+  volatile int64_t batches_;
+};
+
+} // namespace audit
+} // namespace ib
+
+#endif // IB_AUDIT_LOG_H_
@@ -1,13 +1,16 @@
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <boost/ptr_container/ptr_vector.hpp>
-#include <boost/scoped_ptr.hpp>
 #include <glog/logging.h>
+#include "utils.hpp"
 #include "ib/backplane.hpp"
+#include "ib/event_bus.hpp"
 #include "ib/ticker_id.hpp"
 
 using namespace std;
+using lab616::utils::now_micros;
 
 namespace ib {
 
@@ -16,16 +19,14 @@ BackPlane::BackPlane()
 
 }
 
-typedef sigc::signal< void, const Connect& > ConnectSignal;
 typedef ConditionalFunctor< Connect, Receiver<Connect> > ConnectFilter;
-
-typedef sigc::signal< void, const Disconnect& > DisconnectSignal;
 typedef ConditionalFunctor< Disconnect, Receiver<Disconnect> > DisconnectFilter;
-
-typedef sigc::signal< void, const BidAsk& > BidAskSignal;
 typedef ConditionalFunctor< BidAsk, Receiver<BidAsk> > BidAskFilter;
+typedef ConditionalFunctor< Last, Receiver<Last> > LastFilter;
 
 
+// Each event type has a channel of delegates, called in order of
+// registration.  The events are built on the stack.
 class BackPlaneImpl : public BackPlane
 {
  public:
@@ -40,108 +41,139 @@ class BackPlaneImpl : public BackPlane
   virtual void Register(Receiver<Connect>* r,
                         Predicate<Connect>* predicate = NULL)
   {
-    if (predicate == NULL) {
-      connect_signal_.connect(
-          sigc::mem_fun(r, &Receiver<Connect>::operator()));
-    } else {
-      ConnectFilter* filter = new ConnectFilter(predicate, r);
-      connect_signal_.connect(
-          sigc::mem_fun(filter, &ConnectFilter::operator()));
-      connect_filters_.push_back(filter);
-    }
+    Add(&connect_channel_, &connect_filters_, r, predicate);
   }
 
   virtual void Register(Receiver<Disconnect>* r,
                         Predicate<Disconnect>* predicate = NULL)
   {
-    if (predicate == NULL) {
-      disconnect_signal_.connect(
-          sigc::mem_fun(r, &Receiver<Disconnect>::operator()));
-    } else {
-      DisconnectFilter* filter = new DisconnectFilter(predicate, r);
-      disconnect_signal_.connect(
-          sigc::mem_fun(filter, &DisconnectFilter::operator()));
-      disconnect_filters_.push_back(filter);
-    }
+    Add(&disconnect_channel_, &disconnect_filters_, r, predicate);
   }
 
   virtual void Register(Receiver<BidAsk>* r,
                         Predicate<BidAsk>* predicate = NULL)
   {
-    if (predicate == NULL) {
-      bid_ask_signal_.connect(sigc::mem_fun(r, &Receiver<BidAsk>::operator()));
-    } else {
-      BidAskFilter* filter = new BidAskFilter(predicate, r);
-      bid_ask_signal_.connect(sigc::mem_fun(filter, &BidAskFilter::operator()));
-      bid_ask_filters_.push_back(filter);
-    }
+    Add(&bid_ask_channel_, &bid_ask_filters_, r, predicate);
+  }
+
+  virtual void Register(Receiver<Last>* r,
+                        Predicate<Last>* predicate = NULL)
+  {
+    Add(&last_channel_, &last_filters_, r, predicate);
   }
 
   virtual void OnConnect(Timestamp t, Id id)
   {
-    boost::scoped_ptr<Connect> connect(new Connect());
-    connect->set_id(id);
-    connect->set_time_stamp(t);
-    connect_signal_.emit(*connect);
+    Connect connect;
+    connect.set_id(id);
+    connect.set_index(Index(id));
+    connect.set_time_stamp(t);
+    connect_channel_.Emit(connect);
   }
 
   virtual void OnDisconnect(Timestamp t, Id id)
   {
-    boost::scoped_ptr<Disconnect> disconnect(new Disconnect());
-    disconnect->set_id(id);
-    disconnect->set_time_stamp(t);
-    disconnect_signal_.emit(*disconnect);
+    Disconnect disconnect;
+    disconnect.set_id(id);
+    disconnect.set_index(Index(id));
+    disconnect.set_time_stamp(t);
+    disconnect_channel_.Emit(disconnect);
   }
 
   virtual void OnBid(Timestamp t, Id id, double price)
   {
-    boost::scoped_ptr<BidAsk> bidask(new BidAsk());
-    bidask->set_id(id);
-    bidask->set_time_stamp(t);
-    BidAsk_Bid* bid = bidask->mutable_bid();
-    bid->set_price(price);
-    bid_ask_signal_.emit(*bidask);
+    BidAsk bidask;
+    bidask.set_id(id);
+    bidask.set_index(Index(id));
+    bidask.set_time_stamp(t);
+    bidask.mutable_bid()->set_price(price);
+    bid_ask_channel_.Emit(bidask);
   }
 
   virtual void OnBid(Timestamp t, Id id, int size)
   {
-    boost::scoped_ptr<BidAsk> bidask(new BidAsk());
-    bidask->set_id(id);
-    bidask->set_time_stamp(t);
-    BidAsk_Bid* bid = bidask->mutable_bid();
-    bid->set_size(size);
-    bid_ask_signal_.emit(*bidask);
+    BidAsk bidask;
+    bidask.set_id(id);
+    bidask.set_index(Index(id));
+    bidask.set_time_stamp(t);
+    bidask.mutable_bid()->set_size(size);
+    bid_ask_channel_.Emit(bidask);
   }
 
   virtual void OnAsk(Timestamp t, Id id, double price)
   {
-    boost::scoped_ptr<BidAsk> bidask(new BidAsk());
-    bidask->set_id(id);
-    bidask->set_time_stamp(t);
-    BidAsk_Ask* ask = bidask->mutable_ask();
-    ask->set_price(price);
-    bid_ask_signal_.emit(*bidask);
+    BidAsk bidask;
+    bidask.set_id(id);
+    bidask.set_index(Index(id));
+    bidask.set_time_stamp(t);
+    bidask.mutable_ask()->set_price(price);
+    bid_ask_channel_.Emit(bidask);
   }
 
   virtual void OnAsk(Timestamp t, Id id, int size)
   {
-    boost::scoped_ptr<BidAsk> bidask(new BidAsk());
-    bidask->set_id(id);
-    bidask->set_time_stamp(t);
-    BidAsk_Ask* ask = bidask->mutable_ask();
-    ask->set_size(size);
-    bid_ask_signal_.emit(*bidask);
+    BidAsk bidask;
+    bidask.set_id(id);
+    bidask.set_index(Index(id));
+    bidask.set_time_stamp(t);
+    bidask.mutable_ask()->set_size(size);
+    bid_ask_channel_.Emit(bidask);
+  }
+
+  virtual void OnLast(Timestamp t, Id id, double price)
+  {
+    Last last;
+    last.set_id(id);
+    last.set_index(Index(id));
+    last.set_time_stamp(t);
+    last.set_price(price);
+    last_channel_.Emit(last);
+  }
+
+  virtual void OnLast(Timestamp t, Id id, int size)
+  {
+    Last last;
+    last.set_id(id);
+    last.set_index(Index(id));
+    last.set_time_stamp(t);
+    last.set_size(size);
+    last_channel_.Emit(last);
   }
 
  private:
-  ConnectSignal connect_signal_;
+  // Looked up once per event, for all the selections.
+  static inline int Index(Id id)
+  {
+    return signal::TickerIndex::Instance().Find(id);
+  }
+
+  template <typename T>
+  static void Add(EventChannel<T>* channel,
+                  boost::ptr_vector< ConditionalFunctor<T, Receiver<T> > >*
+                  filters,
+                  Receiver<T>* r, Predicate<T>* predicate)
+  {
+    if (predicate == NULL) {
+      channel->Connect(r);
+    } else {
+      ConditionalFunctor<T, Receiver<T> >* filter =
+          new ConditionalFunctor<T, Receiver<T> >(predicate, r);
+      filters->push_back(filter);
+      channel->Connect(filter);
+    }
+  }
+
+  EventChannel<Connect> connect_channel_;
   boost::ptr_vector<ConnectFilter> connect_filters_;
 
-  DisconnectSignal disconnect_signal_;
+  EventChannel<Disconnect> disconnect_channel_;
   boost::ptr_vector<DisconnectFilter> disconnect_filters_;
 
-  BidAskSignal bid_ask_signal_;
+  EventChannel<BidAsk> bid_ask_channel_;
   boost::ptr_vector<BidAskFilter> bid_ask_filters_;
+
+  EventChannel<Last> last_channel_;
+  boost::ptr_vector<LastFilter> last_filters_;
 };
 
 BackPlane* BackPlane::Create()
@@ -158,8 +190,104 @@ int GetTickerId(const std::string& symbol)
 void GetSymbol(const int id, std::string* symbol)
 { ib::internal::SymbolFromTickerId(id, symbol); }
 
+Selection::Selection()
+    : symbols_(new SymbolSet())
+{
+}
+
+Selection::Selection(const Selection& other)
+    : symbols_(new SymbolSet(other.symbols()))
+{
+}
+
+Selection& Selection::operator=(const Selection& other)
+{
+  if (this != &other) Publish(new SymbolSet(other.symbols()));
+  return *this;
+}
+
+Selection::~Selection()
+{
+  delete symbols_;
+  for (size_t i = 0; i < retired_.size(); ++i) delete retired_[i].symbols;
+}
+
+void Selection::Publish(SymbolSet* symbols)
+{
+  const int64_t now = now_micros();
+  Retired retired;
+  retired.at = now;
+  retired.symbols = symbols_;
+  lab616::lockfree::store_release(symbols_,
+                                  const_cast<const SymbolSet*>(symbols));
+  size_t expired = 0;
+  while (expired < retired_.size() &&
+         now - retired_[expired].at >= GRACE_MICROS) {
+    delete retired_[expired++].symbols;
+  }
+  retired_.erase(retired_.begin(), retired_.begin() + expired);
+  retired_.push_back(retired);
+}
+
+Selection& Selection::Add(int id)
+{
+  TickerIndex& indexes = TickerIndex::Instance();
+  const int index = indexes.Index(id);
+  if (Current()->Set(index, true)) return *this;
+  // Grown with room to spare, so the next ones are set in place.
+  SymbolSet* symbols = new SymbolSet(this->symbols());
+  symbols->Reserve(std::max<size_t>(2 * (index + 1), indexes.size()));
+  symbols->Set(index, true);
+  Publish(symbols);
+  return *this;
+}
+
 Selection& Selection::Add(const std::string& symbol)
 { return Selection::Add(GetTickerId(symbol)); }
 
+Selection& Selection::Add(const std::vector<std::string>& symbols)
+{
+  SymbolSet* set = new SymbolSet(this->symbols());
+  for (size_t i = 0; i < symbols.size(); ++i) set->Add(symbols[i]);
+  Publish(set);
+  return *this;
+}
+
+Selection& Selection::Remove(int id)
+{
+  // Without a word for the index, it is not in the set.
+  Current()->Set(TickerIndex::Instance().Find(id), false);
+  return *this;
+}
+
+Selection& Selection::operator|=(const Selection& other)
+{
+  SymbolSet* symbols = new SymbolSet(this->symbols());
+  *symbols |= other.symbols();
+  Publish(symbols);
+  return *this;
+}
+
+Selection& Selection::operator&=(const Selection& other)
+{
+  SymbolSet* symbols = new SymbolSet(this->symbols());
+  *symbols &= other.symbols();
+  Publish(symbols);
+  return *this;
+}
+
+Selection& Selection::operator-=(const Selection& other)
+{
+  SymbolSet* symbols = new SymbolSet(this->symbols());
+  *symbols -= other.symbols();
+  Publish(symbols);
+  return *this;
+}
+
+void Selection::Assign(const SymbolSet& symbols)
+{
+  Publish(new SymbolSet(symbols));
+}
+
 } // namespace signal
 } // namespace ib
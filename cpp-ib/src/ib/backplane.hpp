@@ -1,12 +1,13 @@
 #ifndef IB_BACKPLANE_H_
 #define IB_BACKPLANE_H_
 
-#include <set>
 #include <string>
-#include <sigc++/sigc++.h>
+#include <vector>
 
 #include "common.hpp"
+#include "lockfree.hpp"
 #include "ib/ib_events.pb.h"
+#include "ib/symbol_set.hpp"
 
 using namespace ib::events;
 
@@ -17,11 +18,75 @@ template <class T> struct Predicate
   virtual bool operator()(const T& arg) = 0;
 };
 
-template <class T> struct Receiver : sigc::trackable, NoCopyAndAssign
+// Receivers are connected once and are not disconnected when they go
+// away: they must outlive the BackPlane's emissions.
+template <class T> struct Receiver : NoCopyAndAssign
 {
   virtual void operator()(const T& arg) = 0;
 };
 
+// The fields of the BidAsk and Last events, one value each.
+struct QuoteFields
+{
+  enum Field { BID = 0, BID_SIZE, ASK, ASK_SIZE, LAST, LAST_SIZE };
+};
+
+// Calls handler->OnField(ts, id, field, value) for each field the event
+// sets, in the order of Field.  Sizes come as doubles.
+template <typename Handler>
+inline void ForEachField(const BidAsk& bid_ask, Handler* handler)
+{
+  const int64_t ts = bid_ask.time_stamp();
+  const int id = bid_ask.id();
+  if (bid_ask.has_bid()) {
+    const BidAsk_Bid& bid = bid_ask.bid();
+    if (bid.has_price()) {
+      handler->OnField(ts, id, QuoteFields::BID, bid.price());
+    }
+    if (bid.has_size()) {
+      handler->OnField(ts, id, QuoteFields::BID_SIZE, bid.size());
+    }
+  }
+  if (bid_ask.has_ask()) {
+    const BidAsk_Ask& ask = bid_ask.ask();
+    if (ask.has_price()) {
+      handler->OnField(ts, id, QuoteFields::ASK, ask.price());
+    }
+    if (ask.has_size()) {
+      handler->OnField(ts, id, QuoteFields::ASK_SIZE, ask.size());
+    }
+  }
+}
+
+template <typename Handler>
+inline void ForEachField(const Last& last, Handler* handler)
+{
+  if (last.has_price()) {
+    handler->OnField(last.time_stamp(), last.id(), QuoteFields::LAST,
+                     last.price());
+  }
+  if (last.has_size()) {
+    handler->OnField(last.time_stamp(), last.id(), QuoteFields::LAST_SIZE,
+                     last.size());
+  }
+}
+
+// A receiver of the BidAsk and Last events that takes them one field
+// at a time.  Register it as both.
+class FieldReceiver : public QuoteFields,
+                      public Receiver<BidAsk>,
+                      public Receiver<Last>
+{
+ public:
+  virtual void operator()(const BidAsk& bid_ask)
+  { ForEachField(bid_ask, this); }
+
+  virtual void operator()(const Last& last)
+  { ForEachField(last, this); }
+
+  virtual void OnField(int64_t ts, int id, Field field, double value) = 0;
+};
+
 template <typename T_arg1, typename T_functor>
 struct ConditionalFunctor
 {
@@ -35,7 +100,7 @@ struct ConditionalFunctor
   Predicate<T_arg1>* predicate;
   T_functor* functor;
 
-  inline void operator()(T_arg1 arg1)
+  inline void operator()(const T_arg1& arg1)
   {
     if ((*predicate)(arg1)) (*functor)(arg1);
   }
@@ -63,6 +128,9 @@ class BackPlane : NoCopyAndAssign
   virtual void Register(Receiver<BidAsk>* r,
                         Predicate<BidAsk>* predicate = NULL) = 0;
 
+  virtual void Register(Receiver<Last>* r,
+                        Predicate<Last>* predicate = NULL) = 0;
+
   typedef int64_t Timestamp;
   typedef int Id;
 
@@ -76,6 +144,9 @@ class BackPlane : NoCopyAndAssign
   virtual void OnAsk(Timestamp t, Id id, double price) = 0;
   virtual void OnAsk(Timestamp t, Id id, int size) = 0;
 
+  virtual void OnLast(Timestamp t, Id id, double price) = 0;
+  virtual void OnLast(Timestamp t, Id id, int size) = 0;
+
  protected:
   BackPlane();
 };
@@ -88,14 +159,36 @@ using namespace ib::events;
 int GetTickerId(const std::string& symbol);
 void GetSymbol(const int id, std::string* symbol);
 
+// Ids selected from the BackPlane, as a SymbolSet.  A tick is tested
+// with a load of the set and a test of the bit of its index, which
+// the BackPlane puts in the event; events built elsewhere, without
+// one, look their id up.
+//
+// Adding or removing one id sets its bit where it is, when the set
+// has the word.  Any other change builds a new set and swaps the
+// pointer, so a receiver testing a tick on the feed thread sees either
+// the old universe or the new one, never a partial update.  Changes
+// come from one thread at a time.
+//
+// A reader holds a set for one bit test, with nothing in between to
+// block on.  A replaced set is therefore kept for a grace period,
+// GRACE_MICROS, after which no reader can still be in a test of it,
+// and freed by a later change or with the selection.
 class Selection :
     public Predicate<Connect>,
     public Predicate<Disconnect>,
-    public Predicate<BidAsk>
+    public Predicate<BidAsk>,
+    public Predicate<Last>
 {
  public:
-  Selection() { }
-  ~Selection() { }
+  // A second: a reader stopped that long inside a bit test is stopped
+  // in a debugger.
+  static const int64_t GRACE_MICROS = 1000000;
+
+  Selection();
+  Selection(const Selection& other);
+  Selection& operator=(const Selection& other);
+  virtual ~Selection();
 
   inline Selection& operator<<(int id)
   { return Add(id); }
@@ -103,31 +196,59 @@ class Selection :
   inline Selection& operator<<(const std::string& symbol)
   { return Add(symbol); }
 
-  inline Selection& Add(int id)
-  {
-    ids_.insert(id);
-    return *this;
-  }
-
+  Selection& Add(int id);
   Selection& Add(const std::string& symbol);
+  // Adds them all in one change.
+  Selection& Add(const std::vector<std::string>& symbols);
+  Selection& Remove(int id);
+
+  // Composition of universes, e.g. (sp500 -= halted) |= watchlist.
+  Selection& operator|=(const Selection& other);
+  Selection& operator&=(const Selection& other);
+  Selection& operator-=(const Selection& other);
+
+  // Replaces the whole universe at once.
+  void Assign(const SymbolSet& symbols);
+
+  // For the thread that changes the selection.
+  const SymbolSet& symbols() const
+  { return *lab616::lockfree::load_acquire(symbols_); }
 
   virtual inline bool operator()(const Connect& connect)
-  { return (*this)(connect.id()); }
+  { return Selected(connect); }
 
   virtual inline bool operator()(const Disconnect& disconnect)
-  { return (*this)(disconnect.id()); }
+  { return Selected(disconnect); }
 
   virtual inline bool operator()(const BidAsk& bid_ask)
-  { return (*this)(bid_ask.id()); }
+  { return Selected(bid_ask); }
 
- protected:
-  std::set<int> ids_;
+  virtual inline bool operator()(const Last& last)
+  { return Selected(last); }
 
-  inline bool operator()(int id)
+ protected:
+  template <typename Event>
+  inline bool Selected(const Event& event) const
   {
-    std::set<int>::iterator itr = ids_.find(id);
-    return itr != ids_.end();
+    const SymbolSet* symbols = lab616::lockfree::load_acquire(symbols_);
+    return event.has_index() ? symbols->Test(event.index()) :
+        symbols->Contains(event.id());
   }
+
+ private:
+  struct Retired
+  {
+    int64_t at;
+    const SymbolSet* symbols;
+  };
+
+  // The set being changed where it is, by the changing thread.
+  SymbolSet* Current() { return const_cast<SymbolSet*>(symbols_); }
+
+  void Publish(SymbolSet* symbols);
+
+  const SymbolSet* volatile symbols_;
+  std::vector<Retired> retired_;  // Replaced, oldest first.
 };
 
 class Exclusion : public Selection
@@ -137,20 +258,16 @@ class Exclusion : public Selection
   ~Exclusion() {}
 
   virtual inline bool operator()(const Connect& connect)
-  { return (*this)(connect.id()); }
+  { return !Selected(connect); }
 
   virtual inline bool operator()(const Disconnect& disconnect)
-  { return (*this)(disconnect.id()); }
+  { return !Selected(disconnect); }
 
   virtual inline bool operator()(const BidAsk& bid_ask)
-  { return (*this)(bid_ask.id()); }
+  { return !Selected(bid_ask); }
 
- protected:
-  inline bool operator()(int id)
-  {
-    std::set<int>::iterator itr = ids_.find(id);
-    return itr == ids_.end();
-  }
+  virtual inline bool operator()(const Last& last)
+  { return !Selected(last); }
 };
 
 } // namespace signal
@@ -0,0 +1,340 @@
+#include <netdb.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+#include <glog/logging.h>
+
+#include "utils.hpp"
+#include "ib/clock_discipline.hpp"
+
+#define VLOG_LEVEL 2
+
+using namespace std;
+using lab616::lockfree::compiler_barrier;
+using lab616::lockfree::store_release;
+using lab616::utils::now_micros;
+
+namespace ib {
+
+// Seconds from 1900 (NTP) to 1970 (Unix).
+static const uint64_t NTP_EPOCH = 2208988800ULL;
+
+// Gains of the filter: the share of a residual taken into the offset,
+// and into the drift per micro since the last update.
+static const double ALPHA = 0.25;
+static const double BETA = 0.04;
+
+// Beyond this a clock is broken rather than drifting; see RFC 5905.
+static const double MAX_DRIFT = 500e-6;
+
+// A poll whose best round trip exceeds twice the best of recent polls,
+// plus this, waited in some queue and is dropped.
+static const int64_t RTT_SLACK = 1000;
+
+// Slew before Start sets the poll interval: the default of
+// --ntp_poll_secs.
+static const int64_t DEFAULT_SLEW = 16000000;
+
+// Fastest slew, in micros a micro; below 1 so time keeps moving.
+static const double MAX_SLEW_RATE = 0.5;
+
+uint64_t MicrosToNtp(int64_t micros)
+{
+  const uint64_t seconds = micros / 1000000 + NTP_EPOCH;
+  const uint64_t fraction = ((micros % 1000000) << 32) / 1000000;
+  return (seconds << 32) | fraction;
+}
+
+int64_t NtpToMicros(uint64_t ntp)
+{
+  const int64_t seconds = static_cast<int64_t>(ntp >> 32) - NTP_EPOCH;
+  const int64_t fraction = ((ntp & 0xffffffffULL) * 1000000) >> 32;
+  return seconds * 1000000 + fraction;
+}
+
+static void PutNtp(uint64_t ntp, unsigned char* p)
+{
+  for (int i = 0; i < 8; ++i) p[i] = ntp >> (56 - 8 * i);
+}
+
+static uint64_t GetNtp(const unsigned char* p)
+{
+  uint64_t ntp = 0;
+  for (int i = 0; i < 8; ++i) ntp = (ntp << 8) | p[i];
+  return ntp;
+}
+
+NtpSource::NtpSource(const string& server, int timeout_millis)
+    : server_(server)
+    , timeout_millis_(timeout_millis)
+    , socket_(-1)
+{
+}
+
+NtpSource::~NtpSource()
+{
+  if (socket_ >= 0) close(socket_);
+}
+
+bool NtpSource::Open()
+{
+  string host = server_;
+  string port = "123";
+  const size_t colon = server_.rfind(':');
+  if (colon != string::npos) {
+    host = server_.substr(0, colon);
+    port = server_.substr(colon + 1);
+  }
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  struct addrinfo* address = NULL;
+  int error = getaddrinfo(host.c_str(), port.c_str(), &hints, &address);
+  if (error != 0) {
+    LOG(WARNING) << "Cannot resolve " << server_ << ": "
+                 << gai_strerror(error);
+    return false;
+  }
+  socket_ = socket(address->ai_family, address->ai_socktype,
+                   address->ai_protocol);
+  bool ok = socket_ >= 0 &&
+      connect(socket_, address->ai_addr, address->ai_addrlen) == 0;
+  freeaddrinfo(address);
+  struct timeval timeout;
+  timeout.tv_sec = timeout_millis_ / 1000;
+  timeout.tv_usec = (timeout_millis_ % 1000) * 1000;
+  ok = ok && setsockopt(socket_, SOL_SOCKET, SO_RCVTIMEO,
+                        &timeout, sizeof(timeout)) == 0;
+  if (!ok) {
+    PLOG(WARNING) << "Cannot open a socket to " << server_;
+    if (socket_ >= 0) close(socket_);
+    socket_ = -1;
+  }
+  return ok;
+}
+
+bool NtpSource::Sample(ClockSample* sample)
+{
+  if (socket_ < 0 && !Open()) return false;
+
+  unsigned char packet[48];
+  memset(packet, 0, sizeof(packet));
+  packet[0] = 0x23;  // No leap warning, version 4, client.
+  const int64_t t1 = now_micros();
+  const uint64_t sent = MicrosToNtp(t1);
+  PutNtp(sent, packet + 40);
+  if (send(socket_, packet, sizeof(packet), 0) != sizeof(packet)) {
+    PLOG(WARNING) << "Cannot send to " << server_;
+    return false;
+  }
+  // Replies to earlier, timed out requests do not echo this one.
+  while (true) {
+    if (recv(socket_, packet, sizeof(packet), 0) != sizeof(packet)) {
+      VLOG(VLOG_LEVEL) << "No reply from " << server_;
+      return false;
+    }
+    if (GetNtp(packet + 24) == sent) break;
+  }
+  const int64_t t4 = now_micros();
+  const int mode = packet[0] & 7;
+  const int stratum = packet[1];
+  if (mode != 4 || stratum == 0) {
+    LOG(WARNING) << "Bad reply from " << server_ << ": mode " << mode
+                 << ", stratum " << stratum;
+    return false;
+  }
+  const int64_t t2 = NtpToMicros(GetNtp(packet + 32));
+  const int64_t t3 = NtpToMicros(GetNtp(packet + 40));
+  sample->local = t1 + (t4 - t1) / 2;
+  sample->offset = ((t2 - t1) + (t3 - t4)) / 2;
+  sample->rtt = (t4 - t1) - (t3 - t2);
+  return true;
+}
+
+ClockDiscipline::ClockDiscipline(ClockSource* source, int samples_per_poll)
+    : source_(source)
+    , samples_per_poll_(samples_per_poll)
+    , version_(0)
+    , slew_micros_(DEFAULT_SLEW)
+    , started_(false)
+    , recent_(0)
+    , running_(false)
+{
+  memset(&correction_, 0, sizeof(correction_));
+  memset(&estimate_, 0, sizeof(estimate_));
+}
+
+ClockDiscipline::~ClockDiscipline()
+{
+  Stop();
+}
+
+void ClockDiscipline::Start(int poll_secs)
+{
+  CHECK(!thread_);
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    slew_micros_ = static_cast<int64_t>(poll_secs) * 1000000;
+  }
+  // The first correction is stepped only here, before the feed is up.
+  Poll();
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    started_ = true;
+  }
+  running_ = true;
+  thread_.reset(new boost::thread(
+      boost::bind(&ClockDiscipline::Run, this, poll_secs)));
+}
+
+void ClockDiscipline::Stop()
+{
+  if (!thread_) return;
+  {
+    boost::unique_lock<boost::mutex> lock(run_mutex_);
+    running_ = false;
+    run_control_.notify_all();
+  }
+  thread_->join();
+  thread_.reset();
+}
+
+void ClockDiscipline::Run(int poll_secs)
+{
+  // Start took the first poll.
+  boost::unique_lock<boost::mutex> lock(run_mutex_);
+  while (running_) {
+    const boost::system_time deadline =
+        boost::get_system_time() + boost::posix_time::seconds(poll_secs);
+    while (running_ && run_control_.timed_wait(lock, deadline)) {}
+    if (!running_) break;
+    lock.unlock();
+    Poll();
+    lock.lock();
+  }
+}
+
+bool ClockDiscipline::Poll()
+{
+  if (source_ == NULL) return false;
+  ClockSample best;
+  bool sampled = false;
+  for (int i = 0; i < samples_per_poll_; ++i) {
+    ClockSample sample;
+    if (!source_->Sample(&sample)) continue;
+    if (!sampled || sample.rtt < best.rtt) best = sample;
+    sampled = true;
+  }
+  LOG_IF(WARNING, !sampled) << "No clock sample in this poll.";
+  return sampled && Update(best);
+}
+
+bool ClockDiscipline::Update(const ClockSample& sample)
+{
+  return Update(sample, now_micros());
+}
+
+bool ClockDiscipline::Update(const ClockSample& sample, int64_t now)
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  const int recent = min(recent_, 8);
+  const int64_t best_rtt = recent ?
+      *min_element(recent_rtts_, recent_rtts_ + recent) : sample.rtt;
+  recent_rtts_[recent_++ % 8] = sample.rtt;
+  if (sample.rtt > 2 * best_rtt + RTT_SLACK) {
+    estimate_.dropped++;
+    VLOG(VLOG_LEVEL) << "Dropped a clock sample with rtt " << sample.rtt;
+    return false;
+  }
+
+  Estimate& e = estimate_;
+  const bool first = e.samples == 0;
+  const int64_t dt = sample.local - e.at;
+  if (first || dt <= 0) {
+    e.offset = sample.offset;
+  } else if (e.samples == 1) {
+    e.drift = static_cast<double>(sample.offset - e.offset) / dt;
+    e.offset = sample.offset;
+  } else {
+    const double predicted = e.offset + e.drift * dt;
+    const double residual = sample.offset - predicted;
+    e.offset = static_cast<int64_t>(predicted + ALPHA * residual);
+    e.drift += BETA * residual / dt;
+  }
+  e.drift = max(-MAX_DRIFT, min(MAX_DRIFT, e.drift));
+  e.at = sample.local;
+  e.rtt = sample.rtt;
+  e.samples++;
+
+  // From now on, the correction goes from the one in force to the
+  // estimate, continuously.  Anchored at the sample instead, the slew
+  // would be partly done already and the correction would jump.
+  Correction next;
+  next.offset = e.offset;
+  next.drift = e.drift;
+  next.at = e.at;
+  next.from = now;
+  next.gap = first && !started_ ? 0 :
+      Offset(correction_, now) - e.offset -
+      static_cast<int64_t>(e.drift * (now - e.at));
+  next.until = now + max(slew_micros_, static_cast<int64_t>(
+      (next.gap < 0 ? -next.gap : next.gap) / MAX_SLEW_RATE));
+
+  store_release(version_, version_ + 1);
+  compiler_barrier();
+  correction_ = next;
+  compiler_barrier();
+  store_release(version_, version_ + 1);
+
+  VLOG(VLOG_LEVEL) << "Clock offset " << e.offset << " usec, drift "
+                   << e.drift * 1e6 << " ppm, rtt " << e.rtt << " usec.";
+  return true;
+}
+
+void ClockDiscipline::OnServerTime(long seconds, int64_t sent,
+                                   int64_t received)
+{
+  // The reply carries the server time truncated to the second, taken
+  // between sent and received.
+  const int64_t server = static_cast<int64_t>(seconds) * 1000000;
+  const int64_t lower = server - received;
+  const int64_t upper = server + 1000000 - sent;
+
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  Estimate& e = estimate_;
+  const int n = static_cast<int>(min<uint64_t>(e.server_samples, 16));
+  int64_t low = lower;
+  int64_t high = upper;
+  for (int i = 0; i < n; ++i) {
+    low = max(low, server_lower_[i]);
+    high = min(high, server_upper_[i]);
+  }
+  if (low > high) {
+    // The windows do not meet, so the server clock was stepped.
+    LOG(WARNING) << "TWS time moved; restarting its estimate.";
+    e.server_samples = 0;
+    low = lower;
+    high = upper;
+  }
+  server_lower_[e.server_samples % 16] = lower;
+  server_upper_[e.server_samples % 16] = upper;
+  e.server_samples++;
+  e.server_offset = low + (high - low) / 2;
+  e.server_error = (high - low) / 2;
+}
+
+ClockDiscipline::Estimate ClockDiscipline::GetEstimate() const
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  return estimate_;
+}
+
+} // namespace ib
@@ -0,0 +1,192 @@
+#ifndef IB_CLOCK_DISCIPLINE_H_
+#define IB_CLOCK_DISCIPLINE_H_
+
+// Estimates the offset and drift of the local clock against a
+// reference, so that tick timestamps taken on this host can be
+// compared with those of the gateway, the exchange or another host.
+//
+// A background thread polls a ClockSource, usually NTP.  Each poll
+// takes a few samples and keeps the one with the smallest round
+// trip, whose offset is the least disturbed by queueing; polls whose
+// best round trip is far above the recent ones are dropped.  The
+// kept offsets go through an alpha-beta filter that smooths the
+// offset and tracks the drift (the rate of the local clock against
+// the reference).
+//
+// The correction applied is slewed, not stepped: when an update is
+// published, the difference at that instant between the correction in
+// force and the new estimate is taken off linearly over the poll
+// interval, at most half a second a second, so corrected times never
+// go backwards.  The slew starts at the publication, not at the
+// sample, which was taken a poll's round trips earlier.  Only a first
+// sample taken before Start returns sets the correction at once:
+// Start polls once itself, before the feed is up.  A first sample that
+// comes later, when that poll failed, is slewed like the others.
+//
+// The estimate is published behind a sequence lock, as in
+// quote_table.hpp: Correct() reads it without locks and without
+// system calls, so it can stamp every tick.
+//
+// The TWS server time from reqCurrentTime() is tracked as well.  It
+// has only second resolution, but each reply bounds the offset to the
+// window between the request and the reply, and the intersection of
+// the windows of recent replies narrows it well below a second.  It
+// is reported, not applied.
+
+#include <stdint.h>
+#include <string>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "common.hpp"
+#include "lockfree.hpp"
+
+namespace ib {
+
+struct ClockSample
+{
+  int64_t local;   // Local micros at the middle of the exchange.
+  int64_t offset;  // Reference minus local, micros.
+  int64_t rtt;     // Round trip, less the time spent by the server.
+};
+
+class ClockSource
+{
+ public:
+  virtual ~ClockSource() {}
+
+  // One exchange with the reference.  Returns false on a timeout or
+  // a bad reply.
+  virtual bool Sample(ClockSample* sample) = 0;
+};
+
+// SNTP (RFC 4330) client of one server.
+class NtpSource : public ClockSource, NoCopyAndAssign
+{
+ public:
+  // Host or host:port.  The default port is 123.
+  NtpSource(const std::string& server, int timeout_millis);
+  virtual ~NtpSource();
+
+  virtual bool Sample(ClockSample* sample);
+
+ private:
+  bool Open();
+
+  const std::string server_;
+  const int timeout_millis_;
+  int socket_;
+};
+
+// NTP timestamps: seconds since 1900 in the high 32 bits, the
+// fraction in the low 32.
+uint64_t MicrosToNtp(int64_t micros);
+int64_t NtpToMicros(uint64_t ntp);
+
+class ClockDiscipline : NoCopyAndAssign
+{
+ public:
+  // The source may be NULL to track only the server time.  It is not
+  // owned.
+  explicit ClockDiscipline(ClockSource* source, int samples_per_poll = 4);
+  ~ClockDiscipline();
+
+  // Polls once, then every poll_secs on a background thread, and
+  // slews the correction over as long.  The first poll blocks for its
+  // samples, up to their timeouts.
+  void Start(int poll_secs);
+  void Stop();
+
+  // One poll.  Returns false if no sample was taken or it was
+  // dropped.
+  bool Poll();
+
+  // Feeds a sample directly, e.g. the best of a poll, published at now
+  // in local micros.
+  bool Update(const ClockSample& sample);
+  bool Update(const ClockSample& sample, int64_t now);
+
+  // A currentTime() reply of the TWS: the server seconds, and local
+  // micros when reqCurrentTime() was sent and the reply received.
+  void OnServerTime(long seconds, int64_t sent, int64_t received);
+
+  // Reference micros for a local timestamp: the local one until the
+  // first sample.  Lock-free.
+  inline int64_t Correct(int64_t local) const
+  {
+    while (true) {
+      const uint64_t version = lab616::lockfree::load_acquire(version_);
+      if (version & 1) continue;  // Being updated.
+      const Correction c = correction_;
+      lab616::lockfree::compiler_barrier();
+      if (lab616::lockfree::load_acquire(version_) == version) {
+        return local + Offset(c, local);
+      }
+    }
+  }
+
+  struct Estimate
+  {
+    int64_t offset;         // Reference minus local at 'at', micros.
+    double drift;           // Seconds gained per second, e.g. 1e-5.
+    int64_t at;             // Local micros of the last update.
+    int64_t rtt;            // Of the last kept sample.
+    uint64_t samples;       // Kept.
+    uint64_t dropped;
+    int64_t server_offset;  // TWS time minus local, micros.
+    int64_t server_error;   // Half the width of its window.
+    uint64_t server_samples;
+  };
+  Estimate GetEstimate() const;
+
+ private:
+  void Run(int poll_secs);
+
+  struct Correction
+  {
+    int64_t offset;  // Of the estimate, at 'at'.
+    double drift;
+    int64_t at;
+    int64_t gap;     // Correction in force minus estimate, at 'from'.
+    int64_t from;    // Local micros of the publication, the slew start.
+    int64_t until;
+  };
+
+  static inline int64_t Offset(const Correction& c, int64_t local)
+  {
+    int64_t offset = c.offset + static_cast<int64_t>(c.drift * (local - c.at));
+    if (local < c.until) {
+      offset += local <= c.from ? c.gap : static_cast<int64_t>(
+          static_cast<double>(c.gap) * (c.until - local) /
+          (c.until - c.from));
+    }
+    return offset;
+  }
+
+  ClockSource* source_;
+  const int samples_per_poll_;
+
+  volatile uint64_t version_;   // Of correction_, as in QuoteTable.
+  Correction correction_;
+  int64_t slew_micros_;         // The poll interval.
+  bool started_;                // Later first samples are slewed.
+
+  mutable boost::mutex mutex_;  // Everything else.
+  Estimate estimate_;
+  int64_t recent_rtts_[8];      // Best round trips of recent polls.
+  int recent_;
+
+  // Windows of recent TWS replies: the server offset lies in each.
+  int64_t server_lower_[16];
+  int64_t server_upper_[16];
+
+  boost::mutex run_mutex_;
+  boost::condition_variable run_control_;
+  bool running_;
+  boost::scoped_ptr<boost::thread> thread_;
+};
+
+} // namespace ib
+
+#endif // IB_CLOCK_DISCIPLINE_H_
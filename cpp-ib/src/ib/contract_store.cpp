@@ -0,0 +1,388 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+#include "ib/contract_store.hpp"
+
+#define VLOG_LEVEL 2
+
+using namespace std;
+using ib::wire::Interner;
+using ib::wire::StringRef;
+
+namespace ib {
+
+static StringRef Ref(const string& s)
+{
+  return StringRef(s.c_str(), s.size());
+}
+
+static StringRef Ref(const Interner& names, int id)
+{
+  return id == Interner::NONE ? StringRef() : names.Name(id);
+}
+
+static size_t InternerMemory(const Interner& names)
+{
+  size_t bytes = 0;
+  for (int i = 0; i < names.size(); ++i) {
+    bytes += names.Name(i).size + 1 + sizeof(StringRef) +
+        sizeof(uint32_t) + 2 * sizeof(int);
+  }
+  return bytes;
+}
+
+template <typename T>
+static size_t VectorMemory(const vector<T>& v)
+{
+  return v.capacity() * sizeof(T);
+}
+
+ContractStore::ContractStore()
+    : names_(1 << 16)
+    , symbols_(1 << 30)
+    , compact_(true)
+{
+  // Id 0 of both, and offset 0 of the text, is the empty string.
+  names_.Intern(StringRef());
+  symbols_.Intern(StringRef());
+  text_.push_back('\0');
+}
+
+ContractStore::~ContractStore()
+{
+}
+
+int ContractStore::Add(const ContractDetails& details)
+{
+  const Contract& c = details.summary;
+  Row row;
+  row.con_id = c.conId;
+  row.symbol = Ref(c.symbol);
+  row.long_name = Ref(details.longName);
+  row.local_symbol = Ref(c.localSymbol);
+  row.expiry = ParseExpiry(c.expiry.c_str());
+  row.strike = c.strike;
+  row.right = c.right.empty() ? 0 : c.right[0];
+  row.min_tick = details.minTick;
+  row.price_magnifier = details.priceMagnifier;
+  row.under_con_id = details.underConId;
+  row.names[SEC_TYPE] = Ref(c.secType);
+  row.names[EXCHANGE] = Ref(c.exchange);
+  row.names[PRIMARY_EXCHANGE] = Ref(c.primaryExchange);
+  row.names[CURRENCY] = Ref(c.currency);
+  row.names[MULTIPLIER] = Ref(c.multiplier);
+  row.names[MARKET_NAME] = Ref(details.marketName);
+  row.names[TRADING_CLASS] = Ref(details.tradingClass);
+  row.names[ORDER_TYPES] = Ref(details.orderTypes);
+  row.names[VALID_EXCHANGES] = Ref(details.validExchanges);
+  row.names[CONTRACT_MONTH] = Ref(details.contractMonth);
+  row.names[INDUSTRY] = Ref(details.industry);
+  row.names[CATEGORY] = Ref(details.category);
+  row.names[SUBCATEGORY] = Ref(details.subcategory);
+  row.names[TIME_ZONE_ID] = Ref(details.timeZoneId);
+  row.names[TRADING_HOURS] = Ref(details.tradingHours);
+  row.names[LIQUID_HOURS] = Ref(details.liquidHours);
+  return Add(row);
+}
+
+int ContractStore::Add(const wire::ContractDetailsView& details,
+                       const Interner& names)
+{
+  Row row;
+  row.con_id = details.con_id;
+  row.symbol = details.symbol;
+  row.long_name = details.long_name;
+  row.local_symbol = details.local_symbol;
+  row.expiry = ParseExpiry(details.expiry.data);
+  row.strike = details.strike;
+  row.right = details.right.size ? details.right.data[0] : 0;
+  row.min_tick = details.min_tick;
+  row.price_magnifier = details.price_magnifier;
+  row.under_con_id = details.under_con_id;
+  row.names[SEC_TYPE] = Ref(names, details.sec_type);
+  row.names[EXCHANGE] = Ref(names, details.exchange);
+  row.names[PRIMARY_EXCHANGE] = Ref(names, details.primary_exchange);
+  row.names[CURRENCY] = Ref(names, details.currency);
+  row.names[MULTIPLIER] = details.multiplier;
+  row.names[MARKET_NAME] = details.market_name;
+  row.names[TRADING_CLASS] = details.trading_class;
+  row.names[ORDER_TYPES] = details.order_types;
+  row.names[VALID_EXCHANGES] = details.valid_exchanges;
+  row.names[CONTRACT_MONTH] = details.contract_month;
+  row.names[INDUSTRY] = details.industry;
+  row.names[CATEGORY] = details.category;
+  row.names[SUBCATEGORY] = details.subcategory;
+  row.names[TIME_ZONE_ID] = Ref(names, details.time_zone_id);
+  row.names[TRADING_HOURS] = details.trading_hours;
+  row.names[LIQUID_HOURS] = details.liquid_hours;
+  return Add(row);
+}
+
+int ContractStore::Add(const Row& row)
+{
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  int slot = FindConId(row.con_id);
+  const bool update = slot != NONE;
+  if (update) {
+    UnindexChain(slot);
+  } else {
+    slot = size();
+    con_id_.push_back(row.con_id);
+    symbol_.push_back(0);
+    long_name_.push_back(0);
+    local_symbol_.push_back(0);
+    expiry_.push_back(0);
+    strike_.push_back(0);
+    right_.push_back(0);
+    min_tick_.push_back(0);
+    price_magnifier_.push_back(0);
+    under_con_id_.push_back(0);
+    for (int i = 0; i < NAMES; ++i) name_[i].push_back(0);
+  }
+
+  symbol_[slot] = InternSymbol(row.symbol);
+  long_name_[slot] = InternSymbol(row.long_name);
+  if (!update || !(row.local_symbol == local_symbol(slot))) {
+    local_symbol_[slot] = text_.size();
+    text_.insert(text_.end(), row.local_symbol.data,
+                 row.local_symbol.data + row.local_symbol.size);
+    text_.push_back('\0');
+  }
+  expiry_[slot] = row.expiry;
+  strike_[slot] = row.strike;
+  right_[slot] = row.right;
+  min_tick_[slot] = row.min_tick;
+  price_magnifier_[slot] = row.price_magnifier;
+  under_con_id_[slot] = row.under_con_id;
+  for (int i = 0; i < NAMES; ++i) name_[i][slot] = InternName(row.names[i]);
+
+  if (!update) IndexConId(slot);
+  IndexChain(slot);
+  compact_ = false;
+  return slot;
+}
+
+template <typename T>
+void ContractStore::Permute(const vector<int>& order, vector<T>* column)
+{
+  vector<T> permuted(order.size());
+  for (size_t i = 0; i < order.size(); ++i) permuted[i] = (*column)[order[i]];
+  column->swap(permuted);
+}
+
+void ContractStore::Compact()
+{
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  if (compact_) return;
+  // Chain after chain, each in its order.
+  vector<int> order;
+  order.reserve(size());
+  for (size_t id = 0; id < chains_.size(); ++id) {
+    vector<int>& chain = chains_[id];
+    for (size_t i = 0; i < chain.size(); ++i) {
+      order.push_back(chain[i]);
+      chain[i] = order.size() - 1;
+    }
+  }
+  DCHECK_EQ(size(), static_cast<int>(order.size()));
+  Permute(order, &con_id_);
+  Permute(order, &symbol_);
+  Permute(order, &long_name_);
+  Permute(order, &local_symbol_);
+  Permute(order, &expiry_);
+  Permute(order, &strike_);
+  Permute(order, &right_);
+  Permute(order, &min_tick_);
+  Permute(order, &price_magnifier_);
+  Permute(order, &under_con_id_);
+  for (int i = 0; i < NAMES; ++i) Permute(order, &name_[i]);
+
+  con_id_slots_.assign(con_id_slots_.size(), NONE);
+  for (int slot = 0; slot < size(); ++slot) IndexConId(slot);
+  compact_ = true;
+  VLOG(VLOG_LEVEL) << "Compacted " << size() << " contracts in "
+                   << chains_.size() << " chains.";
+}
+
+uint16_t ContractStore::InternName(const StringRef& name)
+{
+  const int id = names_.Intern(name);
+  LOG_IF(WARNING, id == Interner::NONE)
+      << "Too many distinct contract fields; " << name.data
+      << " is kept as empty.";
+  return id == Interner::NONE ? 0 : id;
+}
+
+uint32_t ContractStore::InternSymbol(const StringRef& name)
+{
+  const int id = symbols_.Intern(name);
+  return id == Interner::NONE ? 0 : id;
+}
+
+static size_t HashConId(long con_id)
+{
+  return static_cast<uint32_t>(con_id) * 2654435761U;
+}
+
+void ContractStore::IndexConId(int slot)
+{
+  // At most half full.
+  if (static_cast<size_t>(size()) * 2 > con_id_slots_.size()) {
+    con_id_slots_.assign(max<size_t>(1024, con_id_slots_.size() * 2), NONE);
+    for (int i = 0; i < slot; ++i) IndexConId(i);
+  }
+  const size_t mask = con_id_slots_.size() - 1;
+  size_t i = HashConId(con_id_[slot]) & mask;
+  while (con_id_slots_[i] != NONE) i = (i + 1) & mask;
+  con_id_slots_[i] = slot;
+}
+
+int ContractStore::FindConId(long con_id) const
+{
+  if (con_id_slots_.empty()) return NONE;
+  const size_t mask = con_id_slots_.size() - 1;
+  for (size_t i = HashConId(con_id) & mask; con_id_slots_[i] != NONE;
+       i = (i + 1) & mask) {
+    if (con_id_[con_id_slots_[i]] == con_id) return con_id_slots_[i];
+  }
+  return NONE;
+}
+
+bool ContractStore::Before(int a, int b) const
+{
+  if (expiry_[a] != expiry_[b]) return expiry_[a] < expiry_[b];
+  if (strike_[a] != strike_[b]) return strike_[a] < strike_[b];
+  return right_[a] < right_[b];
+}
+
+void ContractStore::IndexChain(int slot)
+{
+  if (chains_.size() <= symbol_[slot]) chains_.resize(symbol_[slot] + 1);
+  vector<int>& chain = chains_[symbol_[slot]];
+  // After its equals, as they arrived.
+  size_t low = 0;
+  size_t high = chain.size();
+  while (low < high) {
+    const size_t middle = (low + high) / 2;
+    if (Before(slot, chain[middle])) {
+      high = middle;
+    } else {
+      low = middle + 1;
+    }
+  }
+  chain.insert(chain.begin() + low, slot);
+}
+
+void ContractStore::UnindexChain(int slot)
+{
+  vector<int>& chain = chains_[symbol_[slot]];
+  chain.erase(find(chain.begin(), chain.end(), slot));
+}
+
+const vector<int>* ContractStore::FindSymbol(const string& symbol) const
+{
+  const int id = symbols_.Find(Ref(symbol));
+  if (id == Interner::NONE || static_cast<size_t>(id) >= chains_.size() ||
+      chains_[id].empty()) {
+    return NULL;
+  }
+  return &chains_[id];
+}
+
+int ContractStore::FindOption(const string& symbol, int expiry,
+                              double strike, char right) const
+{
+  const vector<int>* chain = FindSymbol(symbol);
+  if (chain == NULL) return NONE;
+  size_t low = 0;
+  size_t high = chain->size();
+  while (low < high) {
+    const size_t middle = (low + high) / 2;
+    const int s = (*chain)[middle];
+    const bool before = expiry_[s] != expiry ? expiry_[s] < expiry :
+        strike_[s] != strike ? strike_[s] < strike : right_[s] < right;
+    if (before) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if (low == chain->size()) return NONE;
+  const int s = (*chain)[low];
+  return expiry_[s] == expiry && strike_[s] == strike && right_[s] == right ?
+      s : NONE;
+}
+
+void ContractStore::Get(int slot, ContractDetails* details) const
+{
+  Contract& c = details->summary;
+  c.conId = con_id_[slot];
+  c.symbol = symbol(slot).str();
+  c.secType = name(slot, SEC_TYPE).str();
+  c.expiry = FormatExpiry(expiry_[slot]);
+  c.strike = strike_[slot];
+  c.right = right_[slot] ? string(1, right_[slot]) : string();
+  c.multiplier = name(slot, MULTIPLIER).str();
+  c.exchange = name(slot, EXCHANGE).str();
+  c.primaryExchange = name(slot, PRIMARY_EXCHANGE).str();
+  c.currency = name(slot, CURRENCY).str();
+  c.localSymbol = local_symbol(slot);
+  details->marketName = name(slot, MARKET_NAME).str();
+  details->tradingClass = name(slot, TRADING_CLASS).str();
+  details->minTick = min_tick_[slot];
+  details->orderTypes = name(slot, ORDER_TYPES).str();
+  details->validExchanges = name(slot, VALID_EXCHANGES).str();
+  details->priceMagnifier = price_magnifier_[slot];
+  details->underConId = under_con_id_[slot];
+  details->longName = long_name(slot).str();
+  details->contractMonth = name(slot, CONTRACT_MONTH).str();
+  details->industry = name(slot, INDUSTRY).str();
+  details->category = name(slot, CATEGORY).str();
+  details->subcategory = name(slot, SUBCATEGORY).str();
+  details->timeZoneId = name(slot, TIME_ZONE_ID).str();
+  details->tradingHours = name(slot, TRADING_HOURS).str();
+  details->liquidHours = name(slot, LIQUID_HOURS).str();
+}
+
+size_t ContractStore::memory() const
+{
+  size_t bytes = InternerMemory(names_) + InternerMemory(symbols_) +
+      VectorMemory(text_) + VectorMemory(con_id_) + VectorMemory(symbol_) +
+      VectorMemory(long_name_) + VectorMemory(local_symbol_) +
+      VectorMemory(expiry_) + VectorMemory(strike_) + VectorMemory(right_) +
+      VectorMemory(min_tick_) + VectorMemory(price_magnifier_) +
+      VectorMemory(under_con_id_) + VectorMemory(con_id_slots_) +
+      VectorMemory(chains_);
+  for (int i = 0; i < NAMES; ++i) bytes += VectorMemory(name_[i]);
+  for (size_t i = 0; i < chains_.size(); ++i) {
+    bytes += VectorMemory(chains_[i]);
+  }
+  return bytes;
+}
+
+int ContractStore::ParseExpiry(const char* expiry)
+{
+  const size_t length = strlen(expiry);
+  const int value = atoi(expiry);
+  return length == 6 ? value * 100 : value;
+}
+
+string ContractStore::FormatExpiry(int expiry)
+{
+  if (expiry == 0) return "";
+  char buff[16];
+  if (expiry % 100 == 0) {
+    snprintf(buff, sizeof(buff), "%06d", expiry / 100);
+  } else {
+    snprintf(buff, sizeof(buff), "%08d", expiry);
+  }
+  return buff;
+}
+
+} // namespace ib
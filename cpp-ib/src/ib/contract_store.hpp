@@ -0,0 +1,193 @@
+#ifndef IB_CONTRACT_STORE_H_
+#define IB_CONTRACT_STORE_H_
+
+// Contract details of a whole universe (option chains of thousands of
+// underlyings), in a fraction of the memory of ContractDetails.
+//
+// Each contract gets a slot, and each field is a column indexed by
+// slot.  Fields from a small vocabulary (exchanges, currencies,
+// trading hours, ...) are 16-bit ids in an Interner, symbols and long
+// names 32-bit ids in another, local symbols offsets into one block of
+// text; expiries are yyyymmdd ints and rights a char.  An option
+// takes about 150 bytes with the indexes, against a kilobyte and a
+// half as ContractDetails with its 40-odd strings.
+//
+// Slots are given in arrival order, so chains loaded at once are
+// interleaved over the columns.  Compact, run when the loading ends,
+// lays each chain out again in one run of slots ordered by expiry,
+// strike and right, so reading a chain walks the columns in order;
+// contracts added later go at the end until the next Compact.  Each
+// symbol has a list of its slots in that order, through which a
+// chain is read and a single option found by binary search.
+// Contracts are also found by conId.
+//
+// There is one writer.  Add and Compact take mutex(), and readers on
+// other threads hold it while they read.  Compact renumbers the slots:
+// a slot is good only until the next Compact.
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include <Shared/Contract.h>
+
+#include "common.hpp"
+#include "ib/wire/decoder.hpp"
+#include "ib/wire/interner.hpp"
+
+namespace ib {
+
+class ContractStore : NoCopyAndAssign
+{
+ public:
+  enum { NONE = -1 };
+
+  // Fields of few distinct values.
+  enum Name {
+    SEC_TYPE = 0,
+    EXCHANGE,
+    PRIMARY_EXCHANGE,
+    CURRENCY,
+    MULTIPLIER,
+    MARKET_NAME,
+    TRADING_CLASS,
+    ORDER_TYPES,
+    VALID_EXCHANGES,
+    CONTRACT_MONTH,
+    INDUSTRY,
+    CATEGORY,
+    SUBCATEGORY,
+    TIME_ZONE_ID,
+    TRADING_HOURS,
+    LIQUID_HOURS,
+    NAMES
+  };
+
+  ContractStore();
+  ~ContractStore();
+
+  // Adds a contract, or updates the one with its conId, and returns
+  // its slot.  Bond fields are not kept.
+  int Add(const ContractDetails& details);
+
+  // The same from the wire decoder, whose ids are in names.
+  int Add(const wire::ContractDetailsView& details,
+          const wire::Interner& names);
+
+  // Lays each chain out in one run of slots, in the order of
+  // FindSymbol.  Linear in the contracts; nothing is done if no
+  // contract was added since the last time.
+  void Compact();
+
+  // The contract as ContractDetails, e.g. to place an order for it.
+  void Get(int slot, ContractDetails* details) const;
+
+  int size() const { return static_cast<int>(con_id_.size()); }
+
+  // Bytes of the columns, text and indexes.
+  size_t memory() const;
+
+  boost::mutex& mutex() const { return mutex_; }
+
+  // Lookups.  NONE / NULL if there is no such contract.
+  int FindConId(long con_id) const;
+
+  // Slots of the symbol's contracts, ordered by expiry, strike and
+  // right (stocks, without expiry, first).  After Compact they are
+  // adjacent and ascending; those added since come in arrival order.
+  const std::vector<int>* FindSymbol(const std::string& symbol) const;
+
+  // An option: expiry is yyyymmdd and right 'C' or 'P'.
+  int FindOption(const std::string& symbol, int expiry, double strike,
+                 char right) const;
+
+  // Columns.
+  long con_id(int slot) const { return con_id_[slot]; }
+  wire::StringRef symbol(int slot) const
+  {
+    return symbols_.Name(symbol_[slot]);
+  }
+  wire::StringRef long_name(int slot) const
+  {
+    return symbols_.Name(long_name_[slot]);
+  }
+  const char* local_symbol(int slot) const
+  {
+    return &text_[local_symbol_[slot]];
+  }
+  int expiry(int slot) const { return expiry_[slot]; }  // yyyymmdd or 0.
+  double strike(int slot) const { return strike_[slot]; }
+  char right(int slot) const { return right_[slot]; }    // 'C', 'P' or 0.
+  double min_tick(int slot) const { return min_tick_[slot]; }
+  int price_magnifier(int slot) const { return price_magnifier_[slot]; }
+  int under_con_id(int slot) const { return under_con_id_[slot]; }
+  wire::StringRef name(int slot, Name field) const
+  {
+    return names_.Name(name_[field][slot]);
+  }
+
+  // "20110121" or "201101" to 20110121 or 20110100; 0 if empty.
+  static int ParseExpiry(const char* expiry);
+  static std::string FormatExpiry(int expiry);
+
+ private:
+  // The fields every Add takes, whatever they come from.
+  struct Row
+  {
+    long con_id;
+    wire::StringRef symbol;
+    wire::StringRef long_name;
+    wire::StringRef local_symbol;
+    int expiry;
+    double strike;
+    char right;
+    double min_tick;
+    int price_magnifier;
+    int under_con_id;
+    wire::StringRef names[NAMES];
+  };
+
+  int Add(const Row& row);
+  uint16_t InternName(const wire::StringRef& name);
+  uint32_t InternSymbol(const wire::StringRef& name);
+  void IndexConId(int slot);
+  void IndexChain(int slot);
+  void UnindexChain(int slot);
+
+  // Orders the slots of a chain.
+  bool Before(int a, int b) const;
+
+  // Puts the contract of slot order[i] in slot i.
+  template <typename T>
+  static void Permute(const std::vector<int>& order, std::vector<T>* column);
+
+  mutable boost::mutex mutex_;
+
+  wire::Interner names_;
+  wire::Interner symbols_;
+  std::vector<char> text_;
+
+  // Columns.
+  std::vector<int32_t> con_id_;
+  std::vector<uint32_t> symbol_;
+  std::vector<uint32_t> long_name_;
+  std::vector<uint32_t> local_symbol_;  // Offsets into text_.
+  std::vector<int32_t> expiry_;
+  std::vector<double> strike_;
+  std::vector<char> right_;
+  std::vector<double> min_tick_;
+  std::vector<int32_t> price_magnifier_;
+  std::vector<int32_t> under_con_id_;
+  std::vector<uint16_t> name_[NAMES];
+
+  // Indexes.
+  std::vector<int> con_id_slots_;         // Open addressed; NONE if free.
+  std::vector<std::vector<int> > chains_;  // By symbol id.
+  bool compact_;  // No contract added since Compact.
+};
+
+} // namespace ib
+
+#endif // IB_CONTRACT_STORE_H_
@@ -0,0 +1,709 @@
+
+#include <ctype.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <glog/logging.h>
+#include <zmq.hpp>
+
+#include "messaging.hpp"
+#include "ib/control_plane.hpp"
+#include "ib/marketdata.hpp"
+#include "ib/ticker_id.hpp"
+#include "ib/warm_state.hpp"
+
+#define VLOG_LEVEL 2
+
+using namespace std;
+using namespace ib::actions;
+using ib::common::Date;
+using ib::common::Duration;
+using ib::common::Interval;
+using ib::internal::SymbolToTickerId;
+using ib::services::MarketDataInterface;
+
+namespace ib {
+
+typedef ActionResults_Result Result;
+
+// Wait for a request before checking for a stop; zmq 2 polls in
+// micros.
+static const long POLL_MICROS = 100000;
+
+static const int NOT_CONNECTED = 504;
+
+// The ticker ids of market data encode at most 4 letters, and an
+// option strike in the 11 bits below.
+static bool ValidSymbol(const string& symbol)
+{
+  if (symbol.empty() || symbol.size() > 4) return false;
+  for (size_t i = 0; i < symbol.size(); ++i) {
+    if (!isalpha(symbol[i])) return false;
+  }
+  return true;
+}
+
+static bool ValidDate(const Date& date)
+{
+  return date.year() > 1900 && date.month() >= 1 && date.month() <= 12 &&
+      date.day() >= 1 && date.day() <= 31;
+}
+
+// Bar sizes the API takes, e.g. "5 mins"; empty if not one.
+static string BarSizeSetting(const Interval& interval)
+{
+  const int n = interval.duration();
+  switch (interval.unit()) {
+    case Interval::MINUTE:
+      if (n == 1) return "1 min";
+      if (n == 2 || n == 3 || n == 5 || n == 15 || n == 30) {
+        char buff[16];
+        snprintf(buff, sizeof(buff), "%d mins", n);
+        return buff;
+      }
+      break;
+    case Interval::HOUR:
+      if (n == 1) return "1 hour";
+      break;
+    case Interval::DAY:
+      if (n == 1) return "1 day";
+      break;
+    case Interval::WEEK:
+      if (n == 1) return "1 week";
+      break;
+  }
+  return "";
+}
+
+template <typename DateTime>
+static time_t UtcSeconds(const DateTime& at)
+{
+  struct tm t;
+  memset(&t, 0, sizeof(t));
+  t.tm_year = at.date().year() - 1900;
+  t.tm_mon = at.date().month() - 1;
+  t.tm_mday = at.date().day();
+  if (at.has_time()) {
+    t.tm_hour = at.time().hour();
+    t.tm_min = at.time().minute();
+    t.tm_sec = at.time().second();
+  }
+  return timegm(&t);
+}
+
+// The end and the duration of the request, e.g. "20110114 21:00:00
+// GMT" and "3 D".  Returns false if the range is empty.
+static bool HistoryRange(const Duration& duration, string* end,
+                         string* length)
+{
+  if (!ValidDate(duration.start().date()) ||
+      !ValidDate(duration.end().date())) {
+    return false;
+  }
+  const time_t start_secs = UtcSeconds(duration.start());
+  const time_t end_secs = UtcSeconds(duration.end());
+  if (end_secs <= start_secs) return false;
+
+  struct tm t;
+  gmtime_r(&end_secs, &t);
+  char buff[32];
+  strftime(buff, sizeof(buff), "%Y%m%d %H:%M:%S GMT", &t);
+  end->assign(buff);
+
+  const long secs = end_secs - start_secs;
+  const long days = (secs + 86399) / 86400;
+  if (secs < 86400) {
+    snprintf(buff, sizeof(buff), "%ld S", secs);
+  } else if (days <= 365) {
+    snprintf(buff, sizeof(buff), "%ld D", days);
+  } else {
+    snprintf(buff, sizeof(buff), "%ld Y", (days + 364) / 365);
+  }
+  length->assign(buff);
+  return true;
+}
+
+template <typename Request>
+static bool ParseAndApply(ControlPlane* plane, const string& body,
+                          ActionResults* results)
+{
+  Request request;
+  if (!request.ParseFromString(body)) {
+    results->set_error("Malformed " + request.GetTypeName());
+    return false;
+  }
+  plane->Apply(request, results);
+  return true;
+}
+
+ControlPlane::ControlPlane(EClient* client, WarmState* state,
+                           size_t max_lines, TickerId first_id)
+    : client_(client)
+    , state_(state)
+    , max_lines_(max_lines)
+    , next_id_(first_id)
+    , stop_(false)
+{
+}
+
+ControlPlane::~ControlPlane()
+{
+  Stop();
+}
+
+bool ControlPlane::Start(const string& endpoint)
+{
+  CHECK(!thread_);
+  context_.reset(new zmq::context_t(1));
+  socket_.reset(new zmq::socket_t(*context_, ZMQ_REP));
+  try {
+    socket_->bind(endpoint.c_str());
+  } catch (const zmq::error_t& e) {
+    LOG(ERROR) << "Cannot bind the control plane to " << endpoint << ": "
+               << e.what();
+    socket_.reset();
+    context_.reset();
+    return false;
+  }
+  LOG(INFO) << "Control plane at " << endpoint;
+  stop_ = false;
+  thread_.reset(new boost::thread(boost::bind(&ControlPlane::Serve, this)));
+  return true;
+}
+
+void ControlPlane::Stop()
+{
+  if (!thread_) return;
+  stop_ = true;
+  thread_->join();
+  thread_.reset();
+  socket_.reset();
+  context_.reset();
+}
+
+void ControlPlane::Serve()
+{
+  zmq::pollitem_t item = { *socket_, 0, ZMQ_POLLIN, 0 };
+  while (!stop_) {
+    try {
+      if (zmq::poll(&item, 1, POLL_MICROS) <= 0) continue;
+      vector<string> frames(1);
+      while (lab616::messaging::receive(*socket_, &frames.back())) {
+        frames.push_back("");
+      }
+      ActionResults results;
+      if (frames.size() != 2) {
+        results.set_error("Expected the type and the request.");
+      } else {
+        Handle(frames[0], frames[1], &results);
+      }
+      lab616::messaging::last(*socket_, results.SerializeAsString());
+    } catch (const zmq::error_t& e) {
+      LOG(ERROR) << "Control plane: " << e.what();
+    }
+  }
+}
+
+bool ControlPlane::Handle(const string& type, const string& body,
+                          ActionResults* results)
+{
+  bool ok;
+  if (type == RequestMarketData::default_instance().GetTypeName()) {
+    ok = ParseAndApply<RequestMarketData>(this, body, results);
+  } else if (type == CancelMarketData::default_instance().GetTypeName()) {
+    ok = ParseAndApply<CancelMarketData>(this, body, results);
+  } else if (type == RequestBars::default_instance().GetTypeName()) {
+    ok = ParseAndApply<RequestBars>(this, body, results);
+  } else if (type == CancelBars::default_instance().GetTypeName()) {
+    ok = ParseAndApply<CancelBars>(this, body, results);
+  } else if (type == RequestHistory::default_instance().GetTypeName()) {
+    ok = ParseAndApply<RequestHistory>(this, body, results);
+  } else if (type == CancelHistory::default_instance().GetTypeName()) {
+    ok = ParseAndApply<CancelHistory>(this, body, results);
+  } else {
+    results->set_error("Unknown request " + type);
+    ok = false;
+  }
+  if (!ok) {
+    LOG(WARNING) << "Control plane: " << results->error();
+    return false;
+  }
+  int queued = 0;
+  for (int i = 0; i < results->result_size(); ++i) {
+    if (results->result(i).status() == ActionResults::QUEUED) queued++;
+  }
+  LOG(INFO) << "Control plane: " << type << " of "
+            << results->result_size() << " instruments, " << queued
+            << " queued, " << lines() << " lines open.";
+  return true;
+}
+
+void ControlPlane::FromStock(const common::Stock& stock, Instrument* out)
+{
+  out->id = stock.id();
+  out->symbol = stock.symbol();
+  if (!ValidSymbol(out->symbol)) {
+    out->invalid = "Not a symbol of 1 to 4 letters.";
+    return;
+  }
+  out->ticker_id = SymbolToTickerId(out->symbol);
+  internal::CreateContractForStock(out->symbol, &out->contract);
+}
+
+void ControlPlane::FromOption(const common::Option& option, Instrument* out)
+{
+  out->id = option.id();
+  out->symbol = option.symbol();
+  if (!ValidSymbol(out->symbol)) {
+    out->invalid = "Not a symbol of 1 to 4 letters.";
+    return;
+  }
+  if (option.strike() <= 0 || option.strike() >= 1024) {
+    out->invalid = "Strike out of (0, 1024).";
+    return;
+  }
+  if (!ValidDate(option.expiry())) {
+    out->invalid = "No expiry.";
+    return;
+  }
+  const bool call = option.right() == common::CALL;
+  out->ticker_id = SymbolToTickerId(out->symbol, call, option.strike());
+  internal::CreateContractForOption(
+      out->symbol, call ? MarketDataInterface::CALL : MarketDataInterface::PUT,
+      option.strike(), option.expiry().year(), option.expiry().month(),
+      option.expiry().day(), &out->contract);
+}
+
+void ControlPlane::FromIndex(const common::Index& index, Instrument* out)
+{
+  out->id = index.id();
+  out->symbol = index.symbol();
+  if (!ValidSymbol(out->symbol)) {
+    out->invalid = "Not a symbol of 1 to 4 letters.";
+    return;
+  }
+  if (index.exhange().empty()) {
+    out->invalid = "No exchange.";
+    return;
+  }
+  out->ticker_id = SymbolToTickerId(out->symbol);
+  internal::CreateContractForIndex(out->symbol, index.exhange(),
+                                   &out->contract);
+}
+
+Result* ControlPlane::AddResult(const Instrument& instrument,
+                                ActionResults::Status status,
+                                ActionResults* results)
+{
+  Result* result = results->add_result();
+  result->set_id(instrument.id);
+  result->set_symbol(instrument.symbol);
+  result->set_status(status);
+  if (status == ActionResults::INVALID) {
+    result->set_message(instrument.invalid);
+  }
+  return result;
+}
+
+void ControlPlane::Apply(const RequestMarketData& request,
+                         ActionResults* results)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  for (int i = 0; i < request.stock_size(); ++i) {
+    Instrument instrument;
+    FromStock(request.stock(i).stock(), &instrument);
+    OpenMarketData(instrument, request.stock(i).snapshot(), results);
+  }
+  for (int i = 0; i < request.option_size(); ++i) {
+    Instrument instrument;
+    FromOption(request.option(i).option(), &instrument);
+    OpenMarketData(instrument, request.option(i).snapshot(), results);
+  }
+  for (int i = 0; i < request.index_size(); ++i) {
+    Instrument instrument;
+    FromIndex(request.index(i).index(), &instrument);
+    OpenMarketData(instrument, request.index(i).snapshot(), results);
+  }
+}
+
+void ControlPlane::Apply(const CancelMarketData& request,
+                         ActionResults* results)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  for (int i = 0; i < request.stock_size(); ++i) {
+    Instrument instrument;
+    FromStock(request.stock(i), &instrument);
+    CloseMarketData(instrument, results);
+  }
+  for (int i = 0; i < request.option_size(); ++i) {
+    Instrument instrument;
+    FromOption(request.option(i), &instrument);
+    CloseMarketData(instrument, results);
+  }
+  for (int i = 0; i < request.index_size(); ++i) {
+    Instrument instrument;
+    FromIndex(request.index(i), &instrument);
+    CloseMarketData(instrument, results);
+  }
+}
+
+void ControlPlane::Apply(const RequestBars& request, ActionResults* results)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  for (int i = 0; i < request.stock_size(); ++i) {
+    Instrument instrument;
+    FromStock(request.stock(i).stock(), &instrument);
+    OpenBars(instrument, request.stock(i).regular_trading_hours(),
+             results);
+  }
+  for (int i = 0; i < request.option_size(); ++i) {
+    Instrument instrument;
+    FromOption(request.option(i).option(), &instrument);
+    OpenBars(instrument, request.option(i).regular_trading_hours(),
+             results);
+  }
+  for (int i = 0; i < request.index_size(); ++i) {
+    Instrument instrument;
+    FromIndex(request.index(i).index(), &instrument);
+    OpenBars(instrument, request.index(i).regular_trading_hours(),
+             results);
+  }
+}
+
+void ControlPlane::Apply(const CancelBars& request, ActionResults* results)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  for (int i = 0; i < request.stock_size(); ++i) {
+    Instrument instrument;
+    FromStock(request.stock(i), &instrument);
+    Cancel(&bars_, true, instrument, results);
+  }
+  for (int i = 0; i < request.option_size(); ++i) {
+    Instrument instrument;
+    FromOption(request.option(i), &instrument);
+    Cancel(&bars_, true, instrument, results);
+  }
+  for (int i = 0; i < request.index_size(); ++i) {
+    Instrument instrument;
+    FromIndex(request.index(i), &instrument);
+    Cancel(&bars_, true, instrument, results);
+  }
+}
+
+void ControlPlane::Apply(const RequestHistory& request,
+                         ActionResults* results)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  for (int i = 0; i < request.stock_size(); ++i) {
+    const RequestHistory_Stock& stock = request.stock(i);
+    Instrument instrument;
+    FromStock(stock.stock(), &instrument);
+    OpenHistory(instrument, stock.bar_size(), stock.duration(),
+                stock.regular_trading_hours(), results);
+  }
+  for (int i = 0; i < request.option_size(); ++i) {
+    const RequestHistory_Option& option = request.option(i);
+    Instrument instrument;
+    FromOption(option.option(), &instrument);
+    OpenHistory(instrument, option.bar_size(), option.duration(),
+                option.regular_trading_hours(), results);
+  }
+  for (int i = 0; i < request.index_size(); ++i) {
+    const RequestHistory_Index& index = request.index(i);
+    Instrument instrument;
+    FromIndex(index.index(), &instrument);
+    OpenHistory(instrument, index.bar_size(), index.duration(),
+                index.regular_trading_hours(), results);
+  }
+}
+
+void ControlPlane::Apply(const CancelHistory& request,
+                         ActionResults* results)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  for (int i = 0; i < request.stock_size(); ++i) {
+    Instrument instrument;
+    FromStock(request.stock(i), &instrument);
+    Cancel(&history_, false, instrument, results);
+  }
+  for (int i = 0; i < request.option_size(); ++i) {
+    Instrument instrument;
+    FromOption(request.option(i), &instrument);
+    Cancel(&history_, false, instrument, results);
+  }
+  for (int i = 0; i < request.index_size(); ++i) {
+    Instrument instrument;
+    FromIndex(request.index(i), &instrument);
+    Cancel(&history_, false, instrument, results);
+  }
+}
+
+void ControlPlane::OpenMarketData(const Instrument& instrument,
+                                  bool snapshot, ActionResults* results)
+{
+  if (!instrument.invalid.empty()) {
+    AddResult(instrument, ActionResults::INVALID, results);
+    return;
+  }
+  if (streams_.find(instrument.ticker_id) != streams_.end() ||
+      snapshots_.count(instrument.ticker_id)) {
+    AddResult(instrument, ActionResults::ALREADY, results)
+        ->set_ticker_id(instrument.ticker_id);
+    return;
+  }
+  if (streams_.size() + snapshots_.size() >= max_lines_) {
+    AddResult(instrument, ActionResults::NO_LINES, results);
+    return;
+  }
+  if (snapshot) {
+    // Holds a line only until it ends.
+    client_->reqMktData(instrument.ticker_id, instrument.contract, "", true);
+    snapshots_.insert(instrument.ticker_id);
+    AddResult(instrument, ActionResults::QUEUED, results)
+        ->set_ticker_id(instrument.ticker_id);
+    return;
+  }
+  client_->reqMktData(instrument.ticker_id, instrument.contract,
+                      internal::GENERIC_TICK_TAGS, false);
+  Stream& stream = streams_[instrument.ticker_id];
+  stream.symbol = instrument.symbol;
+  stream.contract = instrument.contract;
+  stream.owned = true;
+  stream.lost = false;
+  dropped_.erase(instrument.ticker_id);
+  if (state_ && instrument.contract.secType == "STK") {
+    state_->Subscribe(instrument.symbol, false);
+  }
+  AddResult(instrument, ActionResults::QUEUED, results)
+      ->set_ticker_id(instrument.ticker_id);
+}
+
+void ControlPlane::CloseMarketData(const Instrument& instrument,
+                                   ActionResults* results)
+{
+  if (!instrument.invalid.empty()) {
+    AddResult(instrument, ActionResults::INVALID, results);
+    return;
+  }
+  Streams::iterator found = streams_.find(instrument.ticker_id);
+  if (found == streams_.end()) {
+    AddResult(instrument, ActionResults::NOT_OPEN, results);
+    return;
+  }
+  client_->cancelMktData(instrument.ticker_id);
+  // Tracked streams are the logger's stocks and indexes; an index is
+  // not in the state, and unsubscribing it is harmless.
+  if (state_ && instrument.contract.secType != "OPT") {
+    state_->Unsubscribe(instrument.symbol);
+  }
+  if (!found->second.owned) dropped_.insert(instrument.ticker_id);
+  streams_.erase(found);
+  AddResult(instrument, ActionResults::QUEUED, results)
+      ->set_ticker_id(instrument.ticker_id);
+}
+
+void ControlPlane::OpenBars(const Instrument& instrument, bool rth,
+                            ActionResults* results)
+{
+  if (!instrument.invalid.empty()) {
+    AddResult(instrument, ActionResults::INVALID, results);
+    return;
+  }
+  Requests::const_iterator found = bars_.find(instrument.ticker_id);
+  if (found != bars_.end()) {
+    AddResult(instrument, ActionResults::ALREADY, results)
+        ->set_ticker_id(found->second);
+    return;
+  }
+  const TickerId id = next_id_++;
+  client_->reqRealTimeBars(id, instrument.contract, 5, "TRADES", rth);
+  bars_[instrument.ticker_id] = id;
+  Bars& bars = bar_specs_[id];
+  bars.contract = instrument.contract;
+  bars.rth = rth;
+  bars.lost = false;
+  AddResult(instrument, ActionResults::QUEUED, results)->set_ticker_id(id);
+}
+
+void ControlPlane::OpenHistory(const Instrument& instrument,
+                               const Interval& bar_size,
+                               const Duration& duration, bool rth,
+                               ActionResults* results)
+{
+  if (!instrument.invalid.empty()) {
+    AddResult(instrument, ActionResults::INVALID, results);
+    return;
+  }
+  const string setting = BarSizeSetting(bar_size);
+  string end, length;
+  if (setting.empty()) {
+    AddResult(instrument, ActionResults::INVALID, results)
+        ->set_message("Unsupported bar size.");
+    return;
+  }
+  if (!HistoryRange(duration, &end, &length)) {
+    AddResult(instrument, ActionResults::INVALID, results)
+        ->set_message("Empty or malformed duration.");
+    return;
+  }
+  Requests::const_iterator found = history_.find(instrument.ticker_id);
+  if (found != history_.end()) {
+    AddResult(instrument, ActionResults::ALREADY, results)
+        ->set_ticker_id(found->second);
+    return;
+  }
+  const TickerId id = next_id_++;
+  client_->reqHistoricalData(id, instrument.contract, end, length, setting,
+                             "TRADES", rth ? 1 : 0, 1);
+  history_[instrument.ticker_id] = id;
+  AddResult(instrument, ActionResults::QUEUED, results)->set_ticker_id(id);
+}
+
+void ControlPlane::Cancel(Requests* requests, bool bars,
+                          const Instrument& instrument,
+                          ActionResults* results)
+{
+  if (!instrument.invalid.empty()) {
+    AddResult(instrument, ActionResults::INVALID, results);
+    return;
+  }
+  Requests::iterator found = requests->find(instrument.ticker_id);
+  if (found == requests->end()) {
+    AddResult(instrument, ActionResults::NOT_OPEN, results);
+    return;
+  }
+  const TickerId id = found->second;
+  if (bars) {
+    client_->cancelRealTimeBars(id);
+    bar_specs_.erase(id);
+  } else {
+    client_->cancelHistoricalData(id);
+  }
+  requests->erase(found);
+  AddResult(instrument, ActionResults::QUEUED, results)->set_ticker_id(id);
+}
+
+// Drops the request of the id, if any.
+static bool EraseId(map<TickerId, TickerId>* requests, TickerId id)
+{
+  for (map<TickerId, TickerId>::iterator itr = requests->begin();
+       itr != requests->end(); ++itr) {
+    if (itr->second == id) {
+      requests->erase(itr);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ControlPlane::Track(TickerId id, const string& symbol)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  Stream& stream = streams_[id];
+  stream.symbol = symbol;
+  stream.owned = false;
+  stream.lost = false;
+}
+
+bool ControlPlane::Dropped(TickerId id) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return dropped_.count(id) > 0;
+}
+
+void ControlPlane::OnError(TickerId id, int code)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if (code == NOT_CONNECTED) {
+    // Sent by the scheduler to the socket that went: the stream is
+    // opened again by OnConnect, a snapshot is not.
+    Streams::iterator stream = streams_.find(id);
+    if (stream != streams_.end()) stream->second.lost = true;
+    map<TickerId, Bars>::iterator bars = bar_specs_.find(id);
+    if (bars != bar_specs_.end()) bars->second.lost = true;
+    snapshots_.erase(id);
+    EraseId(&history_, id);
+    return;
+  }
+  // Warnings leave the request open, and so does a duplicate id: the
+  // request it names is still open.
+  if (!internal::EndsRequest(code)) return;
+  if (snapshots_.erase(id)) return;
+  if (streams_.erase(id)) {
+    VLOG(VLOG_LEVEL) << "Stream " << id << " ended by an error.";
+    return;
+  }
+  if (EraseId(&bars_, id)) {
+    bar_specs_.erase(id);
+    return;
+  }
+  EraseId(&history_, id);
+}
+
+void ControlPlane::OnSnapshotEnd(TickerId id)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  snapshots_.erase(id);
+}
+
+void ControlPlane::OnHistoryEnd(TickerId id)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  EraseId(&history_, id);
+}
+
+void ControlPlane::OnConnect()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  int reopened = 0;
+  for (Streams::iterator itr = streams_.begin(); itr != streams_.end();
+       ++itr) {
+    if (!itr->second.lost) continue;
+    client_->reqMktData(itr->first, itr->second.contract,
+                        internal::GENERIC_TICK_TAGS, false);
+    itr->second.lost = false;
+    reopened++;
+  }
+  for (map<TickerId, Bars>::iterator itr = bar_specs_.begin();
+       itr != bar_specs_.end(); ++itr) {
+    if (!itr->second.lost) continue;
+    client_->reqRealTimeBars(itr->first, itr->second.contract, 5, "TRADES",
+                             itr->second.rth);
+    itr->second.lost = false;
+    reopened++;
+  }
+  LOG_IF(INFO, reopened > 0) << "Control plane reopened " << reopened
+                             << " streams.";
+}
+
+void ControlPlane::OnDisconnect()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  // What was sent is gone with the connection and the scheduler has
+  // dropped what was still queued: OnConnect requests it all again.
+  for (Streams::iterator itr = streams_.begin(); itr != streams_.end();) {
+    if (itr->second.owned) {
+      (itr++)->second.lost = true;
+    } else {
+      streams_.erase(itr++);
+    }
+  }
+  for (map<TickerId, Bars>::iterator itr = bar_specs_.begin();
+       itr != bar_specs_.end(); ++itr) {
+    itr->second.lost = true;
+  }
+  snapshots_.clear();
+  history_.clear();
+}
+
+size_t ControlPlane::lines() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return streams_.size() + snapshots_.size();
+}
+
+} // namespace ib
@@ -0,0 +1,184 @@
+#ifndef IB_CONTROL_PLANE_H_
+#define IB_CONTROL_PLANE_H_
+
+// Remote control of the subscriptions of a running session, so a
+// universe can be reshaped without a restart.
+//
+// A ZMQ REP socket takes the requests of ib_actions.proto as two
+// frames, the type name (e.g. "ib.actions.RequestMarketData") and the
+// serialized message, and replies with an ActionResults: one result
+// per instrument.  Each request is applied as one batch: all its
+// instruments are checked, then queued together on the session's
+// OutboundScheduler, which paces them within the TWS message limit
+// and behind orders.  The streams already open are not touched, and
+// a cancel that finds its request still queued drops both.
+//
+// Market data streams are keyed by the ticker id the logger uses
+// (SymbolToTickerId), so their ticks reach the BackPlane as the
+// others do.  Bars and history take ids from first_id on.  At most
+// max_lines streams are open at a time, counting the ones the logger
+// opened and told about with Track, and the snapshots requested here
+// until they end.
+//
+// The API streams real-time bars of 5 seconds only; RequestBars
+// opens those, and bar_size is left to the consumer.
+//
+// Streams opened here are requested again when the connection comes
+// back; the ones tracked are forgotten on a disconnect, as their
+// owner requests them again, but for the ones canceled here (see
+// Dropped).  Stocks are kept in the WarmState, when there is one, so
+// a restart resumes the reshaped universe.
+
+#include <map>
+#include <set>
+#include <string>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <Shared/CommonDefs.h>
+#include <Shared/Contract.h>
+#include <Shared/EClient.h>
+
+#include "common.hpp"
+#include "ib/ib_actions.pb.h"
+
+namespace zmq {
+class context_t;
+class socket_t;
+}
+
+namespace ib {
+
+class WarmState;
+
+class ControlPlane : NoCopyAndAssign
+{
+ public:
+  // Requests go to the client, the session's scheduler, and stocks
+  // are kept in the state if not NULL; neither is owned.
+  ControlPlane(EClient* client, WarmState* state, size_t max_lines,
+               TickerId first_id);
+  ~ControlPlane();
+
+  // Binds a REP socket to the endpoint, e.g. "tcp://*:5556", and
+  // serves it from a thread.  Returns false if it cannot bind.
+  bool Start(const std::string& endpoint);
+  void Stop();
+
+  // Applies the request named by type, serialized in body.  Returns
+  // false, with the error set, if the type is unknown or the body
+  // malformed.
+  bool Handle(const std::string& type, const std::string& body,
+              actions::ActionResults* results);
+
+  void Apply(const actions::RequestMarketData& request,
+             actions::ActionResults* results);
+  void Apply(const actions::CancelMarketData& request,
+             actions::ActionResults* results);
+  void Apply(const actions::RequestBars& request,
+             actions::ActionResults* results);
+  void Apply(const actions::CancelBars& request,
+             actions::ActionResults* results);
+  void Apply(const actions::RequestHistory& request,
+             actions::ActionResults* results);
+  void Apply(const actions::CancelHistory& request,
+             actions::ActionResults* results);
+
+  // A stream opened by someone else, so it takes a line and can be
+  // canceled from here.
+  void Track(TickerId id, const std::string& symbol);
+
+  // True if a tracked stream was canceled from here, so its owner
+  // does not open it again when the connection comes back.
+  bool Dropped(TickerId id) const;
+
+  // Session events: an error, a snapshot or history complete, the
+  // connection confirmed and lost.  Only the errors of EndsRequest in
+  // marketdata.hpp end a request; one not sent for want of a
+  // connection is sent again on the next.
+  void OnError(TickerId id, int code);
+  void OnSnapshotEnd(TickerId id);
+  void OnHistoryEnd(TickerId id);
+  void OnConnect();
+  void OnDisconnect();
+
+  // Market data streams open, and snapshots pending.
+  size_t lines() const;
+
+ private:
+  struct Instrument
+  {
+    Instrument() : id(0), ticker_id(-1) {}
+
+    int id;               // Of the request.
+    std::string symbol;
+    TickerId ticker_id;   // Of its market data.
+    Contract contract;
+    std::string invalid;  // Why it cannot be requested, if so.
+  };
+
+  struct Stream
+  {
+    std::string symbol;
+    Contract contract;
+    bool owned;           // Opened here, not tracked.
+    bool lost;            // Sent before the connection went.
+  };
+
+  struct Bars
+  {
+    Contract contract;
+    bool rth;
+    bool lost;
+  };
+
+  typedef std::map<TickerId, Stream> Streams;
+  typedef std::map<TickerId, TickerId> Requests;  // Market data id to id.
+
+  static void FromStock(const common::Stock& stock, Instrument* out);
+  static void FromOption(const common::Option& option, Instrument* out);
+  static void FromIndex(const common::Index& index, Instrument* out);
+
+  actions::ActionResults_Result* AddResult(
+      const Instrument& instrument,
+      actions::ActionResults::Status status,
+      actions::ActionResults* results);
+
+  void OpenMarketData(const Instrument& instrument, bool snapshot,
+                      actions::ActionResults* results);
+  void CloseMarketData(const Instrument& instrument,
+                       actions::ActionResults* results);
+  void OpenBars(const Instrument& instrument, bool rth,
+                actions::ActionResults* results);
+  void OpenHistory(const Instrument& instrument,
+                   const common::Interval& bar_size,
+                   const common::Duration& duration, bool rth,
+                   actions::ActionResults* results);
+  void Cancel(Requests* requests, bool bars, const Instrument& instrument,
+              actions::ActionResults* results);
+
+  void Serve();
+
+  EClient* client_;
+  WarmState* state_;
+  const size_t max_lines_;
+  TickerId next_id_;
+
+  mutable boost::mutex mutex_;  // Everything below.
+  Streams streams_;
+  std::set<TickerId> snapshots_;  // Pending, each holding a line.
+  Requests bars_;
+  std::map<TickerId, Bars> bar_specs_;  // By id, to reopen.
+  Requests history_;
+  std::set<TickerId> dropped_;
+
+  boost::scoped_ptr<zmq::context_t> context_;
+  boost::scoped_ptr<zmq::socket_t> socket_;
+  boost::scoped_ptr<boost::thread> thread_;
+  volatile bool stop_;
+};
+
+} // namespace ib
+
+#endif // IB_CONTROL_PLANE_H_
@@ -0,0 +1,102 @@
+#ifndef IB_EVENT_BUS_H_
+#define IB_EVENT_BUS_H_
+
+// Typed dispatch of events to receivers, without signal libraries.
+//
+//   Delegate<T>      an object pointer and a plain function pointer to
+//                    a stub that calls one of its methods.  Two words,
+//                    no allocation, no bookkeeping in the receiver.
+//   EventChannel<T>  delegates stored contiguously, connected at setup
+//                    time.  Emit is a loop of indirect calls.
+//
+// Nothing here disconnects automatically: a receiver must outlive
+// every emission of the channels it is connected to, and the code
+// registering it has to see to that; a receiver on the stack of a
+// scope the events outlive is a dangling pointer.  Connecting is not
+// synchronized with emitting; connect everything before the events
+// start.
+
+#include <stddef.h>
+#include <vector>
+
+namespace ib {
+
+template <typename T>
+class Delegate
+{
+ public:
+  typedef void (*Stub)(void* object, const T& event);
+
+  Delegate() : object_(NULL), stub_(NULL) {}
+
+  // Calls object->operator()(event).
+  template <typename R>
+  static Delegate FromReceiver(R* object)
+  {
+    return Delegate(object, &CallReceiver<R>);
+  }
+
+  // Calls (object->*Method)(event).
+  template <typename R, void (R::*Method)(const T&)>
+  static Delegate FromMethod(R* object)
+  {
+    return Delegate(object, &CallMethod<R, Method>);
+  }
+
+  inline void operator()(const T& event) const
+  {
+    stub_(object_, event);
+  }
+
+  void* object() const { return object_; }
+
+ private:
+  Delegate(void* object, Stub stub) : object_(object), stub_(stub) {}
+
+  template <typename R>
+  static void CallReceiver(void* object, const T& event)
+  {
+    (*static_cast<R*>(object))(event);
+  }
+
+  template <typename R, void (R::*Method)(const T&)>
+  static void CallMethod(void* object, const T& event)
+  {
+    (static_cast<R*>(object)->*Method)(event);
+  }
+
+  void* object_;
+  Stub stub_;
+};
+
+template <typename T>
+class EventChannel
+{
+ public:
+  void Connect(const Delegate<T>& delegate)
+  {
+    delegates_.push_back(delegate);
+  }
+
+  template <typename R>
+  void Connect(R* receiver)
+  {
+    delegates_.push_back(Delegate<T>::FromReceiver(receiver));
+  }
+
+  size_t size() const { return delegates_.size(); }
+
+  inline void Emit(const T& event) const
+  {
+    const Delegate<T>* d = delegates_.empty() ? NULL : &delegates_[0];
+    const Delegate<T>* end = d + delegates_.size();
+    for (; d != end; ++d) (*d)(event);
+  }
+
+ private:
+  std::vector<Delegate<T> > delegates_;
+};
+
+} // namespace ib
+
+#endif // IB_EVENT_BUS_H_
@@ -0,0 +1,525 @@
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include <quickfix/FieldConvertors.h>
+
+#include <Shared/Contract.h>
+#include <Shared/Order.h>
+
+#include <glog/logging.h>
+
+#include "ib/fix/fix_gateway.hpp"
+
+using namespace std;
+
+namespace ib {
+namespace fix {
+
+namespace {
+
+// Sets the field unless it has the value already, so that QuickFIX
+// keeps its encoding.
+void Rewrite(FIX::FieldMap* map, int tag, const string& value)
+{
+  if (map->isSetField(tag) && map->getField(tag) == value) return;
+  map->setField(tag, value);
+}
+
+void Rewrite(FIX::FieldMap* map, int tag, char value)
+{
+  Rewrite(map, tag, string(1, value));
+}
+
+// Sets the field, or removes it if value is empty.
+void RewriteOptional(FIX::FieldMap* map, int tag, const string& value)
+{
+  if (value.empty()) {
+    map->removeField(tag);
+  } else {
+    Rewrite(map, tag, value);
+  }
+}
+
+string Optional(const FIX::FieldMap& map, int tag, const string& otherwise)
+{
+  return map.isSetField(tag) ? map.getField(tag) : otherwise;
+}
+
+// The symbols of a MarketDataRequest: from its NoRelatedSym groups if
+// QuickFIX read them with a data dictionary, otherwise from the Symbol
+// fields left in its body.
+void GetSymbols(const FIX44::MarketDataRequest& request,
+                vector<string>* symbols)
+{
+  FIX44::MarketDataRequest::NoRelatedSym group;
+  if (request.hasGroup(group)) {
+    for (int i = 1; request.hasGroup(i, group); ++i) {
+      request.getGroup(i, group);
+      symbols->push_back(group.getField(FIX::FIELD::Symbol));
+    }
+    return;
+  }
+  for (FIX::FieldMap::iterator field = request.begin();
+       field != request.end(); ++field) {
+    if (field->first == FIX::FIELD::Symbol) {
+      symbols->push_back(field->second.getString());
+    }
+  }
+}
+
+// The IB order of a NewOrderSingle.  Returns the reason it cannot be
+// placed, or an empty string.
+string ToOrder(const FIX44::NewOrderSingle& single, Contract* contract,
+               Order* order)
+{
+  contract->symbol = single.getField(FIX::FIELD::Symbol);
+  contract->secType = "STK";
+  contract->exchange = Optional(single, FIX::FIELD::ExDestination, "SMART");
+  contract->currency = Optional(single, FIX::FIELD::Currency, "USD");
+
+  FIX::Side side;
+  single.get(side);
+  switch (side) {
+    case FIX::Side_BUY: order->action = "BUY"; break;
+    case FIX::Side_SELL: order->action = "SELL"; break;
+    case FIX::Side_SELL_SHORT: order->action = "SSHORT"; break;
+    default: return "Unsupported side";
+  }
+
+  FIX::OrderQty quantity;
+  single.get(quantity);
+  order->totalQuantity = static_cast<long>(quantity);
+  if (order->totalQuantity <= 0) return "Bad quantity";
+
+  FIX::OrdType type;
+  single.get(type);
+  switch (type) {
+    case FIX::OrdType_MARKET: order->orderType = "MKT"; break;
+    case FIX::OrdType_LIMIT: order->orderType = "LMT"; break;
+    case FIX::OrdType_STOP: order->orderType = "STP"; break;
+    case FIX::OrdType_STOP_LIMIT: order->orderType = "STP LMT"; break;
+    default: return "Unsupported order type";
+  }
+  if (type == FIX::OrdType_LIMIT || type == FIX::OrdType_STOP_LIMIT) {
+    if (!single.isSetField(FIX::FIELD::Price)) return "No price";
+    FIX::Price price;
+    single.get(price);
+    order->lmtPrice = price;
+  }
+  if (type == FIX::OrdType_STOP || type == FIX::OrdType_STOP_LIMIT) {
+    if (!single.isSetField(FIX::FIELD::StopPx)) return "No stop price";
+    FIX::StopPx stop;
+    single.get(stop);
+    order->auxPrice = stop;
+  }
+
+  const string tif = Optional(single, FIX::FIELD::TimeInForce, "0");
+  if (tif == "0") {
+    order->tif = "DAY";
+  } else if (tif == "1") {
+    order->tif = "GTC";
+  } else if (tif == "3") {
+    order->tif = "IOC";
+  } else {
+    return "Unsupported time in force";
+  }
+  order->account = Optional(single, FIX::FIELD::Account, "");
+  return "";
+}
+
+} // namespace
+
+Gateway::Client::Client()
+    : session(NULL)
+    , stop(false)
+    , entry(NULL)
+{
+  FIX44::MarketDataIncrementalRefresh::NoMDEntries group;
+  group.set(FIX::MDUpdateAction(FIX::MDUpdateAction_CHANGE));
+  refresh.addGroup(group);
+  entry = &refresh.getGroupRef(1, FIX::FIELD::NoMDEntries);
+
+  report.set(FIX::CumQty(0));
+  report.set(FIX::AvgPx(0));
+
+  cancel_reject.set(FIX::OrderID("NONE"));
+  cancel_reject.set(FIX::OrdStatus(FIX::OrdStatus_REJECTED));
+  cancel_reject.set(FIX::CxlRejResponseTo(
+      FIX::CxlRejResponseTo_ORDER_CANCEL_REQUEST));
+  cancel_reject.set(FIX::CxlRejReason(FIX::CxlRejReason_UNKNOWN_ORDER));
+}
+
+Gateway::Gateway(EClient* client, OrderId first_order_id,
+                 services::MarketDataInterface* marketdata)
+    : client_(client)
+    , marketdata_(marketdata)
+    , next_order_id_(first_order_id)
+    , next_exec_id_(1)
+{
+  CHECK(client_);
+  Stats zero = { 0, 0, 0, 0, 0 };
+  stats_ = zero;
+}
+
+Gateway::~Gateway()
+{
+  for (map<FIX::SessionID, Client*>::iterator i = clients_.begin();
+       i != clients_.end(); ++i) {
+    Client* client = i->second;
+    {
+      boost::mutex::scoped_lock lock(client->mutex);
+      client->stop = true;
+      client->queued.notify_all();
+    }
+    client->sender->join();
+    delete client;
+  }
+}
+
+Gateway::Stats Gateway::GetStats() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  Stats stats = stats_;
+  for (map<FIX::SessionID, Client*>::const_iterator i = clients_.begin();
+       i != clients_.end(); ++i) {
+    stats.subscriptions += i->second->subscriptions.size();
+  }
+  return stats;
+}
+
+Gateway::Client* Gateway::Find(const FIX::SessionID& id)
+{
+  map<FIX::SessionID, Client*>::iterator i = clients_.find(id);
+  return i == clients_.end() ? NULL : i->second;
+}
+
+void Gateway::onCreate(const FIX::SessionID& id)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if (Find(id)) return;
+  Client* client = new Client();
+  client->id = id;
+  client->sender.reset(
+      new boost::thread(boost::bind(&Gateway::Send, this, client)));
+  clients_[id] = client;
+}
+
+void Gateway::onLogon(const FIX::SessionID& id)
+{
+  LOG(INFO) << "FIX session " << id << " logged on.";
+  boost::mutex::scoped_lock lock(mutex_);
+  Client* client = Find(id);
+  if (!client) return;
+  {
+    boost::mutex::scoped_lock client_lock(client->mutex);
+    client->session = FIX::Session::lookupSession(id);
+  }
+  while (!client->subscriptions.empty()) {
+    Unsubscribe(client, client->subscriptions.begin()->first);
+  }
+}
+
+void Gateway::onLogout(const FIX::SessionID& id)
+{
+  LOG(INFO) << "FIX session " << id << " logged out.";
+  // QuickFIX holds its session lock here.  No lock of the gateway is
+  // held while sending, so taking them cannot deadlock.
+  boost::mutex::scoped_lock lock(mutex_);
+  Client* client = Find(id);
+  if (!client) return;
+  boost::mutex::scoped_lock client_lock(client->mutex);
+  client->session = NULL;
+  client->outbox.clear();
+}
+
+void Gateway::fromApp(const FIX::Message& message, const FIX::SessionID& id)
+    throw(FIX::FieldNotFound, FIX::IncorrectDataFormat,
+          FIX::IncorrectTagValue, FIX::UnsupportedMessageType)
+{
+  crack(message, id);
+}
+
+void Gateway::onMessage(const FIX44::MarketDataRequest& request,
+                        const FIX::SessionID& id)
+{
+  const string request_id = request.getField(FIX::FIELD::MDReqID);
+  FIX::SubscriptionRequestType type;
+  request.get(type);
+  const bool subscribe =
+      type == FIX::SubscriptionRequestType_SNAPSHOT_PLUS_UPDATES;
+  if (!subscribe && type != FIX::SubscriptionRequestType_UNSUBSCRIBE) {
+    throw FIX::IncorrectTagValue(type.getField());
+  }
+  vector<string> symbols;
+  GetSymbols(request, &symbols);
+
+  boost::mutex::scoped_lock lock(mutex_);
+  Client* client = Find(id);
+  if (!client) return;
+  for (size_t i = 0; i < symbols.size(); ++i) {
+    if (subscribe) {
+      Subscribe(client, symbols[i], request_id);
+    } else {
+      Unsubscribe(client, signal::GetTickerId(symbols[i]));
+    }
+  }
+}
+
+void Gateway::Subscribe(Client* client, const string& symbol,
+                        const string& request)
+{
+  const int id = signal::GetTickerId(symbol);
+  if (marketdata_ && requested_.insert(id).second) {
+    marketdata_->RequestTicks(symbol, false);
+  }
+  Subscribers& subscribers = subscribers_[id];
+  subscribers.symbol = symbol;
+  if (!client->subscriptions.count(id)) {
+    subscribers.clients.push_back(client);
+  }
+  client->subscriptions[id] = request;
+}
+
+void Gateway::Unsubscribe(Client* client, int id)
+{
+  if (!client->subscriptions.erase(id)) return;
+  vector<Client*>& clients = subscribers_[id].clients;
+  clients.erase(remove(clients.begin(), clients.end(), client),
+                clients.end());
+}
+
+void Gateway::onMessage(const FIX44::NewOrderSingle& single,
+                        const FIX::SessionID& id)
+{
+  const string cl_ord_id = single.getField(FIX::FIELD::ClOrdID);
+  PlacedOrder placed;
+  placed.id = 0;
+  placed.symbol = single.getField(FIX::FIELD::Symbol);
+  placed.side = single.getField(FIX::FIELD::Side);
+  placed.quantity = single.getField(FIX::FIELD::OrderQty);
+  Contract contract;
+  Order order;
+  string reason = ToOrder(single, &contract, &order);
+
+  boost::mutex::scoped_lock lock(mutex_);
+  Client* client = Find(id);
+  if (!client) return;
+  if (reason.empty() && client->orders.count(cl_ord_id)) {
+    reason = "Duplicate ClOrdID";
+  }
+  if (!reason.empty()) {
+    stats_.rejects++;
+    QueueReport(client, cl_ord_id, "", placed, FIX::ExecType_REJECTED, reason);
+    return;
+  }
+  placed.id = next_order_id_++;
+  order.orderId = placed.id;
+  client->orders[cl_ord_id] = placed;
+  client_->placeOrder(placed.id, contract, order);
+  stats_.orders++;
+  QueueReport(client, cl_ord_id, "", placed, FIX::ExecType_PENDING_NEW, "");
+}
+
+void Gateway::onMessage(const FIX44::OrderCancelRequest& cancel,
+                        const FIX::SessionID& id)
+{
+  const string cl_ord_id = cancel.getField(FIX::FIELD::ClOrdID);
+  const string orig_cl_ord_id = cancel.getField(FIX::FIELD::OrigClOrdID);
+
+  boost::mutex::scoped_lock lock(mutex_);
+  Client* client = Find(id);
+  if (!client) return;
+  map<string, PlacedOrder>::const_iterator order =
+      client->orders.find(orig_cl_ord_id);
+  if (order == client->orders.end()) {
+    stats_.rejects++;
+    QueueCancelReject(client, cl_ord_id, orig_cl_ord_id, "Unknown order");
+    return;
+  }
+  client_->cancelOrder(order->second.id);
+  stats_.cancels++;
+  QueueReport(client, cl_ord_id, orig_cl_ord_id, order->second,
+              FIX::ExecType_PENDING_CANCEL, "");
+}
+
+bool Gateway::Queue(Client* client, const Outbound& message)
+{
+  boost::mutex::scoped_lock lock(client->mutex);
+  if (!client->session) return false;
+  client->outbox.push_back(message);
+  client->queued.notify_one();
+  return true;
+}
+
+void Gateway::QueueReport(Client* client, const string& cl_ord_id,
+                          const string& orig_cl_ord_id,
+                          const PlacedOrder& order, char exec_type,
+                          const string& text)
+{
+  Outbound report;
+  report.type = Outbound::REPORT;
+  report.code = exec_type;
+  report.exec_id = next_exec_id_++;
+  report.cl_ord_id = cl_ord_id;
+  report.orig_cl_ord_id = orig_cl_ord_id;
+  report.order = order;
+  report.text = text;
+  Queue(client, report);
+}
+
+void Gateway::QueueCancelReject(Client* client, const string& cl_ord_id,
+                                const string& orig_cl_ord_id,
+                                const string& text)
+{
+  Outbound reject;
+  reject.type = Outbound::CANCEL_REJECT;
+  reject.cl_ord_id = cl_ord_id;
+  reject.orig_cl_ord_id = orig_cl_ord_id;
+  reject.text = text;
+  Queue(client, reject);
+}
+
+void Gateway::QueueRefresh(Client* client, char type, double price, int size,
+                           Outbound* refresh)
+{
+  refresh->code = type;
+  refresh->price = price;
+  refresh->size = size;
+  if (Queue(client, *refresh)) stats_.refreshes++;
+}
+
+void Gateway::Publish(int id, bool bid, bool ask, bool last)
+{
+  const int slot = quotes_.Find(id);
+  if (slot < 0) return;
+  Quote quote;
+  quotes_.Read(slot, &quote);
+
+  boost::mutex::scoped_lock lock(mutex_);
+  map<int, Subscribers>::const_iterator subscribers = subscribers_.find(id);
+  if (subscribers == subscribers_.end()) return;
+  Outbound refresh;
+  refresh.type = Outbound::REFRESH;
+  refresh.symbol = subscribers->second.symbol;
+  const vector<Client*>& clients = subscribers->second.clients;
+  for (size_t i = 0; i < clients.size(); ++i) {
+    Client* client = clients[i];
+    refresh.request = client->subscriptions[id];
+    if (bid && quote.bid > 0) {
+      QueueRefresh(client, FIX::MDEntryType_BID, quote.bid, quote.bid_size,
+                   &refresh);
+    }
+    if (ask && quote.ask > 0) {
+      QueueRefresh(client, FIX::MDEntryType_OFFER, quote.ask, quote.ask_size,
+                   &refresh);
+    }
+    if (last && quote.last > 0) {
+      QueueRefresh(client, FIX::MDEntryType_TRADE, quote.last,
+                   quote.last_size, &refresh);
+    }
+  }
+}
+
+void Gateway::Send(Client* client)
+{
+  deque<Outbound> batch;
+  while (true) {
+    FIX::Session* session;
+    {
+      boost::mutex::scoped_lock lock(client->mutex);
+      while (client->outbox.empty() && !client->stop) {
+        client->queued.wait(lock);
+      }
+      if (client->stop) return;
+      batch.swap(client->outbox);
+      session = client->session;
+    }
+    // Queued only while logged on, and a logout drops the outbox.
+    CHECK(session);
+    for (; !batch.empty(); batch.pop_front()) {
+      const Outbound& message = batch.front();
+      switch (message.type) {
+        case Outbound::REFRESH:
+          session->send(SetRefresh(client, message));
+          break;
+        case Outbound::REPORT:
+          session->send(SetReport(client, message));
+          break;
+        case Outbound::CANCEL_REJECT:
+          session->send(SetCancelReject(client, message));
+          break;
+      }
+    }
+  }
+}
+
+FIX::Message& Gateway::SetReport(Client* client, const Outbound& message)
+{
+  FIX44::ExecutionReport& report = client->report;
+  const PlacedOrder& order = message.order;
+  Rewrite(&report, FIX::FIELD::OrderID,
+          order.id ? FIX::IntConvertor::convert(order.id) : string("NONE"));
+  Rewrite(&report, FIX::FIELD::ExecID,
+          FIX::IntConvertor::convert(message.exec_id));
+  // The order states acknowledged here have the same codes as their
+  // executions.
+  Rewrite(&report, FIX::FIELD::ExecType, message.code);
+  Rewrite(&report, FIX::FIELD::OrdStatus, message.code);
+  Rewrite(&report, FIX::FIELD::ClOrdID, message.cl_ord_id);
+  RewriteOptional(&report, FIX::FIELD::OrigClOrdID, message.orig_cl_ord_id);
+  Rewrite(&report, FIX::FIELD::Symbol, order.symbol);
+  Rewrite(&report, FIX::FIELD::Side, order.side);
+  Rewrite(&report, FIX::FIELD::OrderQty, order.quantity);
+  Rewrite(&report, FIX::FIELD::LeavesQty,
+          message.code == FIX::ExecType_REJECTED ? string("0")
+                                                 : order.quantity);
+  RewriteOptional(&report, FIX::FIELD::Text, message.text);
+  return report;
+}
+
+FIX::Message& Gateway::SetCancelReject(Client* client,
+                                       const Outbound& message)
+{
+  FIX44::OrderCancelReject& reject = client->cancel_reject;
+  Rewrite(&reject, FIX::FIELD::ClOrdID, message.cl_ord_id);
+  Rewrite(&reject, FIX::FIELD::OrigClOrdID, message.orig_cl_ord_id);
+  RewriteOptional(&reject, FIX::FIELD::Text, message.text);
+  return reject;
+}
+
+FIX::Message& Gateway::SetRefresh(Client* client, const Outbound& message)
+{
+  Rewrite(&client->refresh, FIX::FIELD::MDReqID, message.request);
+  FIX::FieldMap* entry = client->entry;
+  Rewrite(entry, FIX::FIELD::MDEntryType, message.code);
+  Rewrite(entry, FIX::FIELD::Symbol, message.symbol);
+  Rewrite(entry, FIX::FIELD::MDEntryPx,
+          FIX::DoubleConvertor::convert(message.price));
+  Rewrite(entry, FIX::FIELD::MDEntrySize,
+          FIX::IntConvertor::convert(message.size));
+  return client->refresh;
+}
+
+void Gateway::OnField(int64_t ts, int id, Field field, double value)
+{
+  quotes_.Update(ts, id, field, value);
+}
+
+void Gateway::operator()(const BidAsk& bid_ask)
+{
+  ForEachField(bid_ask, this);
+  Publish(bid_ask.id(), bid_ask.has_bid(), bid_ask.has_ask(), false);
+}
+
+void Gateway::operator()(const Last& last)
+{
+  ForEachField(last, this);
+  Publish(last.id(), false, false, true);
+}
+
+} // namespace fix
+} // namespace ib
@@ -0,0 +1,221 @@
+#ifndef IB_FIX_GATEWAY_H_
+#define IB_FIX_GATEWAY_H_
+
+// A FIX 4.4 acceptor application in front of the session, on QuickFIX.
+//
+// Market data: a MarketDataRequest (V) subscribing (263=1) to symbols
+// requests their ticks if it has a MarketDataInterface, and from then
+// on the quotes on the BackPlane go out to the FIX session as
+// MarketDataIncrementalRefresh (X), an entry for the bid, offer (both
+// with their sizes) or trade that changed.  263=2 unsubscribes.
+//
+// Orders: a NewOrderSingle (D) is placed on the EClient as a stock
+// order on SMART (or the ExDestination) with the next order id, and an
+// OrderCancelRequest (F) cancels the order of its OrigClOrdID.  Both
+// are acknowledged with an ExecutionReport, pending new or pending
+// cancel, or rejected.  Order status and fills are not reported back.
+//
+// Outbound messages are not built from scratch: each FIX session has a
+// template per message type, made when it is created.  Per message
+// only the fields whose value changed are set; QuickFIX keeps the
+// encoding, length and checksum of each field until it is set, so
+// the rest of the message is copied out as is.
+//
+// Quotes arrive on the BackPlane's thread and requests on QuickFIX's,
+// and neither sends: the messages are queued to a sender thread per FIX
+// session, which owns the session's templates.  So a slow FIX session
+// holds up neither the BackPlane nor the other sessions; its queue is
+// not bounded.  One lock covers the subscriptions and orders, then one
+// per FIX session its queue, and none is held while QuickFIX sends.  A
+// logout drops the queue; subscriptions are dropped at the next logon.
+
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <quickfix/Application.h>
+#include <quickfix/Session.h>
+#include <quickfix/fix44/ExecutionReport.h>
+#include <quickfix/fix44/MarketDataIncrementalRefresh.h>
+#include <quickfix/fix44/MarketDataRequest.h>
+#include <quickfix/fix44/MessageCracker.h>
+#include <quickfix/fix44/NewOrderSingle.h>
+#include <quickfix/fix44/OrderCancelReject.h>
+#include <quickfix/fix44/OrderCancelRequest.h>
+
+#include <Shared/EClient.h>
+
+#include "common.hpp"
+#include "ib/backplane.hpp"
+#include "ib/quote_table.hpp"
+#include "ib/services.hpp"
+
+namespace ib {
+namespace fix {
+
+class Gateway : public FIX::Application, public FIX44::MessageCracker,
+                public FieldReceiver
+{
+ public:
+  struct Stats
+  {
+    uint64_t refreshes;      // Queued to send.
+    uint64_t orders;         // Placed.
+    uint64_t cancels;        // Made.
+    uint64_t rejects;        // Orders and cancels rejected.
+    uint64_t subscriptions;  // Symbols, over the FIX sessions.
+  };
+
+  // Orders go to client with ids from first_order_id on.  Market data
+  // is requested from marketdata, or if NULL only published.  Both
+  // must outlive the gateway.
+  Gateway(EClient* client, OrderId first_order_id,
+          services::MarketDataInterface* marketdata);
+  ~Gateway();
+
+  Stats GetStats() const;
+
+  // FieldReceiver, publishing once per event.
+  virtual void operator()(const BidAsk& bid_ask);
+  virtual void operator()(const Last& last);
+  virtual void OnField(int64_t ts, int id, Field field, double value);
+
+  // FIX::Application
+  void onCreate(const FIX::SessionID& id);
+  void onLogon(const FIX::SessionID& id);
+  void onLogout(const FIX::SessionID& id);
+  void toAdmin(FIX::Message& message, const FIX::SessionID& id) {}
+  void toApp(FIX::Message& message, const FIX::SessionID& id)
+      throw(FIX::DoNotSend) {}
+  void fromAdmin(const FIX::Message& message, const FIX::SessionID& id)
+      throw(FIX::FieldNotFound, FIX::IncorrectDataFormat,
+            FIX::IncorrectTagValue, FIX::RejectLogon) {}
+  void fromApp(const FIX::Message& message, const FIX::SessionID& id)
+      throw(FIX::FieldNotFound, FIX::IncorrectDataFormat,
+            FIX::IncorrectTagValue, FIX::UnsupportedMessageType);
+
+  // FIX44::MessageCracker
+  void onMessage(const FIX44::MarketDataRequest& request,
+                 const FIX::SessionID& id);
+  void onMessage(const FIX44::NewOrderSingle& order,
+                 const FIX::SessionID& id);
+  void onMessage(const FIX44::OrderCancelRequest& cancel,
+                 const FIX::SessionID& id);
+
+ private:
+  struct PlacedOrder
+  {
+    OrderId id;
+    std::string symbol;
+    std::string side;
+    std::string quantity;
+  };
+
+  // A message queued to a sender, the values to set in its template.
+  struct Outbound
+  {
+    enum Type { REFRESH, REPORT, CANCEL_REJECT };
+
+    Type type;
+    char code;                   // MDEntryType, or ExecType.
+    std::string request;         // MDReqID.
+    std::string symbol;
+    double price;
+    int size;
+    uint64_t exec_id;
+    std::string cl_ord_id;
+    std::string orig_cl_ord_id;
+    PlacedOrder order;
+    std::string text;
+  };
+
+  // A FIX session: its subscriptions and orders, and its sender.
+  struct Client : NoCopyAndAssign
+  {
+    Client();
+
+    FIX::SessionID id;
+    std::map<int, std::string> subscriptions;   // Ticker id to MDReqID.
+    std::map<std::string, PlacedOrder> orders;  // By ClOrdID.
+
+    boost::mutex mutex;          // The session and outbox.
+    boost::condition_variable queued;
+    FIX::Session* session;       // While logged on.
+    std::deque<Outbound> outbox;
+    bool stop;
+    boost::scoped_ptr<boost::thread> sender;
+
+    // The sender's only.
+    FIX44::MarketDataIncrementalRefresh refresh;
+    FIX::FieldMap* entry;        // The one MDEntry in refresh.
+    FIX44::ExecutionReport report;
+    FIX44::OrderCancelReject cancel_reject;
+  };
+
+  Client* Find(const FIX::SessionID& id);
+
+  // Queues the slot's entries of the given fields to the subscribers.
+  void Publish(int id, bool bid, bool ask, bool last);
+
+  // Queues the message to the client's sender.  Returns false, and
+  // drops it, if the client is not logged on.
+  bool Queue(Client* client, const Outbound& message);
+
+  void QueueRefresh(Client* client, char type, double price, int size,
+                    Outbound* refresh);
+
+  // An ExecutionReport of the order with no fills.
+  void QueueReport(Client* client, const std::string& cl_ord_id,
+                   const std::string& orig_cl_ord_id,
+                   const PlacedOrder& order, char exec_type,
+                   const std::string& text);
+
+  void QueueCancelReject(Client* client, const std::string& cl_ord_id,
+                         const std::string& orig_cl_ord_id,
+                         const std::string& text);
+
+  // The sender thread of the client: sets the queued messages in its
+  // templates and sends them.
+  void Send(Client* client);
+
+  // Set the message in the client's template of its type, and return
+  // the template.
+  static FIX::Message& SetRefresh(Client* client, const Outbound& refresh);
+  static FIX::Message& SetReport(Client* client, const Outbound& report);
+  static FIX::Message& SetCancelReject(Client* client,
+                                       const Outbound& reject);
+
+  void Subscribe(Client* client, const std::string& symbol,
+                 const std::string& request);
+  void Unsubscribe(Client* client, int id);
+
+  struct Subscribers
+  {
+    std::string symbol;
+    std::vector<Client*> clients;
+  };
+
+  EClient* const client_;
+  services::MarketDataInterface* const marketdata_;
+
+  QuoteTable quotes_;   // Written on the BackPlane's thread only.
+
+  mutable boost::mutex mutex_;  // Everything below.
+  OrderId next_order_id_;
+  uint64_t next_exec_id_;
+  std::map<FIX::SessionID, Client*> clients_;
+  std::map<int, Subscribers> subscribers_;  // By ticker id.
+  std::set<int> requested_;     // Ticker ids requested from marketdata.
+  Stats stats_;
+};
+
+} // namespace fix
+} // namespace ib
+
+#endif // IB_FIX_GATEWAY_H_
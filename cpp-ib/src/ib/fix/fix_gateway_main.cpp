@@ -0,0 +1,90 @@
+
+// FIX acceptor in front of an IB session: quotes out as market data
+// refreshes, orders and cancels in.  The FIX sessions, ports and stores
+// are configured in a QuickFIX settings file, e.g.
+//
+//   [DEFAULT]
+//   ConnectionType=acceptor
+//   SocketAcceptPort=9878
+//   StartTime=00:00:00
+//   EndTime=00:00:00
+//   FileStorePath=fix_store
+//   DataDictionary=FIX44.xml
+//   [SESSION]
+//   BeginString=FIX.4.4
+//   SenderCompID=IB
+//   TargetCompID=CLIENT
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <quickfix/FileStore.h>
+#include <quickfix/SessionSettings.h>
+#include <quickfix/ThreadedSocketAcceptor.h>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "ib/backplane.hpp"
+#include "ib/session.hpp"
+#include "ib/fix/fix_gateway.hpp"
+
+using namespace std;
+
+DEFINE_string(host, "", "Hostname to connect.");
+DEFINE_int32(port, 4001, "Port");
+DEFINE_int32(client_id, 0, "Client Id.");
+DEFINE_string(fix_config, "fix_gateway.cfg", "QuickFIX settings file.");
+
+volatile bool terminated = false;
+
+void OnTerminate(int param)
+{
+  terminated = true;
+}
+
+int main(int argc, char** argv)
+{
+  google::SetUsageMessage("FIX gateway to the IB API.");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  signal(SIGTERM, OnTerminate);
+  signal(SIGINT, OnTerminate);
+
+  ib::Session session(FLAGS_host, FLAGS_port, FLAGS_client_id);
+  session.Start();
+  EClient* client = session.AccessClient();
+  if (!client) {
+    LOG(ERROR) << "No connection to " << FLAGS_host << ":" << FLAGS_port;
+    session.Stop();
+    return 1;
+  }
+
+  ib::fix::Gateway gateway(client, session.GetNextValidId(),
+                           session.AccessMarketData());
+  ib::BackPlane* backplane = session.GetBackPlane();
+  backplane->Register(static_cast<ib::Receiver<BidAsk>*>(&gateway));
+  backplane->Register(static_cast<ib::Receiver<Last>*>(&gateway));
+
+  try {
+    FIX::SessionSettings settings(FLAGS_fix_config);
+    FIX::FileStoreFactory store(settings);
+    FIX::ThreadedSocketAcceptor acceptor(gateway, store, settings);
+    acceptor.start();
+    LOG(INFO) << "Accepting FIX sessions.";
+    while (!terminated) sleep(1);
+    acceptor.stop();
+  } catch (FIX::ConfigError& e) {
+    LOG(ERROR) << "Bad FIX settings in " << FLAGS_fix_config << ": "
+               << e.what();
+  } catch (FIX::RuntimeError& e) {
+    LOG(ERROR) << "Cannot accept FIX sessions: " << e.what();
+  }
+
+  ib::fix::Gateway::Stats stats = gateway.GetStats();
+  LOG(INFO) << "Sent " << stats.refreshes << " refreshes, placed "
+            << stats.orders << " orders, made " << stats.cancels
+            << " cancels, rejected " << stats.rejects << ".";
+  session.Stop();
+  return 0;
+}
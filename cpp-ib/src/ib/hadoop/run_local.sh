@@ -0,0 +1,55 @@
+#!/bin/bash
+#
+# Runs the bars and stats streaming jobs over exported ticks.
+#
+#   run_local.sh <input glob> <output dir>
+#
+# e.g. run_local.sh 'ticks/date=201101*/symbol=*/part-*' out
+#
+# With HADOOP_HOME set, runs the jobs with Hadoop streaming in local
+# mode (no cluster; the same command with -jt/-fs pointing at the
+# cluster runs it there).  Without it, the same tasks are chained with
+# sort(1) to check the pipeline.
+#
+# BIN_DIR is where tick_streaming was built (default: build).
+
+set -e
+
+INPUT=$1
+OUTPUT=$2
+BIN_DIR=${BIN_DIR:-build}
+TASK=$BIN_DIR/tick_streaming
+
+if [ -z "$INPUT" ] || [ -z "$OUTPUT" ]; then
+  echo "usage: $0 <input glob> <output dir>" >&2
+  exit 1
+fi
+
+mkdir -p $OUTPUT
+
+if [ -n "$HADOOP_HOME" ]; then
+  STREAMING=$(ls $HADOOP_HOME/contrib/streaming/hadoop-*-streaming.jar)
+  run_job() {
+    $HADOOP_HOME/bin/hadoop jar $STREAMING \
+      -jt local -fs file:/// \
+      -D mapred.reduce.tasks=4 \
+      -inputformat org.apache.hadoop.mapred.SequenceFileAsTextInputFormat \
+      -input "$INPUT" \
+      -output $OUTPUT/$1 \
+      -file $TASK \
+      -mapper "tick_streaming --task=$2" \
+      ${4:+-combiner "tick_streaming --task=$4"} \
+      -reducer "tick_streaming --task=$3"
+  }
+else
+  run_job() {
+    mkdir -p $OUTPUT/$1
+    $TASK --task=cat $INPUT \
+      | $TASK --task=$2 \
+      | LC_ALL=C sort -t "	" -k1,1 \
+      | $TASK --task=$3 > $OUTPUT/$1/part-00000
+  }
+fi
+
+run_job bars bars_map bars_reduce
+run_job stats stats_map stats_reduce stats_combine
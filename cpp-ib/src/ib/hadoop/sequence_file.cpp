@@ -0,0 +1,352 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <zlib.h>
+#include <glog/logging.h>
+
+#include "ib/hadoop/sequence_file.hpp"
+
+namespace ib {
+namespace hadoop {
+
+static const char MAGIC[] = { 'S', 'E', 'Q', 6 };
+static const char* TEXT_CLASS = "org.apache.hadoop.io.Text";
+static const char* DEFAULT_CODEC = "org.apache.hadoop.io.compress.DefaultCodec";
+static const int32_t SYNC_ESCAPE = -1;
+
+void WriteVLong(int64_t i, string* out)
+{
+  if (i >= -112 && i <= 127) {
+    out->push_back(static_cast<char>(i));
+    return;
+  }
+  int len = -112;
+  if (i < 0) {
+    i ^= -1LL;  // Take one's complement.
+    len = -120;
+  }
+  for (int64_t tmp = i; tmp != 0; tmp >>= 8) len--;
+  out->push_back(static_cast<char>(len));
+
+  len = (len < -120) ? -(len + 120) : -(len + 112);
+  for (int idx = len; idx != 0; idx--) {
+    int shift = (idx - 1) * 8;
+    out->push_back(static_cast<char>((i >> shift) & 0xFF));
+  }
+}
+
+bool ReadVLong(const string& in, size_t* pos, int64_t* value)
+{
+  if (*pos >= in.length()) return false;
+  int first = static_cast<signed char>(in[(*pos)++]);
+  if (first >= -112) {
+    *value = first;
+    return true;
+  }
+  int len = (first < -120) ? -119 - first : -111 - first;
+  if (*pos + len - 1 > in.length()) return false;
+  int64_t i = 0;
+  for (int idx = 0; idx < len - 1; ++idx) {
+    i = (i << 8) | (static_cast<unsigned char>(in[(*pos)++]));
+  }
+  *value = (first < -120) ? (i ^ -1LL) : i;
+  return true;
+}
+
+static void WriteInt(int32_t v, string* out)
+{
+  out->push_back(static_cast<char>((v >> 24) & 0xFF));
+  out->push_back(static_cast<char>((v >> 16) & 0xFF));
+  out->push_back(static_cast<char>((v >> 8) & 0xFF));
+  out->push_back(static_cast<char>(v & 0xFF));
+}
+
+// Text.writeString: vint length followed by the UTF-8 bytes.
+static void WriteText(const string& s, string* out)
+{
+  WriteVLong(s.length(), out);
+  out->append(s);
+}
+
+static bool Deflate(const string& in, string* out)
+{
+  uLongf len = compressBound(in.length());
+  out->resize(len);
+  int rc = compress2(reinterpret_cast<Bytef*>(&(*out)[0]), &len,
+                     reinterpret_cast<const Bytef*>(in.data()), in.length(),
+                     Z_DEFAULT_COMPRESSION);
+  if (rc != Z_OK) return false;
+  out->resize(len);
+  return true;
+}
+
+static bool Inflate(const string& in, string* out)
+{
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (inflateInit(&stream) != Z_OK) return false;
+
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+  stream.avail_in = in.length();
+  out->clear();
+  char buff[64 * 1024];
+  int rc;
+  do {
+    stream.next_out = reinterpret_cast<Bytef*>(buff);
+    stream.avail_out = sizeof(buff);
+    rc = inflate(&stream, Z_NO_FLUSH);
+    if (rc != Z_OK && rc != Z_STREAM_END) break;
+    out->append(buff, sizeof(buff) - stream.avail_out);
+  } while (rc != Z_STREAM_END);
+  inflateEnd(&stream);
+  return rc == Z_STREAM_END;
+}
+
+//////////////////////////////////////////////////////////////////////
+// SequenceFileWriter
+
+SequenceFileWriter::SequenceFileWriter(const string& path, size_t block_size)
+    : path_(path)
+    , block_size_(block_size)
+    , file_(NULL)
+    , block_records_(0)
+    , records_(0)
+    , blocks_(0)
+{
+  // Hadoop uses an MD5 of a uid and the time; all that matters is
+  // that the marker is unlikely to appear in the data.
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  unsigned int seed = tv.tv_sec ^ tv.tv_usec ^ (getpid() << 16);
+  for (size_t i = 0; i < sizeof(sync_); ++i) {
+    sync_[i] = static_cast<char>(rand_r(&seed) & 0xFF);
+  }
+}
+
+SequenceFileWriter::~SequenceFileWriter()
+{
+  Close();
+}
+
+bool SequenceFileWriter::Open()
+{
+  // Never over an existing file.
+  file_ = fopen(path_.c_str(), "wbx");
+  if (file_ == NULL) {
+    PLOG(ERROR) << "Cannot create " << path_;
+    return false;
+  }
+  string header(MAGIC, sizeof(MAGIC));
+  WriteText(TEXT_CLASS, &header);
+  WriteText(TEXT_CLASS, &header);
+  header.push_back(1);  // Compressed.
+  header.push_back(1);  // Block compressed.
+  WriteText(DEFAULT_CODEC, &header);
+  WriteInt(0, &header);  // No metadata.
+  header.append(sync_, sizeof(sync_));
+  return Write(header);
+}
+
+void SequenceFileWriter::Append(const string& key, const string& value)
+{
+  size_t start = keys_.length();
+  WriteText(key, &keys_);
+  WriteVLong(keys_.length() - start, &key_lengths_);
+
+  start = values_.length();
+  WriteText(value, &values_);
+  WriteVLong(values_.length() - start, &value_lengths_);
+
+  ++block_records_;
+  ++records_;
+  if (keys_.length() + values_.length() >= block_size_) Sync();
+}
+
+bool SequenceFileWriter::Sync()
+{
+  if (file_ == NULL || block_records_ == 0) return true;
+
+  string head;
+  WriteInt(SYNC_ESCAPE, &head);
+  head.append(sync_, sizeof(sync_));
+  WriteVLong(block_records_, &head);
+
+  bool ok = Write(head) &&
+      WriteBuffer(key_lengths_) && WriteBuffer(keys_) &&
+      WriteBuffer(value_lengths_) && WriteBuffer(values_);
+
+  key_lengths_.clear();
+  keys_.clear();
+  value_lengths_.clear();
+  values_.clear();
+  block_records_ = 0;
+  ++blocks_;
+  return ok;
+}
+
+bool SequenceFileWriter::Close()
+{
+  if (file_ == NULL) return true;
+  bool ok = Sync();
+  ok = (fclose(file_) == 0) && ok;
+  file_ = NULL;
+  return ok;
+}
+
+bool SequenceFileWriter::WriteBuffer(const string& buffer)
+{
+  string compressed;
+  if (!Deflate(buffer, &compressed)) {
+    LOG(ERROR) << "Compression failed for " << path_;
+    return false;
+  }
+  string length;
+  WriteVLong(compressed.length(), &length);
+  return Write(length) && Write(compressed);
+}
+
+bool SequenceFileWriter::Write(const string& bytes)
+{
+  if (fwrite(bytes.data(), 1, bytes.length(), file_) != bytes.length()) {
+    PLOG(ERROR) << "Write failed for " << path_;
+    return false;
+  }
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////
+// SequenceFileReader
+
+SequenceFileReader::SequenceFileReader(const string& path)
+    : path_(path)
+    , file_(NULL)
+    , remaining_(0)
+{
+}
+
+SequenceFileReader::~SequenceFileReader()
+{
+  if (file_ != NULL) fclose(file_);
+}
+
+bool SequenceFileReader::Open()
+{
+  file_ = fopen(path_.c_str(), "rb");
+  if (file_ == NULL) {
+    PLOG(ERROR) << "Cannot open " << path_;
+    return false;
+  }
+  string bytes, key_class, value_class;
+  if (!Read(sizeof(MAGIC), &bytes) ||
+      bytes != string(MAGIC, sizeof(MAGIC))) {
+    LOG(ERROR) << path_ << " is not a version 6 SequenceFile.";
+    return false;
+  }
+  if (!ReadText(&key_class) || !ReadText(&value_class) ||
+      key_class != TEXT_CLASS || value_class != TEXT_CLASS) {
+    LOG(ERROR) << path_ << ": only Text keys and values are supported.";
+    return false;
+  }
+  if (!Read(2, &bytes) || bytes[0] != 1 || bytes[1] != 1) {
+    LOG(ERROR) << path_ << " is not block compressed.";
+    return false;
+  }
+  if (!ReadText(&codec_) || codec_ != DEFAULT_CODEC) {
+    LOG(ERROR) << path_ << ": unsupported codec " << codec_;
+    return false;
+  }
+  if (!Read(4, &bytes) || bytes != string(4, '\0')) {
+    LOG(ERROR) << path_ << ": metadata is not supported.";
+    return false;
+  }
+  if (!Read(sizeof(sync_), &bytes)) return false;
+  memcpy(sync_, bytes.data(), sizeof(sync_));
+  return true;
+}
+
+bool SequenceFileReader::Next(string* key, string* value)
+{
+  if (remaining_ == 0 && !ReadBlock()) return false;
+
+  int64_t key_length, value_length, n;
+  if (!ReadVLong(key_lengths_, &key_lengths_pos_, &key_length) ||
+      !ReadVLong(value_lengths_, &value_lengths_pos_, &value_length)) {
+    return false;
+  }
+  size_t start = keys_pos_;
+  if (!ReadVLong(keys_, &keys_pos_, &n) ||
+      keys_pos_ + n != start + key_length) {
+    return false;
+  }
+  key->assign(keys_, keys_pos_, n);
+  keys_pos_ += n;
+
+  start = values_pos_;
+  if (!ReadVLong(values_, &values_pos_, &n) ||
+      values_pos_ + n != start + value_length) {
+    return false;
+  }
+  value->assign(values_, values_pos_, n);
+  values_pos_ += n;
+
+  --remaining_;
+  return true;
+}
+
+bool SequenceFileReader::ReadBlock()
+{
+  string bytes;
+  if (!Read(4, &bytes)) return false;  // End of file.
+  if (bytes != string(4, '\xff') || !Read(sizeof(sync_), &bytes) ||
+      memcmp(bytes.data(), sync_, sizeof(sync_)) != 0) {
+    LOG(ERROR) << path_ << ": missing sync marker.";
+    return false;
+  }
+  if (!ReadVLongFromFile(&remaining_) ||
+      !ReadBuffer(&key_lengths_) || !ReadBuffer(&keys_) ||
+      !ReadBuffer(&value_lengths_) || !ReadBuffer(&values_)) {
+    LOG(ERROR) << path_ << ": corrupt block.";
+    return false;
+  }
+  key_lengths_pos_ = keys_pos_ = value_lengths_pos_ = values_pos_ = 0;
+  return remaining_ > 0;
+}
+
+bool SequenceFileReader::ReadBuffer(string* buffer)
+{
+  int64_t length;
+  string compressed;
+  return ReadVLongFromFile(&length) && Read(length, &compressed) &&
+      Inflate(compressed, buffer);
+}
+
+bool SequenceFileReader::ReadVLongFromFile(int64_t* value)
+{
+  string bytes;
+  if (!Read(1, &bytes)) return false;
+  int first = static_cast<signed char>(bytes[0]);
+  int len = (first >= -112) ? 1 : (first < -120) ? -119 - first : -111 - first;
+  string rest;
+  if (len > 1 && !Read(len - 1, &rest)) return false;
+  size_t pos = 0;
+  return ReadVLong(bytes + rest, &pos, value);
+}
+
+bool SequenceFileReader::ReadText(string* text)
+{
+  int64_t length;
+  return ReadVLongFromFile(&length) && Read(length, text);
+}
+
+bool SequenceFileReader::Read(size_t n, string* bytes)
+{
+  bytes->resize(n);
+  if (n == 0) return true;
+  return fread(&(*bytes)[0], 1, n, file_) == n;
+}
+
+} // namespace hadoop
+} // namespace ib
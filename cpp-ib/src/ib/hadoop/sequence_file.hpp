@@ -0,0 +1,115 @@
+#ifndef IB_HADOOP_SEQUENCE_FILE_H_
+#define IB_HADOOP_SEQUENCE_FILE_H_
+
+// Reader and writer for Hadoop SequenceFiles (version 6) with Text
+// keys and values, block-compressed with the DefaultCodec (zlib).
+//
+// The files are splittable: a sync marker is written before every
+// block so that a map task can start at an arbitrary offset, and
+// they are read by Hadoop with SequenceFileInputFormat or, for
+// streaming jobs, SequenceFileAsTextInputFormat which hands the
+// mapper "key<TAB>value" lines.
+//
+// Only what the exporters need is supported: no metadata, no
+// record compression, no other Writable types.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+
+using namespace std;
+
+namespace ib {
+namespace hadoop {
+
+// Hadoop's variable length integer encoding (WritableUtils.writeVLong).
+void WriteVLong(int64_t value, string* out);
+
+// Decodes a variable length integer at *pos and advances it.  Returns
+// false if the buffer is too short.
+bool ReadVLong(const string& in, size_t* pos, int64_t* value);
+
+class SequenceFileWriter : NoCopyAndAssign
+{
+ public:
+  // Uncompressed bytes buffered per block before it is compressed and
+  // written.  Same as io.seqfile.compress.blocksize.
+  static const size_t DEFAULT_BLOCK_SIZE = 1000000;
+
+  explicit SequenceFileWriter(const string& path,
+                              size_t block_size = DEFAULT_BLOCK_SIZE);
+  ~SequenceFileWriter();
+
+  // Creates the file and writes the header.  Fails if the file
+  // exists.
+  bool Open();
+
+  void Append(const string& key, const string& value);
+
+  // Writes the pending block.
+  bool Sync();
+
+  // Syncs and closes the file.
+  bool Close();
+
+  int64_t records() const { return records_; }
+  int64_t blocks() const { return blocks_; }
+
+ private:
+  bool WriteBuffer(const string& buffer);
+  bool Write(const string& bytes);
+
+  const string path_;
+  const size_t block_size_;
+  FILE* file_;
+  char sync_[16];
+
+  int64_t block_records_;
+  string key_lengths_;
+  string keys_;
+  string value_lengths_;
+  string values_;
+
+  int64_t records_;
+  int64_t blocks_;
+};
+
+class SequenceFileReader : NoCopyAndAssign
+{
+ public:
+  explicit SequenceFileReader(const string& path);
+  ~SequenceFileReader();
+
+  // Opens the file and validates the header.
+  bool Open();
+
+  // Returns false at the end of the file or on a corrupt block.
+  bool Next(string* key, string* value);
+
+ private:
+  bool ReadBlock();
+  bool ReadBuffer(string* buffer);
+  bool ReadVLongFromFile(int64_t* value);
+  bool ReadText(string* text);
+  bool Read(size_t n, string* bytes);
+
+  const string path_;
+  FILE* file_;
+  char sync_[16];
+  string codec_;
+
+  int64_t remaining_;
+  size_t key_lengths_pos_, keys_pos_, value_lengths_pos_, values_pos_;
+  string key_lengths_;
+  string keys_;
+  string value_lengths_;
+  string values_;
+};
+
+} // namespace hadoop
+} // namespace ib
+
+#endif // IB_HADOOP_SEQUENCE_FILE_H_
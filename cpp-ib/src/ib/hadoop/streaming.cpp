@@ -0,0 +1,283 @@
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "ib/hadoop/streaming.hpp"
+
+using ib::internal::TickEvent;
+using ib::internal::MicrosOfDay;
+using ib::internal::TradeDate;
+
+namespace ib {
+namespace hadoop {
+
+string ExportKey(const TickEvent& tick)
+{
+  return tick.symbol;
+}
+
+string ExportValue(const TickEvent& tick)
+{
+  char buff[64];
+  snprintf(buff, sizeof(buff), "%llu,", (unsigned long long)tick.ts);
+  string value(buff);
+  value.append(tick.event);
+  snprintf(buff, sizeof(buff), ",%.10g", tick.value);
+  value.append(buff);
+  return value;
+}
+
+bool ParseExportLine(const string& line, TickEvent* tick)
+{
+  size_t tab = line.find('\t');
+  if (tab == string::npos) return false;
+  size_t c1 = line.find(',', tab + 1);
+  if (c1 == string::npos) return false;
+  size_t c2 = line.find(',', c1 + 1);
+  if (c2 == string::npos) return false;
+
+  tick->symbol.assign(line, 0, tab);
+  tick->ts = strtoull(line.c_str() + tab + 1, NULL, 10);
+  tick->event.assign(line, c1 + 1, c2 - c1 - 1);
+  tick->value = strtod(line.c_str() + c2 + 1, NULL);
+  return true;
+}
+
+// Splits "key<TAB>value".
+static bool SplitLine(const string& line, string* key, string* value)
+{
+  size_t tab = line.find('\t');
+  if (tab == string::npos) return false;
+  key->assign(line, 0, tab);
+  value->assign(line, tab + 1, string::npos);
+  return true;
+}
+
+// Calls reduce once for every run of lines with the same key.
+template <typename Reducer>
+static int ForEachKey(istream& in, Reducer& reduce)
+{
+  string line, key, value, current;
+  int groups = 0;
+  bool first = true;
+  while (getline(in, line)) {
+    if (!SplitLine(line, &key, &value)) continue;
+    if (first || key != current) {
+      if (!first) {
+        reduce.Finish(current);
+        ++groups;
+      }
+      current = key;
+      first = false;
+    }
+    reduce.Add(value);
+  }
+  if (!first) {
+    reduce.Finish(current);
+    ++groups;
+  }
+  return groups;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Bars
+
+int MapBars(istream& in, ostream& out, const BarOptions& options)
+{
+  CHECK(options.seconds > 0 && 86400 % options.seconds == 0)
+      << "Bar width must divide a day: " << options.seconds;
+  const uint64_t width = options.seconds * 1000000ULL;
+  string line;
+  TickEvent tick;
+  int emitted = 0;
+  while (getline(in, line)) {
+    if (!ParseExportLine(line, &tick)) continue;
+    char kind;
+    if (tick.event == options.price_field) {
+      kind = 'P';
+    } else if (tick.event == options.size_field) {
+      kind = 'S';
+    } else {
+      continue;
+    }
+    uint64_t bar = MicrosOfDay(tick.ts) / width * width / 1000000;
+    char buff[128];
+    snprintf(buff, sizeof(buff), "%s.%s.%02d%02d%02d\t%llu,%c,%.10g",
+             tick.symbol.c_str(), TradeDate(tick.ts).c_str(),
+             (int)(bar / 3600), (int)(bar / 60 % 60), (int)(bar % 60),
+             (unsigned long long)tick.ts, kind, tick.value);
+    out << buff << '\n';
+    ++emitted;
+  }
+  return emitted;
+}
+
+namespace {
+
+struct BarTick {
+  uint64_t ts;
+  char kind;
+  double value;
+  bool operator<(const BarTick& rhs) const { return ts < rhs.ts; }
+};
+
+struct BarReducer {
+  explicit BarReducer(ostream& out) : out(out) {}
+
+  void Add(const string& value)
+  {
+    BarTick tick;
+    size_t c1 = value.find(',');
+    if (c1 == string::npos || c1 + 2 >= value.length()) return;
+    tick.ts = strtoull(value.c_str(), NULL, 10);
+    tick.kind = value[c1 + 1];
+    tick.value = strtod(value.c_str() + c1 + 3, NULL);
+    ticks.push_back(tick);
+  }
+
+  void Finish(const string& key)
+  {
+    // Streaming only sorts by key; order the ticks in the bar by time.
+    stable_sort(ticks.begin(), ticks.end());
+    double open = 0, high = 0, low = 0, close = 0, volume = 0;
+    int count = 0;
+    for (vector<BarTick>::const_iterator t = ticks.begin();
+         t != ticks.end(); ++t) {
+      if (t->kind == 'S') {
+        volume += t->value;
+        continue;
+      }
+      if (count++ == 0) {
+        open = high = low = t->value;
+      }
+      high = max(high, t->value);
+      low = min(low, t->value);
+      close = t->value;
+    }
+    ticks.clear();
+    if (count == 0) return;
+
+    char buff[256];
+    snprintf(buff, sizeof(buff), "%s\t%.10g,%.10g,%.10g,%.10g,%.10g,%d",
+             key.c_str(), open, high, low, close, volume, count);
+    out << buff << '\n';
+  }
+
+  ostream& out;
+  vector<BarTick> ticks;
+};
+
+} // namespace
+
+int ReduceBars(istream& in, ostream& out)
+{
+  BarReducer reducer(out);
+  return ForEachKey(in, reducer);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Statistics
+
+namespace {
+
+struct Moments {
+  Moments() : count(0), sum(0), sum_sq(0), min(0), max(0) {}
+
+  void Merge(int64_t n, double s, double sq, double lo, double hi)
+  {
+    if (count == 0 || lo < min) min = lo;
+    if (count == 0 || hi > max) max = hi;
+    count += n;
+    sum += s;
+    sum_sq += sq;
+  }
+
+  bool Parse(const string& value)
+  {
+    long long n;
+    double s, sq, lo, hi;
+    if (sscanf(value.c_str(), "%lld,%lf,%lf,%lf,%lf",
+               &n, &s, &sq, &lo, &hi) != 5) {
+      return false;
+    }
+    Merge(n, s, sq, lo, hi);
+    return true;
+  }
+
+  int64_t count;
+  double sum;
+  double sum_sq;
+  double min;
+  double max;
+};
+
+struct StatsReducer {
+  StatsReducer(ostream& out, bool partial) : out(out), partial(partial) {}
+
+  void Add(const string& value)
+  {
+    LOG_IF(WARNING, !moments.Parse(value)) << "Bad partial: " << value;
+  }
+
+  void Finish(const string& key)
+  {
+    char buff[256];
+    if (partial) {
+      snprintf(buff, sizeof(buff), "%s\t%lld,%.17g,%.17g,%.17g,%.17g",
+               key.c_str(), (long long)moments.count, moments.sum,
+               moments.sum_sq, moments.min, moments.max);
+    } else {
+      double n = static_cast<double>(moments.count);
+      double mean = moments.sum / n;
+      double var = moments.sum_sq / n - mean * mean;
+      snprintf(buff, sizeof(buff), "%s\t%lld,%.10g,%.10g,%.10g,%.10g",
+               key.c_str(), (long long)moments.count, mean,
+               var > 0 ? sqrt(var) : 0., moments.min, moments.max);
+    }
+    out << buff << '\n';
+    moments = Moments();
+  }
+
+  ostream& out;
+  bool partial;
+  Moments moments;
+};
+
+} // namespace
+
+int MapStats(istream& in, ostream& out)
+{
+  string line;
+  TickEvent tick;
+  int emitted = 0;
+  while (getline(in, line)) {
+    if (!ParseExportLine(line, &tick)) continue;
+    char buff[256];
+    snprintf(buff, sizeof(buff), "%s.%s\t1,%.17g,%.17g,%.17g,%.17g",
+             tick.symbol.c_str(), tick.event.c_str(), tick.value,
+             tick.value * tick.value, tick.value, tick.value);
+    out << buff << '\n';
+    ++emitted;
+  }
+  return emitted;
+}
+
+int CombineStats(istream& in, ostream& out)
+{
+  StatsReducer reducer(out, true);
+  return ForEachKey(in, reducer);
+}
+
+int ReduceStats(istream& in, ostream& out)
+{
+  StatsReducer reducer(out, false);
+  return ForEachKey(in, reducer);
+}
+
+} // namespace hadoop
+} // namespace ib
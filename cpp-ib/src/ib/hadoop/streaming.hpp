@@ -0,0 +1,62 @@
+#ifndef IB_HADOOP_STREAMING_H_
+#define IB_HADOOP_STREAMING_H_
+
+// Map and reduce tasks over exported ticks, for Hadoop streaming.
+//
+// The exporter writes one record per tick with the symbol as the key
+// and "ts,field,value" as the value.  With SequenceFileAsTextInputFormat
+// each mapper reads lines of the form
+//
+//   AAPL<TAB>1295015400123456,LAST,345.12
+//
+// Every task reads lines from the input stream and writes
+// "key<TAB>value" lines to the output stream.  Reducers rely on the
+// framework having sorted their input by key.
+
+#include <stdint.h>
+#include <iostream>
+#include <string>
+
+#include "ib/tick_log.hpp"
+
+using namespace std;
+
+namespace ib {
+namespace hadoop {
+
+// Record format of the exported files.
+string ExportKey(const ib::internal::TickEvent& tick);
+string ExportValue(const ib::internal::TickEvent& tick);
+
+// Parses a "key<TAB>value" line as written by the exporter.
+bool ParseExportLine(const string& line, ib::internal::TickEvent* tick);
+
+struct BarOptions {
+  BarOptions() : seconds(60), price_field("LAST"), size_field("LAST_SIZE") {}
+  int seconds;          // Bar width.
+  string price_field;   // Tick field used for open/high/low/close.
+  string size_field;    // Tick field summed for the volume.
+};
+
+// Emits "SYMBOL.YYYYMMDD.HHMMSS<TAB>ts,P|S,value" for each price or
+// size tick, keyed by the start of its bar in New York time.
+int MapBars(istream& in, ostream& out, const BarOptions& options);
+
+// Emits "SYMBOL.YYYYMMDD.HHMMSS<TAB>open,high,low,close,volume,ticks".
+// Bars with no price ticks are skipped.
+int ReduceBars(istream& in, ostream& out);
+
+// Emits "SYMBOL.FIELD<TAB>count,sum,sum_sq,min,max" for each tick.
+int MapStats(istream& in, ostream& out);
+
+// Merges partial statistics per key; usable as the combiner since
+// input and output have the same form as the mapper output.
+int CombineStats(istream& in, ostream& out);
+
+// Emits "SYMBOL.FIELD<TAB>count,mean,stddev,min,max".
+int ReduceStats(istream& in, ostream& out);
+
+} // namespace hadoop
+} // namespace ib
+
+#endif // IB_HADOOP_STREAMING_H_
@@ -0,0 +1,152 @@
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <fstream>
+#include <map>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "ib/hadoop/sequence_file.hpp"
+#include "ib/hadoop/streaming.hpp"
+#include "ib/tick_log.hpp"
+
+using namespace std;
+using ib::hadoop::SequenceFileWriter;
+using ib::internal::TickEvent;
+
+DEFINE_string(file, "logfile",
+              "Comma separated list of logger files, in time order.");
+DEFINE_string(output_dir, "ticks",
+              "Output root.  Files go to <dir>/date=YYYYMMDD/symbol=SYM/.");
+DEFINE_int32(block_size, SequenceFileWriter::DEFAULT_BLOCK_SIZE,
+             "Uncompressed bytes per compressed block.");
+
+static bool MakeDirs(const string& path)
+{
+  for (size_t pos = 1; pos <= path.length(); ++pos) {
+    if (pos != path.length() && path[pos] != '/') continue;
+    string dir = path.substr(0, pos);
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+      PLOG(ERROR) << "Cannot create " << dir;
+      return false;
+    }
+  }
+  return true;
+}
+
+// First part-NNNNN not in the directory, so a rerun adds to the
+// output of the earlier ones.
+static string NextPart(const string& dir)
+{
+  for (int part = 0; ; ++part) {
+    char name[16];
+    snprintf(name, sizeof(name), "/part-%05d", part);
+    struct stat st;
+    if (stat((dir + name).c_str(), &st) != 0) return dir + name;
+  }
+}
+
+// One open file per (date, symbol).  Logs are in time order, so the
+// files of a date are closed once the next date starts.
+class PartitionedWriter
+{
+ public:
+  explicit PartitionedWriter(const string& root) : root_(root), records_(0) {}
+
+  ~PartitionedWriter()
+  {
+    CloseAll();
+  }
+
+  bool Append(const TickEvent& tick)
+  {
+    string date = ib::internal::TradeDate(tick.ts);
+    if (date != date_) {
+      CloseAll();
+      date_ = date;
+    }
+    map<string, SequenceFileWriter*>::iterator found =
+        writers_.find(tick.symbol);
+    SequenceFileWriter* writer;
+    if (found == writers_.end()) {
+      string dir = root_ + "/date=" + date + "/symbol=" + tick.symbol;
+      if (!MakeDirs(dir)) return false;
+      writer = new SequenceFileWriter(NextPart(dir), FLAGS_block_size);
+      if (!writer->Open()) {
+        delete writer;
+        return false;
+      }
+      writers_[tick.symbol] = writer;
+    } else {
+      writer = found->second;
+    }
+    writer->Append(ib::hadoop::ExportKey(tick), ib::hadoop::ExportValue(tick));
+    ++records_;
+    return true;
+  }
+
+  void CloseAll()
+  {
+    for (map<string, SequenceFileWriter*>::iterator itr = writers_.begin();
+         itr != writers_.end(); ++itr) {
+      LOG_IF(ERROR, !itr->second->Close()) << "Failed to close "
+                                           << date_ << "/" << itr->first;
+      VLOG(1) << date_ << "/" << itr->first << ": "
+              << itr->second->records() << " records, "
+              << itr->second->blocks() << " blocks.";
+      delete itr->second;
+    }
+    writers_.clear();
+  }
+
+  int64_t records() const { return records_; }
+
+ private:
+  const string root_;
+  string date_;
+  map<string, SequenceFileWriter*> writers_;
+  int64_t records_;
+};
+
+////////////////////////////////////////////////////////
+//
+// MAIN
+//
+int main(int argc, char** argv)
+{
+  google::SetUsageMessage(
+      "Exports logger market data as block-compressed SequenceFiles.");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  vector<string> files;
+  boost::split(files, FLAGS_file, boost::is_any_of(","));
+
+  PartitionedWriter writer(FLAGS_output_dir);
+  for (vector<string>::iterator file = files.begin();
+       file != files.end(); ++file) {
+    ifstream infile(file->c_str());
+    if (!infile) {
+      LOG(ERROR) << "Unable to open " << *file;
+      return -1;
+    }
+    LOG(INFO) << "Exporting " << *file;
+
+    string line;
+    TickEvent tick;
+    while (getline(infile, line)) {
+      if (!ib::internal::ParseTickLine(line, &tick)) continue;
+      if (!writer.Append(tick)) return -1;
+    }
+  }
+  writer.CloseAll();
+  LOG(INFO) << "Exported " << writer.records() << " ticks to "
+            << FLAGS_output_dir;
+  return 0;
+}
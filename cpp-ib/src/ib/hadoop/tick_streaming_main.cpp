@@ -0,0 +1,70 @@
+#include <iostream>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "ib/hadoop/sequence_file.hpp"
+#include "ib/hadoop/streaming.hpp"
+
+using namespace std;
+using ib::hadoop::BarOptions;
+
+DEFINE_string(task, "",
+              "One of bars_map, bars_reduce, stats_map, stats_combine, "
+              "stats_reduce, or cat to dump SequenceFiles given as "
+              "arguments the way SequenceFileAsTextInputFormat does.");
+DEFINE_int32(bar_seconds, 60, "Bar width in seconds.");
+DEFINE_string(bar_price_field, "LAST", "Tick field for bar prices.");
+DEFINE_string(bar_size_field, "LAST_SIZE", "Tick field for bar volume.");
+
+static int Cat(int argc, char** argv)
+{
+  for (int i = 1; i < argc; ++i) {
+    ib::hadoop::SequenceFileReader reader(argv[i]);
+    if (!reader.Open()) return -1;
+    string key, value;
+    while (reader.Next(&key, &value)) {
+      cout << key << '\t' << value << '\n';
+    }
+  }
+  return 0;
+}
+
+////////////////////////////////////////////////////////
+//
+// MAIN
+//
+int main(int argc, char** argv)
+{
+  google::SetUsageMessage(
+      "Hadoop streaming tasks over exported ticks.  Reads stdin.");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  // Streaming tasks are line oriented and talk only to pipes.
+  ios_base::sync_with_stdio(false);
+
+  BarOptions bars;
+  bars.seconds = FLAGS_bar_seconds;
+  bars.price_field = FLAGS_bar_price_field;
+  bars.size_field = FLAGS_bar_size_field;
+
+  if (FLAGS_task == "cat") {
+    return Cat(argc, argv);
+  } else if (FLAGS_task == "bars_map") {
+    ib::hadoop::MapBars(cin, cout, bars);
+  } else if (FLAGS_task == "bars_reduce") {
+    ib::hadoop::ReduceBars(cin, cout);
+  } else if (FLAGS_task == "stats_map") {
+    ib::hadoop::MapStats(cin, cout);
+  } else if (FLAGS_task == "stats_combine") {
+    ib::hadoop::CombineStats(cin, cout);
+  } else if (FLAGS_task == "stats_reduce") {
+    ib::hadoop::ReduceStats(cin, cout);
+  } else {
+    LOG(ERROR) << "Unknown task: " << FLAGS_task;
+    return -1;
+  }
+  cout.flush();
+  return 0;
+}
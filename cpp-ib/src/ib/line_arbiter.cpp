@@ -0,0 +1,146 @@
+
+#include <glog/logging.h>
+
+#include "ib/line_arbiter.hpp"
+
+using namespace std;
+
+namespace ib {
+
+// Feeds the market data of one line to the arbiter.
+class LineArbiter::LineReceiver : public FieldReceiver
+{
+ public:
+  LineReceiver(LineArbiter* arbiter, int line)
+      : arbiter_(arbiter), line_(line) {}
+
+  virtual void OnField(int64_t ts, int id, Field field, double value)
+  {
+    arbiter_->OnUpdate(line_, ts, id, field, value);
+  }
+
+ private:
+  LineArbiter* arbiter_;
+  const int line_;
+};
+
+LineArbiter::LineArbiter(BackPlane* output, int64_t window_micros)
+    : output_(output), window_micros_(window_micros)
+{
+  CHECK(output_);
+}
+
+LineArbiter::~LineArbiter()
+{
+}
+
+int LineArbiter::AddLine(BackPlane* line, const string& name)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  const int n = names_.size();
+  CHECK(n < MAX_LINES) << "Too many lines: " << name;
+  LineStats stats = { 0, 0, 0, 0, 0 };
+  names_.push_back(name);
+  stats_.push_back(stats);
+  if (line) {
+    LineReceiver* receiver = new LineReceiver(this, n);
+    receivers_.push_back(receiver);
+    line->Register(static_cast<Receiver<BidAsk>*>(receiver));
+    line->Register(static_cast<Receiver<Last>*>(receiver));
+  }
+  return n;
+}
+
+int LineArbiter::lines() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return names_.size();
+}
+
+LineArbiter::LineStats LineArbiter::GetStats(int line) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return stats_[line];
+}
+
+bool LineArbiter::OnUpdate(int line, int64_t ts, int id,
+                           QuoteTable::Field field, double value)
+{
+  const uint32_t bit = 1U << line;
+  boost::mutex::scoped_lock lock(mutex_);
+  LineStats& stats = stats_[line];
+  stats.updates++;
+
+  Window& window = windows_[id];
+  Update* match = NULL;
+  for (int i = 0; i < WINDOW; ++i) {
+    Update& u = window.updates[i];
+    if (u.lines == 0 || (u.lines & bit) || u.field != field ||
+        u.value != value || ts - u.ts > window_micros_) continue;
+    if (match == NULL || u.ts < match->ts) match = &u;
+  }
+
+  if (match) {
+    // A copy of an update another line won.
+    match->lines |= bit;
+    // The stamps are taken before the lock; a line can lose the lock
+    // but have the earlier stamp.
+    int64_t lag = ts > match->ts ? ts - match->ts : 0;
+    stats.losses++;
+    stats.lag_micros += lag;
+    if (lag > stats.max_lag_micros) stats.max_lag_micros = lag;
+    return false;
+  }
+
+  Update& u = window.updates[window.next];
+  window.next = (window.next + 1) % WINDOW;
+  u.ts = ts;
+  u.value = value;
+  u.field = field;
+  u.lines = bit;
+  stats.wins++;
+  Forward(ts, id, field, value);
+  return true;
+}
+
+void LineArbiter::Forward(int64_t ts, int id, QuoteTable::Field field,
+                          double value)
+{
+  switch (field) {
+    case QuoteTable::BID:
+      output_->OnBid(ts, id, value);
+      break;
+    case QuoteTable::BID_SIZE:
+      output_->OnBid(ts, id, static_cast<int>(value));
+      break;
+    case QuoteTable::ASK:
+      output_->OnAsk(ts, id, value);
+      break;
+    case QuoteTable::ASK_SIZE:
+      output_->OnAsk(ts, id, static_cast<int>(value));
+      break;
+    case QuoteTable::LAST:
+      output_->OnLast(ts, id, value);
+      break;
+    case QuoteTable::LAST_SIZE:
+      output_->OnLast(ts, id, static_cast<int>(value));
+      break;
+  }
+}
+
+void LineArbiter::LogStats() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  for (size_t i = 0; i < names_.size(); ++i) {
+    const LineStats& s = stats_[i];
+    uint64_t arbitrated = s.wins + s.losses;
+    LOG(INFO) << "Line " << i << " (" << names_[i] << "): "
+              << s.updates << " updates, won "
+              << (arbitrated ? 100. * s.wins / arbitrated : 0) << "%, "
+              << "lag when behind "
+              << (s.losses ? s.lag_micros / (int64_t)s.losses : 0)
+              << " us mean, " << s.max_lag_micros << " us max";
+  }
+}
+
+} // namespace ib
@@ -0,0 +1,103 @@
+#ifndef IB_LINE_ARBITER_H_
+#define IB_LINE_ARBITER_H_
+
+// Arbitration between redundant lines: the same symbols subscribed
+// over several gateway connections, each a Session with its own
+// BackPlane.  The first copy of every update is forwarded to a single
+// output BackPlane, the later copies are dropped.
+//
+// The feed carries no sequence numbers, so copies are matched by
+// (id, field, value) within a time window.  Every id keeps its last
+// WINDOW updates and which lines have delivered each of them.  An
+// update matches the oldest one in the window with the same field and
+// value that its line has not delivered yet, so a value that comes
+// back (bid 10.00, 10.01, 10.00) is still forwarded every time.  A
+// line more than WINDOW updates of an id behind the others has its
+// copies forwarded again.
+//
+// Lines call in from their own polling threads.  Updates are
+// arbitrated and forwarded under one lock, so receivers on the output
+// see them one at a time, in the order they were forwarded.
+
+#include <stdint.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread.hpp>
+
+#include "common.hpp"
+#include "ib/backplane.hpp"
+#include "ib/quote_table.hpp"
+
+namespace ib {
+
+class LineArbiter : NoCopyAndAssign
+{
+ public:
+  enum { MAX_LINES = 32, WINDOW = 16 };
+
+  struct LineStats
+  {
+    uint64_t updates;        // Received on the line.
+    uint64_t wins;           // Arrived first and forwarded.
+    uint64_t losses;         // Copies of updates another line won.
+    int64_t lag_micros;      // Over the losses, time behind the winner.
+    int64_t max_lag_micros;
+  };
+
+  // Forwards to output, which it does not own.  Copies of an update
+  // more than window_micros apart are taken as different updates.
+  LineArbiter(BackPlane* output, int64_t window_micros);
+  ~LineArbiter();
+
+  // Subscribes to the market data of a line, e.g.
+  // Session::GetBackPlane(), or NULL to call OnUpdate directly.
+  // Returns the line number.
+  int AddLine(BackPlane* line, const std::string& name);
+
+  // Arbitrates one update received at ts on the line.  Returns true
+  // if it was the first copy and was forwarded.
+  bool OnUpdate(int line, int64_t ts, int id, QuoteTable::Field field,
+                double value);
+
+  int lines() const;
+  LineStats GetStats(int line) const;
+
+  // One line per line: win rate and mean lag when it loses.
+  void LogStats() const;
+
+ private:
+  class LineReceiver;
+
+  struct Update
+  {
+    int64_t ts;
+    double value;
+    int field;
+    uint32_t lines;  // Bit per line that delivered it; 0 if unused.
+  };
+
+  struct Window
+  {
+    Window() : next(0) { memset(updates, 0, sizeof(updates)); }
+    Update updates[WINDOW];
+    int next;
+  };
+
+  void Forward(int64_t ts, int id, QuoteTable::Field field, double value);
+
+  BackPlane* const output_;
+  const int64_t window_micros_;
+  mutable boost::mutex mutex_;
+  std::map<int, Window> windows_;
+  std::vector<std::string> names_;
+  std::vector<LineStats> stats_;
+  boost::ptr_vector<LineReceiver> receivers_;
+};
+
+} // namespace ib
+
+#endif // IB_LINE_ARBITER_H_
@@ -17,8 +17,11 @@
 #include "common.hpp"
 #include "ib/ib_events.pb.h"
 #include "ib/backplane.hpp"
+#include "ib/control_plane.hpp"
 #include "ib/services.hpp"
 #include "ib/session.hpp"
+#include "ib/ticker_id.hpp"
+#include "ib/warm_state.hpp"
 
 
 
@@ -96,13 +99,46 @@ struct BidAskReceiver : public ib::Receiver<BidAsk>
    }
 };
 
+// Tells the control plane about a stream opened here, so it takes a
+// line and can be canceled remotely.
+static void TrackMarketData(unsigned int id, const string& symbol)
+{
+  live_marketdata.push_back(id);
+  session->GetControlPlane()->Track(id, symbol);
+}
+
+// True if the stream was canceled through the control plane, and is
+// not to be opened again.
+static bool Dropped(const string& symbol)
+{
+  return session->GetControlPlane()->Dropped(
+      ib::internal::SymbolToTickerId(symbol));
+}
+
+// The same for an option, keyed by its id.
+static bool Dropped(const string& symbol,
+                    ib::services::MarketDataInterface::OptionType type,
+                    double strike)
+{
+  return session->GetControlPlane()->Dropped(
+      ib::internal::SymbolToTickerId(
+          symbol, type == ib::services::MarketDataInterface::CALL, strike));
+}
+
+static void RequestIndex(ib::services::MarketDataInterface* md,
+                         const string& symbol, const string& exchange)
+{
+  if (Dropped(symbol)) return;
+  TrackMarketData(md->RequestIndex(symbol, exchange), symbol);
+}
+
 static void RequestIndexData(ib::services::MarketDataInterface* md)
 {
 
   if (FLAGS_request_index) {
-    live_marketdata.push_back(md->RequestIndex("INDU", "NYSE"));
-    live_marketdata.push_back(md->RequestIndex("SPX", "CBOE"));
-    live_marketdata.push_back(md->RequestIndex("VIX", "CBOE"));
+    RequestIndex(md, "INDU", "NYSE");
+    RequestIndex(md, "SPX", "CBOE");
+    RequestIndex(md, "VIX", "CBOE");
   }
 }
 
@@ -144,7 +180,7 @@ static void RequestStockData(vector<string> symbols,
   vector<string>::iterator itr;
   unsigned int id;
   for (itr = symbols.begin(); itr != symbols.end(); ++itr) {
-    if (itr->length()) {
+    if (itr->length() && !Dropped(*itr)) {
 
       // also check to see if the symbol is for bookdata
       vector<string>::iterator inBookdataSymbols;
@@ -158,11 +194,36 @@ static void RequestStockData(vector<string> symbols,
       VLOG(1) << "Requested " << *itr
               << ", tickerId=" << id << ", getBook=" << getBook;
 
-      live_marketdata.push_back(id);
+      TrackMarketData(id, *itr);
+      if (session->GetWarmState()) {
+        session->GetWarmState()->Subscribe(*itr, getBook);
+      }
     }
   }
 }
 
+// Adds the subscriptions restored from the last run to the ones from
+// the flags, so a restart picks up where it left off.
+static void AddRestoredSubscriptions(ib::WarmState* state)
+{
+  vector<ib::state::Subscription> subscriptions;
+  state->GetSubscriptions(&subscriptions);
+  vector<ib::state::Subscription>::iterator itr;
+  for (itr = subscriptions.begin(); itr != subscriptions.end(); ++itr) {
+    const string& symbol = itr->symbol();
+    if (find(tickdata_tokens.begin(), tickdata_tokens.end(), symbol) ==
+        tickdata_tokens.end()) {
+      tickdata_tokens.push_back(symbol);
+    }
+    if (itr->book() &&
+        find(bookdata_tokens.begin(), bookdata_tokens.end(), symbol) ==
+        bookdata_tokens.end()) {
+      bookdata_tokens.push_back(symbol);
+    }
+  }
+  LOG(INFO) << "Restored " << subscriptions.size() << " subscriptions.";
+}
+
 static string FormatOptionExpiry(int year, int month, int day,
                                   string* formatted)
 {
@@ -181,13 +242,16 @@ static void RequestOptionData(ib::services::MarketDataInterface* md)
       ib::services::MarketDataInterface::CALL :
       ib::services::MarketDataInterface::PUT;
 
-  live_marketdata.push_back(
-      md->RequestOptionData(FLAGS_option_symbol,
-                            option_type,
-                            FLAGS_option_strike,
-                            FLAGS_option_year,
-                            FLAGS_option_month,
-                            FLAGS_option_day, false));
+  if (!Dropped(FLAGS_option_symbol, option_type, FLAGS_option_strike)) {
+    TrackMarketData(
+        md->RequestOptionData(FLAGS_option_symbol,
+                              option_type,
+                              FLAGS_option_strike,
+                              FLAGS_option_year,
+                              FLAGS_option_month,
+                              FLAGS_option_day, false),
+        FLAGS_option_symbol);
+  }
 
   string formatted;
   VLOG(1) << "Requested " << FLAGS_option_symbol << ",side = " << option_type
@@ -202,13 +266,16 @@ static void RequestOptionData(ib::services::MarketDataInterface* md)
         FLAGS_option_call ?
         ib::services::MarketDataInterface::PUT:
         ib::services::MarketDataInterface::CALL;
-    live_marketdata.push_back(
-        md->RequestOptionData(FLAGS_option_symbol,
-                              option_type2,
-                              FLAGS_option_strike,
-                              FLAGS_option_year,
-                              FLAGS_option_month,
-                              FLAGS_option_day, false));
+    if (!Dropped(FLAGS_option_symbol, option_type2, FLAGS_option_strike)) {
+      TrackMarketData(
+          md->RequestOptionData(FLAGS_option_symbol,
+                                option_type2,
+                                FLAGS_option_strike,
+                                FLAGS_option_year,
+                                FLAGS_option_month,
+                                FLAGS_option_day, false),
+          FLAGS_option_symbol);
+    }
 
     string formatted;
     VLOG(1) << "Requested " << FLAGS_option_symbol << ",side = " << option_type2
@@ -294,20 +361,23 @@ int main(int argc, char** argv)
   VLOG(1) << "Session created for " << host << ":" << port << " @ "
           << connection_id;
 
+  if (session->GetWarmState()) {
+    AddRestoredSubscriptions(session->GetWarmState());
+  }
+
   session->Start();
 
   // register callback
   session->RegisterCallbackOnConnect(boost::bind(OnConnectConfirm));
   session->RegisterCallbackOnDisconnect(boost::bind(OnDisconnect));
 
-  // Receive signals
+  // Receive signals.  The receivers and selections stay registered
+  // as long as the session emits, so they live as long as main.
+  BidAskReceiver receiver1(1);
+  BidAskReceiver receiver2(2);
+  ib::signal::Selection select1;
+  ib::signal::Selection select2;
   if (FLAGS_test_backplane) {
-    BidAskReceiver receiver1(1);
-    BidAskReceiver receiver2(2);
-
-    ib::signal::Selection select1;
-    ib::signal::Selection select2;
-
     select1 << "GOOG" << "AAPL";
     select2 << "SPY" << "QQQQ";
 
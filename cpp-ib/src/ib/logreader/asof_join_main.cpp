@@ -0,0 +1,151 @@
+#include <stdio.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "ib/asof_join.hpp"
+#include "ib/tick_log.hpp"
+
+using namespace std;
+using ib::QuoteTable;
+using ib::history::AsOfIndex;
+using ib::history::AsOfJoin;
+using ib::history::JoinColumns;
+using ib::history::JoinedTick;
+using ib::internal::TickEvent;
+
+DEFINE_string(file, "logfile",
+              "Comma separated list of logger files, in time order.");
+DEFINE_string(left, "", "Comma separated symbols whose ticks are joined.");
+DEFINE_string(right, "SPY:BID,SPY:ASK",
+              "Comma separated SYMBOL:FIELD columns joined to each tick.");
+DEFINE_string(output, "-", "CSV output file, - for stdout.");
+
+// One CSV line per joined tick: ts,symbol,field,value,column...
+class CsvWriter : public ib::Receiver<JoinedTick>
+{
+ public:
+  explicit CsvWriter(FILE* out) : out_(out) {}
+
+  void operator()(const JoinedTick& tick)
+  {
+    static const char* FIELDS[] = {
+      "BID", "BID_SIZE", "ASK", "ASK_SIZE", "LAST", "LAST_SIZE"
+    };
+    string symbol;
+    ib::signal::GetSymbol(tick.id, &symbol);
+    fprintf(out_, "%lld,%s,%s,%.10g", static_cast<long long>(tick.ts),
+            symbol.c_str(), FIELDS[tick.field], tick.value);
+    for (size_t i = 0; i < tick.columns; ++i) {
+      fprintf(out_, ",%.10g", tick.right[i]);
+    }
+    fputc('\n', out_);
+  }
+
+ private:
+  FILE* out_;
+};
+
+// Calls the function with every quote tick of the files.
+template <typename F>
+static bool ForEachTick(const vector<string>& files, F* f)
+{
+  for (vector<string>::const_iterator file = files.begin();
+       file != files.end(); ++file) {
+    ifstream infile(file->c_str());
+    if (!infile) {
+      LOG(ERROR) << "Unable to open " << *file;
+      return false;
+    }
+    string line;
+    TickEvent tick;
+    QuoteTable::Field field;
+    while (getline(infile, line)) {
+      if (!ib::internal::ParseTickLine(line, &tick)) continue;
+      if (!ib::history::FieldFromName(tick.event, &field)) continue;
+      (*f)(tick, ib::signal::GetTickerId(tick.symbol), field);
+    }
+  }
+  return true;
+}
+
+struct Indexer
+{
+  explicit Indexer(AsOfIndex* i) : index(i) {}
+  AsOfIndex* index;
+  void operator()(const TickEvent& tick, int id, QuoteTable::Field field)
+  {
+    index->Add(tick.ts, id, field, tick.value);
+  }
+};
+
+struct Joiner
+{
+  explicit Joiner(AsOfJoin* j) : join(j) {}
+  AsOfJoin* join;
+  void operator()(const TickEvent& tick, int id, QuoteTable::Field field)
+  {
+    join->OnField(tick.ts, id, field, tick.value);
+  }
+};
+
+////////////////////////////////////////////////////////
+//
+// MAIN
+//
+int main(int argc, char** argv)
+{
+  google::SetUsageMessage(
+      "Joins logger ticks of --left symbols to the --right columns as of "
+      "each tick, as CSV.");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  vector<string> files, left, right;
+  boost::split(files, FLAGS_file, boost::is_any_of(","));
+  boost::split(left, FLAGS_left, boost::is_any_of(","));
+  boost::split(right, FLAGS_right, boost::is_any_of(","));
+
+  ib::signal::SymbolSet symbols;
+  for (size_t i = 0; i < left.size(); ++i) {
+    if (!left[i].empty()) symbols.Add(left[i]);
+  }
+  JoinColumns columns;
+  for (size_t i = 0; i < right.size(); ++i) {
+    size_t sep = right[i].find(':');
+    QuoteTable::Field field;
+    if (sep == string::npos ||
+        !ib::history::FieldFromName(right[i].substr(sep + 1), &field)) {
+      LOG(ERROR) << "Bad column " << right[i] << ", expected SYMBOL:FIELD.";
+      return -1;
+    }
+    columns.Add(right[i].substr(0, sep), field);
+  }
+
+  // The right side first, so every left tick sees the whole history.
+  AsOfIndex index(columns);
+  Indexer indexer(&index);
+  if (!ForEachTick(files, &indexer)) return -1;
+  index.Seal();
+  LOG(INFO) << "Indexed " << index.ticks() << " ticks of "
+            << columns.size() << " columns.";
+
+  FILE* out = FLAGS_output == "-" ? stdout : fopen(FLAGS_output.c_str(), "w");
+  if (out == NULL) {
+    PLOG(ERROR) << "Cannot open " << FLAGS_output;
+    return -1;
+  }
+  CsvWriter writer(out);
+  AsOfJoin join(columns, symbols, &index, &writer);
+  Joiner joiner(&join);
+  if (!ForEachTick(files, &joiner)) return -1;
+  if (out != stdout) fclose(out);
+  LOG(INFO) << "Joined " << join.joined() << " ticks.";
+  return 0;
+}
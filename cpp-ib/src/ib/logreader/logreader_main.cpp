@@ -1,7 +1,7 @@
 #include "common.hpp"
 #include "messaging.hpp"
 #include "utils.hpp"
-#include "ib/ticker_id.hpp"
+#include "ib/tick_log.hpp"
 
 #include <iostream>
 #include <fstream>
@@ -37,61 +37,6 @@ DEFINE_int32(playback, 1, "X times actual speed in log. 2 for 2X. 0 to scan.");
 DEFINE_int32(starthour, 9, "Hour EST to start.");
 DEFINE_int32(startmin, 30, "Minute EST to start.");
 
-const char* NUMERIC_EVENTS[] = { "tickPrice", "tickSize", "tickGeneric" };
-
-// Determines if the event has a numeric value.  This corresponds
-// all the IB's tickPrice, tickSize, and tickGeneric events.
-static bool IsMarketDataEvent(map<string, string>& event) {
-  bool hasMatch = false;
-  map<string, string>::iterator found = event.find("event");
-  if (found != event.end()) {
-    for (int i = 0; i < 3; ++i) {
-      if (found->second.compare(NUMERIC_EVENTS[i]) == 0) {
-        hasMatch = true;
-        break;
-      }
-    }
-  }
-  return hasMatch;
-}
-
-static bool Get(map<string, string>& nv, string key, uint64_t* out) {
-  map<string, string>::iterator found = nv.find(key);
-  if (found != nv.end()) {
-    char* end;
-    *out = static_cast<uint64_t>(strtoll(found->second.c_str(), &end, 10));
-    return true;
-  }
-  return false;
-}
-
-static bool Get(map<string, string>& nv, string key, string* out) {
-  map<string, string>::iterator found = nv.find(key);
-  if (found != nv.end()) {
-    out->assign(nv[key]);
-    return true;
-  }
-  return false;
-}
-
-static bool Get(map<string, string>& nv, string key, int* out) {
-  map<string, string>::iterator found = nv.find(key);
-  if (found != nv.end()) {
-    *out = atoi(nv[key].c_str());
-    return true;
-  }
-  return false;
-}
-
-static bool Get(map<string, string>& nv, string key, double* out) {
-  map<string, string>::iterator found = nv.find(key);
-  if (found != nv.end()) {
-    *out = atof(nv[key].c_str());
-    return true;
-  }
-  return false;
-}
-
 const uint64_t SECOND_MICROS = 1000 * 1000LL;
 const uint64_t MINUTE_MICROS = 60 * SECOND_MICROS;
 const uint64_t HOUR_MICROS = 60 * MINUTE_MICROS;
@@ -110,97 +55,9 @@ inline static int second_of_minute(uint64_t ts) {
   return (ts % MINUTE_MICROS) / SECOND_MICROS;
 }
 
-// Struct for holding market data.  Multipart data frames are
-// in the order of the fields.
+// Market data.  Multipart data frames are in the order of the fields.
 // e.g. AAPL|BID|121334233343|350.00
-struct MarketData {
-  string symbol;
-  string event;
-  uint64_t ts;
-  double value;
-};
-
-// Process a parsed map.
-  static bool process(map<string, string>& nv, MarketData* marketData) {
-
-  if (!IsMarketDataEvent(nv)) {
-    DEBUG4 << "Not a numeric event. " << endl;
-    return false;
-  }
-
-  uint64_t ts;
-  string symbol;
-  string event;
-  double value;
-
-  ////////// Timestamp
-  if (!Get(nv, "ts_utc", &ts)) {
-    return false;
-  }
-  DEBUG3 << "Timestamp ==> " << ts << endl;
-
-  ////////// TickerId / Symbol:
-  int code = 0;
-  if (!Get(nv, "tickerId", &code)) {
-    return false;
-  }
-  ib::internal::SymbolFromTickerId(code, &symbol);
-  nv["symbol"] = symbol;
-  DEBUG3 << "symbol ==> " << symbol << "(" << code << ")" << endl;
-
-  ////////// Event
-  if (!Get(nv, "field", &event)) {
-    return false;
-  }
-  DEBUG3 << "event ==> " << event << endl;
-
-  ////////// Price / Size
-  if (!Get(nv, "price", &value)) {
-    if (!Get(nv, "size", &value)) {
-      if (!Get(nv, "value", &value)) {
-        return false;
-      }
-    }
-  }
-  DEBUG3 << "value ==> " << value << endl;
-
-  DEBUG1
-      << symbol << ' '
-      << event << ' '
-      << ts << ' '
-      << value << endl;
-
-  marketData->ts = ts;
-  marketData->symbol = symbol;
-  marketData->event = event;
-  marketData->value = value;
-
-  return true;
-}
-
-
-inline static bool ParseMap(const string& token, map<string, string>& nv) {
-  // Split by the '=' into name-value pairs:
-  vector<string> nvpairs_vec;
-  boost::split(nvpairs_vec, token, boost::is_any_of(","));
-
-  if (nvpairs_vec.empty()) {
-    return false;
-  }
-
-  // Split the name-value pairs by '=' into a map:
-  vector<string>::iterator itr;
-  for (itr = nvpairs_vec.begin(); itr != nvpairs_vec.end(); ++itr) {
-    int sep = itr->find('=');
-    string key = itr->substr(0, sep);
-    string val = itr->substr(sep + 1, itr->length() - sep);
-    DEBUG4 << "Name-Value Pair: " << *itr
-           << " (" << key << ", " << val << ") " << endl;
-    nv[key] = val;
-  }
-  DEBUG4 << "Map, size=" << nv.size() << endl;
-  return true;
-}
+typedef ib::internal::TickEvent MarketData;
 
 ////////////////////////////////////////////////////////
 //
@@ -249,10 +106,10 @@ int  main(int argc, char** argv)
 
       curr = new MarketData();
       map<string, string> nv;
-      if (ParseMap(token, nv)) {
+      if (ib::internal::ParseEventMap(token, &nv)) {
 
         uint64_t t1 = lab616::utils::now_micros();
-        bool ok = process(nv, curr);
+        bool ok = ib::internal::TickEventFromMap(nv, curr);
         if (ok && context != NULL) {
 
           if (last == NULL) {
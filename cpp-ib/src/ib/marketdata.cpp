@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <sstream>
 #include <boost/format.hpp>
 #include <glog/logging.h>
@@ -16,9 +17,31 @@ namespace ib {
 namespace internal {
 
 
-static const string GENERIC_TICK_TAGS =
+const string GENERIC_TICK_TAGS =
     "100,101,104,105,106,107,165,221,225,233,236,258";
 
+// Errors after which the gateway sends nothing more for the id.
+static const int ENDING_CODES[] = {
+  101,    // Max number of tickers reached.
+  162,    // Historical market data service error.
+  200,    // No security definition found.
+  300,    // Can't find the id.
+  320,    // Error reading request.
+  321,    // Error validating request.
+  354,    // Requested market data is not subscribed.
+  366,    // No historical data query found.
+  420,    // Invalid real-time query.
+  430,    // Fundamentals data is not available.
+  504,    // Not connected: the request was not sent.
+  10168,  // Not subscribed, and delayed market data is not enabled.
+};
+
+bool EndsRequest(int code)
+{
+  const int* end = ENDING_CODES + sizeof(ENDING_CODES) / sizeof(int);
+  return find(ENDING_CODES, end, code) != end;
+}
+
 static string* FormatOptionExpiry(int year, int month, int day, string* out)
 {
   ostringstream s1;
@@ -29,10 +52,9 @@ static string* FormatOptionExpiry(int year, int month, int day, string* out)
   return out;
 }
 
-// TODO: Move to another file.
-static void CreateContractForIndex(const string& symbol,
-                                   const string& exchange,
-                                   Contract* contract)
+void CreateContractForIndex(const string& symbol,
+                            const string& exchange,
+                            Contract* contract)
 {
   VLOG(VLOG_MARKETDATA) << "Creating IND contract for " << symbol
                         << " on " << exchange;
@@ -44,8 +66,8 @@ static void CreateContractForIndex(const string& symbol,
   contract->currency = "USD";
 }
 
-static void CreateContractForStock(const string& symbol,
-                                   Contract* contract)
+void CreateContractForStock(const string& symbol,
+                            Contract* contract)
 {
   VLOG(VLOG_MARKETDATA) << "Creating STK contract for " << symbol;
 
@@ -55,12 +77,12 @@ static void CreateContractForStock(const string& symbol,
   contract->currency = "USD";
 }
 
-static void CreateContractForOption(const string& symbol,
-                                    MarketDataInterface::OptionType option_type,
-                                    double strike,
-                                    int year, int month,
-                                    int day,
-                                    Contract* contract)
+void CreateContractForOption(const string& symbol,
+                             MarketDataInterface::OptionType option_type,
+                             double strike,
+                             int year, int month,
+                             int day,
+                             Contract* contract)
 {
   VLOG(VLOG_MARKETDATA) << "Creating OPTION contract for " << symbol;
   contract->symbol = symbol;
@@ -69,7 +91,7 @@ static void CreateContractForOption(const string& symbol,
   contract->currency = "USD";
   if (strike > 0.0) {
     contract->strike = strike;
-    contract->multiplier = 100;
+    contract->multiplier = "100";
   }
   if (year && month && day) {
     string formatted;
@@ -16,6 +16,21 @@ using namespace std;
 namespace ib {
 namespace internal {
 
+// Generic ticks requested with every stream.
+extern const string GENERIC_TICK_TAGS;
+
+// True if an error of the code ends the request of its id.  Others,
+// such as the warnings 10090 and 10167, leave the request open.
+bool EndsRequest(int code);
+
+// Contracts as the requests below make them.
+void CreateContractForIndex(const string& symbol, const string& exchange,
+                            Contract* contract);
+void CreateContractForStock(const string& symbol, Contract* contract);
+void CreateContractForOption(const string& symbol,
+                             services::MarketDataInterface::OptionType type,
+                             double strike, int year, int month, int day,
+                             Contract* contract);
 
 class MarketDataImpl : public ib::services::MarketDataInterface
 {
@@ -0,0 +1,233 @@
+
+extern "C"
+{
+#include <ncurses.h>
+}
+
+#include <signal.h>
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <zmq.hpp>
+
+#include "common.hpp"
+#include "messaging.hpp"
+#include "utils.hpp"
+#include "ib/monitor/quote_grid.hpp"
+#include "ib/quote_table.hpp"
+#include "ib/services.hpp"
+#include "ib/session.hpp"
+#include "ib/shm_bus.hpp"
+#include "ib/ticker_id.hpp"
+
+using namespace std;
+using ib::QuoteTable;
+using ib::monitor::QuoteGrid;
+
+DEFINE_string(symbols, "AAPL,GOOG,PCLN,NFLX", "Watchlist, comma-delimited.");
+DEFINE_int32(fps, 10, "Frames per second.");
+DEFINE_int32(flash_millis, 500, "How long a changed cell stays colored.");
+
+DEFINE_string(endpoint, "",
+              "ZMQ feed to attach to, e.g. tcp://feedhost:5555 (see "
+              "logreader).  If empty, connects to the gateway directly.");
+DEFINE_string(shm_bus, "",
+              "Shared-memory bus of a session on this host to attach to "
+              "(see --shm_bus of the session).  Overrides --endpoint.");
+DEFINE_string(host, "", "Gateway hostname, when not attached to a feed.");
+DEFINE_int32(port, 4001, "Gateway port.");
+DEFINE_int32(client_id, 10, "Client Id.");
+
+static volatile bool running = true;
+
+static void OnTerminate(int)
+{
+  running = false;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Feeds
+
+// Subscribes to the multipart frames published by logreader:
+// symbol | event | ts (uint64) | value (double).  Only the watchlist
+// symbols are subscribed to so the publisher filters the rest.
+static void ZmqFeed(const vector<string>& symbols, QuoteTable* table)
+{
+  map<string, QuoteTable::Field> fields;
+  fields["BID"] = QuoteTable::BID;
+  fields["BID_SIZE"] = QuoteTable::BID_SIZE;
+  fields["ASK"] = QuoteTable::ASK;
+  fields["ASK_SIZE"] = QuoteTable::ASK_SIZE;
+  fields["LAST"] = QuoteTable::LAST;
+  fields["LAST_SIZE"] = QuoteTable::LAST_SIZE;
+
+  zmq::context_t context(1);
+  zmq::socket_t socket(context, ZMQ_SUB);
+  for (vector<string>::const_iterator s = symbols.begin();
+       s != symbols.end(); ++s) {
+    socket.setsockopt(ZMQ_SUBSCRIBE, s->data(), s->length());
+  }
+  socket.connect(FLAGS_endpoint.c_str());
+
+  zmq::pollitem_t items[] = { { socket, 0, ZMQ_POLLIN, 0 } };
+  string symbol, event;
+  uint64_t ts;
+  double value;
+  while (running) {
+    zmq::poll(items, 1, 100000);  // Micros; checks running.
+    if (!(items[0].revents & ZMQ_POLLIN)) continue;
+
+    if (!lab616::messaging::receive(socket, &symbol) ||
+        !lab616::messaging::receive(socket, &event) ||
+        !lab616::messaging::receive(socket, ts)) {
+      continue;
+    }
+    lab616::messaging::receive(socket, value);
+
+    map<string, QuoteTable::Field>::iterator field = fields.find(event);
+    if (field == fields.end()) continue;
+    table->Update(ts, ib::internal::SymbolToTickerId(symbol), field->second,
+                  value);
+  }
+}
+
+static ib::Session* session = NULL;
+
+static void OnConnectConfirm(const vector<string>& symbols)
+{
+  ib::services::MarketDataInterface* md = session->AccessMarketData();
+  if (!md) return;
+  for (vector<string>::const_iterator s = symbols.begin();
+       s != symbols.end(); ++s) {
+    md->RequestTicks(*s, false);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+// Screen
+
+enum Colors { Up = 1, Down, Header };
+
+static void InitScreen()
+{
+  initscr();
+  cbreak();
+  noecho();
+  nodelay(stdscr, TRUE);
+  curs_set(0);
+  if (has_colors()) {
+    start_color();
+    init_pair(Up, COLOR_BLACK, COLOR_GREEN);
+    init_pair(Down, COLOR_BLACK, COLOR_RED);
+    init_pair(Header, COLOR_YELLOW, COLOR_BLACK);
+  }
+  attron(COLOR_PAIR(Header) | A_BOLD);
+  for (int c = 0; c < QuoteGrid::NUM_COLUMNS; ++c) {
+    mvprintw(0, QuoteGrid::Offset(c), "%*s", QuoteGrid::Width(c),
+             QuoteGrid::Title(c));
+  }
+  attroff(COLOR_PAIR(Header) | A_BOLD);
+}
+
+static void Draw(const vector<QuoteGrid::Cell>& cells)
+{
+  // Rows past the bottom of the terminal are not drawn.
+  const int max_rows = LINES - 2;
+  for (vector<QuoteGrid::Cell>::const_iterator cell = cells.begin();
+       cell != cells.end(); ++cell) {
+    if (cell->row >= max_rows) continue;
+    int attr = 0;
+    if (cell->style == QuoteGrid::UP) attr = COLOR_PAIR(Up);
+    if (cell->style == QuoteGrid::DOWN) attr = COLOR_PAIR(Down);
+    attron(attr);
+    mvaddnstr(cell->row + 1, QuoteGrid::Offset(cell->column),
+              cell->text.c_str(), cell->text.length());
+    attroff(attr);
+  }
+}
+
+////////////////////////////////////////////////////////
+//
+// MAIN
+//
+int main(int argc, char** argv)
+{
+  google::SetUsageMessage("Terminal quote monitor.  Press q to quit.");
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+
+  signal(SIGTERM, OnTerminate);
+  signal(SIGINT, OnTerminate);
+
+  vector<string> symbols;
+  boost::split(symbols, FLAGS_symbols, boost::is_any_of(","));
+
+  // Sized for the watchlist; the table never grows.
+  size_t capacity = 16;
+  while (capacity < symbols.size() * 2) capacity <<= 1;
+  QuoteTable table(capacity);
+
+  // The feed only writes into the table.  Rendering happens here, at
+  // a fixed rate, and never blocks the feed.
+  boost::scoped_ptr<boost::thread> feed;
+  boost::scoped_ptr<ib::QuoteTableReceiver> receiver;
+  boost::scoped_ptr<ib::ShmBusReader> bus;
+  const QuoteTable* quotes = &table;
+  if (!FLAGS_shm_bus.empty()) {
+    // The writer keeps the book; nothing to run here.
+    bus.reset(ib::ShmBusReader::Open(FLAGS_shm_bus));
+    if (!bus.get()) return 1;
+    quotes = &bus->book();
+  } else if (!FLAGS_endpoint.empty()) {
+    feed.reset(new boost::thread(boost::bind(ZmqFeed, symbols, &table)));
+  } else {
+    session = new ib::Session(FLAGS_host, FLAGS_port, FLAGS_client_id);
+    receiver.reset(new ib::QuoteTableReceiver(&table));
+    ib::BackPlane* backplane = session->GetBackPlane();
+    backplane->Register(static_cast<ib::Receiver<BidAsk>*>(receiver.get()));
+    backplane->Register(static_cast<ib::Receiver<Last>*>(receiver.get()));
+    session->RegisterCallbackOnConnect(boost::bind(OnConnectConfirm, symbols));
+    session->Start();
+  }
+
+  QuoteGrid grid(quotes, symbols, FLAGS_flash_millis * 1000LL);
+  vector<QuoteGrid::Cell> cells;
+  const int64_t frame_micros = 1000000 / FLAGS_fps;
+
+  InitScreen();
+  while (running) {
+    int64_t start = lab616::utils::now_micros();
+
+    cells.clear();
+    grid.Frame(start, &cells);
+    Draw(cells);
+
+    int64_t elapsed = lab616::utils::now_micros() - start;
+    mvprintw(LINES - 1, 0, "%d symbols  %d cells  %ld us/frame ",
+             grid.rows(), static_cast<int>(cells.size()), (long)elapsed);
+    refresh();
+
+    if (getch() == 'q') break;
+    if (elapsed < frame_micros) {
+      lab616::utils::sleep_micros(frame_micros - elapsed);
+    }
+  }
+  endwin();
+
+  running = false;
+  if (feed.get()) feed->join();
+  if (session) {
+    session->Stop();
+    session->Join();
+    delete session;
+  }
+  return 0;
+}
@@ -0,0 +1,157 @@
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ib/monitor/quote_grid.hpp"
+#include "ib/ticker_id.hpp"
+
+namespace ib {
+namespace monitor {
+
+static const int WIDTHS[] = { 8, 8, 10, 10, 8, 10, 8, 8 };
+static const char* TITLES[] = {
+  "SYMBOL", "BSIZE", "BID", "ASK", "ASIZE", "LAST", "LSIZE", "UPD/S"
+};
+
+static const int64_t RATE_INTERVAL = 1000000;
+
+int QuoteGrid::Width(int column)
+{
+  return WIDTHS[column];
+}
+
+int QuoteGrid::Offset(int column)
+{
+  int offset = 0;
+  for (int i = 0; i < column; ++i) offset += WIDTHS[i] + 1;
+  return offset;
+}
+
+const char* QuoteGrid::Title(int column)
+{
+  return TITLES[column];
+}
+
+QuoteGrid::QuoteGrid(const QuoteTable* table,
+                     const std::vector<std::string>& symbols,
+                     int64_t flash_micros)
+    : table_(table)
+    , flash_micros_(flash_micros)
+    , rows_(symbols.size())
+    , first_(true)
+{
+  for (size_t i = 0; i < symbols.size(); ++i) {
+    Row& row = rows_[i];
+    row.id = ib::internal::SymbolToTickerId(symbols[i]);
+    row.slot = -1;
+    row.version = 0;
+    row.rate_updates = 0;
+    row.rate_ts = 0;
+    row.flashing = 0;
+    for (int c = 0; c < NUM_COLUMNS; ++c) {
+      row.value[c] = 0;
+      row.flash_until[c] = 0;
+      row.style[c] = NORMAL;
+    }
+    row.text[SYMBOL] = symbols[i];
+  }
+}
+
+void QuoteGrid::Frame(int64_t now, std::vector<Cell>* changed)
+{
+  for (size_t r = 0; r < rows_.size(); ++r) {
+    Row& row = rows_[r];
+    if (first_) {
+      for (int c = 0; c < NUM_COLUMNS; ++c) {
+        Cell cell;
+        cell.row = r;
+        cell.column = c;
+        cell.style = NORMAL;
+        cell.text = row.text[c];
+        cell.text.resize(WIDTHS[c], ' ');
+        changed->push_back(cell);
+      }
+    }
+    if (row.slot < 0) {
+      row.slot = table_->Find(row.id);
+      if (row.slot < 0) continue;
+      row.rate_ts = now;
+    }
+
+    bool rate_due = now - row.rate_ts >= RATE_INTERVAL;
+    uint64_t version = table_->version(row.slot);
+    if (version != row.version || rate_due) {
+      Quote quote;
+      row.version = table_->Read(row.slot, &quote);
+      Set(now, r, BID, quote.bid, true, changed);
+      Set(now, r, BID_SIZE, quote.bid_size, true, changed);
+      Set(now, r, ASK, quote.ask, true, changed);
+      Set(now, r, ASK_SIZE, quote.ask_size, true, changed);
+      Set(now, r, LAST, quote.last, true, changed);
+      Set(now, r, LAST_SIZE, quote.last_size, true, changed);
+      if (rate_due) {
+        double rate =
+            (quote.updates - row.rate_updates) * 1e6 / (now - row.rate_ts);
+        row.rate_updates = quote.updates;
+        row.rate_ts = now;
+        Set(now, r, RATE, rate, false, changed);
+      }
+    }
+
+    // Expire the flashes.
+    for (int c = 0; row.flashing > 0 && c < NUM_COLUMNS; ++c) {
+      if (row.style[c] != NORMAL && now >= row.flash_until[c]) {
+        row.flashing--;
+        Emit(r, c, NORMAL, row.text[c], changed);
+      }
+    }
+  }
+  first_ = false;
+}
+
+void QuoteGrid::Set(int64_t now, int r, int column, double value, bool flash,
+                    std::vector<Cell>* changed)
+{
+  Row& row = rows_[r];
+  if (value == row.value[column]) return;
+
+  // The first value of a cell is not a change worth flashing.
+  Style style = row.style[column];
+  if (flash && row.value[column] != 0) {
+    if (style == NORMAL) row.flashing++;
+    style = (value > row.value[column]) ? UP : DOWN;
+    row.flash_until[column] = now + flash_micros_;
+  }
+  row.value[column] = value;
+
+  char buff[32];
+  if (column == BID || column == ASK || column == LAST) {
+    snprintf(buff, sizeof(buff), "%*.2f", WIDTHS[column], value);
+  } else if (column == RATE) {
+    snprintf(buff, sizeof(buff), "%*.1f", WIDTHS[column], value);
+  } else {
+    snprintf(buff, sizeof(buff), "%*d", WIDTHS[column],
+             static_cast<int>(value));
+  }
+  Emit(r, column, style, buff, changed);
+}
+
+void QuoteGrid::Emit(int r, int column, Style style, const std::string& text,
+                     std::vector<Cell>* changed)
+{
+  Row& row = rows_[r];
+  if (style == row.style[column] && text == row.text[column]) return;
+  row.style[column] = style;
+  row.text[column] = text;
+
+  Cell cell;
+  cell.row = r;
+  cell.column = column;
+  cell.style = style;
+  cell.text = text;
+  cell.text.resize(WIDTHS[column], ' ');
+  changed->push_back(cell);
+}
+
+} // namespace monitor
+} // namespace ib
@@ -0,0 +1,82 @@
+#ifndef IB_MONITOR_QUOTE_GRID_H_
+#define IB_MONITOR_QUOTE_GRID_H_
+
+// Screen model for the quote monitor.  Keeps what was last drawn for
+// every cell of the watchlist and, once per frame, works out which
+// cells need to be redrawn: values that changed (flashed up or down),
+// flashes that expired and per-symbol update rates.  Rows whose
+// QuoteTable slot version did not change are skipped without reading
+// the slot, so a frame over a quiet watchlist is a scan of versions.
+//
+// Independent of curses so that it can be tested; see monitor_main.cpp
+// for the renderer.
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+#include "ib/quote_table.hpp"
+
+namespace ib {
+namespace monitor {
+
+class QuoteGrid : NoCopyAndAssign
+{
+ public:
+  enum Column {
+    SYMBOL = 0, BID_SIZE, BID, ASK, ASK_SIZE, LAST, LAST_SIZE, RATE,
+    NUM_COLUMNS
+  };
+
+  enum Style { NORMAL = 0, UP, DOWN };
+
+  struct Cell {
+    int row;
+    int column;
+    Style style;
+    std::string text;  // Padded to the column width.
+  };
+
+  QuoteGrid(const QuoteTable* table, const std::vector<std::string>& symbols,
+            int64_t flash_micros);
+
+  // Appends the cells that differ from what the previous frame
+  // produced.  The first frame produces every cell.
+  void Frame(int64_t now, std::vector<Cell>* changed);
+
+  int rows() const { return rows_.size(); }
+
+  static int Width(int column);
+  static int Offset(int column);
+  static const char* Title(int column);
+
+ private:
+  struct Row {
+    int id;
+    int slot;
+    uint64_t version;
+    uint64_t rate_updates;
+    int64_t rate_ts;
+    int flashing;
+    double value[NUM_COLUMNS];
+    int64_t flash_until[NUM_COLUMNS];
+    Style style[NUM_COLUMNS];
+    std::string text[NUM_COLUMNS];
+  };
+
+  void Set(int64_t now, int row, int column, double value, bool flash,
+           std::vector<Cell>* changed);
+  void Emit(int row, int column, Style style, const std::string& text,
+            std::vector<Cell>* changed);
+
+  const QuoteTable* table_;
+  const int64_t flash_micros_;
+  std::vector<Row> rows_;
+  bool first_;
+};
+
+} // namespace monitor
+} // namespace ib
+
+#endif // IB_MONITOR_QUOTE_GRID_H_
@@ -0,0 +1,310 @@
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include <glog/logging.h>
+
+#include "ib/numa.hpp"
+
+#define VLOG_LEVEL 2
+
+// From <numaif.h>, which comes with libnuma.
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+using namespace std;
+
+namespace ib {
+namespace numa {
+
+static const size_t HUGE_PAGE_SIZE = 2 << 20;
+static const int MAX_NODES = 1024;
+
+static bool ReadFile(const string& path, string* contents)
+{
+  FILE* file = fopen(path.c_str(), "r");
+  if (!file) return false;
+  contents->clear();
+  char buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    contents->append(buffer, n);
+  }
+  fclose(file);
+  return true;
+}
+
+static long ReadLong(const string& path, long missing)
+{
+  string contents;
+  if (!ReadFile(path, &contents)) return missing;
+  return strtol(contents.c_str(), NULL, 10);
+}
+
+// "0-3,8" for 0, 1, 2, 3, 8.
+static string FormatCpuList(const vector<int>& cpus)
+{
+  ostringstream list;
+  for (size_t i = 0; i < cpus.size(); ) {
+    size_t j = i;
+    while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) ++j;
+    if (i > 0) list << ",";
+    list << cpus[i];
+    if (j > i) list << "-" << cpus[j];
+    i = j + 1;
+  }
+  return list.str();
+}
+
+bool Topology::ParseCpuList(const string& list, vector<int>* cpus)
+{
+  cpus->clear();
+  const char* p = list.c_str();
+  while (*p && *p != '\n') {
+    char* end;
+    const long first = strtol(p, &end, 10);
+    if (end == p || first < 0) return false;
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      last = strtol(++p, &end, 10);
+      if (end == p || last < first) return false;
+      p = end;
+    }
+    for (long cpu = first; cpu <= last; ++cpu) {
+      cpus->push_back(static_cast<int>(cpu));
+    }
+    if (*p == ',') ++p;
+    else if (*p && *p != '\n') return false;
+  }
+  sort(cpus->begin(), cpus->end());
+  return true;
+}
+
+Topology::Topology(const string& root)
+{
+  const string node_dir = root + "/node";
+  DIR* dir = opendir(node_dir.c_str());
+  struct dirent* entry;
+  while (dir && (entry = readdir(dir)) != NULL) {
+    int id;
+    char rest;
+    if (sscanf(entry->d_name, "node%d%c", &id, &rest) != 1) continue;
+    const string path = node_dir + "/" + entry->d_name;
+    Node node;
+    node.id = id;
+    string contents;
+    if (!ReadFile(path + "/cpulist", &contents) ||
+        !ParseCpuList(contents, &node.cpus)) {
+      LOG(WARNING) << "Cannot read the cpus of " << path;
+      continue;
+    }
+    node.mem_total_kb = node.mem_free_kb = -1;
+    if (ReadFile(path + "/meminfo", &contents)) {
+      istringstream lines(contents);
+      string line;
+      while (getline(lines, line)) {
+        char name[64];
+        long kb;
+        if (sscanf(line.c_str(), "Node %*d %63[^:]: %ld", name, &kb) != 2) {
+          continue;
+        }
+        if (strcmp(name, "MemTotal") == 0) node.mem_total_kb = kb;
+        if (strcmp(name, "MemFree") == 0) node.mem_free_kb = kb;
+      }
+    }
+    const string huge = path + "/hugepages/hugepages-2048kB/";
+    node.hugepages = ReadLong(huge + "nr_hugepages", -1);
+    node.free_hugepages = ReadLong(huge + "free_hugepages", -1);
+    nodes_.push_back(node);
+  }
+  if (dir) closedir(dir);
+
+  if (nodes_.empty()) {
+    Node node;
+    node.id = 0;
+    string contents;
+    if (!ReadFile(root + "/cpu/online", &contents) ||
+        !ParseCpuList(contents, &node.cpus)) {
+      const long n = sysconf(_SC_NPROCESSORS_ONLN);
+      for (long cpu = 0; cpu < n; ++cpu) node.cpus.push_back(cpu);
+    }
+    node.mem_total_kb = node.mem_free_kb = -1;
+    node.hugepages = node.free_hugepages = -1;
+    nodes_.push_back(node);
+  }
+  for (size_t i = 1; i < nodes_.size(); ++i) {
+    for (size_t j = i; j > 0 && nodes_[j].id < nodes_[j - 1].id; --j) {
+      swap(nodes_[j], nodes_[j - 1]);
+    }
+  }
+}
+
+int Topology::Find(int node) const
+{
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    if (nodes_[i].id == node) return i;
+  }
+  return -1;
+}
+
+int Topology::NodeOfCpu(int cpu) const
+{
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    const vector<int>& cpus = nodes_[i].cpus;
+    if (binary_search(cpus.begin(), cpus.end(), cpu)) return nodes_[i].id;
+  }
+  return -1;
+}
+
+string Topology::Report() const
+{
+  ostringstream report;
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    const Node& node = nodes_[i];
+    report << "node " << node.id << ": cpus " << FormatCpuList(node.cpus);
+    if (node.mem_total_kb >= 0) {
+      report << ", " << node.mem_total_kb / 1024 << " MB";
+      if (node.mem_free_kb >= 0) {
+        report << " (" << node.mem_free_kb / 1024 << " free)";
+      }
+    }
+    if (node.hugepages >= 0) {
+      report << ", 2MB hugepages " << node.free_hugepages << " free of "
+             << node.hugepages;
+    }
+    report << "\n";
+  }
+  return report.str();
+}
+
+bool BindThread(const Topology& topology, int node)
+{
+  const int index = topology.Find(node);
+  if (index < 0) return false;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  const vector<int>& cpus = topology.cpus(index);
+  for (size_t i = 0; i < cpus.size(); ++i) {
+    if (cpus[i] < CPU_SETSIZE) CPU_SET(cpus[i], &set);
+  }
+  const int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (error) {
+    LOG(WARNING) << "Cannot bind to node " << node << ": "
+                 << strerror(error);
+    return false;
+  }
+  VLOG(VLOG_LEVEL) << "Bound to node " << node << ", cpus "
+                   << FormatCpuList(cpus);
+  return true;
+}
+
+ScopedBinding::ScopedBinding(const Topology& topology, int node)
+    : bound_(false)
+{
+  if (pthread_getaffinity_np(pthread_self(), sizeof(saved_), &saved_) == 0) {
+    bound_ = BindThread(topology, node);
+  }
+}
+
+ScopedBinding::~ScopedBinding()
+{
+  if (bound_) pthread_setaffinity_np(pthread_self(), sizeof(saved_), &saved_);
+}
+
+int CurrentNode(const Topology& topology)
+{
+  const int cpu = sched_getcpu();
+  return cpu < 0 ? -1 : topology.NodeOfCpu(cpu);
+}
+
+bool BindMemory(void* memory, size_t size, int node)
+{
+#ifdef SYS_mbind
+  if (node < 0 || node >= MAX_NODES - 1) return false;
+  const size_t bits = 8 * sizeof(unsigned long);
+  unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long))];
+  memset(mask, 0, sizeof(mask));
+  mask[node / bits] |= 1UL << (node % bits);
+  if (syscall(SYS_mbind, memory, size, MPOL_PREFERRED, mask,
+              static_cast<unsigned long>(MAX_NODES), 0) == 0) {
+    return true;
+  }
+  PLOG(WARNING) << "Cannot bind " << size << " bytes to node " << node;
+#endif
+  return false;
+}
+
+int NodeOfAddress(const void* address)
+{
+#ifdef SYS_move_pages
+  const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  void* page = reinterpret_cast<void*>(
+      reinterpret_cast<uintptr_t>(address) & ~(page_size - 1));
+  int status = -1;
+  // Without target nodes it only tells where the page is.
+  if (syscall(SYS_move_pages, 0, 1UL, &page, NULL, &status, 0) == 0 &&
+      status >= 0) {
+    return status;
+  }
+#endif
+  return -1;
+}
+
+NodeMemory::NodeMemory(size_t size, int node, bool huge)
+    : size_(0)
+    , node_(node)
+    , huge_(false)
+    , memory_(NULL)
+{
+  CHECK(size > 0);
+#ifdef MAP_HUGETLB
+  if (huge) {
+    const size_t rounded = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    // Fails, rather than faulting later, if the pool is short.
+    void* memory = mmap(NULL, rounded, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (memory != MAP_FAILED) {
+      memory_ = memory;
+      size_ = rounded;
+      huge_ = true;
+    } else {
+      VLOG(VLOG_LEVEL) << "No " << rounded << " bytes of hugepages; "
+                       << "using normal pages.";
+    }
+  }
+#endif
+  if (!memory_) {
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    size_ = (size + page_size - 1) / page_size * page_size;
+    memory_ = mmap(NULL, size_, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory_ == MAP_FAILED) PLOG(FATAL) << "Cannot map " << size_;
+#ifdef MADV_HUGEPAGE
+    if (huge) madvise(memory_, size_, MADV_HUGEPAGE);
+#endif
+  }
+  if (node >= 0) BindMemory(memory_, size_, node);
+  // Fault the pages in now, under the policy, not on the first tick.
+  memset(memory_, 0, size_);
+}
+
+NodeMemory::~NodeMemory()
+{
+  munmap(memory_, size_);
+}
+
+} // namespace numa
+} // namespace ib
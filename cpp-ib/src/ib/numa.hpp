@@ -0,0 +1,129 @@
+#ifndef IB_NUMA_H_
+#define IB_NUMA_H_
+
+// Placement of threads and memory on the nodes of a NUMA box, so the
+// feed thread, the receivers it calls and the state they write stay
+// on one socket instead of pulling cache lines across the
+// interconnect on every tick.
+//
+// The topology is read from sysfs and memory is bound with the mbind
+// and move_pages system calls, so there is no dependency on libnuma.
+// On a box without NUMA everything is one node and binding is a
+// no-op.
+//
+// A thread created by a bound thread inherits its cpus, so a session
+// binds the thread that starts it and its threads follow; memory is
+// placed by the first touch of a bound thread, or explicitly with
+// NodeMemory for state allocated before the threads exist.
+
+#include <sched.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+
+namespace ib {
+namespace numa {
+
+class Topology
+{
+ public:
+  // Reads <root>/node/node<n>/cpulist and meminfo, and the free and
+  // total 2MB hugepages of each node.  Without node directories the
+  // online cpus, <root>/cpu/online, are one node.
+  explicit Topology(const std::string& root = "/sys/devices/system");
+
+  size_t nodes() const { return nodes_.size(); }
+
+  // Node numbers as the kernel has them; not always dense.
+  int id(size_t index) const { return nodes_[index].id; }
+  const std::vector<int>& cpus(size_t index) const
+  {
+    return nodes_[index].cpus;
+  }
+
+  // Index of the node of the id, or -1.
+  int Find(int node) const;
+
+  // Node of the cpu, or -1.
+  int NodeOfCpu(int cpu) const;
+
+  // One line per node: cpus, memory and hugepages.
+  std::string Report() const;
+
+  // Parses a cpulist, e.g. "0-3,8-11".  Returns false if malformed.
+  static bool ParseCpuList(const std::string& list, std::vector<int>* cpus);
+
+ private:
+  struct Node
+  {
+    int id;
+    std::vector<int> cpus;
+    long mem_total_kb;
+    long mem_free_kb;
+    long hugepages;       // 2MB, or -1 if unknown.
+    long free_hugepages;
+  };
+
+  std::vector<Node> nodes_;
+};
+
+// Binds the calling thread, and the threads it creates from then on,
+// to the cpus of the node.  Returns false if the node is unknown or
+// the kernel refuses.
+bool BindThread(const Topology& topology, int node);
+
+// Binds the calling thread to the node while in scope, so the threads
+// it starts meanwhile run there, and then gives it back its cpus.
+class ScopedBinding : NoCopyAndAssign
+{
+ public:
+  ScopedBinding(const Topology& topology, int node);
+  ~ScopedBinding();
+
+  bool bound() const { return bound_; }
+
+ private:
+  cpu_set_t saved_;
+  bool bound_;
+};
+
+// Node of the cpu the calling thread runs on, or -1.
+int CurrentNode(const Topology& topology);
+
+// Prefers the node for the pages of [memory, memory + size) not
+// touched yet.  The range must be page aligned.
+bool BindMemory(void* memory, size_t size, int node);
+
+// Node of the page of the address, or -1 if not known (never touched,
+// or the kernel does not tell).
+int NodeOfAddress(const void* address);
+
+// Anonymous memory on a node, zeroed and faulted in.  With huge, 2MB
+// pages from the pool if it has enough free, otherwise normal pages
+// advised for transparent hugepages.
+class NodeMemory : NoCopyAndAssign
+{
+ public:
+  NodeMemory(size_t size, int node, bool huge);
+  ~NodeMemory();
+
+  void* data() const { return memory_; }
+  size_t size() const { return size_; }
+  int node() const { return node_; }
+
+  // True if the pages came from the hugepage pool.
+  bool huge() const { return huge_; }
+
+ private:
+  size_t size_;       // Mapped, rounded up to the page size.
+  int node_;
+  bool huge_;
+  void* memory_;
+};
+
+} // namespace numa
+} // namespace ib
+
+#endif // IB_NUMA_H_
@@ -0,0 +1,470 @@
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+#include <glog/logging.h>
+
+#include <Shared/Contract.h>
+#include <Shared/Execution.h>
+#include <Shared/Order.h>
+#include <Shared/ScannerSubscription.h>
+
+#include "utils.hpp"
+#include "ib/outbound_scheduler.hpp"
+
+using namespace std;
+using lab616::utils::now_micros;
+
+namespace ib {
+
+static const char* LANE_NAMES[] = { "orders", "market data", "reference" };
+
+static inline int64_t RequestKey(int kind, int64_t id)
+{
+  return (static_cast<int64_t>(kind) << 48) | (id & ((1LL << 48) - 1));
+}
+
+OutboundScheduler::OutboundScheduler(double rate, int burst)
+    : rate_(rate / 1e6)
+    , burst_(max(burst, 1))
+    , tokens_(burst_)
+    , refilled_at_(now_micros())
+    , stop_(false)
+    , client_(NULL)
+{
+  CHECK(rate > 0);
+  memset(stats_, 0, sizeof(stats_));
+}
+
+OutboundScheduler::~OutboundScheduler()
+{
+  Stop();
+}
+
+void OutboundScheduler::SetClient(EClient* client)
+{
+  {
+    boost::mutex::scoped_lock send_lock(send_mutex_);
+    client_ = client;
+  }
+  boost::mutex::scoped_lock lock(mutex_);
+  queued_.notify_all();
+}
+
+void OutboundScheduler::OnDisconnect()
+{
+  // Only mutex_: Dispatch holds send_mutex_ while it sends, and a send
+  // that fails disconnects from within.
+  boost::mutex::scoped_lock lock(mutex_);
+  for (int lane = MARKET_DATA; lane < NUM_LANES; ++lane) {
+    stats_[lane].dropped += lanes_[lane].size();
+    stats_[lane].queued -= lanes_[lane].size();
+    lanes_[lane].clear();
+  }
+}
+
+void OutboundScheduler::Start()
+{
+  CHECK(!thread_);
+  stop_ = false;
+  thread_.reset(new boost::thread(boost::bind(&OutboundScheduler::Run, this)));
+}
+
+void OutboundScheduler::Stop()
+{
+  if (!thread_) return;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stop_ = true;
+    queued_.notify_all();
+  }
+  thread_->join();
+  thread_.reset();
+}
+
+void OutboundScheduler::Run()
+{
+  while (true) {
+    int64_t wait = Dispatch(now_micros());
+    boost::mutex::scoped_lock lock(mutex_);
+    if (stop_) break;
+    if (wait < 0) {
+      bool empty = true;
+      for (int i = 0; i < NUM_LANES; ++i) empty = empty && lanes_[i].empty();
+      // Queued but no client: look again once in a while.
+      if (!empty) wait = 100000;
+    }
+    if (wait < 0) {
+      queued_.wait(lock);
+    } else {
+      queued_.timed_wait(lock, boost::posix_time::microseconds(wait));
+    }
+  }
+}
+
+int64_t OutboundScheduler::Dispatch(int64_t now)
+{
+  // Lock order: send_mutex_, then mutex_.
+  boost::mutex::scoped_lock send_lock(send_mutex_);
+  if (client_ == NULL) return -1;
+
+  while (true) {
+    Request request;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (now > refilled_at_) {
+        tokens_ = min(burst_, tokens_ + (now - refilled_at_) * rate_);
+        refilled_at_ = now;
+      }
+      int lane = 0;
+      while (lane < NUM_LANES && lanes_[lane].empty()) ++lane;
+      if (lane == NUM_LANES) return -1;
+      if (tokens_ < 1) {
+        return static_cast<int64_t>(ceil((1 - tokens_) / rate_));
+      }
+      tokens_ -= 1;
+      request = lanes_[lane].front();
+      lanes_[lane].pop_front();
+
+      LaneStats& stats = stats_[lane];
+      int64_t delay = max(now - request.queued_at, static_cast<int64_t>(0));
+      stats.sent++;
+      stats.queued--;
+      stats.delay_micros += delay;
+      stats.max_delay_micros = max(stats.max_delay_micros, delay);
+    }
+    request.call(client_);
+  }
+}
+
+void OutboundScheduler::Submit(Lane lane, const Call& call, Kind kind,
+                               int64_t id)
+{
+  Request request;
+  request.call = call;
+  request.key = kind == NONE ? 0 : RequestKey(kind, id);
+  request.queued_at = now_micros();
+
+  boost::mutex::scoped_lock lock(mutex_);
+  lanes_[lane].push_back(request);
+  stats_[lane].submitted++;
+  stats_[lane].queued++;
+  queued_.notify_all();
+}
+
+bool OutboundScheduler::DropQueued(Lane lane, Kind kind, int64_t id)
+{
+  const int64_t key = RequestKey(kind, id);
+  boost::mutex::scoped_lock lock(mutex_);
+  deque<Request>& queue = lanes_[lane];
+  // The latest request of the id; older ones were canceled already.
+  for (deque<Request>::iterator i = queue.end(); i != queue.begin(); ) {
+    if ((--i)->key == key) {
+      queue.erase(i);
+      stats_[lane].dropped++;
+      stats_[lane].queued--;
+      return true;
+    }
+  }
+  return false;
+}
+
+OutboundScheduler::LaneStats OutboundScheduler::GetStats(Lane lane) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return stats_[lane];
+}
+
+void OutboundScheduler::LogStats() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  for (int i = 0; i < NUM_LANES; ++i) {
+    const LaneStats& s = stats_[i];
+    LOG(INFO) << "Lane " << LANE_NAMES[i] << ": "
+              << s.sent << " sent, " << s.dropped << " dropped, "
+              << s.queued << " queued, delay "
+              << (s.sent ? s.delay_micros / (int64_t)s.sent : 0)
+              << " us mean, " << s.max_delay_micros << " us max";
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Connection calls go straight to the client.
+
+bool OutboundScheduler::eConnect(const char* host, unsigned int port,
+                                 int clientId)
+{
+  boost::mutex::scoped_lock send_lock(send_mutex_);
+  return client_ && client_->eConnect(host, port, clientId);
+}
+
+void OutboundScheduler::eDisconnect()
+{
+  boost::mutex::scoped_lock send_lock(send_mutex_);
+  if (client_) client_->eDisconnect();
+}
+
+int OutboundScheduler::serverVersion()
+{
+  boost::mutex::scoped_lock send_lock(send_mutex_);
+  return client_ ? client_->serverVersion() : 0;
+}
+
+IBString OutboundScheduler::TwsConnectionTime()
+{
+  boost::mutex::scoped_lock send_lock(send_mutex_);
+  return client_ ? client_->TwsConnectionTime() : IBString();
+}
+
+bool OutboundScheduler::checkMessages()
+{
+  boost::mutex::scoped_lock send_lock(send_mutex_);
+  return client_ && client_->checkMessages();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Orders and control.
+
+void OutboundScheduler::placeOrder(OrderId id, const Contract& contract,
+                                   const Order& order)
+{
+  Submit(ORDERS, boost::bind(&EClient::placeOrder, _1, id, contract, order),
+         ORDER, id);
+}
+
+void OutboundScheduler::cancelOrder(OrderId id)
+{
+  DropQueued(ORDERS, ORDER, id);
+  Submit(ORDERS, boost::bind(&EClient::cancelOrder, _1, id));
+}
+
+void OutboundScheduler::reqOpenOrders()
+{
+  Submit(ORDERS, boost::bind(&EClient::reqOpenOrders, _1));
+}
+
+void OutboundScheduler::reqAccountUpdates(bool subscribe,
+                                          const IBString& acctCode)
+{
+  Submit(ORDERS, boost::bind(&EClient::reqAccountUpdates, _1, subscribe,
+                             acctCode));
+}
+
+void OutboundScheduler::reqExecutions(int reqId, const ExecutionFilter& filter)
+{
+  Submit(ORDERS, boost::bind(&EClient::reqExecutions, _1, reqId, filter));
+}
+
+void OutboundScheduler::reqIds(int numIds)
+{
+  Submit(ORDERS, boost::bind(&EClient::reqIds, _1, numIds));
+}
+
+void OutboundScheduler::setServerLogLevel(int level)
+{
+  Submit(ORDERS, boost::bind(&EClient::setServerLogLevel, _1, level));
+}
+
+void OutboundScheduler::reqAutoOpenOrders(bool bAutoBind)
+{
+  Submit(ORDERS, boost::bind(&EClient::reqAutoOpenOrders, _1, bAutoBind));
+}
+
+void OutboundScheduler::reqAllOpenOrders()
+{
+  Submit(ORDERS, boost::bind(&EClient::reqAllOpenOrders, _1));
+}
+
+void OutboundScheduler::reqManagedAccts()
+{
+  Submit(ORDERS, boost::bind(&EClient::reqManagedAccts, _1));
+}
+
+void OutboundScheduler::requestFA(faDataType pFaDataType)
+{
+  Submit(ORDERS, boost::bind(&EClient::requestFA, _1, pFaDataType));
+}
+
+void OutboundScheduler::replaceFA(faDataType pFaDataType,
+                                  const IBString& cxml)
+{
+  Submit(ORDERS, boost::bind(&EClient::replaceFA, _1, pFaDataType, cxml));
+}
+
+void OutboundScheduler::exerciseOptions(TickerId id, const Contract& contract,
+                                        int exerciseAction,
+                                        int exerciseQuantity,
+                                        const IBString& account, int override)
+{
+  Submit(ORDERS, boost::bind(&EClient::exerciseOptions, _1, id, contract,
+                             exerciseAction, exerciseQuantity, account,
+                             override));
+}
+
+void OutboundScheduler::reqCurrentTime()
+{
+  Submit(ORDERS, boost::bind(&EClient::reqCurrentTime, _1));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Market data.
+
+void OutboundScheduler::reqMktData(TickerId id, const Contract& contract,
+                                   const IBString& genericTicks, bool snapshot)
+{
+  Submit(MARKET_DATA, boost::bind(&EClient::reqMktData, _1, id, contract,
+                                  genericTicks, snapshot),
+         MKT_DATA, id);
+}
+
+void OutboundScheduler::cancelMktData(TickerId id)
+{
+  if (DropQueued(MARKET_DATA, MKT_DATA, id)) return;
+  Submit(MARKET_DATA, boost::bind(&EClient::cancelMktData, _1, id));
+}
+
+void OutboundScheduler::reqMktDepth(TickerId id, const Contract& contract,
+                                    int numRows)
+{
+  Submit(MARKET_DATA, boost::bind(&EClient::reqMktDepth, _1, id, contract,
+                                  numRows),
+         MKT_DEPTH, id);
+}
+
+void OutboundScheduler::cancelMktDepth(TickerId id)
+{
+  if (DropQueued(MARKET_DATA, MKT_DEPTH, id)) return;
+  Submit(MARKET_DATA, boost::bind(&EClient::cancelMktDepth, _1, id));
+}
+
+void OutboundScheduler::reqNewsBulletins(bool allMsgs)
+{
+  Submit(MARKET_DATA, boost::bind(&EClient::reqNewsBulletins, _1, allMsgs));
+}
+
+void OutboundScheduler::cancelNewsBulletins()
+{
+  Submit(MARKET_DATA, boost::bind(&EClient::cancelNewsBulletins, _1));
+}
+
+void OutboundScheduler::reqRealTimeBars(TickerId id, const Contract& contract,
+                                        int barSize,
+                                        const IBString& whatToShow,
+                                        bool useRTH)
+{
+  Submit(MARKET_DATA, boost::bind(&EClient::reqRealTimeBars, _1, id, contract,
+                                  barSize, whatToShow, useRTH),
+         REAL_TIME_BARS, id);
+}
+
+void OutboundScheduler::cancelRealTimeBars(TickerId tickerId)
+{
+  if (DropQueued(MARKET_DATA, REAL_TIME_BARS, tickerId)) return;
+  Submit(MARKET_DATA, boost::bind(&EClient::cancelRealTimeBars, _1,
+                                  tickerId));
+}
+
+void OutboundScheduler::reqScannerSubscription(
+    int tickerId, const ScannerSubscription& subscription)
+{
+  Submit(MARKET_DATA, boost::bind(&EClient::reqScannerSubscription, _1,
+                                  tickerId, subscription),
+         SCANNER, tickerId);
+}
+
+void OutboundScheduler::cancelScannerSubscription(int tickerId)
+{
+  if (DropQueued(MARKET_DATA, SCANNER, tickerId)) return;
+  Submit(MARKET_DATA, boost::bind(&EClient::cancelScannerSubscription, _1,
+                                  tickerId));
+}
+
+void OutboundScheduler::calculateImpliedVolatility(TickerId reqId,
+                                                   const Contract& contract,
+                                                   double optionPrice,
+                                                   double underPrice)
+{
+  Submit(MARKET_DATA, boost::bind(&EClient::calculateImpliedVolatility, _1,
+                                  reqId, contract, optionPrice, underPrice),
+         IMPLIED_VOLATILITY, reqId);
+}
+
+void OutboundScheduler::cancelCalculateImpliedVolatility(TickerId reqId)
+{
+  if (DropQueued(MARKET_DATA, IMPLIED_VOLATILITY, reqId)) return;
+  Submit(MARKET_DATA, boost::bind(&EClient::cancelCalculateImpliedVolatility,
+                                  _1, reqId));
+}
+
+void OutboundScheduler::calculateOptionPrice(TickerId reqId,
+                                             const Contract& contract,
+                                             double volatility,
+                                             double underPrice)
+{
+  Submit(MARKET_DATA, boost::bind(&EClient::calculateOptionPrice, _1,
+                                  reqId, contract, volatility, underPrice),
+         OPTION_PRICE, reqId);
+}
+
+void OutboundScheduler::cancelCalculateOptionPrice(TickerId reqId)
+{
+  if (DropQueued(MARKET_DATA, OPTION_PRICE, reqId)) return;
+  Submit(MARKET_DATA, boost::bind(&EClient::cancelCalculateOptionPrice, _1,
+                                  reqId));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Reference data.
+
+void OutboundScheduler::reqContractDetails(int reqId, const Contract& contract)
+{
+  Submit(REFERENCE, boost::bind(&EClient::reqContractDetails, _1, reqId,
+                                contract));
+}
+
+void OutboundScheduler::reqHistoricalData(TickerId id,
+                                          const Contract& contract,
+                                          const IBString& endDateTime,
+                                          const IBString& durationStr,
+                                          const IBString& barSizeSetting,
+                                          const IBString& whatToShow,
+                                          int useRTH, int formatDate)
+{
+  Submit(REFERENCE, boost::bind(&EClient::reqHistoricalData, _1, id,
+                                contract, endDateTime, durationStr,
+                                barSizeSetting, whatToShow, useRTH,
+                                formatDate),
+         HISTORICAL, id);
+}
+
+void OutboundScheduler::cancelHistoricalData(TickerId tickerId)
+{
+  if (DropQueued(REFERENCE, HISTORICAL, tickerId)) return;
+  Submit(REFERENCE, boost::bind(&EClient::cancelHistoricalData, _1,
+                                tickerId));
+}
+
+void OutboundScheduler::reqScannerParameters()
+{
+  Submit(REFERENCE, boost::bind(&EClient::reqScannerParameters, _1));
+}
+
+void OutboundScheduler::reqFundamentalData(TickerId reqId,
+                                           const Contract& contract,
+                                           const IBString& reportType)
+{
+  Submit(REFERENCE, boost::bind(&EClient::reqFundamentalData, _1, reqId,
+                                contract, reportType),
+         FUNDAMENTAL, reqId);
+}
+
+void OutboundScheduler::cancelFundamentalData(TickerId reqId)
+{
+  if (DropQueued(REFERENCE, FUNDAMENTAL, reqId)) return;
+  Submit(REFERENCE, boost::bind(&EClient::cancelFundamentalData, _1, reqId));
+}
+
+} // namespace ib
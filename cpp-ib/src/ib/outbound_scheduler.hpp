@@ -0,0 +1,179 @@
+#ifndef IB_OUTBOUND_SCHEDULER_H_
+#define IB_OUTBOUND_SCHEDULER_H_
+
+// Priority lanes in front of the EClient, within the TWS limit on
+// messages per second.
+//
+// The scheduler is an EClient itself: requests made on it are queued
+// as calls and made on the real client when a token bucket allows,
+// the highest lane first:
+//
+//   ORDERS       orders, cancels, executions, account and other
+//                small control requests,
+//   MARKET_DATA  subscriptions to market data, depth, bars and scans,
+//   REFERENCE    contract details, history and fundamentals.
+//
+// So a cancelOrder does not wait behind a resubscription of hundreds
+// of symbols.  Requests are encoded by the real client only when they
+// are sent, and a cancel that finds its request still queued (e.g.
+// cancelMktData of a reqMktData) drops both.  cancelOrder always goes
+// out, but drops a placeOrder of the order that is still queued.
+//
+// Requests come from any thread and are sent from the scheduler's
+// own thread.  Connection calls go straight to the client.  On a
+// disconnect the market data and reference requests still queued are
+// dropped, since their owners request them again on the next
+// connection; orders and control requests stay queued for it.
+
+#include <stdint.h>
+#include <deque>
+
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <Shared/EClient.h>
+
+#include "common.hpp"
+
+namespace ib {
+
+class OutboundScheduler : public EClient, NoCopyAndAssign
+{
+ public:
+  enum Lane { ORDERS = 0, MARKET_DATA, REFERENCE, NUM_LANES };
+
+  struct LaneStats
+  {
+    uint64_t submitted;
+    uint64_t sent;
+    uint64_t dropped;         // Canceled or disconnected while queued.
+    uint64_t queued;          // Waiting now.
+    int64_t delay_micros;     // Over the sent, time queued.
+    int64_t max_delay_micros;
+  };
+
+  // Sends at most rate messages a second, in bursts of at most burst.
+  OutboundScheduler(double rate, int burst);
+  ~OutboundScheduler();
+
+  // The client requests are made on, or NULL to hold them.  Waits for
+  // a request being sent to the previous client.
+  void SetClient(EClient* client);
+
+  // Drops the queued MARKET_DATA and REFERENCE requests, counted as
+  // dropped.  Does not wait for a request being sent, so may be called
+  // from the client's error callback while it sends.
+  void OnDisconnect();
+
+  // Starts and stops the thread that sends.
+  void Start();
+  void Stop();
+
+  // Sends what the bucket allows at now, in micros.  Returns the
+  // micros until the next request can go, or -1 if none is queued.
+  int64_t Dispatch(int64_t now);
+
+  LaneStats GetStats(Lane lane) const;
+
+  // One line per lane: sent, dropped, mean and max queueing delay.
+  void LogStats() const;
+
+  // EClient
+  bool eConnect(const char* host, unsigned int port, int clientId = 0);
+  void eDisconnect();
+  int serverVersion();
+  IBString TwsConnectionTime();
+  void reqMktData(TickerId id, const Contract& contract,
+                  const IBString& genericTicks, bool snapshot);
+  void cancelMktData(TickerId id);
+  void placeOrder(OrderId id, const Contract& contract, const Order& order);
+  void cancelOrder(OrderId id);
+  void reqOpenOrders();
+  void reqAccountUpdates(bool subscribe, const IBString& acctCode);
+  void reqExecutions(int reqId, const ExecutionFilter& filter);
+  void reqIds(int numIds);
+  bool checkMessages();
+  void reqContractDetails(int reqId, const Contract& contract);
+  void reqMktDepth(TickerId id, const Contract& contract, int numRows);
+  void cancelMktDepth(TickerId id);
+  void reqNewsBulletins(bool allMsgs);
+  void cancelNewsBulletins();
+  void setServerLogLevel(int level);
+  void reqAutoOpenOrders(bool bAutoBind);
+  void reqAllOpenOrders();
+  void reqManagedAccts();
+  void requestFA(faDataType pFaDataType);
+  void replaceFA(faDataType pFaDataType, const IBString& cxml);
+  void reqHistoricalData(TickerId id, const Contract& contract,
+                         const IBString& endDateTime,
+                         const IBString& durationStr,
+                         const IBString& barSizeSetting,
+                         const IBString& whatToShow,
+                         int useRTH, int formatDate);
+  void exerciseOptions(TickerId id, const Contract& contract,
+                       int exerciseAction, int exerciseQuantity,
+                       const IBString& account, int override);
+  void cancelHistoricalData(TickerId tickerId);
+  void reqRealTimeBars(TickerId id, const Contract& contract, int barSize,
+                       const IBString& whatToShow, bool useRTH);
+  void cancelRealTimeBars(TickerId tickerId);
+  void cancelScannerSubscription(int tickerId);
+  void reqScannerParameters();
+  void reqScannerSubscription(int tickerId,
+                              const ScannerSubscription& subscription);
+  void reqCurrentTime();
+  void reqFundamentalData(TickerId reqId, const Contract& contract,
+                          const IBString& reportType);
+  void cancelFundamentalData(TickerId reqId);
+  void calculateImpliedVolatility(TickerId reqId, const Contract& contract,
+                                  double optionPrice, double underPrice);
+  void calculateOptionPrice(TickerId reqId, const Contract& contract,
+                            double volatility, double underPrice);
+  void cancelCalculateImpliedVolatility(TickerId reqId);
+  void cancelCalculateOptionPrice(TickerId reqId);
+
+ private:
+  typedef boost::function<void (EClient*)> Call;
+
+  // Request kinds, for matching a cancel to its request.
+  enum Kind {
+    NONE = 0, MKT_DATA, MKT_DEPTH, ORDER, HISTORICAL, REAL_TIME_BARS,
+    SCANNER, FUNDAMENTAL, IMPLIED_VOLATILITY, OPTION_PRICE
+  };
+
+  struct Request
+  {
+    Call call;
+    int64_t key;        // Kind and id, or 0.
+    int64_t queued_at;
+  };
+
+  void Submit(Lane lane, const Call& call, Kind kind = NONE, int64_t id = 0);
+
+  // Drops the queued request of the kind and id.  Returns true if
+  // there was one.
+  bool DropQueued(Lane lane, Kind kind, int64_t id);
+
+  void Run();
+
+  const double rate_;   // Tokens per micro.
+  const double burst_;
+
+  mutable boost::mutex mutex_;  // Lanes, bucket and stats.
+  boost::condition_variable queued_;
+  std::deque<Request> lanes_[NUM_LANES];
+  LaneStats stats_[NUM_LANES];
+  double tokens_;
+  int64_t refilled_at_;
+  volatile bool stop_;
+
+  boost::mutex send_mutex_;  // Held while a request is made.
+  EClient* client_;
+
+  boost::scoped_ptr<boost::thread> thread_;
+};
+
+} // namespace ib
+
+#endif // IB_OUTBOUND_SCHEDULER_H_
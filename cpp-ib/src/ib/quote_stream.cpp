@@ -0,0 +1,310 @@
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+
+#include "utils.hpp"
+#include "ib/backplane.hpp"
+#include "ib/quote_stream.hpp"
+
+using namespace std;
+
+namespace ib {
+namespace websocket {
+
+namespace {
+
+const char kGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+inline uint32_t Rotate(uint32_t x, int n)
+{
+  return (x << n) | (x >> (32 - n));
+}
+
+// SHA-1 (FIPS 180-1), only for the handshake.
+void Sha1(const string& in, unsigned char digest[20])
+{
+  uint32_t h[5] = {
+    0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+  };
+  string message(in);
+  message.push_back('\x80');
+  while (message.size() % 64 != 56) message.push_back('\0');
+  const uint64_t bits = static_cast<uint64_t>(in.size()) * 8;
+  for (int i = 7; i >= 0; --i) {
+    message.push_back(static_cast<char>(bits >> (i * 8)));
+  }
+
+  for (size_t block = 0; block < message.size(); block += 64) {
+    const unsigned char* p =
+        reinterpret_cast<const unsigned char*>(message.data() + block);
+    uint32_t w[80];
+    for (int i = 0; i < 16; ++i) {
+      w[i] = (p[4 * i] << 24) | (p[4 * i + 1] << 16) |
+          (p[4 * i + 2] << 8) | p[4 * i + 3];
+    }
+    for (int i = 16; i < 80; ++i) {
+      w[i] = Rotate(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; ++i) {
+      uint32_t f, k;
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+      uint32_t t = Rotate(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = Rotate(b, 30);
+      b = a;
+      a = t;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+  }
+  for (int i = 0; i < 20; ++i) {
+    digest[i] = static_cast<unsigned char>(h[i / 4] >> (24 - 8 * (i % 4)));
+  }
+}
+
+string Base64(const unsigned char* in, size_t size)
+{
+  static const char kDigits[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  string out;
+  for (size_t i = 0; i < size; i += 3) {
+    uint32_t v = in[i] << 16;
+    if (i + 1 < size) v |= in[i + 1] << 8;
+    if (i + 2 < size) v |= in[i + 2];
+    out.push_back(kDigits[(v >> 18) & 63]);
+    out.push_back(kDigits[(v >> 12) & 63]);
+    out.push_back(i + 1 < size ? kDigits[(v >> 6) & 63] : '=');
+    out.push_back(i + 2 < size ? kDigits[v & 63] : '=');
+  }
+  return out;
+}
+
+} // namespace
+
+string AcceptKey(const string& key)
+{
+  unsigned char digest[20];
+  Sha1(key + kGuid, digest);
+  return Base64(digest, sizeof(digest));
+}
+
+string HandshakeResponse(const string& key)
+{
+  return "HTTP/1.1 101 Switching Protocols\r\n"
+      "Upgrade: websocket\r\n"
+      "Connection: Upgrade\r\n"
+      "Sec-WebSocket-Accept: " + AcceptKey(key) + "\r\n\r\n";
+}
+
+bool ParseUpgrade(const string& request, string* target, string* key)
+{
+  if (request.compare(0, 4, "GET ") != 0) return false;
+  const size_t end = request.find(' ', 4);
+  if (end == string::npos) return false;
+  target->assign(request, 4, end - 4);
+  static const char kKey[] = "\r\nSec-WebSocket-Key:";
+  const size_t size = sizeof(kKey) - 1;
+  for (size_t at = request.find("\r\n"); at != string::npos;
+       at = request.find("\r\n", at + 2)) {
+    if (strncasecmp(request.c_str() + at, kKey, size) != 0) continue;
+    size_t begin = at + size;
+    while (begin < request.size() && request[begin] == ' ') begin++;
+    const size_t line_end = request.find("\r\n", begin);
+    if (line_end == string::npos || line_end == begin) return false;
+    key->assign(request, begin, line_end - begin);
+    return true;
+  }
+  return false;
+}
+
+void TextFrame(const string& payload, string* frame)
+{
+  const uint64_t size = payload.size();
+  frame->push_back('\x81');  // FIN, text.
+  if (size < 126) {
+    frame->push_back(static_cast<char>(size));
+  } else if (size < 65536) {
+    frame->push_back(126);
+    frame->push_back(static_cast<char>(size >> 8));
+    frame->push_back(static_cast<char>(size));
+  } else {
+    frame->push_back(127);
+    for (int i = 7; i >= 0; --i) {
+      frame->push_back(static_cast<char>(size >> (i * 8)));
+    }
+  }
+  frame->append(payload);
+}
+
+} // namespace websocket
+
+ConflatedQuotes::ConflatedQuotes(const QuoteTable* table)
+    : table_(table)
+{
+}
+
+void ConflatedQuotes::Subscribe(const string& symbol)
+{
+  const int id = signal::GetTickerId(symbol);
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    if (slots_[i].id == id) return;
+  }
+  Slot slot = { symbol, id, -1, 0 };
+  slots_.push_back(slot);
+}
+
+size_t ConflatedQuotes::Delta(string* out)
+{
+  size_t n = 0;
+  char buffer[256];
+  out->push_back('[');
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    Slot& slot = slots_[i];
+    if (slot.table_slot < 0) {
+      slot.table_slot = table_->Find(slot.id);
+      if (slot.table_slot < 0) continue;
+    }
+    // Most slots have not changed; only those are copied.
+    if (table_->version(slot.table_slot) == slot.version) continue;
+    Quote quote;
+    slot.version = table_->Read(slot.table_slot, &quote);
+    snprintf(buffer, sizeof(buffer),
+             "%s{\"s\":\"%s\",\"b\":%.10g,\"bs\":%d,\"a\":%.10g,\"as\":%d,"
+             "\"l\":%.10g,\"ls\":%d,\"t\":%lld}",
+             n ? "," : "", slot.symbol.c_str(), quote.bid, quote.bid_size,
+             quote.ask, quote.ask_size, quote.last, quote.last_size,
+             static_cast<long long>(quote.ts));
+    out->append(buffer);
+    n++;
+  }
+  out->push_back(']');
+  return n;
+}
+
+QuoteSender::QuoteSender(int max_fps)
+    : interval_(1000000 / max_fps)
+    , count_(0)
+    , stop_(false)
+{
+}
+
+QuoteSender::~QuoteSender()
+{
+  Stop();
+  boost::mutex::scoped_lock lock(mutex_);
+  clients_.insert(clients_.end(), added_.begin(), added_.end());
+  for (size_t i = 0; i < clients_.size(); ++i) {
+    close(clients_[i]->fd);
+    delete clients_[i];
+  }
+}
+
+void QuoteSender::Add(int fd, ConflatedQuotes* quotes)
+{
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  Client* client = new Client();
+  client->fd = fd;
+  client->quotes.reset(quotes);
+  client->sent = 0;
+  boost::mutex::scoped_lock lock(mutex_);
+  added_.push_back(client);
+  count_++;
+}
+
+void QuoteSender::Start()
+{
+  stop_ = false;
+  thread_.reset(new boost::thread(boost::bind(&QuoteSender::Loop, this)));
+}
+
+void QuoteSender::Stop()
+{
+  if (!thread_) return;
+  stop_ = true;
+  thread_->join();
+  thread_.reset();
+}
+
+size_t QuoteSender::clients() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return count_;
+}
+
+bool QuoteSender::Send(Client* client)
+{
+  // What the client sends, e.g. a close frame, is read and dropped;
+  // a read of 0 is the client gone.
+  char discard[512];
+  ssize_t n;
+  while ((n = recv(client->fd, discard, sizeof(discard), 0)) > 0) {}
+  if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) return false;
+
+  if (client->pending.empty()) {
+    json_.clear();
+    if (!client->quotes->Delta(&json_)) return true;
+    websocket::TextFrame(json_, &client->pending);
+    client->sent = 0;
+  }
+  while (client->sent < client->pending.size()) {
+    n = send(client->fd, client->pending.data() + client->sent,
+             client->pending.size() - client->sent, MSG_NOSIGNAL);
+    if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+    client->sent += n;
+  }
+  client->pending.clear();
+  return true;
+}
+
+void QuoteSender::SendRound()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    clients_.insert(clients_.end(), added_.begin(), added_.end());
+    added_.clear();
+  }
+  size_t kept = 0;
+  for (size_t i = 0; i < clients_.size(); ++i) {
+    if (Send(clients_[i])) {
+      clients_[kept++] = clients_[i];
+      continue;
+    }
+    close(clients_[i]->fd);
+    delete clients_[i];
+    boost::mutex::scoped_lock lock(mutex_);
+    count_--;
+  }
+  clients_.resize(kept);
+}
+
+void QuoteSender::Loop()
+{
+  while (!stop_) {
+    const int64_t start = lab616::utils::now_micros();
+    SendRound();
+    const int64_t wait = start + interval_ - lab616::utils::now_micros();
+    if (wait > 0) lab616::utils::sleep_micros(wait);
+  }
+}
+
+} // namespace ib
@@ -0,0 +1,128 @@
+#ifndef IB_QUOTE_STREAM_H_
+#define IB_QUOTE_STREAM_H_
+
+// Conflated streaming of quotes to WebSocket clients, e.g. browsers.
+//
+// The feed only writes a QuoteTable (see quote_table.hpp), without
+// locks and without knowing about clients, so its cost does not grow
+// with them and no client can hold it up.  Each client has its own
+// ConflatedQuotes: a slot per subscribed symbol with the version of
+// the table slot last sent.  One QuoteSender thread serves all the
+// clients: at most max_fps times a second it sends each one frame
+// with the quotes that changed since, each only once however often it
+// changed.  Sockets are written without blocking, so a slow client
+// holds up no other; its next frame then has the latest quotes.
+//
+// The server side of RFC 6455 is here too, as far as needed to send:
+// the handshake and unmasked text frames.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "common.hpp"
+#include "ib/quote_table.hpp"
+
+namespace ib {
+
+namespace websocket {
+
+// Sec-WebSocket-Accept for the client's Sec-WebSocket-Key.
+std::string AcceptKey(const std::string& key);
+
+// The handshake response for the client's key.
+std::string HandshakeResponse(const std::string& key);
+
+// Reads the target, e.g. "/quotes?symbols=IBM", and the key of an
+// upgrade request, headers included.  Returns false if it is not one.
+bool ParseUpgrade(const std::string& request, std::string* target,
+                  std::string* key);
+
+// Appends a final, unmasked text frame of the payload to frame.
+void TextFrame(const std::string& payload, std::string* frame);
+
+} // namespace websocket
+
+class ConflatedQuotes : NoCopyAndAssign
+{
+ public:
+  // The table must outlive this.
+  explicit ConflatedQuotes(const QuoteTable* table);
+
+  void Subscribe(const std::string& symbol);
+
+  size_t size() const { return slots_.size(); }
+
+  // Appends the quotes changed since the last call to out, as a JSON
+  // array of {"s":symbol,"b":bid,"bs":bid size,"a":ask,"as":ask size,
+  // "l":last,"ls":last size,"t":micros}.  Returns how many.
+  size_t Delta(std::string* out);
+
+ private:
+  struct Slot
+  {
+    std::string symbol;
+    int id;
+    int table_slot;     // -1 until the id is in the table.
+    uint64_t version;   // Sent.
+  };
+
+  const QuoteTable* table_;
+  std::vector<Slot> slots_;
+};
+
+// Sends the deltas of many clients from one thread, at most max_fps
+// frames a second to each.  A client is a connected socket past the
+// handshake, written without blocking: one that reads slowly keeps
+// the rest of its frame and gets no new one until that has gone, so
+// it holds up no other and gets the latest quotes when it catches
+// up.  A client whose socket fails or is closed is dropped.
+class QuoteSender : NoCopyAndAssign
+{
+ public:
+  explicit QuoteSender(int max_fps);
+  ~QuoteSender();  // Stops and closes the clients.
+
+  // Takes the socket, which is made non-blocking, and the quotes.
+  // Any thread.
+  void Add(int fd, ConflatedQuotes* quotes);
+
+  void Start();
+  void Stop();
+
+  // One pass over the clients, as the thread does; for tests when
+  // not started.
+  void SendRound();
+
+  size_t clients() const;
+
+ private:
+  struct Client
+  {
+    int fd;
+    boost::scoped_ptr<ConflatedQuotes> quotes;
+    std::string pending;  // Rest of the frame being sent.
+    size_t sent;
+  };
+
+  // False if the client is gone.
+  bool Send(Client* client);
+  void Loop();
+
+  const int64_t interval_;
+  mutable boost::mutex mutex_;  // added_ and count_.
+  std::vector<Client*> added_;  // Taken by the next round.
+  size_t count_;
+  std::vector<Client*> clients_;  // The sending thread's.
+  std::string json_;
+  boost::scoped_ptr<boost::thread> thread_;
+  volatile bool stop_;
+};
+
+} // namespace ib
+
+#endif // IB_QUOTE_STREAM_H_
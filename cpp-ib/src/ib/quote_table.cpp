@@ -0,0 +1,138 @@
+
+#include <string.h>
+#include <glog/logging.h>
+
+#include "ib/quote_table.hpp"
+
+using lab616::lockfree::compiler_barrier;
+using lab616::lockfree::load_acquire;
+using lab616::lockfree::store_release;
+
+namespace ib {
+
+QuoteTable::QuoteTable(size_t capacity)
+    : mask_(capacity - 1)
+    , owned_(NULL)
+{
+  // One extra line so the slots can be aligned.
+  owned_ = new char[MemorySize(capacity) + lab616::lockfree::CACHE_LINE];
+  uintptr_t aligned = reinterpret_cast<uintptr_t>(owned_) +
+      lab616::lockfree::CACHE_LINE - 1;
+  aligned &= ~static_cast<uintptr_t>(lab616::lockfree::CACHE_LINE - 1);
+  Init(reinterpret_cast<char*>(aligned), true);
+}
+
+QuoteTable::QuoteTable(void* memory, size_t capacity, bool init)
+    : mask_(capacity - 1)
+    , owned_(NULL)
+{
+  Init(static_cast<char*>(memory), init);
+}
+
+QuoteTable::~QuoteTable()
+{
+  delete[] owned_;
+}
+
+size_t QuoteTable::MemorySize(size_t capacity)
+{
+  // The hash is kept at most half full.
+  return sizeof(Header) + sizeof(Slot) * capacity +
+      sizeof(int) * capacity * 2 * 2;
+}
+
+void QuoteTable::Init(char* memory, bool init)
+{
+  const size_t capacity = mask_ + 1;
+  CHECK(capacity >= 2 && (capacity & (capacity - 1)) == 0)
+      << "Capacity must be a power of 2: " << capacity;
+  header_ = reinterpret_cast<Header*>(memory);
+  slots_ = reinterpret_cast<Slot*>(memory + sizeof(Header));
+  keys_ = reinterpret_cast<volatile int*>(slots_ + capacity);
+  indexes_ = keys_ + capacity * 2;
+  if (!init) return;
+
+  memset(memory, 0, sizeof(Header) + sizeof(Slot) * capacity);
+  for (size_t i = 0; i < capacity * 2; ++i) {
+    keys_[i] = 0;
+    indexes_[i] = -1;
+  }
+}
+
+static inline size_t Hash(int id)
+{
+  // Ticker ids are symbol codes shifted left; mix the high bits down.
+  uint32_t h = static_cast<uint32_t>(id) * 2654435761U;
+  return h ^ (h >> 16);
+}
+
+int QuoteTable::Find(int id) const
+{
+  const size_t hash_mask = mask_ * 2 + 1;
+  for (size_t i = Hash(id) & hash_mask; ; i = (i + 1) & hash_mask) {
+    int key = load_acquire(keys_[i]);
+    if (key == 0) return -1;
+    if (key == id + 1) return load_acquire(indexes_[i]);
+  }
+}
+
+int QuoteTable::Insert(int id)
+{
+  size_t n = header_->size;
+  if (n > mask_) return -1;
+
+  Slot& slot = slots_[n];
+  slot.quote.id = id;
+
+  const size_t hash_mask = mask_ * 2 + 1;
+  size_t i = Hash(id) & hash_mask;
+  while (keys_[i] != 0) i = (i + 1) & hash_mask;
+  // Publish the index before the key so a reader that finds the key
+  // also sees the index, and the slot before the size.
+  store_release(indexes_[i], static_cast<int>(n));
+  store_release(keys_[i], id + 1);
+  store_release(header_->size, n + 1);
+  return n;
+}
+
+bool QuoteTable::Update(int64_t ts, int id, Field field, double value)
+{
+  int index = Find(id);
+  if (index < 0 && (index = Insert(id)) < 0) {
+    LOG_EVERY_N(WARNING, 1000) << "Quote table full, dropping " << id;
+    return false;
+  }
+  Slot& slot = slots_[index];
+  uint64_t v = slot.version;
+  store_release(slot.version, v + 1);  // Odd: write in progress.
+  compiler_barrier();
+
+  Quote& q = slot.quote;
+  switch (field) {
+    case BID: q.bid = value; break;
+    case BID_SIZE: q.bid_size = static_cast<int>(value); break;
+    case ASK: q.ask = value; break;
+    case ASK_SIZE: q.ask_size = static_cast<int>(value); break;
+    case LAST: q.last = value; break;
+    case LAST_SIZE: q.last_size = static_cast<int>(value); break;
+  }
+  q.ts = ts;
+  q.updates++;
+
+  store_release(slot.version, v + 2);
+  return true;
+}
+
+uint64_t QuoteTable::Read(size_t index, Quote* quote) const
+{
+  const Slot& slot = slots_[index];
+  while (true) {
+    uint64_t v1 = load_acquire(slot.version);
+    if (v1 & 1) continue;  // Writer is in the middle of an update.
+    *quote = slot.quote;
+    compiler_barrier();
+    if (load_acquire(slot.version) == v1) return v1;
+  }
+}
+
+} // namespace ib
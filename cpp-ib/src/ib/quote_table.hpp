@@ -0,0 +1,121 @@
+#ifndef IB_QUOTE_TABLE_H_
+#define IB_QUOTE_TABLE_H_
+
+// Latest bid / ask / last per ticker id, written by the feed thread
+// and read from any number of other threads without locks.
+//
+// Each slot is protected by a sequence lock: the writer makes the
+// slot version odd, updates the fields and makes it even again;
+// readers copy the slot and retry if the version changed under them.
+// The writer never waits for readers, so a slow consumer (a screen,
+// a web socket) costs the feed only the stores of the update itself.
+//
+// Slots are allocated densely in arrival order, so readers can scan
+// [0, size()) and use the version to skip slots that did not change.
+//
+// The table keeps no pointers in its memory, so it can also be placed
+// in memory shared between processes (see shm_bus.hpp).
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "common.hpp"
+#include "lockfree.hpp"
+#include "ib/backplane.hpp"
+
+namespace ib {
+
+struct Quote
+{
+  int id;
+  double bid;
+  double ask;
+  double last;
+  int bid_size;
+  int ask_size;
+  int last_size;
+  int64_t ts;        // Time of the latest update, micros.
+  uint64_t updates;  // Number of updates since the slot was created.
+};
+
+class QuoteTable : public QuoteFields, NoCopyAndAssign
+{
+ public:
+  // Capacity is the max number of ids and must be a power of 2.
+  explicit QuoteTable(size_t capacity = 4096);
+
+  // A table in caller-owned memory of MemorySize(capacity) bytes,
+  // aligned to a cache line.  With init the memory is cleared first;
+  // otherwise the table attaches to what another writer left there.
+  QuoteTable(void* memory, size_t capacity, bool init);
+
+  ~QuoteTable();
+
+  static size_t MemorySize(size_t capacity);
+
+  // Writer side.  There must be only one writer thread.
+  // Returns false if the table is full and the id is new.
+  bool Update(int64_t ts, int id, Field field, double value);
+
+  // Reader side.
+  size_t size() const
+  {
+    return lab616::lockfree::load_acquire(header_->size);
+  }
+  size_t capacity() const { return mask_ + 1; }
+
+  // Slot index for the id, or -1 if not seen yet.
+  int Find(int id) const;
+
+  // Even, and changes on every update of the slot.
+  uint64_t version(size_t slot) const
+  {
+    return lab616::lockfree::load_acquire(slots_[slot].version);
+  }
+
+  // Copies a consistent snapshot of the slot and returns its version.
+  uint64_t Read(size_t slot, Quote* quote) const;
+
+ private:
+  void Init(char* memory, bool init);
+  int Insert(int id);
+
+  struct Header {
+    volatile size_t size;
+    char pad[lab616::lockfree::CACHE_LINE - sizeof(size_t)];
+  };
+
+  struct Slot {
+    volatile uint64_t version;
+    Quote quote;
+    char pad[lab616::lockfree::CACHE_LINE -
+             (sizeof(uint64_t) + sizeof(Quote)) % lab616::lockfree::CACHE_LINE];
+  };
+
+  const size_t mask_;
+  char* owned_;                  // NULL if the memory is the caller's.
+  Header* header_;
+  Slot* slots_;
+  volatile int* keys_;           // Open addressed: id + 1, 0 if empty.
+  volatile int* indexes_;        // Slot index for the key.
+};
+
+// Keeps a QuoteTable current from the BackPlane.  Register with
+// BackPlane::Register(Receiver<BidAsk>*) and Register(Receiver<Last>*).
+class QuoteTableReceiver : public FieldReceiver
+{
+ public:
+  explicit QuoteTableReceiver(QuoteTable* table) : table_(table) {}
+
+  virtual void OnField(int64_t ts, int id, Field field, double value)
+  {
+    table_->Update(ts, id, field, value);
+  }
+
+ private:
+  QuoteTable* table_;
+};
+
+} // namespace ib
+
+#endif // IB_QUOTE_TABLE_H_
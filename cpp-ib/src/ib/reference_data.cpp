@@ -0,0 +1,458 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sstream>
+
+#include <boost/bind.hpp>
+#include <glog/logging.h>
+
+#include "ib/marketdata.hpp"
+#include "ib/reference_data.hpp"
+#include "ib/xml_scanner.hpp"
+
+#define VLOG_LEVEL 2
+
+using namespace std;
+
+namespace ib {
+
+namespace {
+
+// Id of an error that is not for a request: NO_VALID_ID of the API.
+static const int NO_REQUEST_ID = -1;
+
+// Errors from here up are system messages and warnings, not replies to
+// a request.
+static const int FIRST_SYSTEM_CODE = 1100;
+
+// Element names of the documents, as the TWS sends them.
+class FundamentalsParser : public XmlHandler
+{
+ public:
+  explicit FundamentalsParser(reference::Fundamentals* out) : out_(out) {}
+
+  void StartElement(const string& name, const XmlAttributes& attributes)
+  {
+    text_.clear();
+    const string* type = attributes.Find("Type");
+    type_ = type ? *type : "";
+    if (name == "Ratios") {
+      const string* currency = attributes.Find("PriceCurrency");
+      if (currency && !out_->has_currency()) out_->set_currency(*currency);
+    } else if (name == "Ratio") {
+      const string* field = attributes.Find("FieldName");
+      field_ = field ? *field : "";
+    } else if (name == "Exchange") {
+      const string* code = attributes.Find("Code");
+      field_ = code ? *code : "";
+    } else if (name == "EPS" || name == "DividendPerShare" ||
+               name == "TotalRevenue") {
+      figure_.Clear();
+      figure_.set_kind(name);
+      const string* value = attributes.Find("asofDate");
+      if (value) figure_.set_as_of_date(*value);
+      value = attributes.Find("reportType");
+      if (value) figure_.set_report_type(*value);
+      value = attributes.Find("period");
+      if (value) figure_.set_period(*value);
+    }
+  }
+
+  void EndElement(const string& name)
+  {
+    if (name == "CoID") {
+      if (type_ == "CompanyName" && !out_->has_company_name()) {
+        out_->set_company_name(text_);
+      }
+    } else if (name == "IssueID") {
+      // The first issue is the primary one.
+      if (type_ == "Ticker" && !out_->has_ticker()) out_->set_ticker(text_);
+    } else if (name == "Exchange") {
+      if (!out_->has_exchange()) {
+        out_->set_exchange(field_.empty() ? text_ : field_);
+      }
+    } else if (name == "Industry") {
+      if (!out_->has_industry()) out_->set_industry(text_);
+    } else if (name == "Ratio") {
+      reference::Ratio* ratio = out_->add_ratios();
+      ratio->set_name(field_);
+      if (type_ == "N") {
+        ratio->set_value(strtod(text_.c_str(), NULL));
+      } else {
+        ratio->set_text(text_);
+      }
+    } else if (name == figure_.kind()) {
+      figure_.set_value(strtod(text_.c_str(), NULL));
+      out_->add_figures()->CopyFrom(figure_);
+      figure_.Clear();
+    }
+    text_.clear();
+  }
+
+  void Text(const string& text) { text_.append(text); }
+
+ private:
+  reference::Fundamentals* out_;
+  string text_;
+  string type_;   // Type attribute of the open element.
+  string field_;  // FieldName of a Ratio, Code of an Exchange.
+  reference::Figure figure_;
+};
+
+class ScannerParametersParser : public XmlHandler
+{
+ public:
+  explicit ScannerParametersParser(reference::ScannerParameters* out)
+      : out_(out), depth_(0), instrument_(NULL), scan_type_(NULL) {}
+
+  void StartElement(const string& name, const XmlAttributes&)
+  {
+    const string& parent = depth_ ? path_[depth_ - 1] : empty_;
+    if (name == "Instrument" && parent == "InstrumentList") {
+      instrument_ = out_->add_instruments();
+      instrument_->set_type("");
+    } else if (name == "ScanType" && parent == "ScanTypeList") {
+      scan_type_ = out_->add_scan_types();
+      scan_type_->set_code("");
+    } else if (name == "Location") {
+      // Locations nest in their LocationTrees.
+      reference::Location* location = out_->add_locations();
+      location->set_code("");
+      locations_.push_back(out_->locations_size() - 1);
+    }
+    if (depth_ == path_.size()) path_.push_back(string());
+    path_[depth_++] = name;
+    text_.clear();
+  }
+
+  void EndElement(const string& name)
+  {
+    --depth_;
+    const string& parent = depth_ ? path_[depth_ - 1] : empty_;
+    if (parent == "Instrument" && instrument_) {
+      if (name == "name") instrument_->set_name(text_);
+      if (name == "type") instrument_->set_type(text_);
+    } else if (parent == "ScanType" && scan_type_) {
+      if (name == "displayName") scan_type_->set_display_name(text_);
+      if (name == "scanCode") scan_type_->set_code(text_);
+      if (name == "instruments") scan_type_->set_instruments(text_);
+    } else if (parent == "Location" && !locations_.empty()) {
+      reference::Location* location =
+          out_->mutable_locations(locations_.back());
+      if (name == "displayName") location->set_display_name(text_);
+      if (name == "locationCode") location->set_code(text_);
+      if (name == "instruments") location->set_instruments(text_);
+    }
+    if (name == "Instrument") instrument_ = NULL;
+    if (name == "ScanType") scan_type_ = NULL;
+    if (name == "Location" && !locations_.empty()) locations_.pop_back();
+    text_.clear();
+  }
+
+  void Text(const string& text) { text_.append(text); }
+
+ private:
+  reference::ScannerParameters* out_;
+  vector<string> path_;  // Open elements; kept past depth_ for reuse.
+  size_t depth_;
+  const string empty_;
+  string text_;
+  reference::Instrument* instrument_;
+  reference::ScanType* scan_type_;
+  vector<int> locations_;  // Open ones, by index.
+};
+
+} // namespace
+
+bool ParseFundamentals(const string& xml, reference::Fundamentals* out)
+{
+  FundamentalsParser parser(out);
+  return XmlScanner(&parser).Scan(xml);
+}
+
+bool ParseScannerParameters(const string& xml,
+                            reference::ScannerParameters* out)
+{
+  ScannerParametersParser parser(out);
+  return XmlScanner(&parser).Scan(xml);
+}
+
+ReferenceData::ReferenceData(const string& dir, EClient* client,
+                             int timeout_secs)
+    : dir_(dir)
+    , client_(client)
+    , timeout_secs_(timeout_secs)
+    , scanner_parameters_sent_(0)
+    , answering_(0)
+    , stop_(false)
+{
+}
+
+ReferenceData::~ReferenceData()
+{
+  Stop();
+}
+
+void ReferenceData::Start()
+{
+  CHECK(!thread_);
+  stop_ = false;
+  thread_.reset(new boost::thread(boost::bind(&ReferenceData::Run, this)));
+}
+
+void ReferenceData::Stop()
+{
+  if (!thread_) return;
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    stop_ = true;
+    replied_.notify_all();
+  }
+  thread_->join();
+  thread_.reset();
+}
+
+void ReferenceData::Flush()
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  while (thread_ && (!replies_.empty() || answering_)) replied_.wait(lock);
+}
+
+bool ReferenceData::RequestFundamentals(TickerId req_id,
+                                        const Contract& contract,
+                                        const string& report_type,
+                                        FundamentalsCallback callback)
+{
+  const string key = FundamentalsKey(contract, report_type);
+  reference::Fundamentals cached;
+  if (Load(key, Today(), &cached)) {
+    VLOG(VLOG_LEVEL) << "Fundamentals " << key << " from the cache.";
+    callback(req_id, cached);
+    return true;
+  }
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    Pending& pending = fundamentals_[req_id];
+    pending.key = key;
+    pending.callback = callback;
+  }
+  client_->reqFundamentalData(req_id, contract, report_type);
+  return false;
+}
+
+bool ReferenceData::RequestScannerParameters(
+    ScannerParametersCallback callback)
+{
+  reference::ScannerParameters cached;
+  if (Load("scanner_parameters", Today(), &cached)) {
+    callback(cached);
+    return true;
+  }
+  bool send;
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    // One request answers all that wait, unless it has gone unanswered
+    // too long; then it is sent again for all of them.
+    const time_t now = time(NULL);
+    send = scanner_parameters_.empty() ||
+        now - scanner_parameters_sent_ >= timeout_secs_;
+    if (send) scanner_parameters_sent_ = now;
+    scanner_parameters_.push_back(callback);
+  }
+  if (send) client_->reqScannerParameters();
+  return false;
+}
+
+void ReferenceData::OnFundamentalData(TickerId req_id, const string& xml)
+{
+  Reply reply;
+  reply.req_id = req_id;
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    map<TickerId, Pending>::iterator found = fundamentals_.find(req_id);
+    if (found == fundamentals_.end()) {
+      VLOG(VLOG_LEVEL) << "Fundamentals " << req_id << " not requested here.";
+      return;
+    }
+    reply.fundamentals = found->second;
+    fundamentals_.erase(found);
+  }
+  reply.xml = xml;
+  Queue(&reply);
+}
+
+void ReferenceData::OnScannerParameters(const string& xml)
+{
+  Reply reply;
+  reply.req_id = 0;
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    reply.scanner_parameters.swap(scanner_parameters_);
+  }
+  reply.xml = xml;
+  Queue(&reply);
+}
+
+void ReferenceData::Queue(Reply* reply)
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  replies_.push_back(Reply());
+  Reply& queued = replies_.back();
+  queued.req_id = reply->req_id;
+  queued.fundamentals = reply->fundamentals;
+  queued.scanner_parameters.swap(reply->scanner_parameters);
+  queued.xml.swap(reply->xml);
+  replied_.notify_all();
+}
+
+void ReferenceData::Run()
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  while (true) {
+    while (replies_.empty() && !stop_) replied_.wait(lock);
+    if (replies_.empty()) return;
+    Reply reply;
+    reply.req_id = replies_.front().req_id;
+    reply.fundamentals = replies_.front().fundamentals;
+    reply.scanner_parameters.swap(replies_.front().scanner_parameters);
+    reply.xml.swap(replies_.front().xml);
+    replies_.pop_front();
+    answering_++;
+    lock.unlock();
+    Answer(reply);
+    lock.lock();
+    answering_--;
+    replied_.notify_all();
+  }
+}
+
+void ReferenceData::Answer(const Reply& reply)
+{
+  if (!reply.fundamentals.key.empty()) {
+    reference::Fundamentals fundamentals;
+    if (!ParseFundamentals(reply.xml, &fundamentals)) {
+      LOG(WARNING) << "Malformed fundamentals " << reply.fundamentals.key
+                   << " (" << reply.xml.size() << " bytes).";
+    } else {
+      Store(reply.fundamentals.key, Today(), fundamentals);
+    }
+    reply.fundamentals.callback(reply.req_id, fundamentals);
+    return;
+  }
+  reference::ScannerParameters parameters;
+  if (!ParseScannerParameters(reply.xml, &parameters)) {
+    LOG(WARNING) << "Malformed scanner parameters (" << reply.xml.size()
+                 << " bytes).";
+  } else {
+    Store("scanner_parameters", Today(), parameters);
+  }
+  for (size_t i = 0; i < reply.scanner_parameters.size(); ++i) {
+    reply.scanner_parameters[i](parameters);
+  }
+}
+
+void ReferenceData::OnError(int id, int code)
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  if (id == NO_REQUEST_ID) {
+    if (code < FIRST_SYSTEM_CODE && !scanner_parameters_.empty()) {
+      LOG(WARNING) << "Dropped " << scanner_parameters_.size()
+                   << " waiting for scanner parameters on error " << code;
+      scanner_parameters_.clear();
+    }
+    return;
+  }
+  // A warning leaves the request open, and the reply may still come.
+  if (internal::EndsRequest(code)) fundamentals_.erase(id);
+}
+
+void ReferenceData::OnDisconnect()
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  LOG_IF(WARNING, !fundamentals_.empty() || !scanner_parameters_.empty())
+      << "Dropped " << fundamentals_.size() << " fundamentals and "
+      << scanner_parameters_.size() << " scanner parameters requests "
+      << "on disconnect.";
+  fundamentals_.clear();
+  scanner_parameters_.clear();
+}
+
+string ReferenceData::Path(const string& key, int date) const
+{
+  ostringstream path;
+  path << dir_ << "/";
+  for (size_t i = 0; i < key.size(); ++i) {
+    const char c = key[i];
+    const bool safe = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+        (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '_';
+    path << (safe ? c : '_');
+  }
+  path << "." << date;
+  return path.str();
+}
+
+bool ReferenceData::Load(const string& key, int date,
+                         google::protobuf::MessageLite* message) const
+{
+  if (dir_.empty()) return false;
+  FILE* file = fopen(Path(key, date).c_str(), "r");
+  if (!file) return false;
+  string bytes;
+  char buffer[8192];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    bytes.append(buffer, n);
+  }
+  const bool ok = !ferror(file) && message->ParseFromString(bytes);
+  fclose(file);
+  LOG_IF(WARNING, !ok) << "Cannot read " << Path(key, date);
+  return ok;
+}
+
+bool ReferenceData::Store(const string& key, int date,
+                          const google::protobuf::MessageLite& message) const
+{
+  if (dir_.empty()) return false;
+  const string path = Path(key, date);
+  const string tmp = path + ".tmp";
+  string bytes;
+  if (!message.SerializeToString(&bytes)) return false;
+  FILE* file = fopen(tmp.c_str(), "w");
+  bool ok = file && fwrite(bytes.data(), 1, bytes.size(), file) ==
+      bytes.size();
+  if (file) ok = fclose(file) == 0 && ok;
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+    PLOG(WARNING) << "Cannot write " << path;
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+int ReferenceData::Today()
+{
+  const time_t now = time(NULL);
+  struct tm local;
+  localtime_r(&now, &local);
+  return (local.tm_year + 1900) * 10000 + (local.tm_mon + 1) * 100 +
+      local.tm_mday;
+}
+
+string ReferenceData::FundamentalsKey(const Contract& contract,
+                                      const string& report_type)
+{
+  ostringstream key;
+  key << report_type << ".";
+  if (contract.conId > 0) {
+    key << contract.conId;
+  } else {
+    key << contract.symbol << "." << contract.secType << "."
+        << contract.exchange << "." << contract.currency;
+  }
+  return key.str();
+}
+
+} // namespace ib
@@ -0,0 +1,145 @@
+#ifndef IB_REFERENCE_DATA_H_
+#define IB_REFERENCE_DATA_H_
+
+// Fundamentals and scanner parameters: requested through the
+// session's client, parsed from their XML with the XmlScanner into the
+// protos of ib_reference.proto, and cached on disk by request and
+// date.
+//
+// The XML of a reply is often megabytes and the content changes at
+// most daily, so a request made again the same day, in this process
+// or after a restart, is answered from the cache: the callback runs
+// before the request returns and nothing is sent.  Only the parsed
+// fields are kept, as <dir>/<key>.<yyyymmdd>, written aside and
+// renamed as in warm_state.hpp.
+//
+// Parsing a reply and caching it take too long for the EWrapper
+// thread, which also delivers the ticks: replies are queued to a
+// worker thread of their own, which answers them.
+
+#include <time.h>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <Shared/CommonDefs.h>
+#include <Shared/Contract.h>
+#include <Shared/EClient.h>
+
+#include "common.hpp"
+#include "ib/ib_reference.pb.h"
+
+namespace ib {
+
+// Each returns false if the XML is malformed; the fields seen before
+// the error are set.
+bool ParseFundamentals(const std::string& xml, reference::Fundamentals* out);
+bool ParseScannerParameters(const std::string& xml,
+                            reference::ScannerParameters* out);
+
+class ReferenceData : NoCopyAndAssign
+{
+ public:
+  typedef boost::function<void(TickerId, const reference::Fundamentals&)>
+      FundamentalsCallback;
+  typedef boost::function<void(const reference::ScannerParameters&)>
+      ScannerParametersCallback;
+
+  // Seconds a request for scanner parameters may go unanswered before
+  // the next one is sent again.
+  static const int DEFAULT_TIMEOUT_SECS = 60;
+
+  // Requests not answered from the cache go to the client, which is
+  // not owned.  Without a directory nothing is cached.
+  ReferenceData(const std::string& dir, EClient* client,
+                int timeout_secs = DEFAULT_TIMEOUT_SECS);
+  ~ReferenceData();
+
+  // Starts and stops the worker that answers the replies.  Stop
+  // answers those queued first.
+  void Start();
+  void Stop();
+
+  // Waits until the replies received so far are answered.
+  void Flush();
+
+  // Returns true if answered from the cache.  Otherwise the callback
+  // runs on the worker.
+  bool RequestFundamentals(TickerId req_id, const Contract& contract,
+                           const std::string& report_type,
+                           FundamentalsCallback callback);
+  bool RequestScannerParameters(ScannerParametersCallback callback);
+
+  // Replies, from the EWrapper: queued to the worker.
+  void OnFundamentalData(TickerId req_id, const std::string& xml);
+  void OnScannerParameters(const std::string& xml);
+
+  // An error for the id that ends requests drops its request, if any;
+  // it is not answered.  An error for no id, below the system codes, may be the
+  // reply to the scanner parameters and drops their waiters.
+  void OnError(int id, int code);
+
+  // Drops all pending requests: their replies will not come on a new
+  // connection.  They are not answered.
+  void OnDisconnect();
+
+  // The cache.  Keys are file names; other characters are replaced.
+  bool Load(const std::string& key, int date,
+            google::protobuf::MessageLite* message) const;
+  bool Store(const std::string& key, int date,
+             const google::protobuf::MessageLite& message) const;
+
+  // Local date as yyyymmdd.
+  static int Today();
+
+  // Key of a fundamentals request: the report and the contract.
+  static std::string FundamentalsKey(const Contract& contract,
+                                     const std::string& report_type);
+
+ private:
+  struct Pending
+  {
+    std::string key;
+    FundamentalsCallback callback;
+  };
+
+  // A reply to parse, and those it answers.
+  struct Reply
+  {
+    TickerId req_id;
+    Pending fundamentals;  // Without a key for scanner parameters.
+    std::vector<ScannerParametersCallback> scanner_parameters;
+    std::string xml;
+  };
+
+  void Queue(Reply* reply);
+  void Run();
+  void Answer(const Reply& reply);
+
+  std::string Path(const std::string& key, int date) const;
+
+  const std::string dir_;
+  EClient* client_;
+  const int timeout_secs_;
+
+  boost::mutex mutex_;
+  std::map<TickerId, Pending> fundamentals_;
+  std::vector<ScannerParametersCallback> scanner_parameters_;
+  time_t scanner_parameters_sent_;
+
+  boost::condition_variable replied_;  // Under mutex_, both ways.
+  std::deque<Reply> replies_;
+  int answering_;  // Taken off replies_, not yet answered.
+  bool stop_;
+  boost::scoped_ptr<boost::thread> thread_;
+};
+
+} // namespace ib
+
+#endif // IB_REFERENCE_DATA_H_
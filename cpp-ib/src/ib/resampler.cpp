@@ -0,0 +1,149 @@
+
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <glog/logging.h>
+
+#include "ib/resampler.hpp"
+
+using namespace std;
+
+namespace ib {
+namespace history {
+
+// The buffers have a row before the chunk's first, holding the last
+// row of the previous chunk to carry forward from.
+
+Resampler::Resampler(const JoinColumns& columns, int64_t interval,
+                     size_t chunk_rows, int64_t max_age,
+                     Receiver<GridChunk>* out)
+    : columns_(columns)
+    , interval_(interval)
+    , chunk_rows_(chunk_rows)
+    , max_age_(max_age)
+    , out_(out)
+    , started_(false)
+    , start_(0)
+    , row_(0)
+    , values_((chunk_rows + 1) * columns.size(), NAN)
+    , updated_((chunk_rows + 1) * columns.size(), NAN)
+    , valid_((chunk_rows + 1) * columns.size(), 1)
+    , halted_(columns.size(), 0)
+    , rows_(0)
+{
+  CHECK(interval_ > 0);
+  CHECK(chunk_rows_ > 0);
+  CHECK(columns_.size() > 0);
+  CHECK(out_);
+}
+
+void Resampler::OnField(int64_t ts, int id, Field field, double value)
+{
+  int column = columns_.Find(id, field);
+  if (column < 0) return;
+  if (!started_) {
+    start_ = ts - ts % interval_;
+    started_ = true;
+  }
+  Advance(ts);
+  const size_t cell = (row_ + 1) * columns_.size() + column;
+  values_[cell] = value;
+  updated_[cell] = ts;
+}
+
+void Resampler::SetHalted(size_t column, bool halted)
+{
+  CHECK(column < halted_.size());
+  halted_[column] = halted;
+}
+
+void Resampler::Flush(int64_t ts)
+{
+  if (!started_) return;
+  Advance(ts);
+  CompleteRow();
+  if (row_ > 0) Emit();
+}
+
+// Moves to the row at or after ts.
+void Resampler::Advance(int64_t ts)
+{
+  while (start_ + static_cast<int64_t>(row_) * interval_ < ts) CompleteRow();
+}
+
+void Resampler::CompleteRow()
+{
+  const size_t n = columns_.size();
+  uint8_t* valid = &valid_[(row_ + 1) * n];
+  for (size_t c = 0; c < n; ++c) valid[c] = !halted_[c];
+  if (++row_ == chunk_rows_) Emit();
+}
+
+namespace {
+
+// Row r from its own fresh cells and row r - 1, two columns at a time
+// with SSE2.  A cell is fresh if its time is not NaN, and valid if its
+// time is at or after oldest.
+void CarryForward(double* v, double* u, uint8_t* valid, size_t n,
+                  double oldest)
+{
+  const double* pv = v - n;
+  const double* pu = u - n;
+  size_t c = 0;
+#ifdef __SSE2__
+  const __m128d min = _mm_set1_pd(oldest);
+  for (; c + 2 <= n; c += 2) {
+    __m128d time = _mm_loadu_pd(u + c);
+    __m128d fresh = _mm_cmpord_pd(time, time);
+    __m128d value = _mm_or_pd(_mm_and_pd(fresh, _mm_loadu_pd(v + c)),
+                              _mm_andnot_pd(fresh, _mm_loadu_pd(pv + c)));
+    time = _mm_or_pd(_mm_and_pd(fresh, time),
+                     _mm_andnot_pd(fresh, _mm_loadu_pd(pu + c)));
+    _mm_storeu_pd(v + c, value);
+    _mm_storeu_pd(u + c, time);
+    int recent = _mm_movemask_pd(_mm_cmpge_pd(time, min));
+    valid[c] &= recent & 1;
+    valid[c + 1] &= recent >> 1;
+  }
+#endif
+  for (; c < n; ++c) {
+    if (u[c] != u[c]) {
+      v[c] = pv[c];
+      u[c] = pu[c];
+    }
+    valid[c] &= u[c] >= oldest;
+  }
+}
+
+} // namespace
+
+void Resampler::Emit()
+{
+  const size_t n = columns_.size();
+  for (size_t r = 1; r <= row_; ++r) {
+    const int64_t t = start_ + static_cast<int64_t>(r - 1) * interval_;
+    CarryForward(&values_[r * n], &updated_[r * n], &valid_[r * n], n,
+                 max_age_ > 0 ? t - max_age_ : -INFINITY);
+  }
+
+  GridChunk chunk = {
+    start_, interval_, row_, n, &values_[n], &valid_[n]
+  };
+  (*out_)(chunk);
+  rows_ += row_;
+
+  // The last row is carried into the next chunk.
+  memcpy(&values_[0], &values_[row_ * n], n * sizeof(double));
+  memcpy(&updated_[0], &updated_[row_ * n], n * sizeof(double));
+  fill(values_.begin() + n, values_.end(), NAN);
+  fill(updated_.begin() + n, updated_.end(), NAN);
+  start_ += static_cast<int64_t>(row_) * interval_;
+  row_ = 0;
+}
+
+} // namespace history
+} // namespace ib
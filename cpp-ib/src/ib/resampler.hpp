@@ -0,0 +1,88 @@
+#ifndef IB_RESAMPLER_H_
+#define IB_RESAMPLER_H_
+
+// Sampling of ticks on a common time grid: a dense matrix with a row
+// per grid point and a column per id and field (see JoinColumns), each
+// cell the last value at or before the row's time.
+//
+// Rows are produced in chunks of a fixed number of rows, row major, so
+// a chunk can be handed as is to matrix code.  While a chunk fills up
+// a tick only writes its cell; when the chunk is complete the values
+// are carried forward down the columns a whole row at a time, with
+// SSE2.  The times of the values are kept as doubles for that, exact
+// to the micro for centuries.
+//
+// Alongside the values each chunk has a validity mask, 0 where a cell
+// has no value yet, is older than the max age or its column is halted.
+// The values themselves are carried forward regardless.
+//
+// Ticks are expected in time order; one older than the current row is
+// counted in the current row.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "common.hpp"
+#include "ib/asof_join.hpp"
+#include "ib/backplane.hpp"
+#include "ib/quote_table.hpp"
+
+namespace ib {
+namespace history {
+
+struct GridChunk
+{
+  int64_t start;         // Time of the first row, micros.
+  int64_t interval;      // Between rows.
+  size_t rows;
+  size_t columns;
+  const double* values;  // rows x columns, NaN before the first tick.
+  const uint8_t* valid;  // rows x columns, 1 where the value is usable.
+};
+
+class Resampler : public FieldReceiver
+{
+ public:
+  // Rows are interval micros apart, at multiples of interval.  Values
+  // older than max_age micros are not valid; 0 for no limit.  The
+  // columns and out must outlive the resampler.
+  Resampler(const JoinColumns& columns, int64_t interval, size_t chunk_rows,
+            int64_t max_age, Receiver<GridChunk>* out);
+
+  virtual void OnField(int64_t ts, int id, Field field, double value);
+
+  // The column is not valid from the current row on, until unhalted.
+  void SetHalted(size_t column, bool halted);
+
+  // Completes the rows up to and including the one at ts and emits
+  // them, e.g. at the end of a session.
+  void Flush(int64_t ts);
+
+  uint64_t rows() const { return rows_; }
+
+ private:
+  void Advance(int64_t ts);
+  void CompleteRow();
+  void Emit();
+
+  const JoinColumns& columns_;
+  const int64_t interval_;
+  const size_t chunk_rows_;
+  const int64_t max_age_;
+  Receiver<GridChunk>* out_;
+
+  bool started_;
+  int64_t start_;             // Time of the first row of the chunk.
+  size_t row_;                // Row the next tick goes to.
+  std::vector<double> values_;
+  std::vector<double> updated_;    // Time of the value, or NaN.
+  std::vector<uint8_t> valid_;     // Not halted, until Emit.
+  std::vector<uint8_t> halted_;    // By column.
+  uint64_t rows_;             // Emitted so far.
+};
+
+} // namespace history
+} // namespace ib
+
+#endif // IB_RESAMPLER_H_
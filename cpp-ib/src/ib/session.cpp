@@ -1,6 +1,8 @@
 #include <sys/select.h>
 #include <sys/time.h>
 
+#include <set>
+
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
@@ -8,12 +10,25 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include <Shared/OrderState.h>
+
 #include "ib/adapters.hpp"
+#include "ib/audit/audit_log.hpp"
+#include "ib/clock_discipline.hpp"
+#include "ib/contract_store.hpp"
+#include "ib/control_plane.hpp"
 #include "ib/marketdata.hpp"
+#include "ib/numa.hpp"
+#include "ib/outbound_scheduler.hpp"
 #include "ib/polling_client.hpp"
 #include "ib/services.hpp"
 #include "ib/session.hpp"
+#include "ib/shm_bus.hpp"
+#include "ib/snapshot_sampler.hpp"
 #include "ib/backplane.hpp"
+#include "ib/quote_table.hpp"
+#include "ib/reference_data.hpp"
+#include "ib/warm_state.hpp"
 
 #define VLOG_LEVEL 2
 
@@ -31,6 +46,72 @@ namespace internal {
 
 DEFINE_int32(max_wait_confirm_connection, 2000,
              "Max wait time in millis for connection confirmation.");
+DEFINE_string(audit_db, "",
+              "Path to the SQLite audit database.  Empty to disable.");
+DEFINE_string(shm_bus, "",
+              "Name of the shared-memory market data bus in /dev/shm, "
+              "for other processes on this host.  Empty to disable.");
+DEFINE_int32(shm_bus_ring_size, 1 << 16,
+             "Ticks kept in the shared-memory ring.  A power of 2.");
+DEFINE_int32(shm_bus_book_size, 4096,
+             "Ids in the shared-memory top of book.  A power of 2.");
+DEFINE_double(outbound_rate, 45,
+              "Requests per second sent to the gateway, under its limit "
+              "of 50.");
+DEFINE_int32(outbound_burst, 10,
+             "Requests sent back to back before the rate applies.");
+DEFINE_string(ntp_server, "",
+              "NTP server (host or host:port) to correct tick timestamps "
+              "to.  Empty to use the local clock.");
+DEFINE_int32(ntp_poll_secs, 16, "Seconds between NTP polls.");
+DEFINE_int32(ntp_samples, 4,
+             "Samples per NTP poll; the one with the least round trip "
+             "is kept.");
+DEFINE_int32(ntp_timeout_millis, 500, "Wait for an NTP reply.");
+DEFINE_string(state_dir, "",
+              "Directory of the snapshots and update logs that restore "
+              "the session state on restart.  Empty to disable.");
+DEFINE_int32(state_snapshot_secs, 10, "Seconds between state snapshots.");
+DEFINE_int32(state_quotes, 4096,
+             "Ids in the table of last quotes kept with the state.  "
+             "A power of 2.");
+DEFINE_string(reference_cache_dir, "",
+              "Directory of the parsed fundamentals and scanner "
+              "parameters, kept for the day.  Empty to disable.");
+DEFINE_int32(snapshot_wave, 20,
+             "Snapshot requests of the sampler outstanding at once, "
+             "i.e. the market data lines it takes.");
+DEFINE_int32(snapshot_cycle_secs, 60,
+             "Seconds between the starts of sampling cycles.");
+DEFINE_int32(snapshot_timeout_secs, 15,
+             "Seconds before a snapshot without an end is canceled.");
+DEFINE_int32(snapshot_universe, 8192,
+             "Contracts the snapshot sampler can hold.  A power of 2.");
+// Only the threads Start() creates are bound, and those they create in
+// turn (the reconnects of the polling thread): a thread the caller
+// starts later, e.g. for a strategy capture or a quote stream, runs
+// wherever the caller's cpus are.
+DEFINE_int32(numa_node, -1,
+             "NUMA node of the session: the threads it starts run on the "
+             "cpus of the node and its quote table and shm bus prefer "
+             "the node's memory, falling back to other nodes when it is "
+             "full.  -1 to leave placement to the kernel.");
+DEFINE_bool(numa_hugepages, false,
+            "Back the quote table with 2MB hugepages when the pool "
+            "has them.");
+DEFINE_int32(snapshot_first_id, 1500000000,
+             "First ticker id of the snapshot sampler; above the ids "
+             "of SymbolToTickerId.");
+DEFINE_string(control_endpoint, "",
+              "ZMQ endpoint, e.g. tcp://*:5556, taking ib.actions "
+              "requests to reshape the subscriptions of the running "
+              "session.  Empty for none.");
+DEFINE_int32(control_max_lines, 100,
+             "Market data streams open at a time, counting the ones "
+             "requested through the control endpoint and the logger's.");
+DEFINE_int32(control_first_id, 1600000000,
+             "First request id of the bars and history requested "
+             "through the control endpoint; above the sampler's.");
 
 typedef uint64_t int64;
 inline int64 now_micros()
@@ -50,12 +131,66 @@ class polling_implementation
       : LoggingEWrapper(host, port, connection_id)
       , polling_client_(new PollingClient(this))
       , client_socket_(NULL)
+      , scheduler_(new OutboundScheduler(FLAGS_outbound_rate,
+                                         FLAGS_outbound_burst))
       , marketdata_(NULL)
       , backplane_(BackPlane::Create())
+      , audit_log_(FLAGS_audit_db.empty() ?
+                   NULL : new audit::AuditLog(FLAGS_audit_db))
+      , topology_(FLAGS_numa_node < 0 ? NULL : new numa::Topology())
+      , shm_bus_(FLAGS_shm_bus.empty() ?
+                 NULL : ShmBus::Create(FLAGS_shm_bus,
+                                       FLAGS_shm_bus_ring_size,
+                                       FLAGS_shm_bus_book_size,
+                                       FLAGS_numa_node))
+      , quote_memory_(FLAGS_state_dir.empty() || FLAGS_numa_node < 0 ?
+                      NULL : new numa::NodeMemory(
+                          QuoteTable::MemorySize(FLAGS_state_quotes),
+                          FLAGS_numa_node, FLAGS_numa_hugepages))
+      , quotes_(FLAGS_state_dir.empty() ? NULL :
+                quote_memory_.get() ?
+                new QuoteTable(quote_memory_->data(), FLAGS_state_quotes,
+                               true) :
+                new QuoteTable(FLAGS_state_quotes))
+      , warm_state_(FLAGS_state_dir.empty() ?
+                    NULL : new WarmState(FLAGS_state_dir, quotes_.get()))
+      , ntp_source_(FLAGS_ntp_server.empty() ?
+                    NULL : new NtpSource(FLAGS_ntp_server,
+                                         FLAGS_ntp_timeout_millis))
+      , clock_(new ClockDiscipline(ntp_source_.get(), FLAGS_ntp_samples))
+      , contracts_(new ContractStore())
+      , reference_data_(new ReferenceData(FLAGS_reference_cache_dir,
+                                          scheduler_.get()))
+      , sampler_(new SnapshotSampler(
+            scheduler_.get(), FLAGS_snapshot_first_id,
+            FLAGS_snapshot_universe, FLAGS_snapshot_wave,
+            FLAGS_snapshot_cycle_secs * 1000000LL,
+            FLAGS_snapshot_timeout_secs * 1000000LL))
+      , control_plane_(new ControlPlane(scheduler_.get(), warm_state_.get(),
+                                        FLAGS_control_max_lines,
+                                        FLAGS_control_first_id))
+      , ping_sent_(0)
       , connected_(false)
+      , next_valid_id_(0)
       , connect_confirm_callback_(NULL)
       , disconnect_callback_(NULL)
   {
+    if (shm_bus_.get()) {
+      shm_bus_receiver_.reset(new ShmBusReceiver(shm_bus_.get()));
+      backplane_->Register(
+          static_cast<Receiver<BidAsk>*>(shm_bus_receiver_.get()));
+      backplane_->Register(
+          static_cast<Receiver<Last>*>(shm_bus_receiver_.get()));
+    }
+    if (warm_state_.get()) {
+      // Before any tick can reach the table.
+      warm_state_->Load();
+      quote_table_receiver_.reset(new QuoteTableReceiver(quotes_.get()));
+      backplane_->Register(
+          static_cast<Receiver<BidAsk>*>(quote_table_receiver_.get()));
+      backplane_->Register(
+          static_cast<Receiver<Last>*>(quote_table_receiver_.get()));
+    }
   }
 
   ~polling_implementation()
@@ -66,10 +201,31 @@ class polling_implementation
 
   boost::scoped_ptr<PollingClient> polling_client_;
   boost::scoped_ptr<EPosixClientSocket> client_socket_;
+  boost::scoped_ptr<OutboundScheduler> scheduler_;  // Requests go here.
   boost::scoped_ptr<MarketDataInterface> marketdata_;
   boost::scoped_ptr<BackPlane> backplane_;
+  boost::scoped_ptr<audit::AuditLog> audit_log_;
+  boost::scoped_ptr<numa::Topology> topology_;  // Only with a node.
+  boost::scoped_ptr<ShmBus> shm_bus_;
+  boost::scoped_ptr<ShmBusReceiver> shm_bus_receiver_;
+  boost::scoped_ptr<numa::NodeMemory> quote_memory_;
+  boost::scoped_ptr<QuoteTable> quotes_;
+  boost::scoped_ptr<QuoteTableReceiver> quote_table_receiver_;
+  boost::scoped_ptr<WarmState> warm_state_;
+  boost::scoped_ptr<NtpSource> ntp_source_;
+  boost::scoped_ptr<ClockDiscipline> clock_;
+  boost::scoped_ptr<ContractStore> contracts_;
+  // Requests with details, not ended.  A send error ends one on the
+  // scheduler's thread.
+  boost::mutex loading_contracts_mutex_;
+  std::set<int> loading_contracts_;
+  boost::scoped_ptr<ReferenceData> reference_data_;
+  boost::scoped_ptr<SnapshotSampler> sampler_;
+  boost::scoped_ptr<ControlPlane> control_plane_;
+  volatile int64 ping_sent_;  // Local time of the last reqCurrentTime.
 
   volatile bool connected_;
+  OrderId next_valid_id_;
   boost::mutex connected_mutex_;
   boost::condition_variable connected_control_;
 
@@ -89,6 +245,39 @@ class polling_implementation
   /** @implements Session */
   void Start()
   {
+    // The threads started here, the control plane's and the polling
+    // thread that reconnects among them, inherit the cpus of the node
+    // and the state they allocate lands there on first touch.  Nothing
+    // else of the caller's is bound.
+    boost::scoped_ptr<numa::ScopedBinding> binding;
+    if (topology_.get()) {
+      LOG(INFO) << "NUMA topology:\n" << topology_->Report()
+                << "Session on node " << FLAGS_numa_node
+                << (quote_memory_.get() && quote_memory_->huge() ?
+                    ", quote table on hugepages." : ".");
+      binding.reset(new numa::ScopedBinding(*topology_, FLAGS_numa_node));
+      LOG_IF(ERROR, !binding->bound())
+          << "Cannot bind to node " << FLAGS_numa_node << ".";
+    }
+    if (audit_log_.get() && !audit_log_->Start()) {
+      LOG(ERROR) << "Cannot open audit log " << FLAGS_audit_db
+                 << ". Auditing disabled.";
+      audit_log_.reset();
+    }
+    if (warm_state_.get() &&
+        !warm_state_->Start(FLAGS_state_snapshot_secs)) {
+      LOG(ERROR) << "Cannot write state to " << FLAGS_state_dir
+                 << ". Warm restart disabled.";
+    }
+    if (ntp_source_.get()) clock_->Start(FLAGS_ntp_poll_secs);
+    scheduler_->Start();
+    reference_data_->Start();
+    sampler_->Start();
+    if (!FLAGS_control_endpoint.empty() &&
+        !control_plane_->Start(FLAGS_control_endpoint)) {
+      LOG(ERROR) << "Cannot bind control endpoint " << FLAGS_control_endpoint
+                 << ". Remote control disabled.";
+    }
     polling_client_->start();  // Start the thread.
   }
 
@@ -97,6 +286,14 @@ class polling_implementation
   {
     disconnect();
     polling_client_->stop();
+    control_plane_->Stop();
+    sampler_->Stop();
+    reference_data_->Stop();
+    scheduler_->Stop();
+    scheduler_->LogStats();
+    if (audit_log_.get()) audit_log_->Stop();
+    if (warm_state_.get()) warm_state_->Stop();
+    clock_->Stop();
   }
 
   /** @implements Session */
@@ -139,6 +336,69 @@ class polling_implementation
     return backplane_.get();
   }
 
+  /** @implements Session */
+  EClient* AccessClient()
+  {
+    bool ok = IsReady();
+    LOG_IF(WARNING, !ok) << "Connection not confirmed.  No client.";
+    return (ok) ? scheduler_.get() : NULL;
+  }
+
+  /** @implements Session */
+  OrderId GetNextValidId()
+  {
+    boost::unique_lock<boost::mutex> lock(connected_mutex_);
+    return next_valid_id_;
+  }
+
+  /** @implements Session */
+  audit::AuditLog* GetAuditLog()
+  {
+    return audit_log_.get();
+  }
+
+  /** @implements Session */
+  const ClockDiscipline* GetClock()
+  {
+    return clock_.get();
+  }
+
+  /** @implements Session */
+  WarmState* GetWarmState()
+  {
+    return warm_state_.get();
+  }
+
+  /** @implements Session */
+  const QuoteTable* GetQuotes()
+  {
+    return quotes_.get();
+  }
+
+  /** @implements Session */
+  const ContractStore* GetContracts()
+  {
+    return contracts_.get();
+  }
+
+  /** @implements Session */
+  ReferenceData* GetReferenceData()
+  {
+    return reference_data_.get();
+  }
+
+  /** @implements Session */
+  SnapshotSampler* GetSnapshotSampler()
+  {
+    return sampler_.get();
+  }
+
+  /** @implements Session */
+  ControlPlane* GetControlPlane()
+  {
+    return control_plane_.get();
+  }
+
  private:
 
   /** @implements EPosixClientSocketAccess */
@@ -148,14 +408,26 @@ class polling_implementation
     const unsigned int port = get_port();
     const unsigned int connection_id = get_connection_id();
 
-    // Deletes any previously allocated resource.
+    // The contract requests of the last connection will not end.
+    {
+      boost::mutex::scoped_lock lock(loading_contracts_mutex_);
+      if (!loading_contracts_.empty()) {
+        loading_contracts_.clear();
+        contracts_->Compact();
+      }
+    }
+
+    // Deletes any previously allocated resource, once the scheduler
+    // is done with it.  Requests queued meanwhile go to the new one.
+    scheduler_->SetClient(NULL);
     client_socket_.reset(new LoggingEClientSocket(connection_id, this));
-    marketdata_.reset(new MarketDataImpl(client_socket_.get()));
+    marketdata_.reset(new MarketDataImpl(scheduler_.get()));
 
     LOG(INFO) << "Connecting to "
               << host << ":" << port << " @ " << connection_id;
 
     client_socket_->eConnect(host.c_str(), port, connection_id);
+    scheduler_->SetClient(client_socket_.get());
   }
 
   /** @implements EPosixClientSocketAccess */
@@ -171,6 +443,9 @@ class polling_implementation
       client_socket_->eDisconnect();
       disconnects_++;
       polling_client_->received_disconnected();
+      scheduler_->OnDisconnect();
+      control_plane_->OnDisconnect();
+      reference_data_->OnDisconnect();
       if (disconnect_callback_) disconnect_callback_();
     }
   }
@@ -179,6 +454,7 @@ class polling_implementation
   void ping()
   {
     if (client_socket_.get()) {
+      ping_sent_ = now_micros();
       client_socket_->reqCurrentTime();
     }
   }
@@ -248,6 +524,10 @@ class polling_implementation
   void error(const int id, const int errorCode, const IBString errorString)
   {
     LoggingEWrapper::error(id, errorCode, errorString);
+    reference_data_->OnError(id, errorCode);
+    if (internal::EndsRequest(errorCode)) EndContracts(id);
+    if (sampler_->Owns(id)) sampler_->OnError(id, errorCode);
+    control_plane_->OnError(id, errorCode);
     if (id == -1 && errorCode == 1100) {
       LOG(WARNING) << "Error code = " << errorCode << " disconnecting.";
       disconnect();
@@ -280,11 +560,13 @@ class polling_implementation
               << orderId;
 
     boost::unique_lock<boost::mutex> lock(connected_mutex_);
+    next_valid_id_ = orderId;
     connected_ = true;
     connected_control_.notify_all();
 
     // Notify the poll client too
     polling_client_->received_connected();
+    control_plane_->OnConnect();
     if (connect_confirm_callback_) connect_confirm_callback_();
   }
 
@@ -292,6 +574,7 @@ class polling_implementation
   void currentTime(long time)
   {
     LoggingEWrapper::currentTime(time);
+    if (ping_sent_) clock_->OnServerTime(time, ping_sent_, now_micros());
     // Notify poll client that we have heartbeat.
     polling_client_->received_heartbeat(time);
   }
@@ -300,12 +583,20 @@ class polling_implementation
   void tickPrice(TickerId tickerId, TickType field,
                  double price, int canAutoExecute) {
     LoggingEWrapper::tickPrice(tickerId, field, price, canAutoExecute);
+    if (sampler_->Owns(tickerId)) {
+      // Sampled, not streamed.
+      sampler_->OnTickPrice(tick_time(), tickerId, field, price);
+      return;
+    }
     switch (field) {
       case BID:
-        backplane_->OnBid(now_micros(), tickerId, price);
+        backplane_->OnBid(tick_time(), tickerId, price);
         break;
       case ASK:
-        backplane_->OnAsk(now_micros(), tickerId, price);
+        backplane_->OnAsk(tick_time(), tickerId, price);
+        break;
+      case LAST:
+        backplane_->OnLast(tick_time(), tickerId, price);
         break;
      default:
         break;
@@ -315,18 +606,188 @@ class polling_implementation
   /** @implements EWrapper */
   void tickSize(TickerId tickerId, TickType field, int size) {
     LoggingEWrapper::tickSize(tickerId, field, size);
+    if (sampler_->Owns(tickerId)) {
+      sampler_->OnTickSize(tick_time(), tickerId, field, size);
+      return;
+    }
     switch (field) {
       case BID_SIZE:
-        backplane_->OnBid(now_micros(), tickerId, size);
+        backplane_->OnBid(tick_time(), tickerId, size);
         break;
       case ASK_SIZE:
-        backplane_->OnAsk(now_micros(), tickerId, size);
+        backplane_->OnAsk(tick_time(), tickerId, size);
+        break;
+      case LAST_SIZE:
+        backplane_->OnLast(tick_time(), tickerId, size);
         break;
       default:
         break;
     }
   }
 
+  /** @implements EWrapper */
+  void tickSnapshotEnd(int reqId)
+  {
+    LoggingEWrapper::tickSnapshotEnd(reqId);
+    if (sampler_->Owns(reqId)) {
+      sampler_->OnSnapshotEnd(tick_time(), reqId);
+    } else {
+      control_plane_->OnSnapshotEnd(reqId);
+    }
+  }
+
+  /** @implements EWrapper */
+  void historicalData(TickerId reqId, const IBString& date, double open,
+                      double high, double low, double close, int volume,
+                      int barCount, double WAP, int hasGaps)
+  {
+    LoggingEWrapper::historicalData(reqId, date, open, high, low, close,
+                                    volume, barCount, WAP, hasGaps);
+    // The last row of a request is its end marker.
+    if (date.compare(0, 8, "finished") == 0) {
+      control_plane_->OnHistoryEnd(reqId);
+    }
+  }
+
+  /** @implements EWrapper */
+  void orderStatus(OrderId orderId, const IBString &status, int filled,
+                   int remaining, double avgFillPrice, int permId, int parentId,
+                   double lastFillPrice, int clientId, const IBString& whyHeld)
+  {
+    LoggingEWrapper::orderStatus(orderId, status, filled, remaining,
+                                 avgFillPrice, permId, parentId,
+                                 lastFillPrice, clientId, whyHeld);
+    if (audit_log_.get()) {
+      audit_log_->RecordOrderStatus(orderId, status, filled, remaining,
+                                    avgFillPrice, permId, lastFillPrice,
+                                    clientId, whyHeld);
+    }
+    if (warm_state_.get()) {
+      ib::state::OpenOrder open;
+      open.set_id(orderId);
+      open.set_status(status);
+      open.set_filled(filled);
+      open.set_remaining(remaining);
+      open.set_avg_fill_price(avgFillPrice);
+      warm_state_->UpdateOrder(open);
+    }
+  }
+
+  /** @implements EWrapper */
+  void openOrder(OrderId orderId, const Contract& contract,
+                 const Order& order, const OrderState& state)
+  {
+    LoggingEWrapper::openOrder(orderId, contract, order, state);
+    if (audit_log_.get()) {
+      audit_log_->RecordOrder(orderId, contract, order);
+    }
+    if (warm_state_.get()) {
+      ib::state::OpenOrder open;
+      open.set_id(orderId);
+      open.set_symbol(contract.symbol);
+      open.set_action(order.action);
+      open.set_quantity(order.totalQuantity);
+      open.set_order_type(order.orderType);
+      open.set_price(order.lmtPrice);
+      open.set_status(state.status);
+      warm_state_->UpdateOrder(open);
+    }
+  }
+
+  /** @implements EWrapper */
+  void updatePortfolio(const Contract& contract, int position,
+                       double marketPrice, double marketValue,
+                       double averageCost, double unrealizedPNL,
+                       double realizedPNL, const IBString& accountName)
+  {
+    LoggingEWrapper::updatePortfolio(contract, position, marketPrice,
+                                     marketValue, averageCost, unrealizedPNL,
+                                     realizedPNL, accountName);
+    if (warm_state_.get()) {
+      ib::state::Position held;
+      held.set_symbol(contract.symbol);
+      held.set_account(accountName);
+      held.set_position(position);
+      held.set_avg_cost(averageCost);
+      warm_state_->UpdatePosition(held);
+    }
+  }
+
+  /** @implements EWrapper */
+  void contractDetails(int reqId, const ContractDetails& contractDetails)
+  {
+    LoggingEWrapper::contractDetails(reqId, contractDetails);
+    contracts_->Add(contractDetails);
+    boost::mutex::scoped_lock lock(loading_contracts_mutex_);
+    loading_contracts_.insert(reqId);
+  }
+
+  /**
+   * Contract details straight from the socket's buffer: the store
+   * interns the symbols and the decoder's exchanges and other names,
+   * without a ContractDetails in between.
+   * @implements LoggingEWrapper
+   */
+  void contractDetailsView(int reqId,
+                           const wire::ContractDetailsView& details,
+                           const wire::Interner& names)
+  {
+    VLOG(LOG_LEVEL) << "contractDetails reqId=" << reqId
+                    << ",conId=" << details.con_id
+                    << ",symbol=" << details.symbol.str();
+    contracts_->Add(details, names);
+    boost::mutex::scoped_lock lock(loading_contracts_mutex_);
+    loading_contracts_.insert(reqId);
+  }
+
+  /** @implements EWrapper */
+  void contractDetailsEnd(int reqId)
+  {
+    LoggingEWrapper::contractDetailsEnd(reqId);
+    EndContracts(reqId);
+  }
+
+  // Chains loaded at once interleave in the store: it is compacted
+  // when the last of the requests loading them ends.
+  void EndContracts(int reqId)
+  {
+    boost::mutex::scoped_lock lock(loading_contracts_mutex_);
+    if (loading_contracts_.erase(reqId) && loading_contracts_.empty()) {
+      contracts_->Compact();
+    }
+  }
+
+  /** @implements EWrapper */
+  void fundamentalData(TickerId reqId, const IBString& data)
+  {
+    LoggingEWrapper::fundamentalData(reqId, data);
+    reference_data_->OnFundamentalData(reqId, data);
+  }
+
+  /** @implements EWrapper */
+  void scannerParameters(const IBString& xml)
+  {
+    LoggingEWrapper::scannerParameters(xml);
+    reference_data_->OnScannerParameters(xml);
+  }
+
+  /** @implements EWrapper */
+  void execDetails(int reqId, const Contract& contract,
+                   const Execution& execution)
+  {
+    LoggingEWrapper::execDetails(reqId, contract, execution);
+    if (audit_log_.get()) {
+      audit_log_->RecordExecution(contract, execution);
+    }
+  }
+
+  // Local time corrected to the reference clock; no system call but
+  // the clock read.
+  inline int64 tick_time()
+  {
+    return clock_->Correct(now_micros());
+  }
+
   // Returns false if timed out.
   bool wait_for_order_id(const boost::posix_time::time_duration& duration)
   {
@@ -399,4 +860,34 @@ MarketDataInterface* Session::AccessMarketData()
 BackPlane* Session::GetBackPlane()
 { return impl_->GetBackPlane(); }
 
+EClient* Session::AccessClient()
+{ return impl_->AccessClient(); }
+
+OrderId Session::GetNextValidId()
+{ return impl_->GetNextValidId(); }
+
+audit::AuditLog* Session::GetAuditLog()
+{ return impl_->GetAuditLog(); }
+
+const ClockDiscipline* Session::GetClock()
+{ return impl_->GetClock(); }
+
+WarmState* Session::GetWarmState()
+{ return impl_->GetWarmState(); }
+
+const QuoteTable* Session::GetQuotes()
+{ return impl_->GetQuotes(); }
+
+const ContractStore* Session::GetContracts()
+{ return impl_->GetContracts(); }
+
+ReferenceData* Session::GetReferenceData()
+{ return impl_->GetReferenceData(); }
+
+SnapshotSampler* Session::GetSnapshotSampler()
+{ return impl_->GetSnapshotSampler(); }
+
+ControlPlane* Session::GetControlPlane()
+{ return impl_->GetControlPlane(); }
+
 } // namespace ib
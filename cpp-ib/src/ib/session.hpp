@@ -5,14 +5,30 @@
 #include <boost/function.hpp>
 #include <boost/scoped_ptr.hpp>
 
+#include <Shared/CommonDefs.h>
+
 #include "ib/backplane.hpp"
 #include "ib/services.hpp"
 
 using namespace std;
 using ib::services::MarketDataInterface;
 
+class EClient;
+
 namespace ib {
 
+namespace audit {
+class AuditLog;
+}
+
+class ClockDiscipline;
+class ContractStore;
+class ControlPlane;
+class QuoteTable;
+class ReferenceData;
+class SnapshotSampler;
+class WarmState;
+
 // A single session with the IB API Gateway, identified by
 // the host, port, and connection id.
 class Session
@@ -43,6 +59,48 @@ class Session
 
   BackPlane* GetBackPlane();
 
+  // Client for orders and other requests, through the outbound
+  // scheduler.  NULL if the connection is not confirmed.
+  EClient* AccessClient();
+
+  // The order id given by the gateway when the connection was
+  // confirmed.  Ids from it on are free.
+  OrderId GetNextValidId();
+
+  // Audit store for orders and executions, or NULL if --audit_db
+  // is not set.
+  audit::AuditLog* GetAuditLog();
+
+  // Offset of the local clock to NTP (--ntp_server), which tick
+  // timestamps are corrected by, and to the TWS server time.
+  const ClockDiscipline* GetClock();
+
+  // State restored on start and kept for the next restart, or NULL
+  // if --state_dir is not set.
+  WarmState* GetWarmState();
+
+  // Last quotes, restored with the state and kept current from the
+  // BackPlane.  NULL if --state_dir is not set.
+  const QuoteTable* GetQuotes();
+
+  // Contract details received so far, in compact form.  Hold its
+  // mutex() to read it off the session's thread.
+  const ContractStore* GetContracts();
+
+  // Fundamentals and scanner parameters, parsed and cached by day.
+  // Requests made through it are sent by the session.
+  ReferenceData* GetReferenceData();
+
+  // Samples a universe larger than the market data lines through
+  // snapshots.  Contracts added to it are sampled once the session
+  // starts.
+  SnapshotSampler* GetSnapshotSampler();
+
+  // Takes ib.actions requests from --control_endpoint and applies
+  // them to the running session.  Streams opened elsewhere are told
+  // to it with Track, so they count against its lines.
+  ControlPlane* GetControlPlane();
+
  private:
   class implementation;
   boost::scoped_ptr<implementation> impl_;
@@ -0,0 +1,228 @@
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glog/logging.h>
+
+#include "ib/numa.hpp"
+#include "ib/shm_bus.hpp"
+
+using namespace std;
+using lab616::lockfree::CACHE_LINE;
+using lab616::lockfree::compiler_barrier;
+using lab616::lockfree::load_acquire;
+using lab616::lockfree::store_release;
+
+namespace ib {
+namespace internal {
+
+static const uint32_t kMagic = 0x49425342;  // IBSB
+static const uint32_t kLayout = 1;
+
+// Segment: header | ring_capacity slots | book.
+struct ShmBusHeader
+{
+  volatile uint64_t head;  // Sequence of the next tick.
+  char pad0[CACHE_LINE - sizeof(uint64_t)];
+
+  // Written once, magic last.
+  volatile uint32_t magic;
+  uint32_t layout;
+  uint64_t ring_capacity;
+  uint64_t book_capacity;
+  int64_t writer_pid;
+  volatile uint32_t closed;
+  char pad1[CACHE_LINE - 4 * sizeof(uint64_t) - sizeof(uint32_t)];
+};
+
+// Holds tick n with sequence 2n + 2, or 2n + 1 while it is written.
+struct ShmBusSlot
+{
+  volatile uint64_t sequence;
+  ShmTick tick;
+};
+
+static size_t SegmentSize(size_t ring_capacity, size_t book_capacity)
+{
+  return sizeof(ShmBusHeader) + sizeof(ShmBusSlot) * ring_capacity +
+      QuoteTable::MemorySize(book_capacity);
+}
+
+static string ShmPath(const string& name)
+{
+  return name[0] == '/' ? name : "/" + name;
+}
+
+} // namespace internal
+
+using internal::ShmBusHeader;
+using internal::ShmBusSlot;
+
+ShmBus* ShmBus::Create(const string& name, size_t ring_capacity,
+                       size_t book_capacity, int node)
+{
+  CHECK(ring_capacity >= 2 && (ring_capacity & (ring_capacity - 1)) == 0)
+      << "Capacity must be a power of 2: " << ring_capacity;
+  const string path = internal::ShmPath(name);
+  const size_t size = internal::SegmentSize(ring_capacity, book_capacity);
+
+  // Readers of a previous writer keep their mapping of the old one.
+  shm_unlink(path.c_str());
+  int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    PLOG(ERROR) << "Cannot create " << path;
+    return NULL;
+  }
+  // The new pages read as zero: every slot is empty.
+  if (ftruncate(fd, size) < 0) {
+    PLOG(ERROR) << "Cannot size " << path << " to " << size;
+    close(fd);
+    shm_unlink(path.c_str());
+    return NULL;
+  }
+  void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    PLOG(ERROR) << "Cannot map " << path;
+    shm_unlink(path.c_str());
+    return NULL;
+  }
+  // Before the writer touches any page.
+  if (node >= 0) numa::BindMemory(memory, size, node);
+  LOG(INFO) << "Publishing market data on " << path << " ("
+            << ring_capacity << " ticks, " << book_capacity << " ids)";
+  return new ShmBus(path, static_cast<char*>(memory), size, ring_capacity,
+                    book_capacity);
+}
+
+ShmBus::ShmBus(const string& name, char* memory, size_t size,
+               size_t ring_capacity, size_t book_capacity)
+    : name_(name)
+    , memory_(memory)
+    , size_(size)
+    , header_(reinterpret_cast<ShmBusHeader*>(memory))
+    , ring_(reinterpret_cast<ShmBusSlot*>(memory + sizeof(ShmBusHeader)))
+    , mask_(ring_capacity - 1)
+    , book_(new QuoteTable(ring_ + ring_capacity, book_capacity, true))
+    , next_(0)
+{
+  header_->layout = internal::kLayout;
+  header_->ring_capacity = ring_capacity;
+  header_->book_capacity = book_capacity;
+  header_->writer_pid = getpid();
+  store_release(header_->magic, internal::kMagic);
+}
+
+ShmBus::~ShmBus()
+{
+  store_release(header_->closed, 1U);
+  delete book_;
+  munmap(memory_, size_);
+  shm_unlink(name_.c_str());
+}
+
+void ShmBus::Publish(int64_t ts, int id, QuoteTable::Field field,
+                     double value)
+{
+  // Book first, so a reader that has the tick finds the book with it.
+  book_->Update(ts, id, field, value);
+
+  ShmBusSlot& slot = ring_[next_ & mask_];
+  store_release(slot.sequence, 2 * next_ + 1);
+  compiler_barrier();
+  slot.tick.ts = ts;
+  slot.tick.id = id;
+  slot.tick.field = field;
+  slot.tick.value = value;
+  store_release(slot.sequence, 2 * next_ + 2);
+  store_release(header_->head, ++next_);
+}
+
+ShmBusReader* ShmBusReader::Open(const string& name)
+{
+  const string path = internal::ShmPath(name);
+  int fd = shm_open(path.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    PLOG(WARNING) << "No market data bus at " << path;
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(ShmBusHeader)) {
+    LOG(WARNING) << path << " is not ready.";
+    close(fd);
+    return NULL;
+  }
+  const size_t size = st.st_size;
+  void* memory = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    PLOG(ERROR) << "Cannot map " << path;
+    return NULL;
+  }
+
+  const ShmBusHeader* header = static_cast<const ShmBusHeader*>(memory);
+  if (load_acquire(header->magic) != internal::kMagic ||
+      header->layout != internal::kLayout ||
+      internal::SegmentSize(header->ring_capacity,
+                            header->book_capacity) != size) {
+    LOG(WARNING) << path << " is not ready or has another layout.";
+    munmap(memory, size);
+    return NULL;
+  }
+  VLOG(1) << "Attached to " << path << " of writer " << header->writer_pid;
+  return new ShmBusReader(static_cast<char*>(memory), size);
+}
+
+ShmBusReader::ShmBusReader(char* memory, size_t size)
+    : memory_(memory)
+    , size_(size)
+    , header_(reinterpret_cast<const ShmBusHeader*>(memory))
+    , ring_(reinterpret_cast<const ShmBusSlot*>(memory + sizeof(ShmBusHeader)))
+    , mask_(header_->ring_capacity - 1)
+    , book_(new QuoteTable(const_cast<ShmBusSlot*>(ring_) + mask_ + 1,
+                           header_->book_capacity, false))
+    , next_(load_acquire(header_->head))
+    , overruns_(0)
+    , lost_(0)
+{
+}
+
+ShmBusReader::~ShmBusReader()
+{
+  delete book_;
+  munmap(memory_, size_);
+}
+
+bool ShmBusReader::closed() const
+{
+  return load_acquire(header_->closed) != 0;
+}
+
+bool ShmBusReader::Next(ShmTick* tick)
+{
+  while (true) {
+    const ShmBusSlot& slot = ring_[next_ & mask_];
+    const uint64_t expected = 2 * next_ + 2;
+    uint64_t sequence = load_acquire(slot.sequence);
+    if (sequence < expected) return false;  // Not written yet.
+    if (sequence == expected) {
+      *tick = slot.tick;
+      compiler_barrier();
+      if (load_acquire(slot.sequence) == expected) {
+        next_++;
+        return true;
+      }
+    }
+    // The writer has lapped us and the ticks in between are gone.
+    // Resume at the newest; the book has the state they carried.
+    uint64_t head = load_acquire(header_->head);
+    overruns_++;
+    lost_ += head - next_;
+    next_ = head;
+  }
+}
+
+} // namespace ib
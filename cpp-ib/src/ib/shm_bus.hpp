@@ -0,0 +1,134 @@
+#ifndef IB_SHM_BUS_H_
+#define IB_SHM_BUS_H_
+
+// Market data from the BackPlane published in shared memory, for
+// strategy processes on the same box.  The segment, /dev/shm/<name>,
+// holds
+//
+//   - a ring of ticks with a single writer and any number of readers.
+//     Every slot carries the sequence number of the tick in it, odd
+//     while the writer is filling it in.  Readers keep their own
+//     position; the writer never looks at them.  A reader that falls a
+//     full ring behind sees a newer sequence than it expects, counts
+//     the overrun and resumes at the newest tick;
+//
+//   - the top of book for every id, a QuoteTable under seqlocks, for
+//     readers that only want the latest state.
+//
+// Reading is loads from the mapping: no syscalls, no locks, nothing
+// written to the segment.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+#include "common.hpp"
+#include "lockfree.hpp"
+#include "ib/backplane.hpp"
+#include "ib/quote_table.hpp"
+
+namespace ib {
+
+struct ShmTick
+{
+  int64_t ts;         // Micros.
+  int id;
+  int field;          // QuoteTable::Field
+  double value;
+};
+
+namespace internal {
+struct ShmBusHeader;
+struct ShmBusSlot;
+} // namespace internal
+
+// Writer side.  One per segment and one thread only.
+class ShmBus : NoCopyAndAssign
+{
+ public:
+  // Creates /dev/shm/<name>, replacing any segment a previous writer
+  // left behind.  Both capacities must be powers of 2.  With a NUMA
+  // node, the pages of the segment are placed there.  Returns NULL on
+  // failure.
+  static ShmBus* Create(const std::string& name, size_t ring_capacity,
+                        size_t book_capacity, int node = -1);
+
+  // Marks the segment closed, so readers know to reopen, and removes
+  // its name.  Readers still attached keep their mapping.
+  ~ShmBus();
+
+  void Publish(int64_t ts, int id, QuoteTable::Field field, double value);
+
+  uint64_t published() const { return next_; }
+  QuoteTable* book() { return book_; }
+
+ private:
+  ShmBus(const std::string& name, char* memory, size_t size,
+         size_t ring_capacity, size_t book_capacity);
+
+  const std::string name_;
+  char* const memory_;
+  const size_t size_;
+  internal::ShmBusHeader* const header_;
+  internal::ShmBusSlot* const ring_;
+  const size_t mask_;
+  QuoteTable* const book_;
+  uint64_t next_;
+};
+
+// Reader side, in any process.  Not shared between threads.
+class ShmBusReader : NoCopyAndAssign
+{
+ public:
+  // Attaches to the segment of a running writer, starting after the
+  // newest tick.  Returns NULL if there is none or it has another
+  // layout.
+  static ShmBusReader* Open(const std::string& name);
+
+  ~ShmBusReader();
+
+  // Copies the next tick.  False if there is none yet.
+  bool Next(ShmTick* tick);
+
+  // True once the writer has gone; reopen to follow its successor.
+  bool closed() const;
+
+  // Times the reader fell a full ring behind, and ticks skipped.
+  uint64_t overruns() const { return overruns_; }
+  uint64_t lost() const { return lost_; }
+
+  const QuoteTable& book() const { return *book_; }
+
+ private:
+  ShmBusReader(char* memory, size_t size);
+
+  char* const memory_;
+  const size_t size_;
+  const internal::ShmBusHeader* const header_;
+  const internal::ShmBusSlot* const ring_;
+  const size_t mask_;
+  QuoteTable* const book_;
+  uint64_t next_;
+  uint64_t overruns_;
+  uint64_t lost_;
+};
+
+// Publishes the BackPlane market data.  Register with
+// BackPlane::Register(Receiver<BidAsk>*) and Register(Receiver<Last>*).
+class ShmBusReceiver : public FieldReceiver
+{
+ public:
+  explicit ShmBusReceiver(ShmBus* bus) : bus_(bus) {}
+
+  virtual void OnField(int64_t ts, int id, Field field, double value)
+  {
+    bus_->Publish(ts, id, field, value);
+  }
+
+ private:
+  ShmBus* bus_;
+};
+
+} // namespace ib
+
+#endif // IB_SHM_BUS_H_
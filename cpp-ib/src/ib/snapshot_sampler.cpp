@@ -0,0 +1,252 @@
+
+#include <string.h>
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+#include <glog/logging.h>
+
+#include "utils.hpp"
+#include "ib/marketdata.hpp"
+#include "ib/snapshot_sampler.hpp"
+
+#define VLOG_LEVEL 2
+
+using namespace std;
+using lab616::utils::now_micros;
+
+namespace ib {
+
+SnapshotSampler::SnapshotSampler(EClient* client, TickerId first_id,
+                                 size_t capacity, int wave_size,
+                                 int64_t cycle_micros,
+                                 int64_t timeout_micros)
+    : client_(client)
+    , first_id_(first_id)
+    , capacity_(capacity)
+    , wave_size_(max(wave_size, 1))
+    , cycle_micros_(cycle_micros)
+    , timeout_micros_(timeout_micros)
+    , quotes_(capacity)
+    , next_(0)
+    , cycle_started_(0)
+    , stop_(false)
+{
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+SnapshotSampler::~SnapshotSampler()
+{
+  Stop();
+}
+
+TickerId SnapshotSampler::Add(const Contract& contract)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  map<string, TickerId>::const_iterator found =
+      symbols_.find(contract.symbol);
+  if (found != symbols_.end()) return found->second;
+  if (entries_.size() == capacity_) {
+    LOG(WARNING) << "Snapshot universe full, dropping " << contract.symbol;
+    return -1;
+  }
+  const TickerId id = first_id_ + entries_.size();
+  entries_.push_back(Entry());
+  entries_.back().contract = contract;
+  entries_.back().sampled_at = 0;
+  symbols_[contract.symbol] = id;
+  wave_ended_.notify_all();  // The universe may have been empty.
+  return id;
+}
+
+size_t SnapshotSampler::size() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return entries_.size();
+}
+
+TickerId SnapshotSampler::Find(const string& symbol) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  map<string, TickerId>::const_iterator found = symbols_.find(symbol);
+  return found == symbols_.end() ? -1 : found->second;
+}
+
+bool SnapshotSampler::Get(TickerId id, Sample* sample) const
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    const size_t index = id - first_id_;
+    if (!Owns(id) || index >= entries_.size()) return false;
+    sample->symbol = entries_[index].contract.symbol;
+    sample->sampled_at = entries_[index].sampled_at;
+  }
+  const int slot = quotes_.Find(id);
+  if (slot < 0) {
+    memset(&sample->quote, 0, sizeof(sample->quote));
+    sample->quote.id = id;
+  } else {
+    quotes_.Read(slot, &sample->quote);
+  }
+  return true;
+}
+
+size_t SnapshotSampler::CountStale(int64_t now, int64_t max_age) const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  size_t stale = 0;
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    const int64_t sampled_at = entries_[i].sampled_at;
+    if (sampled_at == 0 || sampled_at < now - max_age) ++stale;
+  }
+  return stale;
+}
+
+SnapshotSampler::Stats SnapshotSampler::GetStats() const
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return stats_;
+}
+
+void SnapshotSampler::Start()
+{
+  CHECK(!thread_);
+  stop_ = false;
+  thread_.reset(new boost::thread(boost::bind(&SnapshotSampler::Run, this)));
+}
+
+void SnapshotSampler::Stop()
+{
+  if (!thread_) return;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stop_ = true;
+    wave_ended_.notify_all();
+  }
+  thread_->join();
+  thread_.reset();
+}
+
+void SnapshotSampler::Run()
+{
+  while (true) {
+    int64_t wait = Dispatch(now_micros());
+    boost::mutex::scoped_lock lock(mutex_);
+    if (stop_) break;
+    // The wave may have ended since.
+    if (Due(now_micros())) continue;
+    if (wait < 0) {
+      wave_ended_.wait(lock);
+    } else {
+      wave_ended_.timed_wait(lock, boost::posix_time::microseconds(wait));
+    }
+  }
+}
+
+bool SnapshotSampler::Due(int64_t now) const
+{
+  if (!wave_.empty() || entries_.empty()) return false;
+  if (next_ > 0) return true;  // Within a cycle, or at its end.
+  return cycle_started_ == 0 || now >= cycle_started_ + cycle_micros_;
+}
+
+int64_t SnapshotSampler::Dispatch(int64_t now)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  for (map<TickerId, int64_t>::iterator it = wave_.begin();
+       it != wave_.end(); ) {
+    if (now - it->second >= timeout_micros_) {
+      VLOG(VLOG_LEVEL) << "Snapshot " << it->first << " timed out.";
+      client_->cancelMktData(it->first);  // Frees the line.
+      stats_.timed_out++;
+      wave_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  if (!wave_.empty()) {
+    int64_t first = now;
+    for (map<TickerId, int64_t>::const_iterator it = wave_.begin();
+         it != wave_.end(); ++it) {
+      first = min(first, it->second);
+    }
+    return first + timeout_micros_ - now;
+  }
+  if (entries_.empty()) return -1;
+
+  if (next_ == entries_.size()) {
+    // The last wave of the cycle ended.
+    stats_.cycle_micros = now - cycle_started_;
+    VLOG(VLOG_LEVEL) << "Sampled " << entries_.size() << " contracts in "
+                     << stats_.cycle_micros << " micros.";
+    next_ = 0;
+  }
+  if (next_ == 0) {
+    if (cycle_started_ && now < cycle_started_ + cycle_micros_) {
+      return cycle_started_ + cycle_micros_ - now;
+    }
+    cycle_started_ = now;
+    stats_.cycles++;
+  }
+  for (size_t n = 0; n < wave_size_ && next_ < entries_.size(); ++n) {
+    const TickerId id = first_id_ + next_;
+    // Generic ticks are not allowed with snapshots.
+    client_->reqMktData(id, entries_[next_].contract, "", true);
+    wave_[id] = now;
+    stats_.requested++;
+    next_++;
+  }
+  return timeout_micros_;
+}
+
+static inline bool ToField(TickType type, QuoteTable::Field* field)
+{
+  switch (type) {
+    case BID: *field = QuoteTable::BID; return true;
+    case BID_SIZE: *field = QuoteTable::BID_SIZE; return true;
+    case ASK: *field = QuoteTable::ASK; return true;
+    case ASK_SIZE: *field = QuoteTable::ASK_SIZE; return true;
+    case LAST: *field = QuoteTable::LAST; return true;
+    case LAST_SIZE: *field = QuoteTable::LAST_SIZE; return true;
+    default: return false;
+  }
+}
+
+void SnapshotSampler::OnTickPrice(int64_t ts, TickerId id, TickType type,
+                                  double price)
+{
+  QuoteTable::Field field;
+  // No price is sent as -1.
+  if (ToField(type, &field) && price > 0) quotes_.Update(ts, id, field, price);
+}
+
+void SnapshotSampler::OnTickSize(int64_t ts, TickerId id, TickType type,
+                                 int size)
+{
+  QuoteTable::Field field;
+  if (ToField(type, &field)) quotes_.Update(ts, id, field, size);
+}
+
+void SnapshotSampler::OnSnapshotEnd(int64_t ts, TickerId id)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  const size_t index = id - first_id_;
+  if (Owns(id) && index < entries_.size()) entries_[index].sampled_at = ts;
+  if (EndRequest(id)) stats_.completed++;
+}
+
+void SnapshotSampler::OnError(TickerId id, int code)
+{
+  if (!internal::EndsRequest(code)) return;
+  boost::mutex::scoped_lock lock(mutex_);
+  if (EndRequest(id)) stats_.failed++;
+}
+
+bool SnapshotSampler::EndRequest(TickerId id)
+{
+  if (wave_.erase(id) == 0) return false;
+  if (wave_.empty()) wave_ended_.notify_all();
+  return true;
+}
+
+} // namespace ib
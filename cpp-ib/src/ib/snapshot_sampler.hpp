@@ -0,0 +1,150 @@
+#ifndef IB_SNAPSHOT_SAMPLER_H_
+#define IB_SNAPSHOT_SAMPLER_H_
+
+// Minute-level coverage of a universe of thousands of contracts,
+// larger than the market data lines of the account, without
+// streaming any of them.
+//
+// The contracts are cycled through snapshot requests (reqMktData with
+// snapshot true) in waves of at most wave_size: a wave is sent, and
+// the next one only when each request of the wave has ended, with
+// tickSnapshotEnd, an error or a timeout.  A snapshot holds a line
+// only until it ends, so the waves never take more than wave_size
+// lines.  When the whole universe has been sampled the next cycle
+// starts, at most once a cycle period.
+//
+// The ids of the sampler are [first_id, first_id + capacity) and its
+// ticks are kept apart from the streamed ones, in its own QuoteTable,
+// with the time each contract was last sampled, so readers can tell
+// how stale a value is.
+//
+// Ticks come from the session's thread, which is the one writer of
+// the table.  Requests are sent from the sampler's thread, or from
+// the caller of Dispatch.
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <Shared/CommonDefs.h>
+#include <Shared/Contract.h>
+#include <Shared/EClient.h>
+#include <Shared/EWrapper.h>
+
+#include "common.hpp"
+#include "ib/quote_table.hpp"
+
+namespace ib {
+
+class SnapshotSampler : NoCopyAndAssign
+{
+ public:
+  struct Sample
+  {
+    std::string symbol;
+    Quote quote;         // Values and time of the latest tick.
+    int64_t sampled_at;  // End of the latest snapshot, or 0.
+  };
+
+  struct Stats
+  {
+    uint64_t cycles;        // Started.
+    uint64_t requested;
+    uint64_t completed;     // Ended with tickSnapshotEnd.
+    uint64_t failed;        // Ended with an error.
+    uint64_t timed_out;
+    int64_t cycle_micros;   // Duration of the last complete cycle.
+  };
+
+  // Requests go to the client, which is not owned.  At most capacity
+  // contracts, a power of 2.
+  SnapshotSampler(EClient* client, TickerId first_id, size_t capacity,
+                  int wave_size, int64_t cycle_micros,
+                  int64_t timeout_micros);
+  ~SnapshotSampler();
+
+  // Adds the contract to the universe and returns its id, the one it
+  // had if the symbol was added before, or -1 if full.
+  TickerId Add(const Contract& contract);
+
+  size_t size() const;
+
+  // True if the id is one of the sampler's.
+  bool Owns(TickerId id) const
+  {
+    return id >= first_id_ &&
+        id < first_id_ + static_cast<TickerId>(capacity_);
+  }
+
+  // Id of the symbol, or -1.
+  TickerId Find(const std::string& symbol) const;
+
+  // Returns false if the id is not in the universe.
+  bool Get(TickerId id, Sample* sample) const;
+
+  // Contracts not sampled since before now - max_age, or never.
+  size_t CountStale(int64_t now, int64_t max_age) const;
+
+  Stats GetStats() const;
+
+  // Starts and stops the thread that sends the waves.
+  void Start();
+  void Stop();
+
+  // Sends the next wave if the current one ended, and times out its
+  // requests, at now in micros.  Returns the micros until something
+  // is due, or -1 if the universe is empty.
+  int64_t Dispatch(int64_t now);
+
+  // From the EWrapper, for the ids the sampler owns; ts in micros.
+  void OnTickPrice(int64_t ts, TickerId id, TickType field, double price);
+  void OnTickSize(int64_t ts, TickerId id, TickType field, int size);
+  void OnSnapshotEnd(int64_t ts, TickerId id);
+  // Only an error that ends the request, as EndsRequest in
+  // marketdata.hpp, ends it here; warnings are ignored.
+  void OnError(TickerId id, int code);
+
+ private:
+  struct Entry
+  {
+    Contract contract;
+    int64_t sampled_at;
+  };
+
+  // Ends the request of the id if it is in the wave.  Holds mutex_.
+  bool EndRequest(TickerId id);
+
+  // True if a wave can be sent at now.  Holds mutex_.
+  bool Due(int64_t now) const;
+
+  void Run();
+
+  EClient* client_;
+  const TickerId first_id_;
+  const size_t capacity_;
+  const size_t wave_size_;
+  const int64_t cycle_micros_;
+  const int64_t timeout_micros_;
+
+  QuoteTable quotes_;
+
+  mutable boost::mutex mutex_;
+  boost::condition_variable wave_ended_;
+  std::vector<Entry> entries_;             // By id - first_id_.
+  std::map<std::string, TickerId> symbols_;
+  std::map<TickerId, int64_t> wave_;       // Pending, and sent at.
+  size_t next_;                            // Next entry to request.
+  int64_t cycle_started_;                  // 0 before the first.
+  Stats stats_;
+  volatile bool stop_;
+
+  boost::scoped_ptr<boost::thread> thread_;
+};
+
+} // namespace ib
+
+#endif // IB_SNAPSHOT_SAMPLER_H_
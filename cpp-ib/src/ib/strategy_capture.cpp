@@ -0,0 +1,368 @@
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "utils.hpp"
+#include "ib/strategy_capture.hpp"
+
+#define VLOG_LEVEL 2
+
+DEFINE_int32(capture_idle_micros, 1000,
+             "Sleep of the capture writer when its queue is empty.");
+
+using namespace std;
+using lab616::utils::now_micros;
+
+namespace ib {
+
+// Start of a capture file; the record size catches a file written by
+// another layout.
+struct CaptureHeader
+{
+  char magic[8];
+  uint32_t record_size;
+  uint32_t reserved;
+};
+
+static const char CAPTURE_MAGIC[8] = { 'I', 'B', 'C', 'A', 'P', 'T', '0', '1' };
+static const size_t BATCH = 1024;
+
+// Threads are numbered as first seen by any capture, so records stay
+// small and the numbers read well.
+static volatile int next_thread_ = 0;
+static __thread int thread_index_ = -1;
+
+static inline uint16_t ThreadIndex()
+{
+  if (thread_index_ < 0) {
+    thread_index_ = __sync_fetch_and_add(&next_thread_, 1);
+  }
+  return static_cast<uint16_t>(thread_index_);
+}
+
+// Sets the fields of a captured BidAsk or Last, from ForEachField.
+struct FieldCapture
+{
+  explicit FieldCapture(CapturedEvent* e) : event(e) {}
+
+  void OnField(int64_t ts, int id, QuoteFields::Field field, double value)
+  {
+    switch (field) {
+      case QuoteFields::BID:
+        event->fields |= CapturedEvent::BID_PRICE;
+        event->price = value;
+        break;
+      case QuoteFields::BID_SIZE:
+        event->fields |= CapturedEvent::BID_SIZE;
+        event->size = static_cast<int32_t>(value);
+        break;
+      case QuoteFields::ASK:
+        event->fields |= CapturedEvent::ASK_PRICE;
+        event->ask_price = value;
+        break;
+      case QuoteFields::ASK_SIZE:
+        event->fields |= CapturedEvent::ASK_SIZE;
+        event->ask_size = static_cast<int32_t>(value);
+        break;
+      case QuoteFields::LAST:
+        event->fields |= CapturedEvent::PRICE;
+        event->price = value;
+        break;
+      case QuoteFields::LAST_SIZE:
+        event->fields |= CapturedEvent::SIZE;
+        event->size = static_cast<int32_t>(value);
+        break;
+    }
+  }
+
+  CapturedEvent* event;
+};
+
+static inline bool Less(const CapturedEvent& a, const CapturedEvent& b)
+{
+  return a.seq < b.seq;
+}
+
+StrategyCapture::StrategyCapture(const string& path,
+                                 const StrategyReceivers& receivers,
+                                 size_t capacity)
+    : path_(path)
+    , receivers_(receivers)
+    , queue_(capacity)
+    , file_(NULL)
+    , stop_requested_(false)
+    , seq_(0)
+    , enqueued_(0)
+    , written_(0)
+    , dropped_(0)
+{
+  batch_.reserve(BATCH);
+}
+
+StrategyCapture::~StrategyCapture()
+{
+  Stop();
+}
+
+void StrategyCapture::Register(BackPlane* backplane,
+                               signal::Selection* selection)
+{
+  if (receivers_.connect) {
+    backplane->Register(static_cast<Receiver<Connect>*>(this), selection);
+  }
+  if (receivers_.disconnect) {
+    backplane->Register(static_cast<Receiver<Disconnect>*>(this),
+                        selection);
+  }
+  if (receivers_.bid_ask) {
+    backplane->Register(static_cast<Receiver<BidAsk>*>(this), selection);
+  }
+  if (receivers_.last) {
+    backplane->Register(static_cast<Receiver<Last>*>(this), selection);
+  }
+}
+
+bool StrategyCapture::Start()
+{
+  CHECK(!writer_thread_);
+  file_ = fopen(path_.c_str(), "w");
+  if (!file_) {
+    PLOG(ERROR) << "Cannot create capture " << path_;
+    return false;
+  }
+  CaptureHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+  header.record_size = sizeof(CapturedEvent);
+  if (fwrite(&header, sizeof(header), 1, file_) != 1) {
+    PLOG(ERROR) << "Cannot write capture " << path_;
+    fclose(file_);
+    file_ = NULL;
+    return false;
+  }
+  stop_requested_ = false;
+  writer_thread_.reset(new boost::thread(
+      boost::bind(&StrategyCapture::WriterLoop, this)));
+  return true;
+}
+
+void StrategyCapture::Stop()
+{
+  if (!writer_thread_) return;
+  stop_requested_ = true;
+  writer_thread_->join();
+  writer_thread_.reset();
+  fclose(file_);
+  file_ = NULL;
+  LOG(INFO) << "Capture " << path_ << " stopped: written=" << written_
+            << ",dropped=" << dropped_;
+}
+
+void StrategyCapture::Flush()
+{
+  int64_t target = enqueued_;
+  while (written_ < target && writer_thread_) {
+    lab616::utils::sleep_micros(FLAGS_capture_idle_micros);
+  }
+}
+
+void StrategyCapture::operator()(const Connect& connect)
+{
+  CapturedEvent event;
+  memset(&event, 0, sizeof(event));
+  event.kind = CapturedEvent::CONNECT;
+  event.ts = connect.time_stamp();
+  event.id = connect.id();
+  Enqueue(&event);
+  (*receivers_.connect)(connect);
+}
+
+void StrategyCapture::operator()(const Disconnect& disconnect)
+{
+  CapturedEvent event;
+  memset(&event, 0, sizeof(event));
+  event.kind = CapturedEvent::DISCONNECT;
+  event.ts = disconnect.time_stamp();
+  event.id = disconnect.id();
+  Enqueue(&event);
+  (*receivers_.disconnect)(disconnect);
+}
+
+void StrategyCapture::operator()(const BidAsk& bid_ask)
+{
+  CapturedEvent event;
+  memset(&event, 0, sizeof(event));
+  event.kind = CapturedEvent::BID_ASK;
+  event.ts = bid_ask.time_stamp();
+  event.id = bid_ask.id();
+  FieldCapture capture(&event);
+  ForEachField(bid_ask, &capture);
+  Enqueue(&event);
+  (*receivers_.bid_ask)(bid_ask);
+}
+
+void StrategyCapture::operator()(const Last& last)
+{
+  CapturedEvent event;
+  memset(&event, 0, sizeof(event));
+  event.kind = CapturedEvent::LAST;
+  event.ts = last.time_stamp();
+  event.id = last.id();
+  FieldCapture capture(&event);
+  ForEachField(last, &capture);
+  Enqueue(&event);
+  (*receivers_.last)(last);
+}
+
+void StrategyCapture::Enqueue(CapturedEvent* event)
+{
+  // Taken in the order the strategy is called; the seq of a dropped
+  // record is a gap the replay reports.
+  event->seq = __sync_fetch_and_add(&seq_, 1);
+  event->delivered = now_micros();
+  event->thread = ThreadIndex();
+  if (!writer_thread_ || !queue_.Push(*event)) {
+    __sync_fetch_and_add(&dropped_, 1);
+    LOG_EVERY_N(WARNING, 1000) << "Capture " << path_ << " dropped "
+                               << dropped_;
+    return;
+  }
+  __sync_fetch_and_add(&enqueued_, 1);
+}
+
+int StrategyCapture::WriteBatch()
+{
+  batch_.clear();
+  CapturedEvent event;
+  while (batch_.size() < BATCH && queue_.Pop(&event)) {
+    batch_.push_back(event);
+  }
+  if (batch_.empty()) return 0;
+  if (fwrite(&batch_[0], sizeof(CapturedEvent), batch_.size(), file_) !=
+      batch_.size()) {
+    LOG_EVERY_N(ERROR, 1000) << "Cannot write capture " << path_;
+  }
+  // Written out at every batch, so a crash loses little.
+  fflush(file_);
+  written_ += batch_.size();
+  return batch_.size();
+}
+
+void StrategyCapture::WriterLoop()
+{
+  VLOG(VLOG_LEVEL) << "Capture writer started for " << path_;
+  while (!stop_requested_) {
+    if (WriteBatch() == 0) {
+      lab616::utils::sleep_micros(FLAGS_capture_idle_micros);
+    }
+  }
+  while (WriteBatch() > 0) {}
+  VLOG(VLOG_LEVEL) << "Capture writer stopped.";
+}
+
+bool CaptureReplay::Load(const string& path)
+{
+  events_.clear();
+  missing_ = 0;
+  FILE* file = fopen(path.c_str(), "r");
+  if (!file) {
+    PLOG(ERROR) << "Cannot open capture " << path;
+    return false;
+  }
+  CaptureHeader header;
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      memcmp(header.magic, CAPTURE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.record_size != sizeof(CapturedEvent)) {
+    LOG(ERROR) << path << " is not a capture of this layout.";
+    fclose(file);
+    return false;
+  }
+  CapturedEvent buffer[BATCH];
+  size_t n;
+  while ((n = fread(buffer, sizeof(CapturedEvent), BATCH, file)) > 0) {
+    events_.insert(events_.end(), buffer, buffer + n);
+  }
+  fclose(file);
+
+  // Threads race between taking a seq and queueing the record, so the
+  // file is only nearly in logical time.
+  stable_sort(events_.begin(), events_.end(), Less);
+  uint64_t expected = 0;
+  for (size_t i = 0; i < events_.size(); ++i) {
+    missing_ += events_[i].seq - expected;
+    expected = events_[i].seq + 1;
+  }
+  VLOG(VLOG_LEVEL) << "Loaded " << events_.size() << " events from "
+                   << path << ", " << missing_ << " missing.";
+  return true;
+}
+
+size_t CaptureReplay::Replay(const StrategyReceivers& receivers) const
+{
+  // One of each, reused: the events are rebuilt in place.
+  Connect connect;
+  Disconnect disconnect;
+  BidAsk bid_ask;
+  Last last;
+  size_t delivered = 0;
+  for (size_t i = 0; i < events_.size(); ++i) {
+    const CapturedEvent& event = events_[i];
+    switch (event.kind) {
+      case CapturedEvent::CONNECT:
+        if (!receivers.connect) break;
+        connect.set_time_stamp(event.ts);
+        connect.set_id(event.id);
+        (*receivers.connect)(connect);
+        delivered++;
+        break;
+      case CapturedEvent::DISCONNECT:
+        if (!receivers.disconnect) break;
+        disconnect.set_time_stamp(event.ts);
+        disconnect.set_id(event.id);
+        (*receivers.disconnect)(disconnect);
+        delivered++;
+        break;
+      case CapturedEvent::BID_ASK:
+        if (!receivers.bid_ask) break;
+        bid_ask.Clear();
+        bid_ask.set_time_stamp(event.ts);
+        bid_ask.set_id(event.id);
+        if (event.fields & CapturedEvent::BID_PRICE) {
+          bid_ask.mutable_bid()->set_price(event.price);
+        }
+        if (event.fields & CapturedEvent::BID_SIZE) {
+          bid_ask.mutable_bid()->set_size(event.size);
+        }
+        if (event.fields & CapturedEvent::ASK_PRICE) {
+          bid_ask.mutable_ask()->set_price(event.ask_price);
+        }
+        if (event.fields & CapturedEvent::ASK_SIZE) {
+          bid_ask.mutable_ask()->set_size(event.ask_size);
+        }
+        (*receivers.bid_ask)(bid_ask);
+        delivered++;
+        break;
+      case CapturedEvent::LAST:
+        if (!receivers.last) break;
+        last.Clear();
+        last.set_time_stamp(event.ts);
+        last.set_id(event.id);
+        if (event.fields & CapturedEvent::PRICE) last.set_price(event.price);
+        if (event.fields & CapturedEvent::SIZE) last.set_size(event.size);
+        (*receivers.last)(last);
+        delivered++;
+        break;
+      default:
+        LOG(WARNING) << "Unknown event kind " << int(event.kind);
+    }
+  }
+  return delivered;
+}
+
+} // namespace ib
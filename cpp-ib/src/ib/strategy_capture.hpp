@@ -0,0 +1,158 @@
+#ifndef IB_STRATEGY_CAPTURE_H_
+#define IB_STRATEGY_CAPTURE_H_
+
+// Capture of everything a strategy is handed by the BackPlane, and
+// exact replay of it in isolation, to debug a strategy that
+// misbehaved in production.
+//
+// A StrategyCapture stands between the BackPlane and the receivers
+// of one strategy: it is registered in their place, copies each
+// event into a fixed-size record and then calls the strategy's
+// receiver on the same thread.  A record carries the event, a
+// logical timestamp (the order of delivery over all the threads that
+// deliver to the strategy), the time it was delivered and the thread
+// it came on.  As in the AuditLog, the delivering thread only pushes
+// the record on a lock-free queue; a writer thread appends batches to
+// the file.  A full queue drops the record and counts it rather than
+// stall the feed, and the replay sees the gap.
+//
+// CaptureReplay reads a capture back and calls the receivers of a
+// fresh strategy with the same events in the same order, on the
+// calling thread and as fast as it can.
+//
+// The file is a header and then the records as they are in memory:
+// it is meant to be read back on the same kind of box.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "common.hpp"
+#include "lockfree.hpp"
+#include "ib/backplane.hpp"
+
+namespace ib {
+
+// The receivers of a strategy; NULL for the events it does not take.
+struct StrategyReceivers
+{
+  StrategyReceivers()
+      : connect(NULL), disconnect(NULL), bid_ask(NULL), last(NULL) {}
+
+  Receiver<Connect>* connect;
+  Receiver<Disconnect>* disconnect;
+  Receiver<BidAsk>* bid_ask;
+  Receiver<Last>* last;
+};
+
+struct CapturedEvent
+{
+  enum Kind { CONNECT = 0, DISCONNECT, BID_ASK, LAST };
+
+  // Fields set in the event.
+  enum Field {
+    BID_PRICE = 1, BID_SIZE = 2, ASK_PRICE = 4, ASK_SIZE = 8,
+    PRICE = 16, SIZE = 32
+  };
+
+  uint64_t seq;         // Logical time, from 0.
+  int64_t ts;           // time_stamp of the event.
+  int64_t delivered;    // Micros, when the strategy was called.
+  int32_t id;
+  uint16_t thread;      // Delivering thread, numbered as first seen.
+  uint8_t kind;
+  uint8_t fields;
+  double price;         // Bid price, or last price.
+  double ask_price;
+  int32_t size;         // Bid size, or last size.
+  int32_t ask_size;
+};
+
+class StrategyCapture : public Receiver<Connect>,
+                        public Receiver<Disconnect>,
+                        public Receiver<BidAsk>,
+                        public Receiver<Last>
+{
+ public:
+  // Records to path the events for the receivers, which are not
+  // owned.  The queue holds capacity records, a power of 2.
+  StrategyCapture(const std::string& path,
+                  const StrategyReceivers& receivers,
+                  size_t capacity = 1 << 16);
+  ~StrategyCapture();
+
+  // Registers in place of the strategy's receivers, for the events it
+  // takes, behind the selection if any.
+  void Register(BackPlane* backplane, signal::Selection* selection = NULL);
+
+  // Starts the writer thread.  Returns false if the file cannot be
+  // created; the events are then delivered but not recorded.
+  bool Start();
+
+  // Writes what is queued and closes the file, once nothing is
+  // delivered any more.
+  void Stop();
+
+  // Blocks until the records queued before the call are written.
+  void Flush();
+
+  virtual void operator()(const Connect& connect);
+  virtual void operator()(const Disconnect& disconnect);
+  virtual void operator()(const BidAsk& bid_ask);
+  virtual void operator()(const Last& last);
+
+  int64_t written() const { return written_; }
+  int64_t dropped() const { return dropped_; }
+
+ private:
+  void Enqueue(CapturedEvent* event);
+  int WriteBatch();
+  void WriterLoop();
+
+  const std::string path_;
+  const StrategyReceivers receivers_;
+  lab616::lockfree::BoundedQueue<CapturedEvent> queue_;
+  std::vector<CapturedEvent> batch_;
+  FILE* file_;
+
+  boost::scoped_ptr<boost::thread> writer_thread_;
+  volatile bool stop_requested_;
+
+  volatile uint64_t seq_;
+  volatile int64_t enqueued_;
+  volatile int64_t written_;
+  volatile int64_t dropped_;
+};
+
+class CaptureReplay : NoCopyAndAssign
+{
+ public:
+  CaptureReplay() : missing_(0) {}
+
+  // Reads the capture.  Returns false if it is not one or cannot be
+  // read.
+  bool Load(const std::string& path);
+
+  // In logical time.
+  const std::vector<CapturedEvent>& events() const { return events_; }
+
+  // Events dropped at capture, from the gaps in logical time.
+  uint64_t missing() const { return missing_; }
+
+  // Calls the receivers with the events, in order, on this thread.
+  // Returns the number delivered; events the strategy does not take
+  // are skipped.
+  size_t Replay(const StrategyReceivers& receivers) const;
+
+ private:
+  std::vector<CapturedEvent> events_;
+  uint64_t missing_;
+};
+
+} // namespace ib
+
+#endif // IB_STRATEGY_CAPTURE_H_
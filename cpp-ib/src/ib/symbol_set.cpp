@@ -0,0 +1,224 @@
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <glog/logging.h>
+
+#include "ib/symbol_set.hpp"
+#include "ib/ticker_id.hpp"
+
+using namespace std;
+using lab616::lockfree::load_acquire;
+using lab616::lockfree::store_release;
+
+namespace ib {
+namespace signal {
+
+TickerIndex& TickerIndex::Instance()
+{
+  static TickerIndex* instance = new TickerIndex();
+  return *instance;
+}
+
+// The hash is kept at most half full.
+TickerIndex::TickerIndex()
+    : keys_(new int[CAPACITY * 2])
+    , indexes_(new int[CAPACITY * 2])
+    , ids_(new int[CAPACITY])
+    , size_(0)
+{
+  for (int i = 0; i < CAPACITY * 2; ++i) {
+    keys_[i] = 0;
+    indexes_[i] = -1;
+  }
+}
+
+TickerIndex::~TickerIndex()
+{
+  delete[] keys_;
+  delete[] indexes_;
+  delete[] ids_;
+}
+
+static inline size_t Hash(int id)
+{
+  // Ticker ids are symbol codes shifted left; mix the high bits down.
+  uint32_t h = static_cast<uint32_t>(id) * 2654435761U;
+  return h ^ (h >> 16);
+}
+
+int TickerIndex::Find(int id) const
+{
+  const size_t mask = CAPACITY * 2 - 1;
+  for (size_t i = Hash(id) & mask; ; i = (i + 1) & mask) {
+    int key = load_acquire(keys_[i]);
+    if (key == 0) return -1;
+    if (key == id + 1) return load_acquire(indexes_[i]);
+  }
+}
+
+int TickerIndex::Index(int id)
+{
+  int index = Find(id);
+  if (index >= 0) return index;
+
+  boost::mutex::scoped_lock lock(mutex_);
+  index = Find(id);
+  if (index >= 0) return index;
+
+  size_t n = size_;
+  CHECK(n < static_cast<size_t>(CAPACITY)) << "Too many ticker ids: " << n;
+  const size_t mask = CAPACITY * 2 - 1;
+  size_t i = Hash(id) & mask;
+  while (keys_[i] != 0) i = (i + 1) & mask;
+  // The index before the key, so a reader that finds the key has it.
+  ids_[n] = id;
+  store_release(indexes_[i], static_cast<int>(n));
+  store_release(keys_[i], id + 1);
+  store_release(size_, n + 1);
+  return n;
+}
+
+void SymbolSet::Add(int id)
+{
+  size_t index = TickerIndex::Instance().Index(id);
+  if ((index >> 6) >= words_.size()) words_.resize((index >> 6) + 1, 0);
+  words_[index >> 6] |= 1ULL << (index & 63);
+}
+
+void SymbolSet::Add(const string& symbol)
+{
+  Add(internal::SymbolToTickerId(symbol));
+}
+
+void SymbolSet::Remove(int id)
+{
+  int index = TickerIndex::Instance().Find(id);
+  if (index < 0 || static_cast<size_t>(index >> 6) >= words_.size()) return;
+  words_[index >> 6] &= ~(1ULL << (index & 63));
+}
+
+bool SymbolSet::Set(int index, bool value)
+{
+  const size_t word = static_cast<size_t>(index) >> 6;
+  if (index < 0 || word >= words_.size()) return false;
+  volatile uint64_t* bits = &words_[word];
+  const uint64_t bit = 1ULL << (index & 63);
+  *bits = value ? (*bits | bit) : (*bits & ~bit);
+  return true;
+}
+
+void SymbolSet::Reserve(size_t n)
+{
+  const size_t words = (n + 63) >> 6;
+  if (words > words_.size()) words_.resize(words, 0);
+}
+
+size_t SymbolSet::count() const
+{
+  size_t n = 0;
+  for (size_t i = 0; i < words_.size(); ++i) {
+    n += __builtin_popcountll(words_[i]);
+  }
+  return n;
+}
+
+void SymbolSet::GetIds(vector<int>* ids) const
+{
+  const TickerIndex& index = TickerIndex::Instance();
+  for (size_t i = 0; i < words_.size(); ++i) {
+    for (uint64_t w = words_[i]; w; w &= w - 1) {
+      ids->push_back(index.id(i * 64 + __builtin_ctzll(w)));
+    }
+  }
+}
+
+// The word loops, two words at a time with SSE2.  The vectors are not
+// necessarily 16-byte aligned, hence the unaligned loads.
+namespace {
+
+enum Op { OR, AND, AND_NOT };
+
+template <Op op> inline uint64_t Apply(uint64_t a, uint64_t b);
+template <> inline uint64_t Apply<OR>(uint64_t a, uint64_t b) { return a | b; }
+template <> inline uint64_t Apply<AND>(uint64_t a, uint64_t b) { return a & b; }
+template <> inline uint64_t Apply<AND_NOT>(uint64_t a, uint64_t b)
+{
+  return a & ~b;
+}
+
+#ifdef __SSE2__
+template <Op op> inline __m128i Apply(__m128i a, __m128i b);
+template <> inline __m128i Apply<OR>(__m128i a, __m128i b)
+{
+  return _mm_or_si128(a, b);
+}
+template <> inline __m128i Apply<AND>(__m128i a, __m128i b)
+{
+  return _mm_and_si128(a, b);
+}
+template <> inline __m128i Apply<AND_NOT>(__m128i a, __m128i b)
+{
+  return _mm_andnot_si128(b, a);
+}
+#endif
+
+template <Op op>
+void ApplyWords(uint64_t* dst, const uint64_t* src, size_t n)
+{
+  size_t i = 0;
+#ifdef __SSE2__
+  for (; i + 2 <= n; i += 2) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), Apply<op>(a, b));
+  }
+#endif
+  for (; i < n; ++i) dst[i] = Apply<op>(dst[i], src[i]);
+}
+
+} // namespace
+
+SymbolSet& SymbolSet::operator|=(const SymbolSet& other)
+{
+  if (other.words_.size() > words_.size()) {
+    words_.resize(other.words_.size(), 0);
+  }
+  if (!other.words_.empty()) {
+    ApplyWords<OR>(&words_[0], &other.words_[0], other.words_.size());
+  }
+  return *this;
+}
+
+SymbolSet& SymbolSet::operator&=(const SymbolSet& other)
+{
+  if (words_.size() > other.words_.size()) {
+    words_.resize(other.words_.size());
+  }
+  if (!words_.empty()) {
+    ApplyWords<AND>(&words_[0], &other.words_[0], words_.size());
+  }
+  return *this;
+}
+
+SymbolSet& SymbolSet::operator-=(const SymbolSet& other)
+{
+  size_t n = min(words_.size(), other.words_.size());
+  if (n) ApplyWords<AND_NOT>(&words_[0], &other.words_[0], n);
+  return *this;
+}
+
+bool SymbolSet::operator==(const SymbolSet& other) const
+{
+  const vector<uint64_t>& a = words_;
+  const vector<uint64_t>& b = other.words_;
+  size_t n = min(a.size(), b.size());
+  for (size_t i = 0; i < n; ++i) if (a[i] != b[i]) return false;
+  for (size_t i = n; i < a.size(); ++i) if (a[i]) return false;
+  for (size_t i = n; i < b.size(); ++i) if (b[i]) return false;
+  return true;
+}
+
+} // namespace signal
+} // namespace ib
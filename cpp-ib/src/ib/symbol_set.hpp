@@ -0,0 +1,105 @@
+#ifndef IB_SYMBOL_SET_H_
+#define IB_SYMBOL_SET_H_
+
+// Sets of ticker ids as dense bitsets.
+//
+// Ticker ids are sparse (symbol codes shifted left, see ticker_id.hpp),
+// so every id is first given a small index, in order of first use, by
+// the process-wide TickerIndex.  A SymbolSet is then one bit per index:
+// membership is a bit test, after a hash probe for the index unless
+// the caller has it, as the BackPlane's events do, and union,
+// intersection and difference of universes run over whole words with
+// SSE2.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "common.hpp"
+#include "lockfree.hpp"
+
+namespace ib {
+namespace signal {
+
+class TickerIndex : NoCopyAndAssign
+{
+ public:
+  enum { CAPACITY = 1 << 15 };
+
+  static TickerIndex& Instance();
+
+  // Index of the id, or -1 if it has none yet.  Lock free.
+  int Find(int id) const;
+
+  // Index of the id, assigned if new.  Dies past CAPACITY ids.
+  int Index(int id);
+
+  // The id of an index below size().
+  int id(int index) const { return ids_[index]; }
+
+  size_t size() const { return lab616::lockfree::load_acquire(size_); }
+
+ private:
+  TickerIndex();
+  ~TickerIndex();
+
+  boost::mutex mutex_;           // Serializes Index.
+  volatile int* const keys_;     // Open addressed: id + 1, 0 if empty.
+  volatile int* const indexes_;
+  volatile int* const ids_;      // Index to id.
+  volatile size_t size_;
+};
+
+class SymbolSet
+{
+ public:
+  SymbolSet() {}
+
+  void Add(int id);
+  void Add(const std::string& symbol);
+  void Remove(int id);
+
+  // Sets or clears the bit of the index where it is, if the set has
+  // its word; returns false if the set must grow first.  A reader
+  // testing the bit meanwhile sees either value.
+  bool Set(int index, bool value);
+
+  // Makes room for the indexes below n.
+  void Reserve(size_t n);
+
+  inline bool Contains(int id) const
+  {
+    return Test(TickerIndex::Instance().Find(id));
+  }
+
+  // Membership by TickerIndex index.
+  inline bool Test(int index) const
+  {
+    size_t word = static_cast<size_t>(index) >> 6;
+    return index >= 0 && word < words_.size() &&
+        ((words_[word] >> (index & 63)) & 1);
+  }
+
+  size_t count() const;
+  bool empty() const { return count() == 0; }
+
+  // The ids in the set, in index order.
+  void GetIds(std::vector<int>* ids) const;
+
+  SymbolSet& operator|=(const SymbolSet& other);  // Union.
+  SymbolSet& operator&=(const SymbolSet& other);  // Intersection.
+  SymbolSet& operator-=(const SymbolSet& other);  // Difference.
+
+  bool operator==(const SymbolSet& other) const;
+
+ private:
+  std::vector<uint64_t> words_;  // Trailing zero words are allowed.
+};
+
+} // namespace signal
+} // namespace ib
+
+#endif // IB_SYMBOL_SET_H_
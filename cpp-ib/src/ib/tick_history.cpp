@@ -0,0 +1,331 @@
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#include <glog/logging.h>
+
+#include "ib/tick_history.hpp"
+
+using namespace std;
+
+namespace ib {
+namespace history {
+
+// Bits are appended from the least significant end of each word.
+struct TickSeries::Block
+{
+  Block() : first_ts(0), last_ts(0), count(0), bits(0) {}
+
+  void Write(uint64_t value, int n)
+  {
+    if (n < 64) value &= (1ULL << n) - 1;
+    const int offset = bits & 63;
+    if (offset == 0) {
+      words.push_back(value);
+    } else {
+      words.back() |= value << offset;
+      if (n > 64 - offset) words.push_back(value >> (64 - offset));
+    }
+    bits += n;
+  }
+
+  int64_t first_ts;
+  int64_t last_ts;
+  size_t count;
+  size_t bits;
+  vector<uint64_t> words;
+};
+
+namespace {
+
+class BitReader
+{
+ public:
+  explicit BitReader(const vector<uint64_t>& words)
+      : words_(&words[0]), pos_(0) {}
+
+  inline uint64_t Read(int n)
+  {
+    const size_t word = pos_ >> 6;
+    const int offset = pos_ & 63;
+    uint64_t value = words_[word] >> offset;
+    if (n > 64 - offset) value |= words_[word + 1] << (64 - offset);
+    if (n < 64) value &= (1ULL << n) - 1;
+    pos_ += n;
+    return value;
+  }
+
+  // Number of 1 bits before a 0, at most max.
+  inline int ReadPrefix(int max)
+  {
+    int n = 0;
+    while (n < max && Read(1)) ++n;
+    return n;
+  }
+
+ private:
+  const uint64_t* words_;
+  size_t pos_;
+};
+
+inline uint64_t ToBits(double value)
+{
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+inline double FromBits(uint64_t bits)
+{
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Timestamp buckets by prefix length: 10, 110, 1110 and 1111.
+const int kDeltaBits[] = { 7, 12, 20, 64 };
+
+} // namespace
+
+TickSeries::TickSeries(double scale)
+    : scale_(scale)
+    , size_(0)
+    , last_ts_(0)
+    , last_delta_(0)
+    , last_bits_(0)
+    , last_value_(0)
+    , leading_(-1)
+    , trailing_(0)
+{
+}
+
+TickSeries::~TickSeries()
+{
+  for (size_t i = 0; i < blocks_.size(); ++i) delete blocks_[i];
+}
+
+void TickSeries::Append(int64_t ts, double value)
+{
+  uint64_t bits = ToBits(value);
+  bool raw = false;
+  if (scale_ > 0) {
+    const double scaled = nearbyint(value * scale_);
+    bits = ToBits(scaled);
+    raw = scaled / scale_ != value;
+  }
+  if (blocks_.empty() || blocks_.back()->count == BLOCK_TICKS) {
+    if (!blocks_.empty()) {
+      // Closed for good: give back the slack.
+      vector<uint64_t>(blocks_.back()->words).swap(blocks_.back()->words);
+    }
+    Block* block = new Block();
+    block->first_ts = ts;
+    block->Write(ts, 64);
+    if (raw) {
+      block->Write(1, 1);
+      block->Write(ToBits(value), 64);
+      bits = 0;
+    } else {
+      block->Write(0, 1);
+      block->Write(bits, 64);
+    }
+    blocks_.push_back(block);
+    last_delta_ = 0;
+    leading_ = -1;
+  } else {
+    Block* block = blocks_.back();
+
+    const int64_t delta = ts - last_ts_;
+    const int64_t dod = delta - last_delta_;
+    const uint64_t zigzag = (static_cast<uint64_t>(dod) << 1) ^
+        static_cast<uint64_t>(dod >> 63);
+    if (zigzag == 0) {
+      block->Write(0, 1);
+    } else {
+      int bucket = 0;
+      while (bucket < 3 && zigzag >= (1ULL << kDeltaBits[bucket])) ++bucket;
+      // 1s then a 0, except for the last bucket.
+      block->Write((1ULL << (bucket + 1)) - 1, bucket + 1);
+      if (bucket < 3) block->Write(0, 1);
+      block->Write(zigzag, kDeltaBits[bucket]);
+    }
+    last_delta_ = delta;
+
+    const uint64_t x = bits ^ last_bits_;
+    if (raw) {
+      block->Write(7, 3);  // 111
+      block->Write(ToBits(value), 64);
+      bits = last_bits_;
+    } else if (x == 0) {
+      block->Write(0, 1);
+    } else {
+      int leading = min(__builtin_clzll(x), 31);
+      int trailing = __builtin_ctzll(x);
+      if (leading_ >= 0 && leading >= leading_ && trailing >= trailing_) {
+        block->Write(1, 2);  // 10
+        block->Write(x >> trailing_, 64 - leading_ - trailing_);
+      } else {
+        const int length = 64 - leading - trailing;
+        block->Write(3, 3);  // 110
+        block->Write(leading, 5);
+        block->Write(length - 1, 6);
+        block->Write(x >> trailing, length);
+        leading_ = leading;
+        trailing_ = trailing;
+      }
+    }
+  }
+  Block* block = blocks_.back();
+  block->last_ts = ts;
+  block->count++;
+  last_ts_ = ts;
+  last_bits_ = bits;
+  last_value_ = value;
+  size_++;
+}
+
+size_t TickSeries::bytes() const
+{
+  size_t n = 0;
+  for (size_t i = 0; i < blocks_.size(); ++i) n += (blocks_[i]->bits + 7) / 8;
+  return n;
+}
+
+Tick TickSeries::back() const
+{
+  CHECK(size_ > 0);
+  Tick tick = { last_ts_, last_value_ };
+  return tick;
+}
+
+inline double TickSeries::Value(uint64_t bits) const
+{
+  return scale_ > 0 ? FromBits(bits) / scale_ : FromBits(bits);
+}
+
+void TickSeries::Decode(const Block& block, size_t skip, int64_t since,
+                        vector<Tick>* out) const
+{
+  BitReader in(block.words);
+  Tick tick;
+  tick.ts = in.Read(64);
+  uint64_t bits = 0;
+  if (in.Read(1)) {
+    tick.value = FromBits(in.Read(64));
+  } else {
+    bits = in.Read(64);
+    tick.value = Value(bits);
+  }
+  if (skip == 0 && tick.ts >= since) out->push_back(tick);
+
+  int64_t delta = 0;
+  int leading = 0, trailing = 0;
+  for (size_t i = 1; i < block.count; ++i) {
+    const int bucket = in.ReadPrefix(4);
+    if (bucket > 0) {
+      uint64_t zigzag = in.Read(kDeltaBits[bucket - 1]);
+      delta += static_cast<int64_t>(zigzag >> 1) ^
+          -static_cast<int64_t>(zigzag & 1);
+    }
+    tick.ts += delta;
+
+    const int code = in.ReadPrefix(3);
+    if (code == 3) {
+      tick.value = FromBits(in.Read(64));
+    } else if (code > 0) {
+      if (code == 2) {
+        leading = in.Read(5);
+        const int length = in.Read(6) + 1;
+        trailing = 64 - leading - length;
+      }
+      bits ^= in.Read(64 - leading - trailing) << trailing;
+      tick.value = Value(bits);
+    } else {
+      tick.value = Value(bits);
+    }
+    if (i >= skip && tick.ts >= since) out->push_back(tick);
+  }
+}
+
+void TickSeries::Last(size_t n, vector<Tick>* out) const
+{
+  n = min(n, size_);
+  if (n == 0) return;
+  size_t covered = 0;
+  size_t b = blocks_.size();
+  while (covered < n) covered += blocks_[--b]->count;
+  size_t skip = covered - n;
+  for (; b < blocks_.size(); ++b, skip = 0) {
+    Decode(*blocks_[b], skip, LLONG_MIN, out);
+  }
+}
+
+void TickSeries::Since(int64_t ts, vector<Tick>* out) const
+{
+  // Binary search for the first block that ends at or after ts; the
+  // ones before it are not decoded.
+  size_t lo = 0, hi = blocks_.size();
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (blocks_[mid]->last_ts < ts) lo = mid + 1; else hi = mid;
+  }
+  for (; lo < blocks_.size(); ++lo) Decode(*blocks_[lo], 0, ts, out);
+}
+
+TickHistory::TickHistory(double price_scale)
+    : price_scale_(price_scale)
+{
+}
+
+TickHistory::~TickHistory()
+{
+  for (SeriesMap::iterator i = series_.begin(); i != series_.end(); ++i) {
+    delete i->second;
+  }
+}
+
+static inline int64_t SeriesKey(int id, QuoteTable::Field field)
+{
+  return (static_cast<int64_t>(id) << 3) | field;
+}
+
+void TickHistory::Append(int64_t ts, int id, QuoteTable::Field field,
+                         double value)
+{
+  TickSeries*& series = series_[SeriesKey(id, field)];
+  if (series == NULL) {
+    const bool price = field == QuoteTable::BID || field == QuoteTable::ASK ||
+        field == QuoteTable::LAST;
+    series = new TickSeries(price ? price_scale_ : 0);
+  }
+  series->Append(ts, value);
+}
+
+const TickSeries* TickHistory::Find(int id, QuoteTable::Field field) const
+{
+  SeriesMap::const_iterator i = series_.find(SeriesKey(id, field));
+  return i == series_.end() ? NULL : i->second;
+}
+
+size_t TickHistory::ticks() const
+{
+  size_t n = 0;
+  for (SeriesMap::const_iterator i = series_.begin(); i != series_.end(); ++i) {
+    n += i->second->size();
+  }
+  return n;
+}
+
+size_t TickHistory::bytes() const
+{
+  size_t n = 0;
+  for (SeriesMap::const_iterator i = series_.begin(); i != series_.end(); ++i) {
+    n += i->second->bytes();
+  }
+  return n;
+}
+
+} // namespace history
+} // namespace ib
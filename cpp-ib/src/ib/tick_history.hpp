@@ -0,0 +1,134 @@
+#ifndef IB_TICK_HISTORY_H_
+#define IB_TICK_HISTORY_H_
+
+// Compressed in-memory history of the ticks of every id and field, so
+// a whole session stays in RAM at a few bytes per tick.
+//
+// Ticks are kept in blocks of up to BLOCK_TICKS, encoded as in
+// Facebook's Gorilla: the first tick of a block in full (the value
+// after a bit that says whether it is raw), then
+//
+//   timestamps  delta of delta, zigzag encoded, in a prefix code:
+//                 0                 unchanged interval
+//                 10   + 7 bits
+//                 110  + 12 bits
+//                 1110 + 20 bits
+//                 1111 + 64 bits
+//   values      XOR with the previous value:
+//                 0                 same value
+//                 10 + bits         fits in the previous window of
+//                                   meaningful bits
+//                 110 + 5 bits of leading zeros, 6 bits of length
+//                     + the meaningful bits
+//                 111 + 64 bits     raw, off the price grid
+//
+// Decimal prices XOR badly as doubles (0.01 has no exact binary form),
+// so a series may be given a scale, e.g. 100 for cents: values are
+// then kept as the integral doubles value * scale, whose XOR has a few
+// meaningful bits, and divided back on decode.  Values that would not
+// come back exactly are stored raw.  Sizes are integral and need no
+// scale.
+//
+// Timestamps may step back (the deltas are signed) but Since()
+// assumes they do not.  A series is written by one thread and read on
+// that thread, or under the caller's lock.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <vector>
+
+#include "common.hpp"
+#include "ib/backplane.hpp"
+#include "ib/quote_table.hpp"
+
+namespace ib {
+namespace history {
+
+struct Tick
+{
+  int64_t ts;
+  double value;
+};
+
+// One field of one id.
+class TickSeries : NoCopyAndAssign
+{
+ public:
+  enum { BLOCK_TICKS = 1024 };
+
+  // A scale of 0 keeps the values as they are.
+  explicit TickSeries(double scale = 0);
+  ~TickSeries();
+
+  void Append(int64_t ts, double value);
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Bytes of encoded ticks, excluding the fixed cost of the blocks.
+  size_t bytes() const;
+
+  // The last n ticks (fewer if there are not as many), oldest first,
+  // appended to out.
+  void Last(size_t n, std::vector<Tick>* out) const;
+
+  // The ticks at or after ts, oldest first, appended to out.
+  void Since(int64_t ts, std::vector<Tick>* out) const;
+
+  // Most recent tick.  The series must not be empty.
+  Tick back() const;
+
+ private:
+  struct Block;
+
+  double Value(uint64_t bits) const;
+  void Decode(const Block& block, size_t skip, int64_t since,
+              std::vector<Tick>* out) const;
+
+  const double scale_;
+  std::vector<Block*> blocks_;  // The last one is open.
+  size_t size_;
+
+  // Encoder state for the open block.
+  int64_t last_ts_;
+  int64_t last_delta_;
+  uint64_t last_bits_;  // Of the last value on the grid.
+  double last_value_;
+  int leading_;
+  int trailing_;
+};
+
+// Keeps the history of the market data from the BackPlane.  Register
+// with BackPlane::Register(Receiver<BidAsk>*) and
+// Register(Receiver<Last>*).
+class TickHistory : public FieldReceiver
+{
+ public:
+  // Prices are kept on a grid of 1 / price_scale, see TickSeries.
+  explicit TickHistory(double price_scale = 10000);
+  ~TickHistory();
+
+  virtual void OnField(int64_t ts, int id, Field field, double value)
+  {
+    Append(ts, id, field, value);
+  }
+
+  void Append(int64_t ts, int id, QuoteTable::Field field, double value);
+
+  // NULL if nothing was received for the id and field.
+  const TickSeries* Find(int id, QuoteTable::Field field) const;
+
+  size_t ticks() const;
+  size_t bytes() const;
+
+ private:
+  typedef std::map<int64_t, TickSeries*> SeriesMap;
+  const double price_scale_;
+  SeriesMap series_;
+};
+
+} // namespace history
+} // namespace ib
+
+#endif // IB_TICK_HISTORY_H_
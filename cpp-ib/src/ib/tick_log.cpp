@@ -0,0 +1,154 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sstream>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+#include <glog/logging.h>
+
+#include "ib/tick_log.hpp"
+#include "ib/ticker_id.hpp"
+
+#define DEBUG3 VLOG(30)
+#define DEBUG4 VLOG(40)
+
+namespace ib {
+namespace internal {
+
+static const char* NUMERIC_EVENTS[] = { "tickPrice", "tickSize", "tickGeneric" };
+
+static const uint64_t HOUR_MICROS = 60 * 60 * 1000000LL;
+static const uint64_t DAY_MICROS = 24 * HOUR_MICROS;
+static const int GMT_NY_OFFSET = -5;
+static const int DAY_SECS = 24 * 60 * 60;
+
+// Midnight UTC of the nth Sunday of the month (1-12), or of the last
+// one if n is 0.
+static time_t Sunday(int year, int month, int n)
+{
+  struct tm t = tm();
+  t.tm_year = year - 1900;
+  t.tm_mon = n ? month - 1 : month;  // The month after, for the last.
+  t.tm_mday = 1;
+  const time_t first = timegm(&t);
+  gmtime_r(&first, &t);
+  if (n) return first + ((7 - t.tm_wday) % 7 + 7 * (n - 1)) * DAY_SECS;
+  return first - ((t.tm_wday + 6) % 7 + 1) * DAY_SECS;
+}
+
+// Hours from UTC to New York at the time: daylight time from 2am
+// local on the second Sunday of March to the first of November, or
+// from the first Sunday of April to the last of October before 2007.
+static int NyOffset(uint64_t ts_utc)
+{
+  const time_t secs = static_cast<time_t>(ts_utc / 1000000);
+  struct tm t;
+  gmtime_r(&secs, &t);
+  const int year = t.tm_year + 1900;
+  const time_t start = year >= 2007 ? Sunday(year, 3, 2) : Sunday(year, 4, 1);
+  const time_t end = year >= 2007 ? Sunday(year, 11, 1) : Sunday(year, 10, 0);
+  // 2am standard time is 7am UTC; 2am daylight time is 6am UTC.
+  const bool daylight = secs >= start + 7 * 3600 && secs < end + 6 * 3600;
+  return GMT_NY_OFFSET + (daylight ? 1 : 0);
+}
+
+// Determines if the event has a numeric value.  This corresponds
+// all the IB's tickPrice, tickSize, and tickGeneric events.
+static bool IsMarketDataEvent(map<string, string>& nv)
+{
+  map<string, string>::iterator found = nv.find("event");
+  if (found != nv.end()) {
+    for (int i = 0; i < 3; ++i) {
+      if (found->second.compare(NUMERIC_EVENTS[i]) == 0) return true;
+    }
+  }
+  return false;
+}
+
+static bool Get(map<string, string>& nv, const string& key, const string** out)
+{
+  map<string, string>::iterator found = nv.find(key);
+  if (found == nv.end()) return false;
+  *out = &found->second;
+  return true;
+}
+
+bool ParseEventMap(const string& token, map<string, string>* nv)
+{
+  vector<string> nvpairs;
+  boost::split(nvpairs, token, boost::is_any_of(","));
+  if (nvpairs.empty()) return false;
+
+  for (vector<string>::iterator itr = nvpairs.begin();
+       itr != nvpairs.end(); ++itr) {
+    size_t sep = itr->find('=');
+    if (sep == string::npos) continue;
+    (*nv)[itr->substr(0, sep)] = itr->substr(sep + 1);
+  }
+  DEBUG4 << "Map, size=" << nv->size();
+  return !nv->empty();
+}
+
+bool TickEventFromMap(map<string, string>& nv, TickEvent* event)
+{
+  if (!IsMarketDataEvent(nv)) return false;
+
+  const string* v;
+  if (!Get(nv, "ts_utc", &v)) return false;
+  event->ts = static_cast<uint64_t>(strtoll(v->c_str(), NULL, 10));
+
+  if (!Get(nv, "tickerId", &v)) return false;
+  SymbolFromTickerId(atoi(v->c_str()), &event->symbol);
+  nv["symbol"] = event->symbol;
+
+  if (!Get(nv, "field", &v)) return false;
+  event->event = *v;
+
+  if (!Get(nv, "price", &v) && !Get(nv, "size", &v) &&
+      !Get(nv, "value", &v)) {
+    return false;
+  }
+  event->value = atof(v->c_str());
+
+  DEBUG3 << event->symbol << ' ' << event->event << ' '
+         << event->ts << ' ' << event->value;
+  return true;
+}
+
+bool ParseTickLine(const string& line, TickEvent* event)
+{
+  // The glog prefix is space separated; the event is the one token
+  // with commas in it.
+  istringstream tokens(line);
+  string token;
+  while (tokens >> token) {
+    if (token.find(',') == string::npos) continue;
+    map<string, string> nv;
+    return ParseEventMap(token, &nv) && TickEventFromMap(nv, event);
+  }
+  return false;
+}
+
+string TradeDate(uint64_t ts_utc)
+{
+  time_t secs = static_cast<time_t>(
+      (ts_utc + NyOffset(ts_utc) * static_cast<int64_t>(HOUR_MICROS)) /
+      1000000);
+  struct tm t;
+  gmtime_r(&secs, &t);
+  char buff[16];
+  snprintf(buff, sizeof(buff), "%04d%02d%02d",
+           t.tm_year + 1900, t.tm_mon + 1, t.tm_mday);
+  return buff;
+}
+
+uint64_t MicrosOfDay(uint64_t ts_utc)
+{
+  return (ts_utc + NyOffset(ts_utc) * static_cast<int64_t>(HOUR_MICROS) +
+          DAY_MICROS) % DAY_MICROS;
+}
+
+} // namespace internal
+} // namespace ib
@@ -0,0 +1,52 @@
+#ifndef IB_TICK_LOG_H_
+#define IB_TICK_LOG_H_
+
+// Parsing of the market data events written by LoggingEWrapper, e.g.
+//
+//   I0114 09:30:00.123456 1234 adapters.cpp:100] cid=0,ts_utc=...,
+//       ts=...,event=tickPrice,tickerId=...,field=BID,price=350.5,...
+//
+// Shared by the logreader, the bulk exporters and anything else that
+// reads logger output.
+
+#include <stdint.h>
+#include <map>
+#include <string>
+
+using namespace std;
+
+namespace ib {
+namespace internal {
+
+// A single numeric market data event (tickPrice, tickSize or
+// tickGeneric).
+struct TickEvent {
+  string symbol;
+  string event;   // The tick field, e.g. BID, ASK_SIZE, LAST.
+  uint64_t ts;    // Micros since epoch, UTC.
+  double value;
+};
+
+// Splits the comma separated name=value token into the map.
+bool ParseEventMap(const string& token, map<string, string>* nv);
+
+// Extracts the market data event from the parsed map.  Returns false
+// if this is not a numeric market data event or a field is missing.
+// Sets nv["symbol"] as a side-effect.
+bool TickEventFromMap(map<string, string>& nv, TickEvent* event);
+
+// Parses one line of the log.  Returns false if the line does not
+// carry a market data event.
+bool ParseTickLine(const string& line, TickEvent* event);
+
+// Trading date of the timestamp in New York as YYYYMMDD.  Both take
+// daylight saving time into account, by the US rules of the year.
+string TradeDate(uint64_t ts_utc);
+
+// Micros since midnight New York time.
+uint64_t MicrosOfDay(uint64_t ts_utc);
+
+} // namespace internal
+} // namespace ib
+
+#endif // IB_TICK_LOG_H_
@@ -0,0 +1,286 @@
+
+#include <string.h>
+#include <algorithm>
+#include <exception>
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include <Shared/EWrapper.h>
+#include <Shared/TwsSocketClientErrors.h>
+
+#include "ib/transport/asio_client_socket.hpp"
+
+DEFINE_int32(asio_connect_timeout_millis, 5000,
+             "How long eConnect waits for the gateway to acknowledge.");
+
+using boost::asio::ip::tcp;
+
+namespace ib {
+namespace transport {
+
+AsioClientSocket::AsioClientSocket(boost::asio::io_service& io_service,
+                                   EWrapper* wrapper)
+    : EClientSocketBase(wrapper)
+    , io_service_(io_service)
+    , socket_(io_service)
+    , strand_(io_service)
+    , open_(false)
+    , pending_(NULL)
+    , pending_size_(0)
+    , decoder_(wrapper)
+    , write_in_flight_(false)
+    , outstanding_(0)
+{
+}
+
+AsioClientSocket::~AsioClientSocket()
+{
+  eDisconnect();
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  while (outstanding_ > 0) cond_.wait(lock);
+}
+
+bool AsioClientSocket::eConnect(const char* host, unsigned int port,
+                                int clientId)
+{
+  if (open_) {
+    getWrapper()->error(NO_VALID_ID, ALREADY_CONNECTED.code(),
+                        ALREADY_CONNECTED.msg());
+    return false;
+  }
+
+  // Handlers from a previous connection must be done with the base
+  // class state before it is reused.
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (outstanding_ > 0) cond_.wait(lock);
+  }
+
+  if (!(host && *host)) host = "127.0.0.1";
+
+  boost::system::error_code error;
+  tcp::resolver resolver(io_service_);
+  tcp::resolver::query query(host, boost::lexical_cast<std::string>(port));
+  tcp::resolver::iterator endpoint = resolver.resolve(query, error);
+  error = boost::asio::error::host_not_found;
+  for (; error && endpoint != tcp::resolver::iterator(); ++endpoint) {
+    socket_.close();
+    socket_.connect(*endpoint, error);
+  }
+  if (error) {
+    LOG(WARNING) << "Cannot connect to " << host << ":" << port << ": "
+                 << error.message();
+    socket_.close();
+    getWrapper()->error(NO_VALID_ID, CONNECT_FAIL.code(), CONNECT_FAIL.msg());
+    return false;
+  }
+  // Requests are small; do not let Nagle hold them back.
+  socket_.set_option(tcp::no_delay(true), error);
+
+  open_ = true;
+  setClientId(clientId);
+
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    outstanding_++;
+  }
+  strand_.post(boost::bind(&AsioClientSocket::StartRead, this));
+
+  // Sends the client version; the ack is processed on the strand.
+  onConnectBase();
+
+  boost::system_time deadline = boost::get_system_time() +
+      boost::posix_time::milliseconds(FLAGS_asio_connect_timeout_millis);
+  bool connected;
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (open_ && !isConnected()) {
+      if (!cond_.timed_wait(lock, deadline)) break;
+    }
+    connected = open_ && isConnected();
+  }
+  if (!connected) {
+    eDisconnect();
+    getWrapper()->error(NO_VALID_ID, CONNECT_FAIL.code(), CONNECT_FAIL.msg());
+    return false;
+  }
+  return true;
+}
+
+void AsioClientSocket::eDisconnect()
+{
+  if (!open_) return;
+  open_ = false;
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    outstanding_++;
+  }
+  // Runs inline when called from a callback on the strand, as the
+  // gateway version check in processConnectAck does.
+  strand_.dispatch(boost::bind(&AsioClientSocket::Close, this));
+}
+
+bool AsioClientSocket::isSocketOK() const
+{
+  return open_;
+}
+
+int AsioClientSocket::send(const char* buf, size_t sz)
+{
+  if (!open_) return -1;
+  if (sz == 0) return 0;
+
+  boost::unique_lock<boost::mutex> lock(write_mutex_);
+  outgoing_.insert(outgoing_.end(), buf, buf + sz);
+  if (!write_in_flight_) {
+    write_in_flight_ = true;
+    lock.unlock();
+    {
+      boost::unique_lock<boost::mutex> l(mutex_);
+      outstanding_++;
+    }
+    strand_.post(boost::bind(&AsioClientSocket::StartWrite, this));
+  }
+  // Everything is taken, so the base class never buffers.
+  return sz;
+}
+
+int AsioClientSocket::receive(char* buf, size_t sz)
+{
+  size_t n = std::min(sz, pending_size_);
+  if (n == 0) return 0;
+  memcpy(buf, pending_, n);
+  pending_ += n;
+  pending_size_ -= n;
+  return n;
+}
+
+int AsioClientSocket::decodeMsg(const char* ptr, const char* endPtr)
+{
+  return decoder_.Decode(ptr, endPtr);
+}
+
+void AsioClientSocket::StartRead()
+{
+  if (open_) {
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      outstanding_++;
+    }
+    socket_.async_read_some(
+        boost::asio::buffer(read_buffer_),
+        strand_.wrap(boost::bind(&AsioClientSocket::HandleRead, this,
+                                 boost::asio::placeholders::error,
+                                 boost::asio::placeholders::bytes_transferred)));
+  }
+  Done();
+}
+
+void AsioClientSocket::HandleRead(const boost::system::error_code& error,
+                                  size_t bytes)
+{
+  if (error) {
+    OnError(error);
+    Done();
+    return;
+  }
+
+  pending_ = read_buffer_.data();
+  pending_size_ = bytes;
+  bool connected = isConnected();
+  try {
+    // One read never exceeds what checkMessages() takes in one call.
+    while (pending_size_ > 0 && checkMessages()) {}
+  } catch (const std::exception& e) {
+    LOG(ERROR) << "Exception processing messages: " << e.what();
+    getWrapper()->error(NO_VALID_ID, SOCKET_EXCEPTION.code(),
+                        SOCKET_EXCEPTION.msg() + e.what());
+    eDisconnect();
+  }
+  pending_size_ = 0;
+
+  if (!connected && isConnected()) NotifyConnect();
+  StartRead();  // Balances this handler's Done().
+}
+
+void AsioClientSocket::StartWrite()
+{
+  boost::unique_lock<boost::mutex> lock(write_mutex_);
+  if (!open_ || outgoing_.empty()) {
+    outgoing_.clear();
+    write_in_flight_ = false;
+    lock.unlock();
+    Done();
+    return;
+  }
+  writing_.swap(outgoing_);
+  outgoing_.clear();
+  lock.unlock();
+
+  {
+    boost::unique_lock<boost::mutex> l(mutex_);
+    outstanding_++;
+  }
+  boost::asio::async_write(
+      socket_, boost::asio::buffer(writing_),
+      strand_.wrap(boost::bind(&AsioClientSocket::HandleWrite, this,
+                               boost::asio::placeholders::error,
+                               boost::asio::placeholders::bytes_transferred)));
+  Done();
+}
+
+void AsioClientSocket::HandleWrite(const boost::system::error_code& error,
+                                   size_t)
+{
+  if (error) OnError(error);
+  // Drains whatever was appended while this write was in flight.
+  {
+    boost::unique_lock<boost::mutex> l(mutex_);
+    outstanding_++;
+  }
+  StartWrite();
+  Done();
+}
+
+void AsioClientSocket::Close()
+{
+  boost::system::error_code ignored;
+  socket_.shutdown(tcp::socket::shutdown_both, ignored);
+  socket_.close(ignored);
+  eDisconnectBase();
+  pending_size_ = 0;
+  VLOG(1) << "Disconnected.";
+  Done();
+}
+
+void AsioClientSocket::OnError(const boost::system::error_code& error)
+{
+  // Our own close; nothing to report.
+  if (error == boost::asio::error::operation_aborted || !open_) return;
+
+  if (error != boost::asio::error::eof) {
+    LOG(WARNING) << "Socket error: " << error.message();
+    getWrapper()->error(NO_VALID_ID, SOCKET_EXCEPTION.code(),
+                        SOCKET_EXCEPTION.msg() + error.message());
+  }
+  eDisconnect();
+  getWrapper()->connectionClosed();
+}
+
+void AsioClientSocket::NotifyConnect()
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  cond_.notify_all();
+}
+
+void AsioClientSocket::Done()
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  if (--outstanding_ == 0 || !open_) cond_.notify_all();
+}
+
+} // namespace transport
+} // namespace ib
@@ -0,0 +1,102 @@
+#ifndef IB_TRANSPORT_ASIO_CLIENT_SOCKET_H_
+#define IB_TRANSPORT_ASIO_CLIENT_SOCKET_H_
+
+// EClientSocketBase over Boost.Asio, as an alternative to the vendored
+// EPosixClientSocket plus a dedicated select() thread per session.
+//
+// Reads are asynchronous, into one buffer reused for the life of the
+// connection; each completion runs EClientSocketBase::checkMessages()
+// and so the EWrapper callbacks on an io_service thread.  All reads,
+// writes and the close run on this socket's strand, so callbacks for
+// one session are never concurrent even when the io_service is run by
+// a pool (see io_service_pool.hpp).
+//
+// Messages ib::wire handles (see //cpp-ib/src/ib/wire/messages.hpp)
+// are decoded by it, the rest by EClientSocketBase.
+//
+// Requests (reqMktData, placeOrder, ...) may be made from any thread:
+// send() only appends to an outgoing buffer under a lock and a single
+// async_write on the strand drains it.
+//
+// eConnect() blocks until the gateway has acknowledged the connection
+// and must not be called from an io_service thread.  Likewise the
+// destructor waits for outstanding handlers.
+
+#ifndef IB_USE_STD_STRING
+#define IB_USE_STD_STRING
+#endif
+
+#include <vector>
+
+#include <boost/array.hpp>
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+
+#include <Shared/EClientSocketBase.h>
+#include <Shared/EWrapper.h>
+#include "common.hpp"
+#include "ib/wire/api_traits.hpp"
+#include "ib/wire/decoder.hpp"
+
+namespace ib {
+namespace transport {
+
+class AsioClientSocket : public EClientSocketBase, NoCopyAndAssign
+{
+ public:
+  AsioClientSocket(boost::asio::io_service& io_service, EWrapper* wrapper);
+  ~AsioClientSocket();
+
+  // EClient
+  bool eConnect(const char* host, unsigned int port, int clientId = 0);
+  void eDisconnect();
+
+  bool isSocketOK() const;
+
+  boost::asio::io_service::strand& strand() { return strand_; }
+
+ private:
+  // EClientSocketBase
+  int send(const char* buf, size_t sz);
+  int receive(char* buf, size_t sz);
+  int decodeMsg(const char* ptr, const char* endPtr);
+
+  void StartRead();
+  void HandleRead(const boost::system::error_code& error, size_t bytes);
+  void StartWrite();
+  void HandleWrite(const boost::system::error_code& error, size_t bytes);
+  void Close();
+  void OnError(const boost::system::error_code& error);
+  void NotifyConnect();
+  void Done();
+
+  boost::asio::io_service& io_service_;
+  boost::asio::ip::tcp::socket socket_;
+  boost::asio::io_service::strand strand_;
+  volatile bool open_;
+
+  // Filled by async_read_some and consumed by receive() from within
+  // checkMessages().  Only touched on the strand.
+  boost::array<char, 8192> read_buffer_;
+  const char* pending_;
+  size_t pending_size_;
+  wire::Decoder<wire::CurrentApi, EWrapper> decoder_;
+
+  // Double-buffered output: callers append to outgoing_ while writing_
+  // is in flight.
+  boost::mutex write_mutex_;
+  std::vector<char> outgoing_;
+  std::vector<char> writing_;
+  bool write_in_flight_;
+
+  // Signalled on the connect ack, close and when the last outstanding
+  // handler completes.
+  boost::mutex mutex_;
+  boost::condition_variable cond_;
+  int outstanding_;
+};
+
+} // namespace transport
+} // namespace ib
+
+#endif // IB_TRANSPORT_ASIO_CLIENT_SOCKET_H_
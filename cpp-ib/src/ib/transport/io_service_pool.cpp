@@ -0,0 +1,50 @@
+
+#include <boost/bind.hpp>
+#include <glog/logging.h>
+
+#include "ib/transport/io_service_pool.hpp"
+
+namespace ib {
+namespace transport {
+
+IoServicePool::IoServicePool(int threads)
+    : size_(threads)
+    , work_(new boost::asio::io_service::work(io_service_))
+{
+  CHECK(threads > 0) << "Need at least one thread: " << threads;
+}
+
+IoServicePool::~IoServicePool()
+{
+  Stop();
+  Join();
+}
+
+static void Run(boost::asio::io_service* io_service)
+{
+  boost::system::error_code error;
+  io_service->run(error);
+  LOG_IF(ERROR, error) << "io_service exited: " << error.message();
+}
+
+void IoServicePool::Start()
+{
+  for (int i = 0; i < size_; ++i) {
+    threads_.create_thread(boost::bind(Run, &io_service_));
+  }
+  VLOG(1) << "Started io_service pool with " << size_ << " threads.";
+}
+
+void IoServicePool::Stop()
+{
+  work_.reset();
+  io_service_.stop();
+}
+
+void IoServicePool::Join()
+{
+  threads_.join_all();
+}
+
+} // namespace transport
+} // namespace ib
@@ -0,0 +1,48 @@
+#ifndef IB_TRANSPORT_IO_SERVICE_POOL_H_
+#define IB_TRANSPORT_IO_SERVICE_POOL_H_
+
+// A single io_service run by a fixed set of threads.  Gateway
+// sessions (see asio_client_socket.hpp) and anything else doing
+// socket i/o in the process post their handlers here instead of each
+// owning a polling thread.  Per-connection ordering comes from
+// strands, not from dedicated threads.
+
+#include <boost/asio.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "common.hpp"
+
+namespace ib {
+namespace transport {
+
+class IoServicePool : NoCopyAndAssign
+{
+ public:
+  explicit IoServicePool(int threads);
+  ~IoServicePool();
+
+  // Starts the threads.  Handlers posted before Start() run once the
+  // threads are up.
+  void Start();
+
+  // Stops the io_service; handlers not yet run are abandoned.
+  void Stop();
+
+  // Waits for the threads to exit.
+  void Join();
+
+  boost::asio::io_service& io_service() { return io_service_; }
+  int threads() const { return size_; }
+
+ private:
+  const int size_;
+  boost::asio::io_service io_service_;
+  boost::scoped_ptr<boost::asio::io_service::work> work_;
+  boost::thread_group threads_;
+};
+
+} // namespace transport
+} // namespace ib
+
+#endif // IB_TRANSPORT_IO_SERVICE_POOL_H_
@@ -245,7 +245,7 @@ class LogWrapper : public EWrapper {
   }
   void scannerParameters(const IBString &xml) {
     LOG_EVENT
-        << __f__(xml);
+        << ",xml_bytes=" << xml.size();  // Megabytes at times.
   }
   void scannerData(
       int reqId, int rank, const ContractDetails &contractDetails,
@@ -282,7 +282,7 @@ class LogWrapper : public EWrapper {
   void fundamentalData(TickerId reqId, const IBString& data) {
     LOG_EVENT
         << __f__(reqId)
-        << __f__(data);
+        << ",data_bytes=" << data.size();
   }
   void deltaNeutralValidation(int reqId, const UnderComp& underComp) {
     LOG_EVENT
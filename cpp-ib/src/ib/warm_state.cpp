@@ -0,0 +1,414 @@
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include <boost/bind.hpp>
+
+#include <glog/logging.h>
+
+#include "utils.hpp"
+#include "ib/warm_state.hpp"
+
+#define VLOG_LEVEL 2
+
+using namespace std;
+
+namespace ib {
+
+static const char SNAPSHOT[] = "snapshot";
+static const char UPDATES[] = "updates";
+
+// Final statuses of the order API; the order is no longer open.
+static bool IsFinal(const string& status)
+{
+  return status == "Filled" || status == "Cancelled" ||
+      status == "ApiCancelled" || status == "Inactive";
+}
+
+static string PositionKey(const state::Position& position)
+{
+  return position.account() + ":" + position.symbol();
+}
+
+// Records are a 4 byte length, in host order, and the message.
+static bool WriteRecord(FILE* file, const string& bytes)
+{
+  uint32_t size = bytes.size();
+  return fwrite(&size, sizeof(size), 1, file) == 1 &&
+      fwrite(bytes.data(), 1, size, file) == size;
+}
+
+static bool ReadRecord(FILE* file, string* bytes)
+{
+  uint32_t size;
+  if (fread(&size, sizeof(size), 1, file) != 1) return false;
+  bytes->resize(size);
+  return size == 0 || fread(&(*bytes)[0], 1, size, file) == size;
+}
+
+WarmState::WarmState(const string& dir, QuoteTable* quotes)
+    : dir_(dir)
+    , quotes_(quotes)
+    , log_(NULL)
+    , generation_(0)
+    , replayed_(0)
+    , running_(false)
+{
+}
+
+WarmState::~WarmState()
+{
+  if (thread_) Stop();
+  if (log_) fclose(log_);
+}
+
+string WarmState::Path(const char* kind, int64_t generation) const
+{
+  ostringstream path;
+  path << dir_ << "/" << kind << "." << generation;
+  return path.str();
+}
+
+void WarmState::Scan(vector<int64_t>* snapshots, vector<int64_t>* logs) const
+{
+  DIR* dir = opendir(dir_.c_str());
+  if (dir == NULL) {
+    PLOG(ERROR) << "Cannot read " << dir_;
+    return;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL) {
+    const char* name = entry->d_name;
+    const char* dot = strchr(name, '.');
+    if (dot == NULL) continue;
+    char* end;
+    int64_t generation = strtoll(dot + 1, &end, 10);
+    if (end == dot + 1 || *end != '\0') continue;  // E.g. a .tmp file.
+    const string kind(name, dot - name);
+    if (kind == SNAPSHOT) snapshots->push_back(generation);
+    if (kind == UPDATES) logs->push_back(generation);
+  }
+  closedir(dir);
+  sort(snapshots->begin(), snapshots->end());
+  sort(logs->begin(), logs->end());
+}
+
+bool WarmState::Load()
+{
+  const int64_t start = lab616::utils::now_micros();
+  vector<int64_t> snapshots;
+  vector<int64_t> logs;
+  Scan(&snapshots, &logs);
+
+  // The latest snapshot that parses; an older one is kept until a
+  // newer one is complete, so normally that is the last.
+  state::Snapshot snapshot;
+  int64_t from = 0;
+  while (!snapshots.empty()) {
+    const string path = Path(SNAPSHOT, snapshots.back());
+    FILE* file = fopen(path.c_str(), "r");
+    string bytes;
+    bool ok = file && ReadRecord(file, &bytes) &&
+        snapshot.ParseFromString(bytes);
+    if (file) fclose(file);
+    if (ok) {
+      from = snapshots.back();
+      break;
+    }
+    LOG(WARNING) << "Skipping unreadable snapshot " << path;
+    snapshot.Clear();
+    snapshots.pop_back();
+  }
+
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  for (int i = 0; i < snapshot.subscription_size(); ++i) {
+    const state::Subscription& s = snapshot.subscription(i);
+    subscriptions_[s.symbol()] = s;
+  }
+  for (int i = 0; i < snapshot.order_size(); ++i) {
+    orders_[snapshot.order(i).id()] = snapshot.order(i);
+  }
+  for (int i = 0; i < snapshot.position_size(); ++i) {
+    positions_[PositionKey(snapshot.position(i))] = snapshot.position(i);
+  }
+  for (int i = 0; i < snapshot.quote_size(); ++i) {
+    const state::LastQuote& q = snapshot.quote(i);
+    const int64_t ts = q.time_stamp();
+    quotes_->Update(ts, q.id(), QuoteTable::BID, q.bid());
+    quotes_->Update(ts, q.id(), QuoteTable::BID_SIZE, q.bid_size());
+    quotes_->Update(ts, q.id(), QuoteTable::ASK, q.ask());
+    quotes_->Update(ts, q.id(), QuoteTable::ASK_SIZE, q.ask_size());
+    quotes_->Update(ts, q.id(), QuoteTable::LAST, q.last());
+    quotes_->Update(ts, q.id(), QuoteTable::LAST_SIZE, q.last_size());
+  }
+
+  generation_ = from;
+  bool replayed = false;
+  for (size_t i = 0; i < logs.size(); ++i) {
+    if (logs[i] < from) continue;
+    replayed = Replay(logs[i]) || replayed;
+    generation_ = logs[i];
+  }
+  const bool loaded = snapshot.IsInitialized() || replayed;
+  LOG_IF(INFO, loaded)
+      << "Warm state of generation " << from << " loaded in "
+      << (lab616::utils::now_micros() - start) << " micros: "
+      << subscriptions_.size() << " subscriptions, " << orders_.size()
+      << " open orders, " << positions_.size() << " positions, "
+      << snapshot.quote_size() << " quotes, " << replayed_ << " updates.";
+  return loaded;
+}
+
+bool WarmState::Replay(int64_t generation)
+{
+  const string path = Path(UPDATES, generation);
+  FILE* file = fopen(path.c_str(), "r");
+  if (file == NULL) {
+    PLOG(WARNING) << "Cannot open " << path;
+    return false;
+  }
+  string bytes;
+  state::Update update;
+  int64_t n = 0;
+  while (ReadRecord(file, &bytes)) {
+    if (!update.ParseFromString(bytes)) break;
+    Apply(update);
+    n++;
+  }
+  LOG_IF(WARNING, !feof(file)) << "Update log " << path << " ends torn after "
+                               << n << " updates.";
+  fclose(file);
+  replayed_ += n;
+  return n > 0;
+}
+
+bool WarmState::Start(int period_secs)
+{
+  CHECK(!thread_);
+  if (!Snapshot()) return false;
+  running_ = true;
+  thread_.reset(new boost::thread(
+      boost::bind(&WarmState::Run, this, period_secs)));
+  return true;
+}
+
+void WarmState::Stop()
+{
+  if (!thread_) return;
+  {
+    boost::unique_lock<boost::mutex> lock(run_mutex_);
+    running_ = false;
+    run_control_.notify_all();
+  }
+  thread_->join();
+  thread_.reset();
+  Snapshot();
+}
+
+void WarmState::Run(int period_secs)
+{
+  boost::unique_lock<boost::mutex> lock(run_mutex_);
+  while (running_) {
+    const boost::system_time deadline =
+        boost::get_system_time() + boost::posix_time::seconds(period_secs);
+    while (running_ && run_control_.timed_wait(lock, deadline)) {}
+    if (!running_) break;
+    lock.unlock();
+    Snapshot();
+    lock.lock();
+  }
+}
+
+bool WarmState::Snapshot()
+{
+  boost::unique_lock<boost::mutex> snapshot_lock(snapshot_mutex_);
+  const int64_t start = lab616::utils::now_micros();
+  spare_.Clear();
+  int64_t generation;
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    generation = generation_ + 1;
+    const string path = Path(UPDATES, generation);
+    FILE* log = fopen(path.c_str(), "a");
+    if (log == NULL) {
+      PLOG(ERROR) << "Cannot create " << path;
+      return false;
+    }
+    if (log_) fclose(log_);
+    log_ = log;
+    generation_ = generation;
+
+    spare_.set_time_stamp(start);
+    spare_.set_generation(generation);
+    for (map<string, state::Subscription>::const_iterator i =
+             subscriptions_.begin(); i != subscriptions_.end(); ++i) {
+      *spare_.add_subscription() = i->second;
+    }
+    for (map<int64_t, state::OpenOrder>::const_iterator i = orders_.begin();
+         i != orders_.end(); ++i) {
+      *spare_.add_order() = i->second;
+    }
+    for (map<string, state::Position>::const_iterator i =
+             positions_.begin(); i != positions_.end(); ++i) {
+      *spare_.add_position() = i->second;
+    }
+  }
+
+  // Quotes are current to this moment rather than to the start of
+  // the log; the feed overwrites them anyway.
+  Quote quote;
+  for (size_t slot = 0; slot < quotes_->size(); ++slot) {
+    quotes_->Read(slot, &quote);
+    state::LastQuote* q = spare_.add_quote();
+    q->set_id(quote.id);
+    q->set_bid(quote.bid);
+    q->set_ask(quote.ask);
+    q->set_last(quote.last);
+    q->set_bid_size(quote.bid_size);
+    q->set_ask_size(quote.ask_size);
+    q->set_last_size(quote.last_size);
+    q->set_time_stamp(quote.ts);
+  }
+
+  buffer_.clear();
+  spare_.SerializeToString(&buffer_);
+  const string path = Path(SNAPSHOT, generation);
+  const string tmp = path + ".tmp";
+  FILE* file = fopen(tmp.c_str(), "w");
+  bool ok = file && WriteRecord(file, buffer_) && fflush(file) == 0 &&
+      fsync(fileno(file)) == 0;
+  if (file) ok = fclose(file) == 0 && ok;
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+    PLOG(ERROR) << "Cannot write " << path;
+    unlink(tmp.c_str());
+    return false;
+  }
+
+  // Older generations are covered by this one now.
+  vector<int64_t> snapshots;
+  vector<int64_t> logs;
+  Scan(&snapshots, &logs);
+  for (size_t i = 0; i < snapshots.size(); ++i) {
+    if (snapshots[i] < generation) {
+      unlink(Path(SNAPSHOT, snapshots[i]).c_str());
+    }
+  }
+  for (size_t i = 0; i < logs.size(); ++i) {
+    if (logs[i] < generation) unlink(Path(UPDATES, logs[i]).c_str());
+  }
+  VLOG(VLOG_LEVEL) << "Snapshot " << generation << " of " << buffer_.size()
+                   << " bytes in " << (lab616::utils::now_micros() - start)
+                   << " micros.";
+  return true;
+}
+
+void WarmState::Record(const state::Update& update)
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  if (log_) {
+    string bytes;
+    update.SerializeToString(&bytes);
+    if (!WriteRecord(log_, bytes) || fflush(log_) != 0) {
+      PLOG(ERROR) << "Cannot append to the update log.";
+    }
+  }
+  Apply(update);
+}
+
+void WarmState::Apply(const state::Update& update)
+{
+  if (update.has_subscribe()) {
+    subscriptions_[update.subscribe().symbol()] = update.subscribe();
+  }
+  if (update.has_unsubscribe()) {
+    subscriptions_.erase(update.unsubscribe());
+  }
+  if (update.has_order()) {
+    const state::OpenOrder& order = update.order();
+    if (order.has_status() && IsFinal(order.status())) {
+      orders_.erase(order.id());
+    } else {
+      orders_[order.id()].MergeFrom(order);
+    }
+  }
+  if (update.has_position()) {
+    const state::Position& position = update.position();
+    if (position.position() == 0) {
+      positions_.erase(PositionKey(position));
+    } else {
+      positions_[PositionKey(position)] = position;
+    }
+  }
+}
+
+void WarmState::Subscribe(const string& symbol, bool book)
+{
+  state::Update update;
+  update.set_time_stamp(lab616::utils::now_micros());
+  update.mutable_subscribe()->set_symbol(symbol);
+  update.mutable_subscribe()->set_book(book);
+  Record(update);
+}
+
+void WarmState::Unsubscribe(const string& symbol)
+{
+  state::Update update;
+  update.set_time_stamp(lab616::utils::now_micros());
+  update.set_unsubscribe(symbol);
+  Record(update);
+}
+
+void WarmState::UpdateOrder(const state::OpenOrder& order)
+{
+  state::Update update;
+  update.set_time_stamp(lab616::utils::now_micros());
+  *update.mutable_order() = order;
+  Record(update);
+}
+
+void WarmState::UpdatePosition(const state::Position& position)
+{
+  state::Update update;
+  update.set_time_stamp(lab616::utils::now_micros());
+  *update.mutable_position() = position;
+  Record(update);
+}
+
+void WarmState::GetSubscriptions(vector<state::Subscription>* out) const
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  for (map<string, state::Subscription>::const_iterator i =
+           subscriptions_.begin(); i != subscriptions_.end(); ++i) {
+    out->push_back(i->second);
+  }
+}
+
+void WarmState::GetOpenOrders(vector<state::OpenOrder>* out) const
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  for (map<int64_t, state::OpenOrder>::const_iterator i = orders_.begin();
+       i != orders_.end(); ++i) {
+    out->push_back(i->second);
+  }
+}
+
+void WarmState::GetPositions(vector<state::Position>* out) const
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  for (map<string, state::Position>::const_iterator i = positions_.begin();
+       i != positions_.end(); ++i) {
+    out->push_back(i->second);
+  }
+}
+
+int64_t WarmState::generation() const
+{
+  boost::unique_lock<boost::mutex> lock(mutex_);
+  return generation_;
+}
+
+} // namespace ib
@@ -0,0 +1,119 @@
+#ifndef IB_WARM_STATE_H_
+#define IB_WARM_STATE_H_
+
+// Session state that survives a restart: subscriptions, open orders,
+// positions and the last quotes.
+//
+// Two kinds of files are kept in one directory, numbered by
+// generation:
+//
+//   snapshot.<g>  the whole state when generation g began, and
+//   updates.<g>   every change since, appended as it happens.
+//
+// Changes are rare next to ticks, so each one is appended to the log
+// and flushed before it is applied.  Quotes are not logged; they are
+// read from the QuoteTable, without locks, when a snapshot is taken.
+//
+// A background thread takes a snapshot every period.  It copies the
+// small maps into a spare Snapshot and starts the next log under the
+// lock, then serializes and writes the copy with the lock released,
+// so changes wait at most for the copy.  The file is written aside
+// and renamed, and only then are older generations removed.
+//
+// Load reads the latest complete snapshot and rolls forward the logs
+// of that generation and any later one.  A record torn by a crash
+// ends the roll forward.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "common.hpp"
+#include "ib/ib_state.pb.h"
+#include "ib/quote_table.hpp"
+
+namespace ib {
+
+class WarmState : NoCopyAndAssign
+{
+ public:
+  // The directory must exist.  Last quotes are restored to and taken
+  // from the table, which must outlive this.
+  WarmState(const std::string& dir, QuoteTable* quotes);
+  ~WarmState();
+
+  // Restores the state.  Call once, before Start and before the feed
+  // writes to the table.  Returns false if there was nothing to load.
+  bool Load();
+
+  // Takes a snapshot, which also starts a new log, and then one every
+  // period_secs on a background thread.
+  bool Start(int period_secs);
+
+  // Stops the thread and takes a last snapshot.
+  void Stop();
+
+  // Writes a snapshot of the current state and starts a new log.
+  // Returns false on an I/O error; the previous files are then kept.
+  bool Snapshot();
+
+  // Changes.  Before Start they are applied without being logged.
+  void Subscribe(const std::string& symbol, bool book);
+  void Unsubscribe(const std::string& symbol);
+
+  // Merges the set fields into the order with the id.  The order is
+  // dropped once its status is final (Filled, Cancelled, ...).
+  void UpdateOrder(const state::OpenOrder& order);
+
+  // Replaces the position of the account in the symbol; a position
+  // of 0 removes it.
+  void UpdatePosition(const state::Position& position);
+
+  // Copies of the current state.
+  void GetSubscriptions(std::vector<state::Subscription>* out) const;
+  void GetOpenOrders(std::vector<state::OpenOrder>* out) const;
+  void GetPositions(std::vector<state::Position>* out) const;
+
+  int64_t generation() const;
+
+  // Updates rolled forward by Load.
+  int64_t replayed() const { return replayed_; }
+
+ private:
+  void Record(const state::Update& update);
+  void Apply(const state::Update& update);
+  bool Replay(int64_t generation);
+  void Scan(std::vector<int64_t>* snapshots,
+            std::vector<int64_t>* logs) const;
+  std::string Path(const char* kind, int64_t generation) const;
+  void Run(int period_secs);
+
+  const std::string dir_;
+  QuoteTable* quotes_;
+
+  mutable boost::mutex mutex_;  // The maps, the log and generation_.
+  std::map<std::string, state::Subscription> subscriptions_;
+  std::map<int64_t, state::OpenOrder> orders_;
+  std::map<std::string, state::Position> positions_;  // account:symbol
+  FILE* log_;
+  int64_t generation_;
+  int64_t replayed_;
+
+  boost::mutex snapshot_mutex_;  // One snapshot at a time.
+  state::Snapshot spare_;        // Copied into under mutex_.
+  std::string buffer_;
+
+  boost::mutex run_mutex_;
+  boost::condition_variable run_control_;
+  bool running_;
+  boost::scoped_ptr<boost::thread> thread_;
+};
+
+} // namespace ib
+
+#endif // IB_WARM_STATE_H_
@@ -0,0 +1,92 @@
+#ifndef IB_WIRE_API_TRAITS_H_
+#define IB_WIRE_API_TRAITS_H_
+
+// What distinguishes the vendored API releases under //cpp-ib/src/ib/api
+// on the wire, as compile-time constants.  The codec (decoder.hpp,
+// encoder.hpp) is written once against these instead of once per tree.
+//
+// Each release only states what changed from the one before it; the
+// enum in a derived struct hides the base's constant of the same name.
+// Features a release does not know about have a minimum server version
+// of NEVER, so a runtime check against the negotiated server version
+// compiles down to nothing.
+
+#include <limits.h>
+
+namespace ib {
+namespace wire {
+
+enum { NEVER = INT_MAX };
+
+struct Api962
+{
+  static const char* name() { return "9.62"; }
+  enum {
+    CLIENT_VERSION = 45,
+    SERVER_VERSION = 38,  // Oldest server the client accepts.
+
+    MIN_SERVER_VER_PTA_ORDERS = 39,
+    MIN_SERVER_VER_FUNDAMENTAL_DATA = 40,
+    MIN_SERVER_VER_UNDER_COMP = 40,
+    MIN_SERVER_VER_CONTRACT_DATA_CHAIN = 40,
+    MIN_SERVER_VER_SCALE_ORDERS2 = 40,
+    MIN_SERVER_VER_ALGO_ORDERS = 41,
+    MIN_SERVER_VER_EXECUTION_DATA_CHAIN = 42,
+    MIN_SERVER_VER_NOT_HELD = 44,
+    MIN_SERVER_VER_SEC_ID_TYPE = NEVER,
+    MIN_SERVER_VER_PLACE_ORDER_CONID = NEVER,
+    MIN_SERVER_VER_REQ_MKT_DATA_CONID = NEVER,
+    MIN_SERVER_VER_REQ_CALC_IMPLIED_VOLAT = NEVER,
+    MIN_SERVER_VER_REQ_CALC_OPTION_PRICE = NEVER,
+    MIN_SERVER_VER_CANCEL_CALC_IMPLIED_VOLAT = NEVER,
+    MIN_SERVER_VER_CANCEL_CALC_OPTION_PRICE = NEVER,
+
+    // Message versions sent by the client.
+    REQ_MKT_DATA_VERSION = 8,
+
+    // EWrapper::tickOptionComputation takes gamma, vega, theta and
+    // undPrice (client version 47).
+    OPTION_GREEKS = 0
+  };
+};
+
+struct Api963 : Api962
+{
+  static const char* name() { return "9.63"; }
+  enum {
+    CLIENT_VERSION = 46,
+    MIN_SERVER_VER_SEC_ID_TYPE = 45
+  };
+};
+
+struct Api964Beta : Api963
+{
+  static const char* name() { return "9.64beta"; }
+  enum {
+    CLIENT_VERSION = 47,
+    MIN_SERVER_VER_PLACE_ORDER_CONID = 46,
+    MIN_SERVER_VER_REQ_MKT_DATA_CONID = 47,
+    MIN_SERVER_VER_REQ_CALC_IMPLIED_VOLAT = 49,
+    REQ_MKT_DATA_VERSION = 9,
+    OPTION_GREEKS = 1
+  };
+};
+
+struct Api964 : Api964Beta
+{
+  static const char* name() { return "9.64"; }
+  enum {
+    MIN_SERVER_VER_REQ_CALC_OPTION_PRICE = 50,
+    MIN_SERVER_VER_CANCEL_CALC_IMPLIED_VOLAT = 50,
+    MIN_SERVER_VER_CANCEL_CALC_OPTION_PRICE = 50
+  };
+};
+
+// Matches IBAPI_VERSION in //cpp-ib/CMakeLists.txt, i.e. the EClient /
+// EWrapper headers the rest of the tree is compiled against.
+typedef Api964 CurrentApi;
+
+} // namespace wire
+} // namespace ib
+
+#endif // IB_WIRE_API_TRAITS_H_
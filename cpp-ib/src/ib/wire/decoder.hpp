@@ -0,0 +1,507 @@
+#ifndef IB_WIRE_DECODER_H_
+#define IB_WIRE_DECODER_H_
+
+// Incoming half of the codec: market data, order status, errors and
+// the other high-rate messages, decoded once for every API release.
+// Traits is one of the structs in api_traits.hpp.  Handler receives the
+// same calls, with the same arguments, as the vendored processMsg makes
+// on an EWrapper; it is a template parameter so the calls are static
+// when the handler is not an EWrapper.
+//
+// Messages not listed in messages.hpp (open orders, historical data,
+// ...) are reported as UNHANDLED without consuming anything, for the
+// caller to hand to EClientSocketBase.  The sockets do so by returning
+// Decode from their EClientSocketBase::decodeMsg (see adapters.hpp).
+//
+// Strings chooses how string fields reach the handler.  CopyStrings,
+// the default, copies them into std::string as processMsg does.
+// ViewStrings passes StringRefs into the buffer given to Decode,
+// valid until the call returns, and interns the low-cardinality ones
+// in the decoder's Interner, so market depth and contract details
+// allocate nothing per message once their names have been seen.  A
+// ViewStrings handler has these callbacks instead of the EWrapper
+// ones:
+//
+//   tickString(TickerId, TickType, const StringRef& value)
+//   orderStatus(OrderId, const StringRef& status, int filled,
+//               int remaining, double avg_fill_price, int perm_id,
+//               int parent_id, double last_fill_price, int client_id,
+//               const StringRef& why_held)
+//   error(int id, int code, const StringRef& message)
+//   updateMktDepthL2(TickerId, int position, int market_maker,
+//                    int operation, int side, double price, int size)
+//   contractDetails(int req_id, const ContractDetailsView& details)
+//   contractDetailsEnd(int req_id)
+//
+// Interned ids are names()->Name(id); they are Interner::NONE when
+// the table is full.  Contract details are only decoded here with
+// ViewStrings.
+
+#ifndef IB_USE_STD_STRING
+#define IB_USE_STD_STRING
+#endif
+
+#include <float.h>
+#include <string>
+
+#include <Shared/CommonDefs.h>
+#include <Shared/EWrapper.h>
+
+#include "ib/wire/field_codec.hpp"
+#include "ib/wire/interner.hpp"
+#include "ib/wire/messages.hpp"
+
+namespace ib {
+namespace wire {
+
+struct CopyStrings
+{
+  typedef std::string Type;
+  enum { VIEWS = 0 };
+};
+
+struct ViewStrings
+{
+  typedef StringRef Type;
+  enum { VIEWS = 1 };
+};
+
+// CONTRACT_DATA, with the fields ContractDetails has in 9.64.  The
+// ints named after what they hold are interned ids.  Fields a server
+// version does not send are empty or 0, as in processMsg.
+struct ContractDetailsView
+{
+  StringRef symbol;
+  int sec_type;
+  StringRef expiry;
+  double strike;
+  StringRef right;
+  int exchange;
+  int currency;
+  StringRef local_symbol;
+  StringRef market_name;
+  StringRef trading_class;
+  long con_id;
+  double min_tick;
+  StringRef multiplier;
+  StringRef order_types;
+  StringRef valid_exchanges;
+  int price_magnifier;
+  int under_con_id;
+  StringRef long_name;
+  int primary_exchange;
+  StringRef contract_month;
+  StringRef industry;
+  StringRef category;
+  StringRef subcategory;
+  int time_zone_id;
+  StringRef trading_hours;
+  StringRef liquid_hours;
+};
+
+#define IB_WIRE_READ(x) if (!in.Read(&x)) return 0;
+
+namespace internal {
+
+// tickOptionComputation lost its last four arguments before 9.64.
+template <bool Greeks> struct OptionComputation;
+
+template <> struct OptionComputation<true>
+{
+  template <typename Handler>
+  static void Call(Handler* handler, TickerId id, TickType type,
+                   double implied_vol, double delta, double opt_price,
+                   double pv_dividend, double gamma, double vega,
+                   double theta, double und_price)
+  {
+    handler->tickOptionComputation(id, type, implied_vol, delta, opt_price,
+                                   pv_dividend, gamma, vega, theta,
+                                   und_price);
+  }
+};
+
+template <> struct OptionComputation<false>
+{
+  template <typename Handler>
+  static void Call(Handler* handler, TickerId id, TickType type,
+                   double implied_vol, double delta, double opt_price,
+                   double pv_dividend, double, double, double, double)
+  {
+    handler->tickOptionComputation(id, type, implied_vol, delta, opt_price,
+                                   pv_dividend);
+  }
+};
+
+// Market makers are interned with ViewStrings.
+template <bool Views> struct MarketDepthL2;
+
+template <> struct MarketDepthL2<false>
+{
+  template <typename Handler>
+  static void Call(Handler* handler, Interner*, TickerId id, int position,
+                   const std::string& market_maker, int operation, int side,
+                   double price, int size)
+  {
+    handler->updateMktDepthL2(id, position, market_maker, operation, side,
+                              price, size);
+  }
+};
+
+template <> struct MarketDepthL2<true>
+{
+  template <typename Handler>
+  static void Call(Handler* handler, Interner* names, TickerId id,
+                   int position, const StringRef& market_maker,
+                   int operation, int side, double price, int size)
+  {
+    handler->updateMktDepthL2(id, position, names->Intern(market_maker),
+                              operation, side, price, size);
+  }
+};
+
+// CONTRACT_DATA and CONTRACT_DATA_END; false if the message is not
+// complete yet.
+template <bool Views> struct ContractData;
+
+template <> struct ContractData<false>
+{
+  template <typename Handler>
+  static bool Decode(int, FieldReader*, Handler*, Interner*)
+  {
+    return false;  // Not reached: left to processMsg.
+  }
+};
+
+template <> struct ContractData<true>
+{
+  template <typename Handler>
+  static bool Decode(int msg_id, FieldReader* reader, Handler* handler,
+                     Interner* names)
+  {
+    FieldReader& in = *reader;
+    int version;
+    int req_id = -1;
+    IB_WIRE_READ(version);
+    if (msg_id == CONTRACT_DATA_END) {
+      IB_WIRE_READ(req_id);
+      handler->contractDetailsEnd(req_id);
+      return true;
+    }
+    if (version >= 3) IB_WIRE_READ(req_id);
+
+    ContractDetailsView c;
+    StringRef name;
+    IB_WIRE_READ(c.symbol);
+    IB_WIRE_READ(name);
+    c.sec_type = names->Intern(name);
+    IB_WIRE_READ(c.expiry);
+    IB_WIRE_READ(c.strike);
+    IB_WIRE_READ(c.right);
+    IB_WIRE_READ(name);
+    c.exchange = names->Intern(name);
+    IB_WIRE_READ(name);
+    c.currency = names->Intern(name);
+    IB_WIRE_READ(c.local_symbol);
+    IB_WIRE_READ(c.market_name);
+    IB_WIRE_READ(c.trading_class);
+    IB_WIRE_READ(c.con_id);
+    IB_WIRE_READ(c.min_tick);
+    IB_WIRE_READ(c.multiplier);
+    IB_WIRE_READ(c.order_types);
+    IB_WIRE_READ(c.valid_exchanges);
+    IB_WIRE_READ(c.price_magnifier);
+    c.under_con_id = 0;
+    if (version >= 4) IB_WIRE_READ(c.under_con_id);
+    name = StringRef();
+    if (version >= 5) {
+      IB_WIRE_READ(c.long_name);
+      IB_WIRE_READ(name);
+    }
+    c.primary_exchange = names->Intern(name);
+    name = StringRef();
+    if (version >= 6) {
+      IB_WIRE_READ(c.contract_month);
+      IB_WIRE_READ(c.industry);
+      IB_WIRE_READ(c.category);
+      IB_WIRE_READ(c.subcategory);
+      IB_WIRE_READ(name);
+      IB_WIRE_READ(c.trading_hours);
+      IB_WIRE_READ(c.liquid_hours);
+    }
+    c.time_zone_id = names->Intern(name);
+    handler->contractDetails(req_id, c);
+    return true;
+  }
+};
+
+} // namespace internal
+
+template <typename Traits, typename Handler,
+          typename Strings = CopyStrings>
+class Decoder
+{
+ public:
+  enum { UNHANDLED = -1 };
+
+  explicit Decoder(Handler* handler) : handler_(handler) {}
+
+  // The ids of interned names; see ViewStrings above.
+  Interner* names() { return &names_; }
+
+  // Decodes the message at the start of [begin, end).  Returns the
+  // number of bytes consumed, 0 if the message is not complete yet
+  // (the handler has not been called) or UNHANDLED.
+  int Decode(const char* begin, const char* end);
+
+  // Decodes messages until the buffer ends or one cannot be decoded
+  // here.  Returns the bytes consumed; *unhandled tells the two apart.
+  size_t DecodeAll(const char* begin, const char* end, bool* unhandled)
+  {
+    const char* ptr = begin;
+    *unhandled = false;
+    while (ptr < end) {
+      int n = Decode(ptr, end);
+      if (n == UNHANDLED) *unhandled = true;
+      if (n <= 0) break;
+      ptr += n;
+    }
+    return ptr - begin;
+  }
+
+ private:
+  Handler* handler_;
+  Interner names_;
+};
+
+template <typename Traits, typename Handler, typename Strings>
+int Decoder<Traits, Handler, Strings>::Decode(const char* begin,
+                                              const char* end)
+{
+  FieldReader in(begin, end);
+  int msg_id;
+  IB_WIRE_READ(msg_id);
+
+  // Fields marked "ver N" in EClientSocketBaseImpl.h have been sent by
+  // every server the client accepts (SERVER_VERSION), so they are read
+  // unconditionally here too.
+  int version;
+  switch (msg_id) {
+    case TICK_PRICE: {
+      int ticker_id, tick_type, size, can_auto_execute;
+      double price;
+      IB_WIRE_READ(version);
+      IB_WIRE_READ(ticker_id);
+      IB_WIRE_READ(tick_type);
+      IB_WIRE_READ(price);
+      IB_WIRE_READ(size);
+      IB_WIRE_READ(can_auto_execute);
+
+      handler_->tickPrice(ticker_id, static_cast<TickType>(tick_type), price,
+                          can_auto_execute);
+      TickType size_type = NOT_SET;
+      switch (tick_type) {
+        case BID: size_type = BID_SIZE; break;
+        case ASK: size_type = ASK_SIZE; break;
+        case LAST: size_type = LAST_SIZE; break;
+      }
+      if (size_type != NOT_SET) handler_->tickSize(ticker_id, size_type, size);
+      break;
+    }
+
+    case TICK_SIZE: {
+      int ticker_id, tick_type, size;
+      IB_WIRE_READ(version);
+      IB_WIRE_READ(ticker_id);
+      IB_WIRE_READ(tick_type);
+      IB_WIRE_READ(size);
+      handler_->tickSize(ticker_id, static_cast<TickType>(tick_type), size);
+      break;
+    }
+
+    case TICK_OPTION_COMPUTATION: {
+      int ticker_id, tick_type;
+      double implied_vol, delta;
+      double opt_price = DBL_MAX, pv_dividend = DBL_MAX;
+      double gamma = DBL_MAX, vega = DBL_MAX, theta = DBL_MAX;
+      double und_price = DBL_MAX;
+      IB_WIRE_READ(version);
+      IB_WIRE_READ(ticker_id);
+      IB_WIRE_READ(tick_type);
+      IB_WIRE_READ(implied_vol);
+      IB_WIRE_READ(delta);
+      // -1 / -2 are the "not computed" indicators.
+      if (implied_vol < 0) implied_vol = DBL_MAX;
+      if (delta > 1 || delta < -1) delta = DBL_MAX;
+      // Only clients that announce version 47 get version 6.
+      const bool v6 = Traits::OPTION_GREEKS && version >= 6;
+      if (v6 || tick_type == MODEL_OPTION) {
+        IB_WIRE_READ(opt_price);
+        IB_WIRE_READ(pv_dividend);
+        if (opt_price < 0) opt_price = DBL_MAX;
+        if (pv_dividend < 0) pv_dividend = DBL_MAX;
+      }
+      if (v6) {
+        IB_WIRE_READ(gamma);
+        IB_WIRE_READ(vega);
+        IB_WIRE_READ(theta);
+        IB_WIRE_READ(und_price);
+        if (gamma > 1 || gamma < -1) gamma = DBL_MAX;
+        if (vega > 1 || vega < -1) vega = DBL_MAX;
+        if (theta > 1 || theta < -1) theta = DBL_MAX;
+        if (und_price < 0) und_price = DBL_MAX;
+      }
+      internal::OptionComputation<Traits::OPTION_GREEKS != 0>::Call(
+          handler_, ticker_id, static_cast<TickType>(tick_type), implied_vol,
+          delta, opt_price, pv_dividend, gamma, vega, theta, und_price);
+      break;
+    }
+
+    case TICK_GENERIC: {
+      int ticker_id, tick_type;
+      double value;
+      IB_WIRE_READ(version);
+      IB_WIRE_READ(ticker_id);
+      IB_WIRE_READ(tick_type);
+      IB_WIRE_READ(value);
+      handler_->tickGeneric(ticker_id, static_cast<TickType>(tick_type), value);
+      break;
+    }
+
+    case TICK_STRING: {
+      int ticker_id, tick_type;
+      typename Strings::Type value;
+      IB_WIRE_READ(version);
+      IB_WIRE_READ(ticker_id);
+      IB_WIRE_READ(tick_type);
+      IB_WIRE_READ(value);
+      handler_->tickString(ticker_id, static_cast<TickType>(tick_type), value);
+      break;
+    }
+
+    case ORDER_STATUS: {
+      int order_id, filled, remaining, perm_id, parent_id, client_id;
+      double avg_fill_price, last_fill_price;
+      typename Strings::Type status, why_held;
+      IB_WIRE_READ(version);
+      IB_WIRE_READ(order_id);
+      IB_WIRE_READ(status);
+      IB_WIRE_READ(filled);
+      IB_WIRE_READ(remaining);
+      IB_WIRE_READ(avg_fill_price);
+      IB_WIRE_READ(perm_id);
+      IB_WIRE_READ(parent_id);
+      IB_WIRE_READ(last_fill_price);
+      IB_WIRE_READ(client_id);
+      IB_WIRE_READ(why_held);
+      handler_->orderStatus(order_id, status, filled, remaining,
+                            avg_fill_price, perm_id, parent_id,
+                            last_fill_price, client_id, why_held);
+      break;
+    }
+
+    case ERR_MSG: {
+      int id, error_code;
+      typename Strings::Type message;
+      IB_WIRE_READ(version);
+      IB_WIRE_READ(id);
+      IB_WIRE_READ(error_code);
+      IB_WIRE_READ(message);
+      handler_->error(id, error_code, message);
+      break;
+    }
+
+    case NEXT_VALID_ID: {
+      int order_id;
+      IB_WIRE_READ(version);
+      IB_WIRE_READ(order_id);
+      handler_->nextValidId(order_id);
+      break;
+    }
+
+    case MARKET_DEPTH: {
+      int id, position, operation, side, size;
+      double price;
+      IB_WIRE_READ(version);
+      IB_WIRE_READ(id);
+      IB_WIRE_READ(position);
+      IB_WIRE_READ(operation);
+      IB_WIRE_READ(side);
+      IB_WIRE_READ(price);
+      IB_WIRE_READ(size);
+      handler_->updateMktDepth(id, position, operation, side, price, size);
+      break;
+    }
+
+    case MARKET_DEPTH_L2: {
+      int id, position, operation, side, size;
+      double price;
+      typename Strings::Type market_maker;
+      IB_WIRE_READ(version);
+      IB_WIRE_READ(id);
+      IB_WIRE_READ(position);
+      IB_WIRE_READ(market_maker);
+      IB_WIRE_READ(operation);
+      IB_WIRE_READ(side);
+      IB_WIRE_READ(price);
+      IB_WIRE_READ(size);
+      internal::MarketDepthL2<Strings::VIEWS != 0>::Call(
+          handler_, &names_, id, position, market_maker, operation, side,
+          price, size);
+      break;
+    }
+
+    case CONTRACT_DATA:
+    case CONTRACT_DATA_END:
+      if (!Strings::VIEWS) return UNHANDLED;
+      if (!internal::ContractData<Strings::VIEWS != 0>::Decode(
+              msg_id, &in, handler_, &names_)) {
+        return 0;
+      }
+      break;
+
+    case CURRENT_TIME: {
+      int time;
+      IB_WIRE_READ(version);
+      IB_WIRE_READ(time);
+      handler_->currentTime(time);
+      break;
+    }
+
+    case REAL_TIME_BARS: {
+      int req_id, time, volume, count;
+      double open, high, low, close, average;
+      IB_WIRE_READ(version);
+      IB_WIRE_READ(req_id);
+      IB_WIRE_READ(time);
+      IB_WIRE_READ(open);
+      IB_WIRE_READ(high);
+      IB_WIRE_READ(low);
+      IB_WIRE_READ(close);
+      IB_WIRE_READ(volume);
+      IB_WIRE_READ(average);
+      IB_WIRE_READ(count);
+      handler_->realtimeBar(req_id, time, open, high, low, close, volume,
+                            average, count);
+      break;
+    }
+
+    case TICK_SNAPSHOT_END: {
+      int req_id;
+      IB_WIRE_READ(version);
+      IB_WIRE_READ(req_id);
+      handler_->tickSnapshotEnd(req_id);
+      break;
+    }
+
+    default:
+      return UNHANDLED;
+  }
+  return in.position() - begin;
+}
+
+#undef IB_WIRE_READ
+
+} // namespace wire
+} // namespace ib
+
+#endif // IB_WIRE_DECODER_H_
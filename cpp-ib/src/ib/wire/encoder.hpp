@@ -0,0 +1,140 @@
+#ifndef IB_WIRE_ENCODER_H_
+#define IB_WIRE_ENCODER_H_
+
+// Outgoing half of the codec.  Produces byte for byte what the vendored
+// EClientSocketBase of the release named by Traits sends to a server of
+// the given version, appended to a caller-owned string so that a batch
+// of requests goes out in one write.
+
+#ifndef IB_USE_STD_STRING
+#define IB_USE_STD_STRING
+#endif
+
+#include <string>
+
+#include <Shared/CommonDefs.h>
+#include <Shared/Contract.h>
+
+#include "ib/wire/field_codec.hpp"
+#include "ib/wire/messages.hpp"
+
+namespace ib {
+namespace wire {
+
+template <typename Traits>
+class Encoder
+{
+ public:
+  explicit Encoder(int server_version) : server_version_(server_version) {}
+
+  int server_version() const { return server_version_; }
+
+  // False, with nothing appended, if the server cannot take the
+  // contract (a conId or delta-neutral combo it does not support).
+  bool ReqMktData(TickerId ticker_id, const Contract& contract,
+                  const std::string& generic_ticks, bool snapshot,
+                  std::string* out) const
+  {
+    // Releases that predate the conId field ignore it.
+    const int min_con_id = Traits::MIN_SERVER_VER_REQ_MKT_DATA_CONID;
+    const bool con_id = server_version_ >= min_con_id;
+    const bool under_comp =
+        server_version_ >= Traits::MIN_SERVER_VER_UNDER_COMP;
+    if (!under_comp && contract.underComp) return false;
+    if (!con_id && contract.conId > 0 && min_con_id != NEVER) return false;
+
+    FieldWriter w(out);
+    w.Write(static_cast<int>(REQ_MKT_DATA));
+    w.Write(static_cast<int>(Traits::REQ_MKT_DATA_VERSION));
+    w.Write(ticker_id);
+    if (con_id) w.Write(contract.conId);
+    w.Write(contract.symbol);
+    w.Write(contract.secType);
+    w.Write(contract.expiry);
+    w.Write(contract.strike);
+    w.Write(contract.right);
+    w.Write(contract.multiplier);
+    w.Write(contract.exchange);
+    w.Write(contract.primaryExchange);
+    w.Write(contract.currency);
+    w.Write(contract.localSymbol);
+    if (contract.secType == "BAG") {
+      if (!contract.comboLegs || contract.comboLegs->empty()) {
+        w.Write(0);
+      } else {
+        const Contract::ComboLegList& legs = *contract.comboLegs;
+        w.Write(static_cast<int>(legs.size()));
+        for (Contract::ComboLegList::const_iterator leg = legs.begin();
+             leg != legs.end(); ++leg) {
+          w.Write((*leg)->conId);
+          w.Write((*leg)->ratio);
+          w.Write((*leg)->action);
+          w.Write((*leg)->exchange);
+        }
+      }
+    }
+    if (under_comp) {
+      if (contract.underComp) {
+        w.Write(true);
+        w.Write(contract.underComp->conId);
+        w.Write(contract.underComp->delta);
+        w.Write(contract.underComp->price);
+      } else {
+        w.Write(false);
+      }
+    }
+    w.Write(generic_ticks);
+    w.Write(snapshot);
+    return true;
+  }
+
+  void CancelMktData(TickerId ticker_id, std::string* out) const
+  {
+    FieldWriter w(out);
+    w.Write(static_cast<int>(CANCEL_MKT_DATA));
+    w.Write(2);
+    w.Write(ticker_id);
+  }
+
+  void ReqMktDepth(TickerId ticker_id, const Contract& contract, int rows,
+                   std::string* out) const
+  {
+    FieldWriter w(out);
+    w.Write(static_cast<int>(REQ_MKT_DEPTH));
+    w.Write(3);
+    w.Write(ticker_id);
+    w.Write(contract.symbol);
+    w.Write(contract.secType);
+    w.Write(contract.expiry);
+    w.Write(contract.strike);
+    w.Write(contract.right);
+    w.Write(contract.multiplier);
+    w.Write(contract.exchange);
+    w.Write(contract.currency);
+    w.Write(contract.localSymbol);
+    w.Write(rows);
+  }
+
+  void CancelMktDepth(TickerId ticker_id, std::string* out) const
+  {
+    FieldWriter w(out);
+    w.Write(static_cast<int>(CANCEL_MKT_DEPTH));
+    w.Write(1);
+    w.Write(ticker_id);
+  }
+
+  void ReqCurrentTime(std::string* out) const
+  {
+    FieldWriter w(out);
+    w.Write(static_cast<int>(REQ_CURRENT_TIME));
+    w.Write(1);
+  }
+
+ private:
+  const int server_version_;
+};
+
+} // namespace wire
+} // namespace ib
+
+#endif // IB_WIRE_ENCODER_H_
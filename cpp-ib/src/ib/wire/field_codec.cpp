@@ -0,0 +1,42 @@
+
+#include <float.h>
+#include <stdio.h>
+
+#include "ib/wire/field_codec.hpp"
+
+namespace ib {
+namespace wire {
+
+double ParseDoubleSlow(const char* field)
+{
+  return atof(field);
+}
+
+void FieldWriter::Write(double value)
+{
+  char buff[128];
+  int n = snprintf(buff, sizeof(buff), "%.10g", value);
+  out_->append(buff, n);
+  out_->push_back('\0');
+}
+
+void FieldWriter::WriteMax(int value)
+{
+  if (value == INT_MAX) {
+    out_->push_back('\0');
+    return;
+  }
+  Write(value);
+}
+
+void FieldWriter::WriteMax(double value)
+{
+  if (value == DBL_MAX) {
+    out_->push_back('\0');
+    return;
+  }
+  Write(value);
+}
+
+} // namespace wire
+} // namespace ib
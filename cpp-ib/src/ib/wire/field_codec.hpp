@@ -0,0 +1,226 @@
+#ifndef IB_WIRE_FIELD_CODEC_H_
+#define IB_WIRE_FIELD_CODEC_H_
+
+// Fields on the TWS wire are NUL-terminated ASCII.  FieldReader walks
+// a buffer of them without copying; numbers are parsed in the same
+// pass that finds the terminator.  FieldWriter appends fields to a
+// string without going through an ostream.  Both produce exactly what
+// the vendored EClientSocketBase's DecodeField (atoi / atof) and
+// EncodeField (operator<<, "%.10g") do.
+//
+// String fields can be read as a StringRef into the buffer instead of
+// a std::string, for callers that would only compare or intern them.
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+namespace ib {
+namespace wire {
+
+// A string field in place.  The byte after it is the field's
+// terminator, so data is also a C string.
+struct StringRef
+{
+  StringRef() : data(""), size(0) {}
+  StringRef(const char* d, size_t n) : data(d), size(n) {}
+
+  std::string str() const { return std::string(data, size); }
+
+  const char* data;
+  size_t size;
+};
+
+inline bool operator==(const StringRef& a, const StringRef& b)
+{
+  return a.size == b.size && memcmp(a.data, b.data, a.size) == 0;
+}
+
+inline bool operator==(const StringRef& a, const char* b)
+{
+  return strncmp(a.data, b, a.size) == 0 && b[a.size] == '\0';
+}
+
+// Slow path for numbers the inline parser does not take: exponents,
+// more than 15 significant digits, inf / nan.
+double ParseDoubleSlow(const char* field);
+
+class FieldReader
+{
+ public:
+  FieldReader(const char* begin, const char* end) : ptr_(begin), end_(end) {}
+
+  // Each returns false, leaving the position unchanged, if the buffer
+  // ends before the field's terminator.
+  bool Read(int* value)
+  {
+    const char* p = ptr_;
+    bool negative = false;
+    if (p < end_ && *p == '-') {
+      negative = true;
+      ++p;
+    }
+    unsigned v = 0;
+    while (p < end_ && static_cast<unsigned>(*p - '0') < 10) {
+      v = v * 10 + (*p++ - '0');
+    }
+    if (p < end_ && *p == '\0') {
+      *value = static_cast<int>(negative ? 0U - v : v);
+      ptr_ = p + 1;
+      return true;
+    }
+    const char* field = ptr_;
+    if (!Skip()) return false;
+    *value = atoi(field);
+    return true;
+  }
+
+  bool Read(long* value)
+  {
+    int v;
+    if (!Read(&v)) return false;
+    *value = v;
+    return true;
+  }
+
+  bool Read(bool* value)
+  {
+    int v;
+    if (!Read(&v)) return false;
+    *value = v > 0;
+    return true;
+  }
+
+  bool Read(double* value)
+  {
+    static const double kPow10[] = {
+      1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+      1e13, 1e14, 1e15
+    };
+    const char* p = ptr_;
+    bool negative = false;
+    if (p < end_ && *p == '-') {
+      negative = true;
+      ++p;
+    }
+    // Up to 15 digits fit a double's mantissa exactly, and dividing by
+    // an exact power of ten then rounds correctly, as strtod would.
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int scale = 0;
+    while (p < end_ && static_cast<unsigned>(*p - '0') < 10) {
+      mantissa = mantissa * 10 + (*p++ - '0');
+      digits++;
+    }
+    if (p < end_ && *p == '.') {
+      ++p;
+      while (p < end_ && static_cast<unsigned>(*p - '0') < 10) {
+        mantissa = mantissa * 10 + (*p++ - '0');
+        digits++;
+        scale++;
+      }
+    }
+    if (p < end_ && *p == '\0' && digits <= 15) {
+      double v = static_cast<double>(mantissa) / kPow10[scale];
+      *value = negative ? -v : v;
+      ptr_ = p + 1;
+      return true;
+    }
+    const char* field = ptr_;
+    if (!Skip()) return false;
+    *value = ParseDoubleSlow(field);
+    return true;
+  }
+
+  bool Read(std::string* value)
+  {
+    const char* s;
+    size_t length;
+    if (!Read(&s, &length)) return false;
+    value->assign(s, length);
+    return true;
+  }
+
+  // The field in place; valid for as long as the buffer is.
+  bool Read(const char** value, size_t* length)
+  {
+    const char* field = ptr_;
+    if (!Skip()) return false;
+    *value = field;
+    *length = ptr_ - field - 1;
+    return true;
+  }
+
+  bool Read(StringRef* value)
+  {
+    return Read(&value->data, &value->size);
+  }
+
+  bool Skip()
+  {
+    if (ptr_ >= end_) return false;
+    const char* field_end =
+        static_cast<const char*>(memchr(ptr_, 0, end_ - ptr_));
+    if (!field_end) return false;
+    ptr_ = field_end + 1;
+    return true;
+  }
+
+  const char* position() const { return ptr_; }
+
+ private:
+  const char* ptr_;
+  const char* end_;
+};
+
+class FieldWriter
+{
+ public:
+  explicit FieldWriter(std::string* out) : out_(out) {}
+
+  void Write(int value) { Write(static_cast<long>(value)); }
+
+  void Write(long value)
+  {
+    char buff[24];
+    char* p = buff + sizeof(buff);
+    unsigned long v = value < 0 ? 0UL - value : value;
+    do {
+      *--p = '0' + v % 10;
+      v /= 10;
+    } while (v);
+    if (value < 0) *--p = '-';
+    out_->append(p, buff + sizeof(buff) - p);
+    out_->push_back('\0');
+  }
+
+  void Write(bool value) { Write(value ? 1L : 0L); }
+
+  void Write(double value);
+
+  void Write(const std::string& value)
+  {
+    out_->append(value);
+    out_->push_back('\0');
+  }
+
+  void Write(const char* value)
+  {
+    out_->append(value);
+    out_->push_back('\0');
+  }
+
+  // Empty field for the API's "unset" values.
+  void WriteMax(int value);
+  void WriteMax(double value);
+
+ private:
+  std::string* out_;
+};
+
+} // namespace wire
+} // namespace ib
+
+#endif // IB_WIRE_FIELD_CODEC_H_
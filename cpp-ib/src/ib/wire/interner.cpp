@@ -0,0 +1,78 @@
+
+#include <string.h>
+
+#include "ib/wire/interner.hpp"
+
+namespace ib {
+namespace wire {
+
+static const size_t BLOCK_SIZE = 4096;
+
+Interner::Interner(int max_names)
+    : max_names_(max_names)
+    , block_free_(0)
+{
+}
+
+Interner::~Interner()
+{
+  for (size_t i = 0; i < blocks_.size(); ++i) delete[] blocks_[i];
+}
+
+int Interner::Find(const StringRef& name) const
+{
+  if (slots_.empty()) return NONE;
+  const uint32_t hash = Hash(name);
+  const size_t mask = slots_.size() - 1;
+  for (size_t i = hash & mask; slots_[i] != NONE; i = (i + 1) & mask) {
+    const int id = slots_[i];
+    if (hashes_[id] == hash && names_[id] == name) return id;
+  }
+  return NONE;
+}
+
+int Interner::Add(const StringRef& name, uint32_t hash)
+{
+  if (size() >= max_names_) return NONE;
+  char* copy = Allocate(name.size + 1);
+  memcpy(copy, name.data, name.size);
+  copy[name.size] = '\0';
+  const int id = size();
+  names_.push_back(StringRef(copy, name.size));
+  hashes_.push_back(hash);
+
+  // At most half full, so probes stay short.
+  if (names_.size() * 2 > slots_.size()) {
+    slots_.assign(slots_.empty() ? 64 : slots_.size() * 2, NONE);
+    for (int i = 0; i < id; ++i) Insert(i);
+  }
+  Insert(id);
+  return id;
+}
+
+void Interner::Insert(int id)
+{
+  const size_t mask = slots_.size() - 1;
+  size_t i = hashes_[id] & mask;
+  while (slots_[i] != NONE) i = (i + 1) & mask;
+  slots_[i] = id;
+}
+
+char* Interner::Allocate(size_t size)
+{
+  if (size > BLOCK_SIZE / 4) {
+    // A block of its own; the current one keeps its space.
+    blocks_.insert(blocks_.begin(), new char[size]);
+    return blocks_.front();
+  }
+  if (size > block_free_) {
+    blocks_.push_back(new char[BLOCK_SIZE]);
+    block_free_ = BLOCK_SIZE;
+  }
+  char* p = blocks_.back() + BLOCK_SIZE - block_free_;
+  block_free_ -= size;
+  return p;
+}
+
+} // namespace wire
+} // namespace ib
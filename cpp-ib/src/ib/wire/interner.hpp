@@ -0,0 +1,81 @@
+#ifndef IB_WIRE_INTERNER_H_
+#define IB_WIRE_INTERNER_H_
+
+// Maps the strings of a small vocabulary (exchanges, currencies,
+// security types, market makers) to small ids 0, 1, ... in order of
+// first sight.  Looking up a known string hashes it and compares it
+// in place, so it allocates nothing; a new one is copied once into an
+// arena whose blocks never move, so names stay valid for the life of
+// the interner.  Not thread-safe.
+
+#include <stdint.h>
+#include <vector>
+
+#include "ib/wire/field_codec.hpp"
+
+namespace ib {
+namespace wire {
+
+class Interner
+{
+ public:
+  enum { NONE = -1 };
+
+  // Past max_names strings, new ones are not added and get NONE, so a
+  // field that is not as low-cardinality as assumed cannot grow the
+  // table without bound.
+  explicit Interner(int max_names = 4096);
+  ~Interner();
+
+  // Id of the string, adding it if it is new.
+  int Intern(const StringRef& name)
+  {
+    const uint32_t hash = Hash(name);
+    if (!slots_.empty()) {
+      const size_t mask = slots_.size() - 1;
+      for (size_t i = hash & mask; slots_[i] != NONE; i = (i + 1) & mask) {
+        const int id = slots_[i];
+        if (hashes_[id] == hash && names_[id] == name) return id;
+      }
+    }
+    return Add(name, hash);
+  }
+
+  // NONE if it has not been interned.
+  int Find(const StringRef& name) const;
+
+  // Valid, and NUL-terminated, for the life of the interner.
+  const StringRef& Name(int id) const { return names_[id]; }
+
+  int size() const { return static_cast<int>(names_.size()); }
+
+ private:
+  Interner(const Interner&);
+  Interner& operator=(const Interner&);
+
+  // FNV-1a.
+  static uint32_t Hash(const StringRef& name)
+  {
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < name.size; ++i) {
+      hash = (hash ^ static_cast<unsigned char>(name.data[i])) * 16777619U;
+    }
+    return hash;
+  }
+
+  int Add(const StringRef& name, uint32_t hash);
+  void Insert(int id);
+  char* Allocate(size_t size);
+
+  const int max_names_;
+  std::vector<StringRef> names_;
+  std::vector<uint32_t> hashes_;  // Of names_.
+  std::vector<int> slots_;        // Ids or NONE; a power of two long.
+  std::vector<char*> blocks_;     // The arena.
+  size_t block_free_;             // Bytes left in the last block.
+};
+
+} // namespace wire
+} // namespace ib
+
+#endif // IB_WIRE_INTERNER_H_
@@ -0,0 +1,42 @@
+#ifndef IB_WIRE_MESSAGES_H_
+#define IB_WIRE_MESSAGES_H_
+
+// Message ids, identical across the vendored API releases.  Only the
+// ones the codec handles are listed; see EClientSocketBaseImpl.h for
+// the rest.
+
+namespace ib {
+namespace wire {
+
+// Client -> server.
+enum OutgoingMessage {
+  REQ_MKT_DATA = 1,
+  CANCEL_MKT_DATA = 2,
+  REQ_MKT_DEPTH = 10,
+  CANCEL_MKT_DEPTH = 11,
+  REQ_CURRENT_TIME = 49
+};
+
+// Server -> client.
+enum IncomingMessage {
+  TICK_PRICE = 1,
+  TICK_SIZE = 2,
+  ORDER_STATUS = 3,
+  ERR_MSG = 4,
+  NEXT_VALID_ID = 9,
+  CONTRACT_DATA = 10,
+  MARKET_DEPTH = 12,
+  MARKET_DEPTH_L2 = 13,
+  TICK_OPTION_COMPUTATION = 21,
+  TICK_GENERIC = 45,
+  TICK_STRING = 46,
+  CURRENT_TIME = 49,
+  REAL_TIME_BARS = 50,
+  CONTRACT_DATA_END = 52,
+  TICK_SNAPSHOT_END = 57
+};
+
+} // namespace wire
+} // namespace ib
+
+#endif // IB_WIRE_MESSAGES_H_
@@ -0,0 +1,243 @@
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ib/xml_scanner.hpp"
+
+using namespace std;
+
+namespace ib {
+
+static inline bool IsSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static inline bool IsNameChar(char c)
+{
+  return !IsSpace(c) && c != '>' && c != '/' && c != '=' && c != '<' &&
+      c != '"' && c != '\'';
+}
+
+static inline bool IsEntity(const char* entity, size_t length,
+                            const char* name)
+{
+  return strlen(name) == length && memcmp(entity, name, length) == 0;
+}
+
+// UTF-8 of a code point.
+static void AppendUtf8(unsigned long c, string* out)
+{
+  if (c < 0x80) {
+    out->push_back(static_cast<char>(c));
+  } else if (c < 0x800) {
+    out->push_back(static_cast<char>(0xc0 | (c >> 6)));
+    out->push_back(static_cast<char>(0x80 | (c & 0x3f)));
+  } else if (c < 0x10000) {
+    out->push_back(static_cast<char>(0xe0 | (c >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | (c & 0x3f)));
+  } else {
+    out->push_back(static_cast<char>(0xf0 | (c >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((c >> 12) & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | ((c >> 6) & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | (c & 0x3f)));
+  }
+}
+
+const string* XmlAttributes::Find(const char* name) const
+{
+  for (size_t i = 0; i < size_; ++i) {
+    if (names_[i] == name) return &values_[i];
+  }
+  return NULL;
+}
+
+void XmlAttributes::Add(string** name, string** value)
+{
+  if (size_ == names_.size()) {
+    names_.push_back(string());
+    values_.push_back(string());
+  }
+  *name = &names_[size_];
+  *value = &values_[size_];
+  (*name)->clear();
+  (*value)->clear();
+  size_++;
+}
+
+bool XmlScanner::Scan(const char* begin, const char* end)
+{
+  ptr_ = begin;
+  end_ = end;
+  depth_ = 0;
+  text_.clear();
+  while (ptr_ < end_) {
+    if (*ptr_ == '<') {
+      if (!Tag()) return false;
+      continue;
+    }
+    const char* lt = static_cast<const char*>(memchr(ptr_, '<', end_ - ptr_));
+    const char* text_end = lt ? lt : end_;
+    if (!Decode(ptr_, text_end, &text_)) return false;
+    ptr_ = text_end;
+  }
+  FlushText();
+  return depth_ == 0;
+}
+
+void XmlScanner::FlushText()
+{
+  for (size_t i = 0; i < text_.size(); ++i) {
+    if (!IsSpace(text_[i])) {
+      handler_->Text(text_);
+      break;
+    }
+  }
+  text_.clear();
+}
+
+bool XmlScanner::Tag()
+{
+  const char* tag = ptr_ + 1;
+  const size_t left = end_ - tag;
+  if (left >= 3 && memcmp(tag, "!--", 3) == 0) {
+    ptr_ = tag + 3;
+    return Skip("-->");
+  }
+  if (left >= 8 && memcmp(tag, "![CDATA[", 8) == 0) {
+    const char* data = tag + 8;
+    ptr_ = data;
+    if (!Skip("]]>")) return false;
+    text_.append(data, ptr_ - 3 - data);
+    return true;
+  }
+  if (left >= 1 && (*tag == '?' || *tag == '!')) {
+    ptr_ = tag;
+    return Skip(">");
+  }
+
+  FlushText();
+  if (left >= 1 && *tag == '/') {
+    ptr_ = tag + 1;
+    if (!Name(&name_)) return false;
+    SkipSpace();
+    if (ptr_ >= end_ || *ptr_ != '>') return false;
+    ++ptr_;
+    if (depth_ == 0 || open_[depth_ - 1] != name_) return false;
+    --depth_;
+    handler_->EndElement(name_);
+    return true;
+  }
+
+  ptr_ = tag;
+  if (depth_ == open_.size()) open_.push_back(string());
+  string& name = open_[depth_];
+  if (!Name(&name)) return false;
+  attributes_.Clear();
+  while (true) {
+    SkipSpace();
+    if (ptr_ >= end_) return false;
+    if (*ptr_ == '>' || *ptr_ == '/') break;
+    string* attribute;
+    string* value;
+    attributes_.Add(&attribute, &value);
+    if (!Name(attribute)) return false;
+    SkipSpace();
+    if (ptr_ >= end_ || *ptr_ != '=') return false;
+    ++ptr_;
+    SkipSpace();
+    if (ptr_ >= end_ || (*ptr_ != '"' && *ptr_ != '\'')) return false;
+    const char quote = *ptr_++;
+    const char* close =
+        static_cast<const char*>(memchr(ptr_, quote, end_ - ptr_));
+    if (!close || !Decode(ptr_, close, value)) return false;
+    ptr_ = close + 1;
+  }
+  const bool empty = *ptr_ == '/';
+  if (empty && (++ptr_ >= end_ || *ptr_ != '>')) return false;
+  ++ptr_;
+  handler_->StartElement(name, attributes_);
+  if (empty) {
+    handler_->EndElement(name);
+  } else {
+    ++depth_;
+  }
+  return true;
+}
+
+bool XmlScanner::Name(string* name)
+{
+  const char* start = ptr_;
+  while (ptr_ < end_ && IsNameChar(*ptr_)) ++ptr_;
+  if (ptr_ == start) return false;
+  name->assign(start, ptr_ - start);
+  return true;
+}
+
+bool XmlScanner::Decode(const char* begin, const char* end, string* out)
+{
+  while (begin < end) {
+    const char* amp =
+        static_cast<const char*>(memchr(begin, '&', end - begin));
+    if (!amp) {
+      out->append(begin, end - begin);
+      return true;
+    }
+    out->append(begin, amp - begin);
+    const char* semi =
+        static_cast<const char*>(memchr(amp, ';', end - amp));
+    if (!semi) return false;
+    const char* entity = amp + 1;
+    const size_t length = semi - entity;
+    if (IsEntity(entity, length, "amp")) {
+      out->push_back('&');
+    } else if (IsEntity(entity, length, "lt")) {
+      out->push_back('<');
+    } else if (IsEntity(entity, length, "gt")) {
+      out->push_back('>');
+    } else if (IsEntity(entity, length, "quot")) {
+      out->push_back('"');
+    } else if (IsEntity(entity, length, "apos")) {
+      out->push_back('\'');
+    } else if (length > 1 && entity[0] == '#') {
+      const bool hex = entity[1] == 'x';
+      const char* digits = entity + (hex ? 2 : 1);
+      // strtoul takes no digits, a sign or spaces, which XML does not;
+      // and NUL is no character of it.
+      if (!(hex ? isxdigit(*digits) : isdigit(*digits))) return false;
+      char* parsed;
+      const unsigned long c = strtoul(digits, &parsed, hex ? 16 : 10);
+      if (parsed != semi || c == 0) return false;
+      AppendUtf8(c, out);
+    } else {
+      return false;
+    }
+    begin = semi + 1;
+  }
+  return true;
+}
+
+bool XmlScanner::Skip(const char* terminator)
+{
+  const size_t n = strlen(terminator);
+  while (static_cast<size_t>(end_ - ptr_) >= n) {
+    const char* p = static_cast<const char*>(
+        memchr(ptr_, terminator[0], end_ - ptr_ - n + 1));
+    if (!p) break;
+    if (memcmp(p, terminator, n) == 0) {
+      ptr_ = p + n;
+      return true;
+    }
+    ptr_ = p + 1;
+  }
+  return false;
+}
+
+void XmlScanner::SkipSpace()
+{
+  while (ptr_ < end_ && IsSpace(*ptr_)) ++ptr_;
+}
+
+} // namespace ib
@@ -0,0 +1,97 @@
+#ifndef IB_XML_SCANNER_H_
+#define IB_XML_SCANNER_H_
+
+// A forward-only XML scanner for the documents the TWS sends as single
+// strings (fundamentalData, scannerParameters): one pass that calls a
+// handler for each element and its text, without building a tree, so
+// a document of megabytes costs a scan and the fields the handler
+// keeps.
+//
+// It is not validating.  It takes the declaration, comments,
+// processing instructions, a DOCTYPE without an internal subset,
+// CDATA, attributes in either quote, the predefined entities and
+// character references.  Names, text and attribute values are passed
+// in buffers the scanner reuses, so after the first few elements a
+// scan does not allocate.
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+
+namespace ib {
+
+class XmlAttributes
+{
+ public:
+  XmlAttributes() : size_(0) {}
+
+  size_t size() const { return size_; }
+  const std::string& name(size_t i) const { return names_[i]; }
+  const std::string& value(size_t i) const { return values_[i]; }
+
+  // The value of the named attribute, or NULL.
+  const std::string* Find(const char* name) const;
+
+ private:
+  friend class XmlScanner;
+
+  void Clear() { size_ = 0; }
+  void Add(std::string** name, std::string** value);
+
+  size_t size_;
+  std::vector<std::string> names_;  // Kept past size_ for reuse.
+  std::vector<std::string> values_;
+};
+
+class XmlHandler
+{
+ public:
+  virtual ~XmlHandler() {}
+
+  // An empty element (<a/>) is a start followed by an end.
+  virtual void StartElement(const std::string& name,
+                            const XmlAttributes& attributes) = 0;
+  virtual void EndElement(const std::string& name) = 0;
+
+  // Character data, with entities decoded.  The text of one element
+  // may come in several calls (around comments, CDATA or children);
+  // runs of only whitespace are not passed.
+  virtual void Text(const std::string& text) = 0;
+};
+
+class XmlScanner : NoCopyAndAssign
+{
+ public:
+  explicit XmlScanner(XmlHandler* handler) : handler_(handler) {}
+
+  // Returns false at the first malformed construct or unbalanced end
+  // tag; the handler has seen the document up to it.
+  bool Scan(const char* begin, const char* end);
+  bool Scan(const std::string& document)
+  {
+    return Scan(document.data(), document.data() + document.size());
+  }
+
+ private:
+  bool Tag();
+  bool Name(std::string* name);
+  bool Decode(const char* begin, const char* end, std::string* out);
+  bool Skip(const char* terminator);
+  void SkipSpace();
+  void FlushText();
+
+  XmlHandler* handler_;
+  const char* ptr_;
+  const char* end_;
+  std::string name_;
+  std::string text_;
+  XmlAttributes attributes_;
+  std::vector<std::string> open_;  // Element names, for end tags.
+  size_t depth_;                    // Of open_ in use.
+};
+
+} // namespace ib
+
+#endif // IB_XML_SCANNER_H_
@@ -0,0 +1,137 @@
+#ifndef LOCKFREE_H_
+#define LOCKFREE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <glog/logging.h>
+
+#include "common.hpp"
+
+namespace lab616 {
+namespace lockfree {
+
+// Size of a cache line on the boxes we run on.  Used to pad hot
+// counters so producers and consumers do not false-share.
+static const size_t CACHE_LINE = 64;
+
+// Full memory barrier (also a compiler barrier).
+inline void memory_barrier()
+{
+  __sync_synchronize();
+}
+
+// Compiler-only barrier.  Sufficient on x86 for load-acquire and
+// store-release since the hardware does not reorder those.
+inline void compiler_barrier()
+{
+  __asm__ __volatile__("" ::: "memory");
+}
+
+template <typename T> inline T load_acquire(const volatile T& v)
+{
+  T value = v;
+  compiler_barrier();
+  return value;
+}
+
+template <typename T> inline void store_release(volatile T& v, T value)
+{
+  compiler_barrier();
+  v = value;
+}
+
+// Bounded multi-producer / single-consumer queue.
+//
+// This is the array-based queue described by Dmitry Vyukov: every slot
+// carries a sequence number, producers claim a position with a single
+// CAS and publish by bumping the slot sequence.  Neither side takes a
+// lock and neither side ever waits on the other; a full queue is
+// reported to the producer, which decides whether to drop or retry.
+//
+// Capacity must be a power of 2.  T must be copy-assignable.
+template <typename T>
+class BoundedQueue : NoCopyAndAssign
+{
+ public:
+  explicit BoundedQueue(size_t capacity)
+      : mask_(capacity - 1)
+      , slots_(new Slot[capacity])
+      , enqueue_pos_(0)
+      , dequeue_pos_(0)
+  {
+    CHECK(capacity >= 2 && (capacity & (capacity - 1)) == 0)
+        << "Capacity must be a power of 2: " << capacity;
+    for (size_t i = 0; i < capacity; ++i) {
+      slots_[i].sequence = i;
+    }
+  }
+
+  ~BoundedQueue()
+  {
+    delete[] slots_;
+  }
+
+  // Returns false if the queue is full.  Never blocks.
+  bool Push(const T& data)
+  {
+    Slot* slot;
+    size_t pos = load_acquire(enqueue_pos_);
+    while (true) {
+      slot = &slots_[pos & mask_];
+      size_t seq = load_acquire(slot->sequence);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (__sync_bool_compare_and_swap(&enqueue_pos_, pos, pos + 1)) break;
+        pos = load_acquire(enqueue_pos_);
+      } else if (diff < 0) {
+        return false;  // Full.
+      } else {
+        pos = load_acquire(enqueue_pos_);
+      }
+    }
+    slot->data = data;
+    store_release(slot->sequence, pos + 1);
+    return true;
+  }
+
+  // Returns false if the queue is empty.  Single consumer only.
+  bool Pop(T* data)
+  {
+    size_t pos = dequeue_pos_;
+    Slot* slot = &slots_[pos & mask_];
+    size_t seq = load_acquire(slot->sequence);
+    if ((intptr_t)seq - (intptr_t)(pos + 1) < 0) return false;  // Empty.
+    *data = slot->data;
+    store_release(slot->sequence, pos + mask_ + 1);
+    dequeue_pos_ = pos + 1;
+    return true;
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+
+  // Approximate number of queued items.
+  size_t size() const
+  {
+    return load_acquire(enqueue_pos_) - load_acquire(dequeue_pos_);
+  }
+
+ private:
+  struct Slot {
+    volatile size_t sequence;
+    T data;
+  };
+
+  const size_t mask_;
+  Slot* const slots_;
+
+  char pad0_[CACHE_LINE];
+  volatile size_t enqueue_pos_;
+  char pad1_[CACHE_LINE];
+  volatile size_t dequeue_pos_;
+  char pad2_[CACHE_LINE];
+};
+
+} // namespace lockfree
+} // namespace lab616
+
+#endif // LOCKFREE_H_
@@ -6,6 +6,9 @@
 #include <gtest/gtest.h>
 
 #include <ib/adapters.hpp>
+#include <ib/contract_store.hpp>
+
+#include "fake_gateway.hpp"
 
 using namespace ib::adapter;
 using namespace std;
@@ -53,4 +56,143 @@ TEST(AdapterTest, CreateAdapterTest) {
   EXPECT_EQ(CONNECTED, wrapper.GetState());
 }
 
+// Counts the callbacks for the fake gateway's messages.
+class CountingEWrapper : public LoggingEWrapper {
+ public:
+  CountingEWrapper() :
+      LoggingEWrapper::LoggingEWrapper("", 0, 2),
+      ticks(0), next_id(0), time(0)
+  {
+  }
+
+  void tickPrice(TickerId id, TickType field, double price,
+                 int canAutoExecute) {
+    if (field == BID && id == ticks) ticks++;
+  }
+  void nextValidId(OrderId orderId) { next_id = orderId; }
+  void currentTime(long t) { time = t; }
+
+  int ticks;
+  OrderId next_id;
+  long time;
+};
+
+// The socket's ticks are decoded, and its reqCurrentTime encoded, by
+// ib::wire.
+TEST(AdapterTest, SocketUsesTheWireCodec) {
+  ib::testing::FakeGateway gateway;
+  gateway.Start(1000);
+  CountingEWrapper wrapper;
+  LoggingEClientSocket socket(2, &wrapper);
+  ASSERT_TRUE(socket.eConnect("127.0.0.1", gateway.port(), 2));
+  while (wrapper.ticks < 1000 && socket.isSocketOK()) socket.onReceive();
+  EXPECT_EQ(1000, wrapper.ticks);
+  EXPECT_EQ(1, wrapper.next_id);
+
+  socket.reqCurrentTime();
+  while (wrapper.time == 0 && socket.isSocketOK()) socket.onReceive();
+  EXPECT_GT(wrapper.time, 0);
+  socket.eDisconnect();
+  gateway.Join();
+}
+
+// CONTRACT_DATA (version 6) for AAPL, request 3, then its end.
+string ContractData()
+{
+  const char* fields[] = {
+    "10", "6", "3", "AAPL", "STK", "", "0", "", "SMART", "USD", "AAPL",
+    "NMS", "NMS", "265598", "0.01", "", "ACTIVETIM,ADJUST,ALERT",
+    "SMART,ISLAND,ARCA", "1", "0", "APPLE INC", "NASDAQ", "", "Technology",
+    "Computers", "Computers", "EST", "20110114:0400-2000",
+    "20110114:0930-1600", "52", "1", "3" };
+  string out;
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+    out.append(fields[i]);
+    out.push_back('\0');
+  }
+  return out;
+}
+
+// Stores the views, as Session does.
+class StoringEWrapper : public LoggingEWrapper {
+ public:
+  StoringEWrapper() :
+      LoggingEWrapper::LoggingEWrapper("", 0, 3),
+      ended(0)
+  {
+  }
+
+  void contractDetailsView(int reqId,
+                           const ib::wire::ContractDetailsView& details,
+                           const ib::wire::Interner& names) {
+    store.Add(details, names);
+  }
+  void contractDetailsEnd(int reqId) { ended = reqId; }
+
+  ib::ContractStore store;
+  int ended;
+};
+
+// The socket decodes contract details in place and the store interns
+// their names.
+TEST(AdapterTest, SocketInternsContractDetails) {
+  ib::testing::FakeGateway gateway;
+  gateway.Start(0, ContractData());
+  StoringEWrapper wrapper;
+  LoggingEClientSocket socket(3, &wrapper);
+  ASSERT_TRUE(socket.eConnect("127.0.0.1", gateway.port(), 3));
+  while (wrapper.ended != 3 && socket.isSocketOK()) socket.onReceive();
+  EXPECT_EQ(3, wrapper.ended);
+
+  ASSERT_EQ(1, wrapper.store.size());
+  int slot = wrapper.store.FindConId(265598);
+  ASSERT_NE(ib::ContractStore::NONE, slot);
+  EXPECT_EQ("AAPL", wrapper.store.symbol(slot).str());
+  EXPECT_EQ("SMART",
+            wrapper.store.name(slot, ib::ContractStore::EXCHANGE).str());
+  EXPECT_EQ("NASDAQ",
+            wrapper.store.name(slot,
+                               ib::ContractStore::PRIMARY_EXCHANGE).str());
+  socket.eDisconnect();
+  gateway.Join();
+}
+
+// Keeps the copy LoggingEWrapper makes of the views.
+class CopyingEWrapper : public LoggingEWrapper {
+ public:
+  CopyingEWrapper() :
+      LoggingEWrapper::LoggingEWrapper("", 0, 4),
+      ended(0)
+  {
+  }
+
+  void contractDetails(int reqId, const ContractDetails& details) {
+    copy = details;
+  }
+  void contractDetailsEnd(int reqId) { ended = reqId; }
+
+  ContractDetails copy;
+  int ended;
+};
+
+// Wrappers that only know ContractDetails still get every field.
+TEST(AdapterTest, SocketCopiesContractDetails) {
+  ib::testing::FakeGateway gateway;
+  gateway.Start(0, ContractData());
+  CopyingEWrapper wrapper;
+  LoggingEClientSocket socket(4, &wrapper);
+  ASSERT_TRUE(socket.eConnect("127.0.0.1", gateway.port(), 4));
+  while (wrapper.ended != 3 && socket.isSocketOK()) socket.onReceive();
+  EXPECT_EQ(3, wrapper.ended);
+
+  EXPECT_EQ("AAPL", string(wrapper.copy.summary.symbol));
+  EXPECT_EQ(265598, wrapper.copy.summary.conId);
+  EXPECT_EQ("NASDAQ", string(wrapper.copy.summary.primaryExchange));
+  EXPECT_EQ("APPLE INC", string(wrapper.copy.longName));
+  EXPECT_EQ("SMART,ISLAND,ARCA", string(wrapper.copy.validExchanges));
+  EXPECT_EQ("20110114:0930-1600", string(wrapper.copy.liquidHours));
+  socket.eDisconnect();
+  gateway.Join();
+}
+
 } // namespace
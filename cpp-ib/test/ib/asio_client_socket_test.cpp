@@ -0,0 +1,143 @@
+
+#include <boost/thread.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "ib/adapters.hpp"
+#include "ib/transport/asio_client_socket.hpp"
+#include "ib/transport/io_service_pool.hpp"
+#include "fake_gateway.hpp"
+
+using namespace std;
+using ib::testing::FakeGateway;
+using ib::transport::AsioClientSocket;
+using ib::transport::IoServicePool;
+
+namespace {
+
+class CountingEWrapper : public ib::adapter::LoggingEWrapper
+{
+ public:
+  CountingEWrapper()
+      : LoggingEWrapper("127.0.0.1", 0, 0)
+      , ticks(0), sizes(0), out_of_order(0), next_id(0), time(0)
+      , closed(false)
+  {
+  }
+
+  void tickPrice(TickerId id, TickType, double, int)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (id != ticks) out_of_order++;
+    ticks++;
+    cond.notify_all();
+  }
+
+  void tickSize(TickerId, TickType, int)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    sizes++;
+    cond.notify_all();
+  }
+
+  void nextValidId(OrderId id)
+  {
+    next_id = id;
+  }
+
+  void currentTime(long t)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    time = t;
+    cond.notify_all();
+  }
+
+  void connectionClosed()
+  {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    closed = true;
+    cond.notify_all();
+  }
+
+  bool WaitForTicks(int n)
+  {
+    boost::system_time deadline =
+        boost::get_system_time() + boost::posix_time::seconds(10);
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (ticks < n || sizes < n) {
+      if (!cond.timed_wait(lock, deadline)) return false;
+    }
+    return true;
+  }
+
+  bool WaitForTime()
+  {
+    boost::system_time deadline =
+        boost::get_system_time() + boost::posix_time::seconds(10);
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (time == 0) {
+      if (!cond.timed_wait(lock, deadline)) return false;
+    }
+    return true;
+  }
+
+  boost::mutex mutex;
+  boost::condition_variable cond;
+  int ticks;
+  int sizes;
+  int out_of_order;
+  long next_id;
+  long time;
+  bool closed;
+};
+
+TEST(AsioClientSocketTest, ConnectsAndReceivesInOrder)
+{
+  FakeGateway gateway;
+  gateway.Start(20000);
+
+  IoServicePool pool(4);
+  pool.Start();
+
+  CountingEWrapper wrapper;
+  AsioClientSocket client(pool.io_service(), &wrapper);
+  ASSERT_TRUE(client.eConnect("127.0.0.1", gateway.port(), 7));
+  EXPECT_TRUE(client.isConnected());
+  EXPECT_EQ(45, client.serverVersion());
+
+  // Callbacks run on the pool but never concurrently or out of order.
+  ASSERT_TRUE(wrapper.WaitForTicks(20000));
+  EXPECT_EQ(0, wrapper.out_of_order);
+  EXPECT_EQ(20000, wrapper.sizes);
+  EXPECT_EQ(1, wrapper.next_id);
+
+  // Requests go out from this thread.
+  client.reqCurrentTime();
+  ASSERT_TRUE(wrapper.WaitForTime());
+  EXPECT_GT(wrapper.time, 0);
+
+  client.eDisconnect();
+  EXPECT_FALSE(client.isSocketOK());
+  gateway.Join();
+  EXPECT_FALSE(wrapper.closed);  // Only reported when the peer closes.
+}
+
+TEST(AsioClientSocketTest, FailsWithoutGateway)
+{
+  unsigned int port;
+  {
+    // Nothing listens on a port that was just released.
+    FakeGateway gateway;
+    port = gateway.port();
+  }
+  IoServicePool pool(1);
+  pool.Start();
+
+  CountingEWrapper wrapper;
+  AsioClientSocket client(pool.io_service(), &wrapper);
+  EXPECT_FALSE(client.eConnect("127.0.0.1", port, 7));
+  EXPECT_FALSE(client.isSocketOK());
+}
+
+} // namespace
@@ -0,0 +1,169 @@
+
+// Compares the vendored EPosixClientSocket, polled by a select() loop
+// on its own thread as PollingClient does, with AsioClientSocket on a
+// shared io_service pool.  Both connect to the loopback FakeGateway:
+//
+//   throughput: time to decode a burst of tickPrice messages;
+//   latency:    round trips of reqCurrentTime -> currentTime.
+
+#include <sys/select.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "utils.hpp"
+#include "ib/adapters.hpp"
+#include "ib/transport/asio_client_socket.hpp"
+#include "ib/transport/io_service_pool.hpp"
+#include "fake_gateway.hpp"
+
+using namespace std;
+using ib::testing::FakeGateway;
+using ib::transport::AsioClientSocket;
+using ib::transport::IoServicePool;
+using lab616::utils::now_micros;
+
+namespace {
+
+const int kTicks = 500000;
+const int kRoundTrips = 2000;
+
+class BenchmarkEWrapper : public ib::adapter::LoggingEWrapper
+{
+ public:
+  BenchmarkEWrapper()
+      : LoggingEWrapper("127.0.0.1", 0, 0), ticks(0), times(0) {}
+
+  void tickPrice(TickerId, TickType, double, int)
+  {
+    if (++ticks == kTicks) {
+      boost::unique_lock<boost::mutex> lock(mutex);
+      cond.notify_all();
+    }
+  }
+  void tickSize(TickerId, TickType, int) {}
+
+  void currentTime(long)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    times++;
+    cond.notify_all();
+  }
+
+  void WaitForTicks()
+  {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (ticks < kTicks) cond.wait(lock);
+  }
+
+  void WaitForTime(int n)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (times < n) cond.wait(lock);
+  }
+
+  boost::mutex mutex;
+  boost::condition_variable cond;
+  volatile int ticks;
+  int times;
+};
+
+void Report(const string& name, int64_t burst_micros,
+            vector<int64_t>* round_trips)
+{
+  sort(round_trips->begin(), round_trips->end());
+  cout << name << ": "
+       << kTicks * 1e6 / burst_micros << " ticks/s, round trip p50="
+       << (*round_trips)[round_trips->size() / 2] << "us p99="
+       << (*round_trips)[round_trips->size() * 99 / 100] << "us" << endl;
+}
+
+// Times the burst from the connect call, which includes the handshake;
+// the same for both transports.
+template <typename Client>
+void Measure(const string& name, Client* client, BenchmarkEWrapper* wrapper,
+             int64_t start)
+{
+  wrapper->WaitForTicks();
+  int64_t burst = now_micros() - start;
+
+  vector<int64_t> round_trips;
+  for (int i = 1; i <= kRoundTrips; ++i) {
+    int64_t t = now_micros();
+    client->reqCurrentTime();
+    wrapper->WaitForTime(i);
+    round_trips.push_back(now_micros() - t);
+  }
+  Report(name, burst, &round_trips);
+}
+
+void Poll(EPosixClientSocket* client, volatile bool* running)
+{
+  while (*running && client->isSocketOK()) {
+    fd_set readers;
+    FD_ZERO(&readers);
+    FD_SET(client->fd(), &readers);
+    struct timeval tval;
+    tval.tv_sec = 0;
+    tval.tv_usec = 1000;
+    if (select(client->fd() + 1, &readers, NULL, NULL, &tval) > 0) {
+      client->onReceive();
+    }
+  }
+}
+
+TEST(AsioSocketBenchmark, PollingSocket)
+{
+  FakeGateway gateway;
+  gateway.Start(kTicks);
+
+  BenchmarkEWrapper wrapper;
+  EPosixClientSocket client(&wrapper);
+  int64_t start = now_micros();
+  ASSERT_TRUE(client.eConnect("127.0.0.1", gateway.port(), 1));
+  volatile bool running = true;
+  boost::thread poller(boost::bind(Poll, &client, &running));
+
+  Measure("polling", &client, &wrapper, start);
+
+  running = false;
+  poller.join();
+  client.eDisconnect();
+}
+
+void BenchmarkAsio(int threads)
+{
+  FakeGateway gateway;
+  gateway.Start(kTicks);
+
+  IoServicePool pool(threads);
+  pool.Start();
+
+  BenchmarkEWrapper wrapper;
+  AsioClientSocket client(pool.io_service(), &wrapper);
+  int64_t start = now_micros();
+  ASSERT_TRUE(client.eConnect("127.0.0.1", gateway.port(), 1));
+
+  Measure("asio x" + boost::lexical_cast<string>(threads), &client, &wrapper,
+          start);
+
+  client.eDisconnect();
+}
+
+TEST(AsioSocketBenchmark, AsioSocketOneThread)
+{
+  BenchmarkAsio(1);
+}
+
+TEST(AsioSocketBenchmark, AsioSocketPool)
+{
+  BenchmarkAsio(4);
+}
+
+} // namespace
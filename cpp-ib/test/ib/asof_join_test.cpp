@@ -0,0 +1,159 @@
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "ib/asof_join.hpp"
+#include "ib/backplane.hpp"
+
+using namespace std;
+using ib::BackPlane;
+using ib::QuoteTable;
+using ib::Receiver;
+using ib::history::AsOfIndex;
+using ib::history::AsOfJoin;
+using ib::history::JoinColumns;
+using ib::history::JoinedTick;
+using ib::signal::GetTickerId;
+using ib::signal::SymbolSet;
+
+namespace {
+
+struct Row
+{
+  int64_t ts;
+  int id;
+  double value;
+  vector<double> right;
+};
+
+struct Rows : public Receiver<JoinedTick>
+{
+  void operator()(const JoinedTick& tick)
+  {
+    Row row;
+    row.ts = tick.ts;
+    row.id = tick.id;
+    row.value = tick.value;
+    row.right.assign(tick.right, tick.right + tick.columns);
+    rows.push_back(row);
+  }
+  vector<Row> rows;
+};
+
+TEST(AsOfJoinTest, JoinsHistory)
+{
+  JoinColumns columns;
+  EXPECT_EQ(0U, columns.Add("SPY", QuoteTable::BID));
+  EXPECT_EQ(1U, columns.Add("SPY", QuoteTable::ASK));
+  EXPECT_EQ(0U, columns.Add("SPY", QuoteTable::BID));
+  const int spy = GetTickerId("SPY"), qqq = GetTickerId("QQQ");
+
+  AsOfIndex index(columns);
+  EXPECT_TRUE(index.Add(100, spy, QuoteTable::BID, 110.0));
+  EXPECT_TRUE(index.Add(300, spy, QuoteTable::BID, 110.1));
+  EXPECT_TRUE(index.Add(200, spy, QuoteTable::ASK, 110.2));  // Out of order.
+  EXPECT_TRUE(index.Add(150, spy, QuoteTable::ASK, 110.3));
+  EXPECT_FALSE(index.Add(150, spy, QuoteTable::LAST, 110.3));
+  EXPECT_FALSE(index.Add(150, qqq, QuoteTable::BID, 50.0));
+  index.Seal();
+  EXPECT_EQ(4U, index.ticks());
+
+  SymbolSet left;
+  left.Add("QQQ");
+  Rows out;
+  AsOfJoin join(columns, left, &index, &out);
+  join.OnField(50, qqq, QuoteTable::BID, 50.0);
+  join.OnField(100, qqq, QuoteTable::BID, 50.1);
+  join.OnField(175, qqq, QuoteTable::ASK, 50.2);
+  join.OnField(175, spy, QuoteTable::BID, 1.0);  // Not on the left.
+  join.OnField(500, qqq, QuoteTable::ASK, 50.3);
+  join.OnField(120, qqq, QuoteTable::ASK, 50.4);  // Back in time.
+
+  ASSERT_EQ(5U, out.rows.size());
+  EXPECT_EQ(5U, join.joined());
+  EXPECT_TRUE(isnan(out.rows[0].right[0]));
+  EXPECT_TRUE(isnan(out.rows[0].right[1]));
+  EXPECT_EQ(110.0, out.rows[1].right[0]);
+  EXPECT_TRUE(isnan(out.rows[1].right[1]));
+  EXPECT_EQ(110.0, out.rows[2].right[0]);
+  EXPECT_EQ(110.3, out.rows[2].right[1]);
+  EXPECT_EQ(110.1, out.rows[3].right[0]);
+  EXPECT_EQ(110.2, out.rows[3].right[1]);
+  EXPECT_EQ(110.0, out.rows[4].right[0]);
+  EXPECT_TRUE(isnan(out.rows[4].right[1]));
+}
+
+TEST(AsOfJoinTest, MatchesLinearScan)
+{
+  JoinColumns columns;
+  columns.Add("SPY", QuoteTable::LAST);
+  const int spy = GetTickerId("SPY"), opt = GetTickerId("SPYOPT");
+
+  // Bursts of underlying ticks between the option ticks.
+  srand(616);
+  vector<int64_t> times;
+  AsOfIndex index(columns);
+  int64_t ts = 0;
+  for (int i = 0; i < 100000; ++i) {
+    ts += rand() % 3;
+    times.push_back(ts);
+    index.Add(ts, spy, QuoteTable::LAST, i);
+  }
+  index.Seal();
+
+  SymbolSet left;
+  left.Add(opt);
+  Rows out;
+  AsOfJoin join(columns, left, &index, &out);
+  for (int64_t t = -5; t < ts + 5; t += 1 + rand() % 50) {
+    join.OnField(t, opt, QuoteTable::BID, 1.0);
+  }
+  for (size_t i = 0; i < out.rows.size(); ++i) {
+    const Row& row = out.rows[i];
+    size_t n = upper_bound(times.begin(), times.end(), row.ts) - times.begin();
+    if (n == 0) {
+      EXPECT_TRUE(isnan(row.right[0])) << row.ts;
+    } else {
+      EXPECT_EQ(n - 1, row.right[0]) << row.ts;
+    }
+  }
+}
+
+TEST(AsOfJoinTest, JoinsTheLiveBackPlane)
+{
+  JoinColumns columns;
+  columns.Add("SPY", QuoteTable::BID);
+  columns.Add("IWM", QuoteTable::LAST);
+  const int spy = GetTickerId("SPY"), iwm = GetTickerId("IWM");
+
+  SymbolSet left;
+  left.Add("SPY");
+  left.Add("IWM");
+  Rows out;
+  AsOfJoin join(columns, left, NULL, &out);
+  boost::scoped_ptr<BackPlane> backplane(BackPlane::Create());
+  backplane->Register(static_cast<Receiver<BidAsk>*>(&join));
+  backplane->Register(static_cast<Receiver<Last>*>(&join));
+
+  backplane->OnLast(100, iwm, 80.5);
+  backplane->OnBid(110, spy, 110.0);
+  backplane->OnAsk(120, spy, 110.1);
+  backplane->OnLast(130, iwm, 80.6);
+
+  ASSERT_EQ(4U, out.rows.size());
+  EXPECT_TRUE(isnan(out.rows[0].right[0]));
+  EXPECT_EQ(80.5, out.rows[0].right[1]);  // Its own tick first.
+  EXPECT_EQ(110.0, out.rows[1].right[0]);
+  EXPECT_EQ(spy, out.rows[2].id);
+  EXPECT_EQ(110.1, out.rows[2].value);
+  EXPECT_EQ(80.5, out.rows[2].right[1]);
+  EXPECT_EQ(80.6, out.rows[3].right[1]);
+}
+
+} // namespace
@@ -0,0 +1,180 @@
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "ib/audit/audit_log.hpp"
+
+using namespace std;
+using ib::audit::AuditLog;
+
+namespace {
+
+static string TempDb(const string& name)
+{
+  ostringstream path;
+  path << "/tmp/" << name << "." << getpid() << ".db";
+  unlink(path.str().c_str());
+  return path.str();
+}
+
+static int Count(AuditLog* log, const string& table)
+{
+  vector<AuditLog::Row> rows;
+  EXPECT_TRUE(log->Query("select count(*) from " + table, &rows));
+  return rows.size() == 1 ? atoi(rows[0][0].c_str()) : -1;
+}
+
+TEST(AuditLogTest, RecordsOrdersAndExecutions)
+{
+  string path = TempDb("audit_log_test");
+  AuditLog log(path);
+  ASSERT_TRUE(log.Start());
+
+  Contract contract;
+  contract.symbol = "AAPL";
+  contract.secType = "STK";
+
+  Order order;
+  order.action = "BUY";
+  order.orderType = "LMT";
+  order.totalQuantity = 100;
+  order.lmtPrice = 250.5;
+  EXPECT_TRUE(log.RecordOrder(10, contract, order));
+
+  EXPECT_TRUE(log.RecordOrderStatus(10, "Submitted", 0, 100, 0., 1234, 0.,
+                                    0, ""));
+
+  Execution execution;
+  execution.execId = "0001f4e8.4c1b9e3a.01.01";
+  execution.orderId = 10;
+  execution.side = "BOT";
+  execution.shares = 100;
+  execution.price = 250.45;
+  execution.exchange = "ISLAND";
+  EXPECT_TRUE(log.RecordExecution(contract, execution));
+
+  log.Flush();
+  EXPECT_EQ(3, log.committed());
+  EXPECT_EQ(0, log.dropped());
+
+  EXPECT_EQ(1, Count(&log, "orders"));
+  EXPECT_EQ(1, Count(&log, "order_status"));
+  EXPECT_EQ(1, Count(&log, "executions"));
+
+  vector<AuditLog::Row> rows;
+  EXPECT_TRUE(log.Query(
+      "select o.symbol, o.action, e.shares, e.exchange from orders o "
+      "join executions e on o.order_id = e.order_id", &rows));
+  ASSERT_EQ(1U, rows.size());
+  EXPECT_EQ("AAPL", rows[0][0]);
+  EXPECT_EQ("BUY", rows[0][1]);
+  EXPECT_EQ("100", rows[0][2]);
+  EXPECT_EQ("ISLAND", rows[0][3]);
+
+  log.Stop();
+  unlink(path.c_str());
+}
+
+TEST(AuditLogTest, RecordsTradesAndGainLoss)
+{
+  string path = TempDb("audit_log_test_trades");
+  AuditLog log(path);
+  ASSERT_TRUE(log.Start());
+
+  trading::Trade trade;
+  trade.set_date("01/14/2011");
+  trade.set_ordertype(trading::BUY);
+  trade.set_security("GOOG");
+  trade.set_description("GOOGLE INC CL A");
+  trade.set_quantity(10);
+  trade.set_price(616.69f);
+  trade.set_net(-6166.9f);
+  trade.set_timestamp(1295000000000000LL);
+  trade.set_tradeid(1);
+  EXPECT_TRUE(log.RecordTrade(trade));
+
+  trading::GainLoss gain_loss;
+  gain_loss.set_symbol("GOOG");
+  gain_loss.set_quantity(10);
+  gain_loss.set_open_date("01/14/2011");
+  gain_loss.set_open_price(616.69f);
+  gain_loss.set_open_net(-6166.9f);
+  gain_loss.set_order_type(trading::SELL);
+  gain_loss.set_closing_date("01/18/2011");
+  gain_loss.set_closing_price(639.63f);
+  gain_loss.set_closing_net(6396.3f);
+  gain_loss.set_gain_loss(229.4f);
+  gain_loss.set_id(2);
+  EXPECT_TRUE(log.RecordGainLoss(gain_loss));
+
+  log.Flush();
+
+  vector<AuditLog::Row> rows;
+  EXPECT_TRUE(log.Query("select security, quantity, trade_ts from trades",
+                        &rows));
+  ASSERT_EQ(1U, rows.size());
+  EXPECT_EQ("GOOG", rows[0][0]);
+  EXPECT_EQ("10", rows[0][1]);
+  EXPECT_EQ("1295000000000000", rows[0][2]);
+
+  rows.clear();
+  EXPECT_TRUE(log.Query("select symbol, closing_date from gain_loss", &rows));
+  ASSERT_EQ(1U, rows.size());
+  EXPECT_EQ("01/18/2011", rows[0][1]);
+
+  log.Stop();
+  unlink(path.c_str());
+}
+
+// Producers on several threads; everything queued must be committed
+// and the writer must have batched rather than committed row by row.
+struct Producer
+{
+  Producer(AuditLog* log, int n) : log(log), n(n) {}
+  AuditLog* log;
+  int n;
+  void operator()()
+  {
+    for (int i = 0; i < n; ++i) {
+      while (!log->RecordOrderStatus(i, "Submitted", 0, 100, 0., i, 0., 0,
+                                     "")) {
+        boost::this_thread::yield();
+      }
+    }
+  }
+};
+
+TEST(AuditLogTest, BatchesConcurrentProducers)
+{
+  string path = TempDb("audit_log_test_batches");
+  AuditLog log(path);
+  ASSERT_TRUE(log.Start());
+
+  const int producers = 4;
+  const int per_producer = 5000;
+  boost::thread_group threads;
+  for (int i = 0; i < producers; ++i) {
+    threads.create_thread(Producer(&log, per_producer));
+  }
+  threads.join_all();
+  log.Flush();
+
+  EXPECT_EQ(producers * per_producer, log.committed());
+  EXPECT_EQ(producers * per_producer, Count(&log, "order_status"));
+  EXPECT_LT(log.batches(), producers * per_producer / 10);
+
+  log.Stop();
+  unlink(path.c_str());
+}
+
+} // namespace
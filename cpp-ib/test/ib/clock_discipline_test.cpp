@@ -0,0 +1,215 @@
+
+#include <stdlib.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "utils.hpp"
+#include "ib/clock_discipline.hpp"
+#include "ntp_responder.hpp"
+
+using namespace std;
+using ib::ClockDiscipline;
+using ib::ClockSample;
+using ib::NtpSource;
+using ib::testing::NtpResponder;
+
+namespace {
+
+ClockSample Sample(int64_t local, int64_t offset, int64_t rtt)
+{
+  ClockSample sample;
+  sample.local = local;
+  sample.offset = offset;
+  sample.rtt = rtt;
+  return sample;
+}
+
+TEST(ClockDisciplineTest, NtpTimestamps)
+{
+  const int64_t micros = 1300000000123456LL;
+  EXPECT_EQ(1300000000ULL + 2208988800ULL, ib::MicrosToNtp(micros) >> 32);
+  EXPECT_NEAR(micros, ib::NtpToMicros(ib::MicrosToNtp(micros)), 1);
+}
+
+TEST(ClockDisciplineTest, SamplesNtpServer)
+{
+  NtpResponder responder(15123, 250000);
+  NtpSource source("127.0.0.1:15123", 500);
+  ClockSample sample;
+  ASSERT_TRUE(source.Sample(&sample));
+  EXPECT_NEAR(250000, sample.offset, 2000);
+  EXPECT_LE(0, sample.rtt);
+  EXPECT_GT(2000, sample.rtt);
+
+  NtpSource nobody("127.0.0.1:15124", 50);
+  EXPECT_FALSE(nobody.Sample(&sample));
+}
+
+TEST(ClockDisciplineTest, CorrectsToNtpServer)
+{
+  NtpResponder responder(15125, -75000);
+  NtpSource source("localhost:15125", 500);
+  ClockDiscipline clock(&source, 4);
+  const int64_t now = lab616::utils::now_micros();
+  EXPECT_EQ(now, clock.Correct(now));
+
+  clock.Start(3600);
+  while (clock.GetEstimate().samples == 0) {
+    lab616::utils::sleep_micros(1000);
+  }
+  clock.Stop();
+  EXPECT_EQ(4, responder.replies());
+  EXPECT_NEAR(now - 75000, clock.Correct(now), 2000);
+}
+
+TEST(ClockDisciplineTest, DropsQueuedPolls)
+{
+  NtpResponder responder(15126, 10000);
+  NtpSource source("127.0.0.1:15126", 500);
+  ClockDiscipline clock(&source, 1);
+  ASSERT_TRUE(clock.Poll());
+  ASSERT_TRUE(clock.Poll());
+
+  // Queued 20 msec on the way in: 10 msec off, and dropped.
+  responder.set_delay(20000);
+  EXPECT_FALSE(clock.Poll());
+  ClockDiscipline::Estimate estimate = clock.GetEstimate();
+  EXPECT_EQ(2U, estimate.samples);
+  EXPECT_EQ(1U, estimate.dropped);
+  EXPECT_NEAR(10000, estimate.offset, 2000);
+}
+
+TEST(ClockDisciplineTest, TracksDrift)
+{
+  ClockDiscipline clock(NULL);
+  EXPECT_FALSE(clock.Poll());
+
+  // The local clock loses 50 usec a second, polled every 16 seconds
+  // with +-30 usec of noise.
+  const int64_t start = 1300000000000000LL;
+  const int64_t poll = 16000000;
+  for (int i = 0; i < 200; ++i) {
+    const int64_t local = start + i * poll;
+    const int64_t offset = 1000 + 50 * (local - start) / 1000000;
+    const int64_t noise = (i % 3 - 1) * 30;
+    ASSERT_TRUE(clock.Update(Sample(local, offset + noise, 300), local));
+  }
+  ClockDiscipline::Estimate estimate = clock.GetEstimate();
+  EXPECT_NEAR(50e-6, estimate.drift, 1e-6);
+
+  // Half a poll later.
+  const int64_t local = start + 200 * poll + poll / 2;
+  const int64_t offset = 1000 + 50 * (local - start) / 1000000;
+  EXPECT_NEAR(local + offset, clock.Correct(local), 50);
+}
+
+TEST(ClockDisciplineTest, SlewsWithoutGoingBack)
+{
+  ClockDiscipline clock(NULL);
+  const int64_t start = 1300000000000000LL;
+  const int64_t poll = 16000000;
+  ASSERT_TRUE(clock.Update(Sample(start, 5000, 300), start));
+  ASSERT_TRUE(clock.Update(Sample(start + poll, 5000, 300),
+                           start + poll));
+  EXPECT_EQ(start + poll + 5000, clock.Correct(start + poll));
+
+  // The reference says the clock is 4 msec ahead of what was
+  // thought: the correction eases down over a poll.
+  const int64_t at = start + 2 * poll;
+  ASSERT_TRUE(clock.Update(Sample(at, 1000, 300), at));
+  const int64_t estimate = clock.GetEstimate().offset;
+  const double drift = clock.GetEstimate().drift;
+  EXPECT_GT(5000, estimate);
+  EXPECT_EQ(at + 5000, clock.Correct(at));
+  int64_t last = clock.Correct(at);
+  for (int64_t local = at + 1; local < at + poll + 1000; local += 997) {
+    const int64_t corrected = clock.Correct(local);
+    ASSERT_LE(last, corrected) << local - at;
+    last = corrected;
+  }
+  EXPECT_NEAR(at + poll / 2 + (5000 + estimate) / 2 + drift * poll / 2,
+              clock.Correct(at + poll / 2), 2);
+  EXPECT_NEAR(at + poll + estimate + drift * poll,
+              clock.Correct(at + poll), 1);
+
+  // A step larger than a poll takes longer than a poll, at half
+  // speed.
+  const int64_t later = at + 2 * poll;
+  ASSERT_TRUE(clock.Update(Sample(later, -60000000, 300), later));
+  last = clock.Correct(later);
+  for (int64_t local = later + 1; local < later + 10 * poll;
+       local += 99991) {
+    const int64_t corrected = clock.Correct(local);
+    ASSERT_LE(last, corrected) << local - later;
+    last = corrected;
+  }
+}
+
+TEST(ClockDisciplineTest, SlewsFromThePublication)
+{
+  ClockDiscipline clock(NULL);
+  const int64_t start = 1300000000000000LL;
+  const int64_t poll = 16000000;
+  ASSERT_TRUE(clock.Update(Sample(start, 0, 300), start));
+  ASSERT_TRUE(clock.Update(Sample(start + poll, 0, 300), start + poll));
+
+  // The clock is a second ahead, and the drift changes with it, but
+  // the sample is published 2 seconds after it was taken: the slew
+  // starts at the publication, from the correction in force then.
+  const int64_t at = start + 2 * poll;
+  const int64_t published = at + 2000000;
+  const int64_t before = clock.Correct(published);
+  ASSERT_TRUE(clock.Update(Sample(at, -1000000, 300), published));
+  EXPECT_NE(0, clock.GetEstimate().drift);
+  EXPECT_NEAR(before, clock.Correct(published), 1);
+  int64_t last = clock.Correct(published - poll);
+  for (int64_t local = published - poll + 1; local < published + 4 * poll;
+       local += 997) {
+    const int64_t corrected = clock.Correct(local);
+    ASSERT_LE(last, corrected) << local - published;
+    last = corrected;
+  }
+}
+
+TEST(ClockDisciplineTest, SlewsAFirstSampleAfterStart)
+{
+  // The poll of Start gets no reply, so the feed may be up by the
+  // first sample: it is slewed in, not stepped.
+  NtpSource nobody("127.0.0.1:15127", 10);
+  ClockDiscipline clock(&nobody, 1);
+  clock.Start(3600);
+  EXPECT_EQ(0U, clock.GetEstimate().samples);
+  const int64_t now = lab616::utils::now_micros();
+  ASSERT_TRUE(clock.Update(Sample(now, 500000, 300), now));
+  EXPECT_EQ(now, clock.Correct(now));
+  const int64_t slewed = now + 3600000000LL;  // A poll later.
+  EXPECT_EQ(slewed + 500000, clock.Correct(slewed));
+  clock.Stop();
+}
+
+TEST(ClockDisciplineTest, NarrowsServerTime)
+{
+  ClockDiscipline clock(NULL);
+  const int64_t offset = 300123;
+  int64_t local = 1300000000000000LL;
+  for (int i = 0; i < 40; ++i) {
+    // Heartbeats at uneven phases of the server second.
+    local += 1000000 + (rand() % 1000) * 997;
+    const int64_t server = local + 1000 + offset;
+    clock.OnServerTime(server / 1000000, local, local + 2000);
+  }
+  ClockDiscipline::Estimate estimate = clock.GetEstimate();
+  EXPECT_EQ(40U, estimate.server_samples);
+  EXPECT_NEAR(offset, estimate.server_offset, estimate.server_error);
+  EXPECT_GT(100000, estimate.server_error);
+
+  // The server clock steps by a minute.
+  local += 1000000;
+  clock.OnServerTime((local + 60000000) / 1000000, local, local + 2000);
+  estimate = clock.GetEstimate();
+  EXPECT_EQ(1U, estimate.server_samples);
+  EXPECT_EQ(501000, estimate.server_error);
+}
+
+} // namespace
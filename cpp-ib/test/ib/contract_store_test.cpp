@@ -0,0 +1,257 @@
+
+#include <stdio.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "ib/contract_store.hpp"
+#include "ib/wire/api_traits.hpp"
+#include "ib/wire/decoder.hpp"
+
+using namespace std;
+using ib::ContractStore;
+
+namespace {
+
+ContractDetails Option(long con_id, const string& symbol,
+                       const string& expiry, double strike,
+                       const string& right)
+{
+  ContractDetails details;
+  Contract& c = details.summary;
+  c.conId = con_id;
+  c.symbol = symbol;
+  c.secType = "OPT";
+  c.expiry = expiry;
+  c.strike = strike;
+  c.right = right;
+  c.multiplier = "100";
+  c.exchange = "SMART";
+  c.currency = "USD";
+  char local[32];
+  snprintf(local, sizeof(local), "%-6s%s%s%08d", symbol.c_str(),
+           expiry.substr(2).c_str(), right.c_str(),
+           static_cast<int>(strike * 1000));
+  c.localSymbol = local;
+  details.marketName = symbol;
+  details.tradingClass = symbol;
+  details.minTick = 0.01;
+  details.orderTypes = "ACTIVETIM,ADJUST,ALERT,ALLOC,AVGCOST,BASKET,COND";
+  details.validExchanges = "SMART,AMEX,BOX,CBOE,ISE,NASDAQOM,PHLX";
+  details.priceMagnifier = 1;
+  details.underConId = 265598;
+  details.longName = "APPLE INC";
+  details.timeZoneId = "EST";
+  details.tradingHours = "20110114:0930-1600;20110117:CLOSED";
+  details.liquidHours = "20110114:0930-1600;20110117:CLOSED";
+  return details;
+}
+
+TEST(ContractStoreTest, FindsChainsAndOptions)
+{
+  ContractStore store;
+  store.Add(Option(3, "AAPL", "20110219", 350, "C"));
+  store.Add(Option(1, "AAPL", "20110121", 345, "P"));
+  store.Add(Option(2, "AAPL", "20110121", 345, "C"));
+  store.Add(Option(4, "GOOG", "20110121", 600, "C"));
+  store.Add(Option(5, "AAPL", "20110121", 340, "C"));
+  EXPECT_EQ(5, store.size());
+
+  const vector<int>* chain = store.FindSymbol("AAPL");
+  ASSERT_TRUE(chain != NULL);
+  ASSERT_EQ(4U, chain->size());
+  const long expected[] = { 5, 2, 1, 3 };
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(expected[i], store.con_id((*chain)[i]));
+  }
+  EXPECT_TRUE(store.FindSymbol("MSFT") == NULL);
+
+  int slot = store.FindOption("AAPL", 20110121, 345, 'P');
+  EXPECT_EQ(1, store.con_id(slot));
+  EXPECT_EQ(slot, store.FindConId(1));
+  EXPECT_EQ(ContractStore::NONE,
+            store.FindOption("AAPL", 20110121, 350, 'C'));
+  EXPECT_EQ(ContractStore::NONE, store.FindConId(6));
+
+  EXPECT_TRUE(store.symbol(slot) == "AAPL");
+  EXPECT_EQ('P', store.right(slot));
+  EXPECT_EQ(20110121, store.expiry(slot));
+  EXPECT_STREQ("AAPL  110121P00345000", store.local_symbol(slot));
+  EXPECT_TRUE(store.name(slot, ContractStore::EXCHANGE) == "SMART");
+  EXPECT_TRUE(store.name(slot, ContractStore::TIME_ZONE_ID) == "EST");
+}
+
+TEST(ContractStoreTest, GivesBackContractDetails)
+{
+  ContractStore store;
+  const ContractDetails in = Option(7, "AAPL", "20110121", 347.5, "C");
+  ContractDetails out;
+  store.Get(store.Add(in), &out);
+  EXPECT_EQ(in.summary.conId, out.summary.conId);
+  EXPECT_EQ(in.summary.symbol, out.summary.symbol);
+  EXPECT_EQ(in.summary.secType, out.summary.secType);
+  EXPECT_EQ(in.summary.expiry, out.summary.expiry);
+  EXPECT_EQ(in.summary.strike, out.summary.strike);
+  EXPECT_EQ(in.summary.right, out.summary.right);
+  EXPECT_EQ(in.summary.multiplier, out.summary.multiplier);
+  EXPECT_EQ(in.summary.exchange, out.summary.exchange);
+  EXPECT_EQ(in.summary.currency, out.summary.currency);
+  EXPECT_EQ(in.summary.localSymbol, out.summary.localSymbol);
+  EXPECT_EQ(in.orderTypes, out.orderTypes);
+  EXPECT_EQ(in.validExchanges, out.validExchanges);
+  EXPECT_EQ(in.minTick, out.minTick);
+  EXPECT_EQ(in.underConId, out.underConId);
+  EXPECT_EQ(in.longName, out.longName);
+  EXPECT_EQ(in.liquidHours, out.liquidHours);
+
+  EXPECT_EQ(20110100, ContractStore::ParseExpiry("201101"));
+  EXPECT_EQ("201101", ContractStore::FormatExpiry(20110100));
+  EXPECT_EQ("", ContractStore::FormatExpiry(ContractStore::ParseExpiry("")));
+}
+
+TEST(ContractStoreTest, UpdatesByConId)
+{
+  ContractStore store;
+  store.Add(Option(1, "AAPL", "20110121", 345, "C"));
+  store.Add(Option(2, "AAPL", "20110121", 350, "C"));
+  const int slot = store.Add(Option(1, "AAPL", "20110121", 355, "C"));
+  EXPECT_EQ(2, store.size());
+  EXPECT_EQ(slot, store.FindOption("AAPL", 20110121, 355, 'C'));
+  EXPECT_EQ(ContractStore::NONE,
+            store.FindOption("AAPL", 20110121, 345, 'C'));
+  EXPECT_EQ(slot, store.FindSymbol("AAPL")->back());
+  EXPECT_STREQ("AAPL  110121C00355000", store.local_symbol(slot));
+}
+
+TEST(ContractStoreTest, CompactsChainsIntoRuns)
+{
+  // Two chains loading at once, interleaved.
+  ContractStore store;
+  for (int strike = 0; strike < 10; ++strike) {
+    store.Add(Option(100 + strike, "AAPL", "20110121", 340 + strike, "C"));
+    store.Add(Option(200 + strike, "GOOG", "20110121", 590 + strike, "P"));
+  }
+  const vector<int>& aapl = *store.FindSymbol("AAPL");
+  EXPECT_EQ(2, aapl[1] - aapl[0]);
+
+  store.Compact();
+  const char* symbols[] = { "AAPL", "GOOG" };
+  for (int s = 0; s < 2; ++s) {
+    const vector<int>& chain = *store.FindSymbol(symbols[s]);
+    ASSERT_EQ(10U, chain.size());
+    for (size_t i = 1; i < chain.size(); ++i) {
+      EXPECT_EQ(chain[i - 1] + 1, chain[i]);
+      EXPECT_LT(store.strike(chain[i - 1]), store.strike(chain[i]));
+    }
+    for (size_t i = 0; i < chain.size(); ++i) {
+      EXPECT_TRUE(store.symbol(chain[i]) == symbols[s]);
+      EXPECT_EQ(chain[i], store.FindConId(store.con_id(chain[i])));
+    }
+  }
+  const int slot = store.FindOption("GOOG", 20110121, 595, 'P');
+  ASSERT_NE(ContractStore::NONE, slot);
+  EXPECT_EQ(205, store.con_id(slot));
+  ContractDetails out;
+  store.Get(slot, &out);
+  EXPECT_EQ("GOOG  110121P00595000", out.summary.localSymbol);
+
+  // Added later: at the end until the next Compact.
+  const int added = store.Add(Option(110, "AAPL", "20110121", 300, "C"));
+  EXPECT_EQ(20, added);
+  EXPECT_EQ(added, store.FindSymbol("AAPL")->front());
+}
+
+// Keeps the details the wire decoder hands over in view mode.
+struct StoringHandler
+{
+  typedef ib::wire::StringRef StringRef;
+  void tickPrice(TickerId, TickType, double, int) {}
+  void tickSize(TickerId, TickType, int) {}
+  void tickOptionComputation(TickerId, TickType, double, double, double,
+                             double, double, double, double, double) {}
+  void tickGeneric(TickerId, TickType, double) {}
+  void tickString(TickerId, TickType, const StringRef&) {}
+  void orderStatus(OrderId, const StringRef&, int, int, double, int, int,
+                   double, int, const StringRef&) {}
+  void error(int, int, const StringRef&) {}
+  void nextValidId(OrderId) {}
+  void updateMktDepth(TickerId, int, int, int, double, int) {}
+  void updateMktDepthL2(TickerId, int, int, int, int, double, int) {}
+  void currentTime(long) {}
+  void realtimeBar(TickerId, long, double, double, double, double, long,
+                   double, int) {}
+  void tickSnapshotEnd(int) {}
+  void contractDetails(int, const ib::wire::ContractDetailsView& details)
+  {
+    store.Add(details, *names);
+  }
+  void contractDetailsEnd(int) {}
+
+  ContractStore store;
+  ib::wire::Interner* names;
+};
+
+TEST(ContractStoreTest, TakesWireViews)
+{
+  const char fields[] =
+      "10\0" "6\0" "3\0" "AAPL\0" "OPT\0" "20110121\0" "345\0" "P\0"
+      "SMART\0" "USD\0" "AAPL  110121P00345000\0" "AAPL\0" "AAPL\0"
+      "81513409\0" "0.01\0" "100\0" "LMT\0" "SMART,CBOE\0" "1\0"
+      "265598\0" "APPLE INC\0" "\0" "201101\0" "Technology\0"
+      "Computers\0" "Computers\0" "EST\0" "20110121:0930-1600\0"
+      "20110121:0930-1600";
+  StoringHandler handler;
+  ib::wire::Decoder<ib::wire::Api964, StoringHandler,
+                    ib::wire::ViewStrings> decoder(&handler);
+  handler.names = decoder.names();
+  EXPECT_EQ(static_cast<int>(sizeof(fields)),
+            decoder.Decode(fields, fields + sizeof(fields)));
+
+  ContractStore& store = handler.store;
+  const int slot = store.FindOption("AAPL", 20110121, 345, 'P');
+  ASSERT_NE(ContractStore::NONE, slot);
+  EXPECT_EQ(81513409, store.con_id(slot));
+  EXPECT_EQ(265598, store.under_con_id(slot));
+  EXPECT_TRUE(store.long_name(slot) == "APPLE INC");
+  EXPECT_TRUE(store.name(slot, ContractStore::CURRENCY) == "USD");
+  EXPECT_TRUE(store.name(slot, ContractStore::MULTIPLIER) == "100");
+  EXPECT_TRUE(store.name(slot, ContractStore::INDUSTRY) == "Technology");
+}
+
+TEST(ContractStoreTest, IsCompact)
+{
+  ContractStore store;
+  const char* expiries[] = { "20110121", "20110219", "20110319" };
+  int con_id = 1;
+  for (int symbol = 0; symbol < 100; ++symbol) {
+    char name[8];
+    snprintf(name, sizeof(name), "S%03d", symbol);
+    for (int e = 0; e < 3; ++e) {
+      for (int strike = 0; strike < 40; ++strike) {
+        const double price = 50 + 2.5 * strike;
+        store.Add(Option(con_id++, name, expiries[e], price, "C"));
+        store.Add(Option(con_id++, name, expiries[e], price, "P"));
+      }
+    }
+  }
+  EXPECT_EQ(24000, store.size());
+  EXPECT_EQ(240U, store.FindSymbol("S042")->size());
+
+  // Against the struct and the strings too long to fit in it.
+  const ContractDetails details = Option(1, "S042", "20110121", 50, "C");
+  const string* strings[] = {
+    &details.summary.localSymbol, &details.orderTypes,
+    &details.validExchanges, &details.tradingHours, &details.liquidHours
+  };
+  size_t footprint = sizeof(details);
+  for (int i = 0; i < 5; ++i) footprint += strings[i]->size() + 1;
+  const size_t per_contract = store.memory() / store.size();
+  cout << "ContractDetails " << footprint << " bytes, stored "
+       << per_contract << endl;
+  EXPECT_GT(footprint / 5, per_contract);
+}
+
+} // namespace
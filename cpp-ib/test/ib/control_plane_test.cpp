@@ -0,0 +1,318 @@
+
+#include <unistd.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <zmq.hpp>
+
+#include <Shared/Contract.h>
+
+#include "messaging.hpp"
+#include "ib/control_plane.hpp"
+#include "ib/ticker_id.hpp"
+#include "loopback_client.hpp"
+
+using namespace std;
+using namespace ib::actions;
+using ib::ControlPlane;
+using ib::internal::SymbolToTickerId;
+using ib::testing::LoopbackClient;
+
+namespace {
+
+static const TickerId FIRST_ID = 1600000000;
+
+// Records the requests that reach the client.
+class RecordingClient : public LoopbackClient
+{
+ public:
+  RecordingClient() : LoopbackClient(NULL) {}
+
+  void reqMktData(TickerId id, const Contract& contract,
+                  const IBString& genericTicks, bool snapshot)
+  {
+    ostringstream s;
+    s << "reqMktData " << id << " " << contract.symbol << " "
+      << contract.secType << (snapshot ? " snapshot" : "");
+    calls.push_back(s.str());
+  }
+  void cancelMktData(TickerId id)
+  {
+    ostringstream s;
+    s << "cancelMktData " << id;
+    calls.push_back(s.str());
+  }
+  void reqRealTimeBars(TickerId id, const Contract& contract, int barSize,
+                       const IBString& whatToShow, bool useRTH)
+  {
+    ostringstream s;
+    s << "reqRealTimeBars " << id << " " << contract.symbol << " "
+      << barSize << (useRTH ? " rth" : "");
+    calls.push_back(s.str());
+  }
+  void cancelRealTimeBars(TickerId id)
+  {
+    ostringstream s;
+    s << "cancelRealTimeBars " << id;
+    calls.push_back(s.str());
+  }
+  void reqHistoricalData(TickerId id, const Contract& contract,
+                         const IBString& endDateTime,
+                         const IBString& durationStr,
+                         const IBString& barSizeSetting,
+                         const IBString& whatToShow, int useRTH,
+                         int formatDate)
+  {
+    ostringstream s;
+    s << "reqHistoricalData " << id << " " << contract.symbol << " "
+      << endDateTime << " / " << durationStr << " / " << barSizeSetting;
+    calls.push_back(s.str());
+  }
+  void cancelHistoricalData(TickerId id)
+  {
+    ostringstream s;
+    s << "cancelHistoricalData " << id;
+    calls.push_back(s.str());
+  }
+
+  vector<string> calls;
+};
+
+void SetStock(int id, const string& symbol, ib::common::Stock* stock)
+{
+  stock->set_id(id);
+  stock->set_symbol(symbol);
+}
+
+void SetDate(int year, int month, int day, ib::common::Date* date)
+{
+  date->set_year(year);
+  date->set_month(month);
+  date->set_day(day);
+}
+
+string Ticker(const string& symbol)
+{
+  ostringstream s;
+  s << SymbolToTickerId(symbol);
+  return s.str();
+}
+
+TEST(ControlPlaneTest, AppliesMarketDataInBatches)
+{
+  RecordingClient client;
+  ControlPlane plane(&client, NULL, 3, FIRST_ID);
+  plane.Track(SymbolToTickerId("IBM"), "IBM");
+
+  RequestMarketData request;
+  SetStock(1, "AAPL", request.add_stock()->mutable_stock());
+  SetStock(2, "IBM", request.add_stock()->mutable_stock());
+  SetStock(3, "TOOLONG", request.add_stock()->mutable_stock());
+  SetStock(4, "MSFT", request.add_stock()->mutable_stock());
+  SetStock(5, "GOOG", request.add_stock()->mutable_stock());
+  RequestMarketData_Index* index = request.add_index();
+  index->mutable_index()->set_id(6);
+  index->mutable_index()->set_symbol("VIX");
+  index->mutable_index()->set_exhange("CBOE");
+  index->set_snapshot(true);
+
+  ActionResults results;
+  ASSERT_TRUE(plane.Handle(RequestMarketData::default_instance().GetTypeName(),
+                           request.SerializeAsString(), &results));
+  EXPECT_FALSE(results.has_error());
+  ASSERT_EQ(6, results.result_size());
+  EXPECT_EQ(ActionResults::QUEUED, results.result(0).status());
+  EXPECT_EQ(SymbolToTickerId("AAPL"), results.result(0).ticker_id());
+  EXPECT_EQ(ActionResults::ALREADY, results.result(1).status());
+  EXPECT_EQ(ActionResults::INVALID, results.result(2).status());
+  EXPECT_EQ("TOOLONG", results.result(2).symbol());
+  EXPECT_EQ(ActionResults::QUEUED, results.result(3).status());
+  EXPECT_EQ(ActionResults::NO_LINES, results.result(4).status());
+  EXPECT_EQ(5, results.result(4).id());
+  // A snapshot takes a line too.
+  EXPECT_EQ(ActionResults::NO_LINES, results.result(5).status());
+  EXPECT_EQ(3U, plane.lines());
+
+  ASSERT_EQ(2U, client.calls.size());
+  EXPECT_EQ("reqMktData " + Ticker("AAPL") + " AAPL STK", client.calls[0]);
+  EXPECT_EQ("reqMktData " + Ticker("MSFT") + " MSFT STK", client.calls[1]);
+
+  // Canceling a tracked stream frees its line, and it stays dropped
+  // across a reconnect.
+  CancelMarketData cancel;
+  SetStock(7, "IBM", cancel.add_stock());
+  SetStock(8, "GOOG", cancel.add_stock());
+  results.Clear();
+  plane.Apply(cancel, &results);
+  ASSERT_EQ(2, results.result_size());
+  EXPECT_EQ(ActionResults::QUEUED, results.result(0).status());
+  EXPECT_EQ(ActionResults::NOT_OPEN, results.result(1).status());
+  EXPECT_EQ("cancelMktData " + Ticker("IBM"), client.calls.back());
+  EXPECT_EQ(2U, plane.lines());
+  EXPECT_TRUE(plane.Dropped(SymbolToTickerId("IBM")));
+  EXPECT_FALSE(plane.Dropped(SymbolToTickerId("AAPL")));
+
+  // Until it ends.
+  request.clear_stock();
+  results.Clear();
+  plane.Apply(request, &results);
+  ASSERT_EQ(1, results.result_size());
+  EXPECT_EQ(ActionResults::QUEUED, results.result(0).status());
+  EXPECT_EQ("reqMktData " + Ticker("VIX") + " VIX IND snapshot",
+            client.calls.back());
+  EXPECT_EQ(3U, plane.lines());
+  plane.OnSnapshotEnd(SymbolToTickerId("VIX"));
+  EXPECT_EQ(2U, plane.lines());
+
+  // Streams opened here come back with the connection.
+  client.calls.clear();
+  plane.OnDisconnect();
+  plane.OnConnect();
+  ASSERT_EQ(2U, client.calls.size());
+  EXPECT_EQ(2U, plane.lines());
+
+  // A warning does not end the stream, an error does.
+  plane.OnError(SymbolToTickerId("AAPL"), 10167);
+  plane.OnError(SymbolToTickerId("AAPL"), 10090);
+  EXPECT_EQ(2U, plane.lines());
+  plane.OnError(SymbolToTickerId("AAPL"), 200);
+  EXPECT_EQ(1U, plane.lines());
+}
+
+TEST(ControlPlaneTest, ReopensRequestsQueuedAcrossADisconnect)
+{
+  RecordingClient client;
+  ControlPlane plane(&client, NULL, 100, FIRST_ID);
+  RequestMarketData request;
+  SetStock(1, "AAPL", request.add_stock()->mutable_stock());
+  ActionResults results;
+  plane.Apply(request, &results);
+
+  // The connection goes with the request still queued: the scheduler
+  // sends it to the dead socket, which refuses it.
+  plane.OnDisconnect();
+  request.clear_stock();
+  SetStock(2, "MSFT", request.add_stock()->mutable_stock());
+  results.Clear();
+  plane.Apply(request, &results);
+  plane.OnError(SymbolToTickerId("AAPL"), 504);
+  plane.OnError(SymbolToTickerId("MSFT"), 504);
+  EXPECT_EQ(2U, plane.lines());
+
+  client.calls.clear();
+  plane.OnConnect();
+  ASSERT_EQ(2U, client.calls.size());
+  EXPECT_EQ("reqMktData " + Ticker("AAPL") + " AAPL STK", client.calls[0]);
+  EXPECT_EQ("reqMktData " + Ticker("MSFT") + " MSFT STK", client.calls[1]);
+
+  // Had it gone out on the new connection, the one sent again is a
+  // duplicate, and the stream stays open.
+  plane.OnError(SymbolToTickerId("AAPL"), 322);
+  EXPECT_EQ(2U, plane.lines());
+}
+
+TEST(ControlPlaneTest, NumbersBarsAndHistory)
+{
+  RecordingClient client;
+  ControlPlane plane(&client, NULL, 100, FIRST_ID);
+
+  RequestBars bars;
+  RequestBars_Stock* stock = bars.add_stock();
+  SetStock(1, "AAPL", stock->mutable_stock());
+  stock->mutable_bar_size()->set_unit(ib::common::Interval::MINUTE);
+  stock->mutable_bar_size()->set_duration(1);
+  stock->set_regular_trading_hours(true);
+  ActionResults results;
+  plane.Apply(bars, &results);
+  results.Clear();
+  plane.Apply(bars, &results);
+  ASSERT_EQ(1, results.result_size());
+  EXPECT_EQ(ActionResults::ALREADY, results.result(0).status());
+  EXPECT_EQ(FIRST_ID, results.result(0).ticker_id());
+
+  RequestHistory history;
+  RequestHistory_Stock* past = history.add_stock();
+  SetStock(2, "IBM", past->mutable_stock());
+  past->mutable_bar_size()->set_unit(ib::common::Interval::MINUTE);
+  past->mutable_bar_size()->set_duration(5);
+  SetDate(2011, 1, 12, past->mutable_duration()->mutable_start()
+          ->mutable_date());
+  SetDate(2011, 1, 14, past->mutable_duration()->mutable_end()
+          ->mutable_date());
+  RequestHistory_Stock* odd = history.add_stock();
+  odd->CopyFrom(*past);
+  odd->mutable_stock()->set_symbol("MSFT");
+  odd->mutable_bar_size()->set_duration(7);
+  results.Clear();
+  plane.Apply(history, &results);
+  ASSERT_EQ(2, results.result_size());
+  EXPECT_EQ(ActionResults::QUEUED, results.result(0).status());
+  EXPECT_EQ(FIRST_ID + 1, results.result(0).ticker_id());
+  EXPECT_EQ(ActionResults::INVALID, results.result(1).status());
+
+  ASSERT_EQ(2U, client.calls.size());
+  ostringstream first, second;
+  first << "reqRealTimeBars " << FIRST_ID << " AAPL 5 rth";
+  second << "reqHistoricalData " << FIRST_ID + 1
+         << " IBM 20110114 00:00:00 GMT / 2 D / 5 mins";
+  EXPECT_EQ(first.str(), client.calls[0]);
+  EXPECT_EQ(second.str(), client.calls[1]);
+
+  // Once complete, the history can be requested again.
+  plane.OnHistoryEnd(FIRST_ID + 1);
+  history.mutable_stock()->RemoveLast();
+  results.Clear();
+  plane.Apply(history, &results);
+  EXPECT_EQ(ActionResults::QUEUED, results.result(0).status());
+  EXPECT_EQ(FIRST_ID + 2, results.result(0).ticker_id());
+
+  CancelBars cancel;
+  SetStock(1, "AAPL", cancel.add_stock());
+  results.Clear();
+  plane.Apply(cancel, &results);
+  EXPECT_EQ(ActionResults::QUEUED, results.result(0).status());
+  ostringstream canceled;
+  canceled << "cancelRealTimeBars " << FIRST_ID;
+  EXPECT_EQ(canceled.str(), client.calls.back());
+}
+
+TEST(ControlPlaneTest, ServesRequestsOverZmq)
+{
+  RecordingClient client;
+  ControlPlane plane(&client, NULL, 100, FIRST_ID);
+  ostringstream endpoint;
+  endpoint << "ipc:///tmp/control_plane_test." << getpid();
+  ASSERT_TRUE(plane.Start(endpoint.str()));
+
+  zmq::context_t context(1);
+  zmq::socket_t socket(context, ZMQ_REQ);
+  socket.connect(endpoint.str().c_str());
+
+  RequestMarketData request;
+  SetStock(1, "AAPL", request.add_stock()->mutable_stock());
+  lab616::messaging::frame(socket,
+                           RequestMarketData::default_instance().GetTypeName());
+  lab616::messaging::last(socket, request.SerializeAsString());
+  string reply;
+  EXPECT_FALSE(lab616::messaging::receive(socket, &reply));
+  ActionResults results;
+  ASSERT_TRUE(results.ParseFromString(reply));
+  ASSERT_EQ(1, results.result_size());
+  EXPECT_EQ(ActionResults::QUEUED, results.result(0).status());
+
+  // An unknown request is answered with an error.
+  lab616::messaging::frame(socket, string("ib.actions.Nothing"));
+  lab616::messaging::last(socket, string());
+  lab616::messaging::receive(socket, &reply);
+  ASSERT_TRUE(results.ParseFromString(reply));
+  EXPECT_TRUE(results.has_error());
+  EXPECT_EQ(0, results.result_size());
+
+  plane.Stop();
+  EXPECT_EQ(1U, client.calls.size());
+}
+
+} // namespace
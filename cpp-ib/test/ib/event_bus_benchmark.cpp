@@ -0,0 +1,100 @@
+
+// Emission cost of the event bus against sigc++, with four receivers
+// of the same BidAsk:
+//
+//   sigc::signal       slots of sigc::trackable receivers, as the
+//                      BackPlane used to emit;
+//   EventChannel       delegates in a vector;
+//   BackPlane          the whole OnBid path, event construction
+//                      included, to virtual Receivers.
+
+#include <iostream>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <sigc++/sigc++.h>
+
+#include "utils.hpp"
+#include "ib/backplane.hpp"
+#include "ib/event_bus.hpp"
+
+using namespace std;
+using lab616::utils::now_micros;
+
+namespace {
+
+const int kEvents = 10000000;
+
+struct Sum
+{
+  Sum() : sum(0) {}
+  inline void operator()(const BidAsk& bid_ask) { sum += bid_ask.bid().price(); }
+  double sum;
+};
+
+struct TrackableSum : public sigc::trackable
+{
+  TrackableSum() : sum(0) {}
+  void operator()(const BidAsk& bid_ask) { sum += bid_ask.bid().price(); }
+  double sum;
+};
+
+struct VirtualSum : public ib::Receiver<BidAsk>
+{
+  VirtualSum() : sum(0) {}
+  virtual void operator()(const BidAsk& bid_ask) { sum += bid_ask.bid().price(); }
+  double sum;
+};
+
+void Report(const char* name, int64_t elapsed, double sum)
+{
+  cout << name << ": " << elapsed * 1000. / kEvents << " ns/event ("
+       << sum << ")" << endl;
+}
+
+BidAsk MakeBid()
+{
+  BidAsk bid_ask;
+  bid_ask.set_id(7);
+  bid_ask.set_time_stamp(1);
+  bid_ask.mutable_bid()->set_price(0.5);
+  return bid_ask;
+}
+
+TEST(EventBusBenchmark, SigcSignal)
+{
+  BidAsk bid_ask = MakeBid();
+  TrackableSum r[4];
+  sigc::signal<void, const BidAsk&> signal;
+  for (int i = 0; i < 4; ++i) {
+    signal.connect(sigc::mem_fun(r[i], &TrackableSum::operator()));
+  }
+  int64_t start = now_micros();
+  for (int i = 0; i < kEvents; ++i) signal.emit(bid_ask);
+  Report("sigc::signal", now_micros() - start, r[0].sum + r[3].sum);
+}
+
+TEST(EventBusBenchmark, EventChannel)
+{
+  BidAsk bid_ask = MakeBid();
+  Sum r[4];
+  ib::EventChannel<BidAsk> channel;
+  for (int i = 0; i < 4; ++i) channel.Connect(&r[i]);
+  int64_t start = now_micros();
+  for (int i = 0; i < kEvents; ++i) channel.Emit(bid_ask);
+  Report("EventChannel", now_micros() - start, r[0].sum + r[3].sum);
+}
+
+TEST(EventBusBenchmark, BackPlane)
+{
+  boost::scoped_ptr<ib::BackPlane> backplane(ib::BackPlane::Create());
+  VirtualSum r[4];
+  for (int i = 0; i < 4; ++i) backplane->Register(&r[i]);
+  int64_t start = now_micros();
+  for (int i = 0; i < kEvents; ++i) backplane->OnBid(i, 7, 0.5);
+  Report("BackPlane::OnBid", now_micros() - start, r[0].sum + r[3].sum);
+}
+
+} // namespace
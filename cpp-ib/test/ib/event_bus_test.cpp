@@ -0,0 +1,79 @@
+
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "ib/backplane.hpp"
+#include "ib/event_bus.hpp"
+
+using namespace std;
+using ib::Delegate;
+using ib::EventChannel;
+
+namespace {
+
+// Records the order of the calls across receivers.
+struct Recorder
+{
+  Recorder(const string& name, vector<string>* calls)
+      : name(name), calls(calls) {}
+  void operator()(const BidAsk& bid_ask) { calls->push_back(name + " bid"); }
+  void operator()(const Last& last) { calls->push_back(name + " last"); }
+  void OnLast(const Last& last) { calls->push_back(name + " OnLast"); }
+  string name;
+  vector<string>* calls;
+};
+
+TEST(EventBusTest, ChannelsCallInOrderOfConnection)
+{
+  vector<string> calls;
+  Recorder a("a", &calls), b("b", &calls);
+
+  EventChannel<Last> channel;
+  EXPECT_EQ(0U, channel.size());
+  channel.Emit(Last());  // Nothing connected.
+
+  channel.Connect(&b);
+  channel.Connect(Delegate<Last>::FromMethod<Recorder, &Recorder::OnLast>(&a));
+  channel.Connect(&a);
+  EXPECT_EQ(3U, channel.size());
+
+  channel.Emit(Last());
+  ASSERT_EQ(3U, calls.size());
+  EXPECT_EQ("b last", calls[0]);
+  EXPECT_EQ("a OnLast", calls[1]);
+  EXPECT_EQ("a last", calls[2]);
+}
+
+struct CountingReceiver : public ib::Receiver<BidAsk>
+{
+  CountingReceiver() : count(0) {}
+  virtual void operator()(const BidAsk& bid_ask) { count++; }
+  int count;
+};
+
+struct BidOnly : public ib::Predicate<BidAsk>
+{
+  virtual bool operator()(const BidAsk& bid_ask) { return bid_ask.has_bid(); }
+};
+
+TEST(EventBusTest, BackPlaneFiltersWithPredicates)
+{
+  boost::scoped_ptr<ib::BackPlane> backplane(ib::BackPlane::Create());
+  CountingReceiver all, bids;
+  BidOnly bid_only;
+  backplane->Register(&all);
+  backplane->Register(&bids, &bid_only);
+
+  backplane->OnBid(1, 7, 10.5);
+  backplane->OnAsk(2, 7, 10.6);
+  backplane->OnBid(3, 7, 300);
+  EXPECT_EQ(3, all.count);
+  EXPECT_EQ(2, bids.count);
+}
+
+} // namespace
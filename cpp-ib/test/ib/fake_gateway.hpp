@@ -0,0 +1,140 @@
+#ifndef IB_TEST_FAKE_GATEWAY_H_
+#define IB_TEST_FAKE_GATEWAY_H_
+
+// Loopback stand-in for the IB gateway, for tests and benchmarks of
+// the client transports.  Serves a single client: completes the
+// version / client id handshake, sends nextValidId, streams a fixed
+// number of BID tickPrice messages (ticker id = sequence number) and
+// any other messages given, then answers reqCurrentTime until the
+// client goes away.
+
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+namespace ib {
+namespace testing {
+
+class FakeGateway
+{
+ public:
+  FakeGateway()
+      : acceptor_(io_service_, boost::asio::ip::tcp::endpoint(
+            boost::asio::ip::address::from_string("127.0.0.1"), 0))
+      , socket_(io_service_)
+  {
+  }
+
+  ~FakeGateway()
+  {
+    Join();
+  }
+
+  unsigned int port() const
+  {
+    return acceptor_.local_endpoint().port();
+  }
+
+  // messages are sent as they are, after the ticks.
+  void Start(int ticks, const std::string& messages = std::string())
+  {
+    thread_.reset(new boost::thread(
+        boost::bind(&FakeGateway::Serve, this, ticks, messages)));
+  }
+
+  void Join()
+  {
+    if (thread_.get()) thread_->join();
+    thread_.reset();
+  }
+
+  // The bytes of one BID tickPrice (TICK_PRICE version 6).
+  static void AppendTick(int id, double price, int size, std::string* out)
+  {
+    Field("1", out);
+    Field("6", out);
+    Field(boost::lexical_cast<std::string>(id), out);
+    Field("1", out);  // BID
+    Field(boost::lexical_cast<std::string>(price), out);
+    Field(boost::lexical_cast<std::string>(size), out);
+    Field("1", out);  // canAutoExecute
+  }
+
+ private:
+  static void Field(const std::string& f, std::string* out)
+  {
+    out->append(f);
+    out->push_back('\0');
+  }
+
+  // Returns false once the client has closed the connection.
+  bool ReadField(std::string* field)
+  {
+    boost::system::error_code error;
+    size_t n = boost::asio::read_until(socket_, in_, '\0', error);
+    if (error) return false;
+    std::vector<char> bytes(n);
+    in_.sgetn(&bytes[0], n);
+    field->assign(&bytes[0], n - 1);
+    return true;
+  }
+
+  void Write(const std::string& bytes)
+  {
+    boost::system::error_code error;
+    boost::asio::write(socket_, boost::asio::buffer(bytes), error);
+  }
+
+  void Serve(int ticks, const std::string& messages)
+  {
+    acceptor_.accept(socket_);
+    socket_.set_option(boost::asio::ip::tcp::no_delay(true));
+
+    std::string field, out;
+    if (!ReadField(&field)) return;  // Client version.
+    Field("45", &out);
+    Field("20110114 09:30:00 EST", &out);
+    Write(out);
+    if (!ReadField(&field)) return;  // Client id.
+
+    out.clear();
+    Field("9", &out);  // NEXT_VALID_ID
+    Field("1", &out);
+    Field("1", &out);
+    for (int i = 0; i < ticks; ++i) {
+      AppendTick(i, 100. + (i % 100) / 100., 100 + i % 10, &out);
+      if (out.size() > 64 * 1024) {
+        Write(out);
+        out.clear();
+      }
+    }
+    out.append(messages);
+    Write(out);
+
+    while (ReadField(&field)) {
+      if (field != "49") continue;  // REQ_CURRENT_TIME
+      if (!ReadField(&field)) break;
+      out.clear();
+      Field("49", &out);  // CURRENT_TIME
+      Field("1", &out);
+      Field(boost::lexical_cast<std::string>(time(NULL)), &out);
+      Write(out);
+    }
+  }
+
+  boost::asio::io_service io_service_;
+  boost::asio::ip::tcp::acceptor acceptor_;
+  boost::asio::ip::tcp::socket socket_;
+  boost::asio::streambuf in_;
+  boost::scoped_ptr<boost::thread> thread_;
+};
+
+} // namespace testing
+} // namespace ib
+
+#endif // IB_TEST_FAKE_GATEWAY_H_
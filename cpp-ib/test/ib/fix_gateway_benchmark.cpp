@@ -0,0 +1,146 @@
+
+// Market data through the FIX gateway to a QuickFIX initiator on the
+// same host: latency of single quotes and throughput of a stream, and
+// the cost of encoding a refresh from a template against building it.
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <quickfix/FieldConvertors.h>
+#include <quickfix/MessageStore.h>
+#include <quickfix/SessionSettings.h>
+#include <quickfix/ThreadedSocketAcceptor.h>
+#include <quickfix/fix44/MarketDataIncrementalRefresh.h>
+#include <quickfix/fix44/MarketDataRequest.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "utils.hpp"
+#include "ib/backplane.hpp"
+#include "ib/fix/fix_gateway.hpp"
+#include "fix_initiator.hpp"
+#include "loopback_client.hpp"
+
+using namespace std;
+using ib::fix::Gateway;
+using ib::testing::FixInitiator;
+using ib::testing::FixSettings;
+using ib::testing::LoopbackClient;
+using lab616::utils::now_micros;
+
+namespace {
+
+const int kSingles = 2000;
+const int kStream = 200000;
+
+BidAsk Bid(int id, int i)
+{
+  BidAsk bid_ask;
+  bid_ask.set_time_stamp(now_micros());
+  bid_ask.set_id(id);
+  bid_ask.mutable_bid()->set_price(100 + (i % 1000) / 100.);
+  bid_ask.mutable_bid()->set_size(100 + i % 7 * 100);
+  return bid_ask;
+}
+
+TEST(FixGatewayBenchmark, QuotesToInitiator)
+{
+  LoopbackClient client(NULL);
+  Gateway gateway(&client, 1, NULL);
+  FIX::MemoryStoreFactory store;
+  istringstream settings_text(FixSettings(true, 15763));
+  FIX::SessionSettings settings(settings_text);
+  FIX::ThreadedSocketAcceptor acceptor(gateway, store, settings);
+  acceptor.start();
+  {
+    FixInitiator initiator(15763, false);
+    ASSERT_TRUE(initiator.WaitLogon(5000));
+
+    FIX44::MarketDataRequest request(
+        FIX::MDReqID("q1"),
+        FIX::SubscriptionRequestType(
+            FIX::SubscriptionRequestType_SNAPSHOT_PLUS_UPDATES),
+        FIX::MarketDepth(1));
+    FIX44::MarketDataRequest::NoRelatedSym related;
+    related.set(FIX::Symbol("IBM"));
+    request.addGroup(related);
+    ASSERT_TRUE(initiator.Send(request));
+    while (gateway.GetStats().subscriptions == 0) {
+      lab616::utils::sleep_micros(1000);
+    }
+    const int id = ib::signal::GetTickerId("IBM");
+
+    // One at a time, from the BackPlane call to the initiator's fromApp.
+    vector<int64_t> latencies;
+    for (int i = 0; i < kSingles; ++i) {
+      int64_t start = now_micros();
+      gateway(Bid(id, i));
+      ASSERT_TRUE(initiator.WaitFor(i + 1, 5000));
+      latencies.push_back(initiator.received_at(i) - start);
+    }
+    sort(latencies.begin(), latencies.end());
+    cout << "Latency: median " << latencies[kSingles / 2]
+         << " usec, 99% " << latencies[kSingles * 99 / 100]
+         << " usec, max " << latencies.back() << " usec" << endl;
+
+    int64_t start = now_micros();
+    for (int i = 0; i < kStream; ++i) gateway(Bid(id, i));
+    int64_t published = now_micros() - start;
+    ASSERT_TRUE(initiator.WaitFor(kSingles + kStream, 60000));
+    int64_t elapsed = initiator.received_at(kSingles + kStream - 1) - start;
+    cout << "Stream: " << kStream << " refreshes published in "
+         << published << " usec, received in " << elapsed << " usec = "
+         << kStream * 1e6 / elapsed << " messages/sec" << endl;
+  }
+  acceptor.stop();
+}
+
+// Encoding alone: a refresh built per quote, and one template with
+// only the changed fields set, as in the gateway.
+TEST(FixGatewayBenchmark, TemplateEncoding)
+{
+  string out;
+  size_t bytes = 0;
+  int64_t start = now_micros();
+  for (int i = 0; i < kStream; ++i) {
+    FIX44::MarketDataIncrementalRefresh refresh;
+    refresh.set(FIX::MDReqID("q1"));
+    FIX44::MarketDataIncrementalRefresh::NoMDEntries entry;
+    entry.set(FIX::MDUpdateAction(FIX::MDUpdateAction_CHANGE));
+    entry.set(FIX::MDEntryType(FIX::MDEntryType_BID));
+    entry.set(FIX::Symbol("IBM"));
+    entry.set(FIX::MDEntryPx(100 + (i % 1000) / 100.));
+    entry.set(FIX::MDEntrySize(100 + i % 7 * 100));
+    refresh.addGroup(entry);
+    bytes += refresh.toString(out).size();
+  }
+  int64_t built = now_micros() - start;
+
+  FIX44::MarketDataIncrementalRefresh refresh;
+  refresh.set(FIX::MDReqID("q1"));
+  FIX44::MarketDataIncrementalRefresh::NoMDEntries group;
+  group.set(FIX::MDUpdateAction(FIX::MDUpdateAction_CHANGE));
+  group.set(FIX::MDEntryType(FIX::MDEntryType_BID));
+  group.set(FIX::Symbol("IBM"));
+  refresh.addGroup(group);
+  FIX::FieldMap& entry = refresh.getGroupRef(1, FIX::FIELD::NoMDEntries);
+  start = now_micros();
+  for (int i = 0; i < kStream; ++i) {
+    entry.setField(FIX::FIELD::MDEntryPx,
+                   FIX::DoubleConvertor::convert(100 + (i % 1000) / 100.));
+    entry.setField(FIX::FIELD::MDEntrySize,
+                   FIX::IntConvertor::convert(100 + i % 7 * 100));
+    bytes -= refresh.toString(out).size();
+  }
+  int64_t templated = now_micros() - start;
+  EXPECT_EQ(0U, bytes);
+  cout << "Encoding: built " << built * 1000. / kStream
+       << " nsec/message, template " << templated * 1000. / kStream
+       << " nsec/message" << endl;
+}
+
+} // namespace
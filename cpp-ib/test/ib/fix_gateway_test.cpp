@@ -0,0 +1,239 @@
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <quickfix/MessageStore.h>
+#include <quickfix/SessionSettings.h>
+#include <quickfix/ThreadedSocketAcceptor.h>
+#include <quickfix/fix44/MarketDataRequest.h>
+#include <quickfix/fix44/NewOrderSingle.h>
+#include <quickfix/fix44/OrderCancelRequest.h>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <Shared/Contract.h>
+#include <Shared/Order.h>
+
+#include "utils.hpp"
+#include "ib/backplane.hpp"
+#include "ib/fix/fix_gateway.hpp"
+#include "fix_initiator.hpp"
+#include "loopback_client.hpp"
+
+using namespace std;
+using ib::fix::Gateway;
+using ib::testing::FixInitiator;
+using ib::testing::FixSettings;
+using ib::testing::LoopbackClient;
+
+namespace {
+
+// Records the orders that reach the client.
+class RecordingClient : public LoopbackClient
+{
+ public:
+  RecordingClient() : LoopbackClient(NULL) {}
+
+  void placeOrder(OrderId id, const Contract& contract, const Order& order)
+  {
+    ostringstream s;
+    s << "placeOrder " << id << " " << contract.symbol << "@"
+      << contract.exchange << " " << order.action << " "
+      << order.totalQuantity << " " << order.orderType << " "
+      << order.lmtPrice << " " << order.tif;
+    calls.push_back(s.str());
+  }
+  void cancelOrder(OrderId id)
+  {
+    ostringstream s;
+    s << "cancelOrder " << id;
+    calls.push_back(s.str());
+  }
+
+  vector<string> calls;
+};
+
+// The gateway behind an acceptor, and an initiator logged on to it.
+class FixGatewayTest : public ::testing::Test
+{
+ protected:
+  FixGatewayTest() : gateway(&client, 100, NULL) {}
+
+  void Start(int port)
+  {
+    istringstream settings_text(FixSettings(true, port));
+    settings.reset(new FIX::SessionSettings(settings_text));
+    acceptor.reset(new FIX::ThreadedSocketAcceptor(gateway, store, *settings));
+    acceptor->start();
+    initiator.reset(new FixInitiator(port, true));
+    ASSERT_TRUE(initiator->WaitLogon(5000));
+  }
+
+  void TearDown()
+  {
+    initiator.reset();
+    if (acceptor.get()) acceptor->stop();
+  }
+
+  void RequestMarketData(char type, const string& symbol)
+  {
+    FIX44::MarketDataRequest request(FIX::MDReqID("q1"),
+                                     FIX::SubscriptionRequestType(type),
+                                     FIX::MarketDepth(1));
+    FIX44::MarketDataRequest::NoMDEntryTypes types;
+    types.set(FIX::MDEntryType(FIX::MDEntryType_BID));
+    request.addGroup(types);
+    FIX44::MarketDataRequest::NoRelatedSym related;
+    related.set(FIX::Symbol(symbol));
+    request.addGroup(related);
+    ASSERT_TRUE(initiator->Send(request));
+  }
+
+  bool WaitSubscriptions(uint64_t n)
+  {
+    for (int i = 0; i < 500; ++i) {
+      if (gateway.GetStats().subscriptions == n) return true;
+      lab616::utils::sleep_micros(10000);
+    }
+    return false;
+  }
+
+  void SendOrder(const string& id, char type, double price)
+  {
+    FIX44::NewOrderSingle order(FIX::ClOrdID(id), FIX::Side(FIX::Side_BUY),
+                                FIX::TransactTime(), FIX::OrdType(type));
+    order.set(FIX::Symbol("IBM"));
+    order.set(FIX::OrderQty(100));
+    if (price > 0) order.set(FIX::Price(price));
+    ASSERT_TRUE(initiator->Send(order));
+  }
+
+  void SendCancel(const string& id, const string& orig)
+  {
+    FIX44::OrderCancelRequest cancel(FIX::OrigClOrdID(orig), FIX::ClOrdID(id),
+                                     FIX::Side(FIX::Side_BUY),
+                                     FIX::TransactTime());
+    cancel.set(FIX::Symbol("IBM"));
+    ASSERT_TRUE(initiator->Send(cancel));
+  }
+
+  RecordingClient client;
+  Gateway gateway;
+  FIX::MemoryStoreFactory store;
+  boost::scoped_ptr<FIX::SessionSettings> settings;
+  boost::scoped_ptr<FIX::ThreadedSocketAcceptor> acceptor;
+  boost::scoped_ptr<FixInitiator> initiator;
+};
+
+string Field(const FIX::FieldMap& map, int tag)
+{
+  return map.isSetField(tag) ? map.getField(tag) : "";
+}
+
+string Type(const FIX::Message& message)
+{
+  return message.getHeader().getField(FIX::FIELD::MsgType);
+}
+
+BidAsk Bid(const string& symbol, double price, int size)
+{
+  BidAsk bid_ask;
+  bid_ask.set_time_stamp(lab616::utils::now_micros());
+  bid_ask.set_id(ib::signal::GetTickerId(symbol));
+  bid_ask.mutable_bid()->set_price(price);
+  bid_ask.mutable_bid()->set_size(size);
+  return bid_ask;
+}
+
+TEST_F(FixGatewayTest, PublishesSubscribedQuotes)
+{
+  Start(15761);
+  RequestMarketData(FIX::SubscriptionRequestType_SNAPSHOT_PLUS_UPDATES, "IBM");
+  ASSERT_TRUE(WaitSubscriptions(1));
+
+  gateway(Bid("IBM", 101.25, 300));
+  gateway(Bid("MSFT", 25.5, 100));  // Not subscribed.
+  BidAsk ask;
+  ask.set_time_stamp(lab616::utils::now_micros());
+  ask.set_id(ib::signal::GetTickerId("IBM"));
+  ask.mutable_ask()->set_price(101.5);
+  ask.mutable_ask()->set_size(200);
+  gateway(ask);
+  Last last;
+  last.set_time_stamp(lab616::utils::now_micros());
+  last.set_id(ib::signal::GetTickerId("IBM"));
+  last.set_price(101.3);
+  last.set_size(5);
+  gateway(last);
+
+  ASSERT_TRUE(initiator->WaitFor(3, 5000));
+  const char types[] = "012";
+  const char* prices[] = { "101.25", "101.5", "101.3" };
+  const char* sizes[] = { "300", "200", "5" };
+  for (int i = 0; i < 3; ++i) {
+    FIX::Message refresh = initiator->message(i);
+    EXPECT_EQ("X", Type(refresh));
+    EXPECT_EQ("q1", Field(refresh, FIX::FIELD::MDReqID));
+    EXPECT_EQ("1", Field(refresh, FIX::FIELD::NoMDEntries));
+    // Without a data dictionary the entry's fields are in the body.
+    const FIX::Message& entry = refresh;
+    EXPECT_EQ(string(1, types[i]), Field(entry, FIX::FIELD::MDEntryType));
+    EXPECT_EQ("IBM", Field(entry, FIX::FIELD::Symbol));
+    EXPECT_EQ(prices[i], Field(entry, FIX::FIELD::MDEntryPx));
+    EXPECT_EQ(sizes[i], Field(entry, FIX::FIELD::MDEntrySize));
+  }
+
+  RequestMarketData(FIX::SubscriptionRequestType_UNSUBSCRIBE, "IBM");
+  ASSERT_TRUE(WaitSubscriptions(0));
+  gateway(Bid("IBM", 101.3, 100));
+  EXPECT_EQ(3U, gateway.GetStats().refreshes);
+}
+
+TEST_F(FixGatewayTest, PlacesAndCancelsOrders)
+{
+  Start(15762);
+  SendOrder("o1", FIX::OrdType_LIMIT, 99.5);
+  ASSERT_TRUE(initiator->WaitFor(1, 5000));
+  FIX::Message report = initiator->message(0);
+  EXPECT_EQ("8", Type(report));
+  EXPECT_EQ("A", Field(report, FIX::FIELD::ExecType));
+  EXPECT_EQ("100", Field(report, FIX::FIELD::OrderID));
+  EXPECT_EQ("o1", Field(report, FIX::FIELD::ClOrdID));
+  EXPECT_EQ("100", Field(report, FIX::FIELD::LeavesQty));
+  ASSERT_EQ(1U, client.calls.size());
+  EXPECT_EQ("placeOrder 100 IBM@SMART BUY 100 LMT 99.5 DAY", client.calls[0]);
+
+  // A limit order without a price.
+  SendOrder("o2", FIX::OrdType_LIMIT, 0);
+  ASSERT_TRUE(initiator->WaitFor(2, 5000));
+  report = initiator->message(1);
+  EXPECT_EQ("8", Field(report, FIX::FIELD::ExecType));
+  EXPECT_EQ("NONE", Field(report, FIX::FIELD::OrderID));
+  EXPECT_EQ("o2", Field(report, FIX::FIELD::ClOrdID));
+  EXPECT_EQ("No price", Field(report, FIX::FIELD::Text));
+
+  SendCancel("c1", "o1");
+  ASSERT_TRUE(initiator->WaitFor(3, 5000));
+  report = initiator->message(2);
+  EXPECT_EQ("6", Field(report, FIX::FIELD::ExecType));
+  EXPECT_EQ("100", Field(report, FIX::FIELD::OrderID));
+  EXPECT_EQ("c1", Field(report, FIX::FIELD::ClOrdID));
+  EXPECT_EQ("o1", Field(report, FIX::FIELD::OrigClOrdID));
+  EXPECT_EQ("", Field(report, FIX::FIELD::Text));
+  ASSERT_EQ(2U, client.calls.size());
+  EXPECT_EQ("cancelOrder 100", client.calls[1]);
+
+  SendCancel("c2", "o3");
+  ASSERT_TRUE(initiator->WaitFor(4, 5000));
+  EXPECT_EQ("9", Type(initiator->message(3)));
+  EXPECT_EQ("o3", Field(initiator->message(3), FIX::FIELD::OrigClOrdID));
+
+  Gateway::Stats stats = gateway.GetStats();
+  EXPECT_EQ(1U, stats.orders);
+  EXPECT_EQ(1U, stats.cancels);
+  EXPECT_EQ(2U, stats.rejects);
+}
+
+} // namespace
@@ -0,0 +1,160 @@
+#ifndef IB_TEST_FIX_INITIATOR_H_
+#define IB_TEST_FIX_INITIATOR_H_
+
+// A QuickFIX initiator on localhost, as CLIENT to IB over FIX 4.4,
+// recording the application messages it receives and when.  The
+// other end of the FIX gateway in tests and benchmarks.
+
+#include <stdint.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <quickfix/Application.h>
+#include <quickfix/MessageStore.h>
+#include <quickfix/Session.h>
+#include <quickfix/SessionSettings.h>
+#include <quickfix/ThreadedSocketInitiator.h>
+
+#include "common.hpp"
+#include "utils.hpp"
+
+namespace ib {
+namespace testing {
+
+// Settings of both ends.  The acceptor is IB and listens on port.
+inline std::string FixSettings(bool acceptor, int port)
+{
+  std::ostringstream s;
+  s << "[DEFAULT]\n"
+    << "ConnectionType=" << (acceptor ? "acceptor" : "initiator") << "\n"
+    << "StartTime=00:00:00\n"
+    << "EndTime=00:00:00\n"
+    << "HeartBtInt=30\n"
+    << "ReconnectInterval=1\n"
+    << "UseDataDictionary=N\n"
+    << "SocketNodelay=Y\n"
+    << (acceptor ? "SocketAcceptPort=" : "SocketConnectPort=") << port
+    << "\n"
+    << "SocketConnectHost=127.0.0.1\n"
+    << "[SESSION]\n"
+    << "BeginString=FIX.4.4\n"
+    << "SenderCompID=" << (acceptor ? "IB" : "CLIENT") << "\n"
+    << "TargetCompID=" << (acceptor ? "CLIENT" : "IB") << "\n";
+  return s.str();
+}
+
+class FixInitiator : public FIX::Application, NoCopyAndAssign
+{
+ public:
+  // Keeps the messages received only if keep, otherwise their times.
+  FixInitiator(int port, bool keep)
+      : keep_(keep), logged_on_(false), received_(0)
+  {
+    std::istringstream settings(FixSettings(false, port));
+    settings_.reset(new FIX::SessionSettings(settings));
+    initiator_.reset(
+        new FIX::ThreadedSocketInitiator(*this, store_, *settings_));
+    initiator_->start();
+  }
+
+  ~FixInitiator()
+  {
+    initiator_->stop(true);
+  }
+
+  bool WaitLogon(int timeout_millis)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    boost::system_time timeout = boost::get_system_time() +
+        boost::posix_time::milliseconds(timeout_millis);
+    while (!logged_on_) {
+      if (!changed_.timed_wait(lock, timeout)) return false;
+    }
+    return true;
+  }
+
+  bool Send(FIX::Message& message)
+  {
+    return FIX::Session::sendToTarget(message, id_);
+  }
+
+  // Waits until n application messages have been received.
+  bool WaitFor(size_t n, int timeout_millis)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    boost::system_time timeout = boost::get_system_time() +
+        boost::posix_time::milliseconds(timeout_millis);
+    while (received_ < n) {
+      if (!changed_.timed_wait(lock, timeout)) return false;
+    }
+    return true;
+  }
+
+  size_t received() const
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    return received_;
+  }
+
+  FIX::Message message(size_t i) const
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    return messages_[i];
+  }
+
+  // When the message was received, in micros.
+  int64_t received_at(size_t i) const
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    return times_[i];
+  }
+
+  // FIX::Application
+  void onCreate(const FIX::SessionID& id) { id_ = id; }
+  void onLogon(const FIX::SessionID& id)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    logged_on_ = true;
+    changed_.notify_all();
+  }
+  void onLogout(const FIX::SessionID& id) {}
+  void toAdmin(FIX::Message&, const FIX::SessionID&) {}
+  void toApp(FIX::Message&, const FIX::SessionID&) throw(FIX::DoNotSend) {}
+  void fromAdmin(const FIX::Message&, const FIX::SessionID&)
+      throw(FIX::FieldNotFound, FIX::IncorrectDataFormat,
+            FIX::IncorrectTagValue, FIX::RejectLogon) {}
+  void fromApp(const FIX::Message& message, const FIX::SessionID&)
+      throw(FIX::FieldNotFound, FIX::IncorrectDataFormat,
+            FIX::IncorrectTagValue, FIX::UnsupportedMessageType)
+  {
+    const int64_t now = lab616::utils::now_micros();
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    if (keep_) messages_.push_back(message);
+    times_.push_back(now);
+    received_++;
+    changed_.notify_all();
+  }
+
+ private:
+  const bool keep_;
+  FIX::MemoryStoreFactory store_;
+  boost::scoped_ptr<FIX::SessionSettings> settings_;
+  boost::scoped_ptr<FIX::ThreadedSocketInitiator> initiator_;
+  FIX::SessionID id_;
+
+  mutable boost::mutex mutex_;
+  boost::condition_variable changed_;
+  bool logged_on_;
+  size_t received_;
+  std::vector<FIX::Message> messages_;
+  std::vector<int64_t> times_;
+};
+
+} // namespace testing
+} // namespace ib
+
+#endif // IB_TEST_FIX_INITIATOR_H_
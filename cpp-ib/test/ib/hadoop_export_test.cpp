@@ -0,0 +1,197 @@
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "ib/hadoop/sequence_file.hpp"
+#include "ib/hadoop/streaming.hpp"
+#include "ib/tick_log.hpp"
+#include "ib/ticker_id.hpp"
+
+using namespace std;
+using namespace ib::hadoop;
+using ib::internal::TickEvent;
+
+namespace {
+
+static string Encode(int64_t v)
+{
+  string out;
+  WriteVLong(v, &out);
+  return out;
+}
+
+TEST(HadoopExportTest, VLongMatchesWritableUtils)
+{
+  EXPECT_EQ(string("\x00", 1), Encode(0));
+  EXPECT_EQ("\x7f", Encode(127));
+  EXPECT_EQ("\x90", Encode(-112));
+  EXPECT_EQ("\x8f\x80", Encode(128));
+  EXPECT_EQ("\x87\x70", Encode(-113));
+  EXPECT_EQ(string("\x8e\x01\x00", 3), Encode(256));
+
+  int64_t values[] = { 0, 1, -1, 127, 128, -112, -113, 65535, -65536,
+                       1295015400123456LL, -1295015400123456LL };
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+    string encoded = Encode(values[i]);
+    size_t pos = 0;
+    int64_t decoded;
+    ASSERT_TRUE(ReadVLong(encoded, &pos, &decoded));
+    EXPECT_EQ(values[i], decoded);
+    EXPECT_EQ(encoded.length(), pos);
+  }
+}
+
+TEST(HadoopExportTest, ParsesLoggerLines)
+{
+  ostringstream line;
+  line << "I0114 09:30:00.123456  1234 adapters.cpp:100] "
+       << "cid=0,ts_utc=1295015400123456,ts=1295015400123460,"
+       << "event=tickPrice,tickerId="
+       << ib::internal::SymbolToTickerId("AAPL")
+       << ",field=LAST,price=345.12,canAutoExecute=1";
+
+  TickEvent tick;
+  ASSERT_TRUE(ib::internal::ParseTickLine(line.str(), &tick));
+  EXPECT_EQ("AAPL", tick.symbol);
+  EXPECT_EQ("LAST", tick.event);
+  EXPECT_EQ(1295015400123456ULL, tick.ts);
+  EXPECT_DOUBLE_EQ(345.12, tick.value);
+  EXPECT_EQ("20110114", ib::internal::TradeDate(tick.ts));
+
+  EXPECT_FALSE(ib::internal::ParseTickLine(
+      "I0114 09:30:00.1 1 a.cpp:1] cid=0,event=nextValidId,orderId=1", &tick));
+
+  TickEvent parsed;
+  ASSERT_TRUE(ParseExportLine(ExportKey(tick) + "\t" + ExportValue(tick),
+                              &parsed));
+  EXPECT_EQ(tick.symbol, parsed.symbol);
+  EXPECT_EQ(tick.event, parsed.event);
+  EXPECT_EQ(tick.ts, parsed.ts);
+  EXPECT_DOUBLE_EQ(tick.value, parsed.value);
+}
+
+TEST(HadoopExportTest, SequenceFileRoundTripAcrossBlocks)
+{
+  ostringstream path;
+  path << "/tmp/hadoop_export_test." << getpid() << ".seq";
+
+  const int records = 5000;
+  {
+    SequenceFileWriter writer(path.str(), 4096);
+    ASSERT_TRUE(writer.Open());
+    for (int i = 0; i < records; ++i) {
+      ostringstream value;
+      value << 1295015400000000LL + i << ",BID," << 100 + i * 0.01;
+      writer.Append(i % 2 ? "AAPL" : "GOOG", value.str());
+    }
+    ASSERT_TRUE(writer.Close());
+    EXPECT_EQ(records, writer.records());
+    EXPECT_LT(1, writer.blocks());
+  }
+
+  SequenceFileReader reader(path.str());
+  ASSERT_TRUE(reader.Open());
+  string key, value;
+  int count = 0;
+  while (reader.Next(&key, &value)) {
+    EXPECT_EQ(count % 2 ? "AAPL" : "GOOG", key);
+    ostringstream expected;
+    expected << 1295015400000000LL + count << ",BID," << 100 + count * 0.01;
+    EXPECT_EQ(expected.str(), value);
+    ++count;
+  }
+  EXPECT_EQ(records, count);
+
+  // An existing file is not overwritten.
+  SequenceFileWriter again(path.str(), 4096);
+  EXPECT_FALSE(again.Open());
+  unlink(path.str().c_str());
+}
+
+TEST(HadoopExportTest, NewYorkTimeFollowsDaylightSaving)
+{
+  using ib::internal::MicrosOfDay;
+  using ib::internal::TradeDate;
+  const uint64_t HOUR = 3600000000ULL;
+  // 09:30 New York in winter, 13:30 UTC in summer.
+  EXPECT_EQ(9 * HOUR + HOUR / 2, MicrosOfDay(1295015400000000ULL));
+  EXPECT_EQ(9 * HOUR + HOUR / 2, MicrosOfDay(1310650200000000ULL));
+  // 2011-03-13 06:59 and 07:00 UTC, either side of 2am EST.
+  EXPECT_EQ(HOUR + 59 * HOUR / 60, MicrosOfDay(1299999540000000ULL));
+  EXPECT_EQ(3 * HOUR, MicrosOfDay(1299999600000000ULL));
+  // 2011-11-06 05:59 and 06:00 UTC, either side of 2am EDT.
+  EXPECT_EQ(HOUR + 59 * HOUR / 60, MicrosOfDay(1320559140000000ULL));
+  EXPECT_EQ(HOUR, MicrosOfDay(1320559200000000ULL));
+  // 2006 had the older rules: 2006-04-02 07:00 UTC.
+  EXPECT_EQ(3 * HOUR, MicrosOfDay(1143961200000000ULL));
+  // 23:30 New York on 2011-07-14 is the 15th in UTC.
+  EXPECT_EQ("20110714", TradeDate(1310700600000000ULL));
+}
+
+// 09:30:00 New York on 2011-01-14, in micros UTC.
+static const uint64_t OPEN = 1295015400000000ULL;
+
+static string Tick(const string& symbol, uint64_t ts, const string& field,
+                   double value)
+{
+  TickEvent tick;
+  tick.symbol = symbol;
+  tick.ts = ts;
+  tick.event = field;
+  tick.value = value;
+  return ExportKey(tick) + "\t" + ExportValue(tick) + "\n";
+}
+
+TEST(HadoopExportTest, BarsMapAndReduce)
+{
+  // Out of order within the bar, as a reducer may see them.
+  istringstream in(
+      Tick("AAPL", OPEN + 30000000, "LAST", 346.0) +
+      Tick("AAPL", OPEN + 1000000, "LAST", 345.0) +
+      Tick("AAPL", OPEN + 1000000, "LAST_SIZE", 100) +
+      Tick("AAPL", OPEN + 45000000, "LAST", 344.5) +
+      Tick("AAPL", OPEN + 50000000, "BID", 344.4) +
+      Tick("AAPL", OPEN + 59000000, "LAST", 345.5) +
+      Tick("AAPL", OPEN + 59000000, "LAST_SIZE", 200) +
+      Tick("AAPL", OPEN + 61000000, "LAST", 347.0));
+  ostringstream mapped;
+  EXPECT_EQ(7, MapBars(in, mapped, BarOptions()));
+
+  // Stands in for the shuffle; the map output here is already grouped.
+  istringstream shuffled(mapped.str());
+  ostringstream reduced;
+  EXPECT_EQ(2, ReduceBars(shuffled, reduced));
+  EXPECT_EQ("AAPL.20110114.093000\t345,346,344.5,345.5,300,4\n"
+            "AAPL.20110114.093100\t347,347,347,347,0,1\n",
+            reduced.str());
+}
+
+TEST(HadoopExportTest, StatsCombineAndReduce)
+{
+  istringstream in(Tick("GOOG", OPEN, "BID", 1.0) +
+                   Tick("GOOG", OPEN + 1, "BID", 2.0) +
+                   Tick("GOOG", OPEN + 2, "BID", 3.0) +
+                   Tick("GOOG", OPEN + 3, "BID", 4.0));
+  ostringstream mapped;
+  EXPECT_EQ(4, MapStats(in, mapped));
+
+  // Combining part of the output must not change the result.
+  string lines = mapped.str();
+  size_t half = lines.find('\n', lines.length() / 2) + 1;
+  istringstream first(lines.substr(0, half));
+  ostringstream combined;
+  EXPECT_EQ(1, CombineStats(first, combined));
+
+  istringstream shuffled(combined.str() + lines.substr(half));
+  ostringstream reduced;
+  EXPECT_EQ(1, ReduceStats(shuffled, reduced));
+  EXPECT_EQ("GOOG.BID\t4,2.5,1.118033989,1,4\n", reduced.str());
+}
+
+} // namespace
@@ -0,0 +1,119 @@
+
+#include <sstream>
+#include <string>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "ib/backplane.hpp"
+#include "ib/line_arbiter.hpp"
+
+using namespace std;
+using ib::BackPlane;
+using ib::FieldReceiver;
+using ib::LineArbiter;
+using ib::QuoteTable;
+using ib::Receiver;
+
+namespace {
+
+// Writes what reaches the output as text, a line a field.
+struct Output : public FieldReceiver
+{
+  void OnField(int64_t ts, int id, Field field, double value)
+  {
+    static const char* NAMES[] = {
+      "bid", "bid_size", "ask", "ask_size", "last", "last_size"
+    };
+    out << ts << " " << id << " " << NAMES[field] << " " << value << "\n";
+  }
+  ostringstream out;
+};
+
+class LineArbiterTest : public ::testing::Test
+{
+ protected:
+  LineArbiterTest() : output_(BackPlane::Create()), arbiter_(output_.get(), 1000)
+  {
+    output_->Register(static_cast<Receiver<BidAsk>*>(&received_));
+    output_->Register(static_cast<Receiver<Last>*>(&received_));
+  }
+
+  boost::scoped_ptr<BackPlane> output_;
+  LineArbiter arbiter_;
+  Output received_;
+};
+
+TEST_F(LineArbiterTest, ForwardsTheFirstCopyOnly)
+{
+  int a = arbiter_.AddLine(NULL, "a");
+  int b = arbiter_.AddLine(NULL, "b");
+
+  EXPECT_TRUE(arbiter_.OnUpdate(a, 100, 7, QuoteTable::BID, 10.5));
+  EXPECT_FALSE(arbiter_.OnUpdate(b, 130, 7, QuoteTable::BID, 10.5));
+  EXPECT_TRUE(arbiter_.OnUpdate(b, 200, 7, QuoteTable::ASK, 10.6));
+  EXPECT_FALSE(arbiter_.OnUpdate(a, 250, 7, QuoteTable::ASK, 10.6));
+  EXPECT_TRUE(arbiter_.OnUpdate(a, 300, 7, QuoteTable::LAST_SIZE, 200));
+  EXPECT_FALSE(arbiter_.OnUpdate(b, 310, 7, QuoteTable::LAST_SIZE, 200));
+
+  EXPECT_EQ("100 7 bid 10.5\n"
+            "200 7 ask 10.6\n"
+            "300 7 last_size 200\n", received_.out.str());
+
+  LineArbiter::LineStats stats = arbiter_.GetStats(a);
+  EXPECT_EQ(3U, stats.updates);
+  EXPECT_EQ(2U, stats.wins);
+  EXPECT_EQ(1U, stats.losses);
+  EXPECT_EQ(50, stats.lag_micros);
+  stats = arbiter_.GetStats(b);
+  EXPECT_EQ(1U, stats.wins);
+  EXPECT_EQ(2U, stats.losses);
+  EXPECT_EQ(40, stats.lag_micros);
+  EXPECT_EQ(30, stats.max_lag_micros);
+}
+
+TEST_F(LineArbiterTest, ForwardsValuesThatComeBack)
+{
+  int a = arbiter_.AddLine(NULL, "a");
+  int b = arbiter_.AddLine(NULL, "b");
+
+  // Each line delivers 10.00, 10.01, 10.00; b is behind.
+  EXPECT_TRUE(arbiter_.OnUpdate(a, 100, 7, QuoteTable::BID, 10.00));
+  EXPECT_TRUE(arbiter_.OnUpdate(a, 110, 7, QuoteTable::BID, 10.01));
+  EXPECT_TRUE(arbiter_.OnUpdate(a, 120, 7, QuoteTable::BID, 10.00));
+  EXPECT_FALSE(arbiter_.OnUpdate(b, 140, 7, QuoteTable::BID, 10.00));
+  EXPECT_FALSE(arbiter_.OnUpdate(b, 150, 7, QuoteTable::BID, 10.01));
+  EXPECT_FALSE(arbiter_.OnUpdate(b, 160, 7, QuoteTable::BID, 10.00));
+  EXPECT_EQ(3U, arbiter_.GetStats(a).wins);
+  EXPECT_EQ(3U, arbiter_.GetStats(b).losses);
+
+  // The same value on another id, or later than the window, is new.
+  EXPECT_TRUE(arbiter_.OnUpdate(b, 170, 8, QuoteTable::BID, 10.00));
+  EXPECT_TRUE(arbiter_.OnUpdate(a, 5000, 7, QuoteTable::BID, 10.01));
+  EXPECT_TRUE(arbiter_.OnUpdate(b, 9000, 7, QuoteTable::BID, 10.01));
+}
+
+TEST_F(LineArbiterTest, SubscribesToSessionBackPlanes)
+{
+  boost::scoped_ptr<BackPlane> line_a(BackPlane::Create());
+  boost::scoped_ptr<BackPlane> line_b(BackPlane::Create());
+  int a = arbiter_.AddLine(line_a.get(), "a");
+  int b = arbiter_.AddLine(line_b.get(), "b");
+  EXPECT_EQ(2, arbiter_.lines());
+
+  line_b->OnLast(100, 7, 99.5);
+  line_a->OnLast(120, 7, 99.5);
+  line_a->OnAsk(130, 7, 300);
+  line_b->OnAsk(135, 7, 300);
+
+  EXPECT_EQ("100 7 last 99.5\n"
+            "130 7 ask_size 300\n", received_.out.str());
+  EXPECT_EQ(1U, arbiter_.GetStats(a).wins);
+  EXPECT_EQ(20, arbiter_.GetStats(a).lag_micros);
+  EXPECT_EQ(1U, arbiter_.GetStats(b).wins);
+  EXPECT_EQ(5, arbiter_.GetStats(b).lag_micros);
+}
+
+} // namespace
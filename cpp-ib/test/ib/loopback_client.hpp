@@ -0,0 +1,75 @@
+#ifndef IB_TEST_LOOPBACK_CLIENT_H_
+#define IB_TEST_LOOPBACK_CLIENT_H_
+
+// The vendored EClientSocketBase over an in-memory connection: bytes
+// fed in are decoded by its processMsg and requests are captured in
+// `sent`.  The reference that the wire codec is checked and
+// benchmarked against.
+
+#ifndef IB_USE_STD_STRING
+#define IB_USE_STD_STRING
+#endif
+
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+#include <Shared/EClientSocketBase.h>
+
+namespace ib {
+namespace testing {
+
+class LoopbackClient : public EClientSocketBase
+{
+ public:
+  explicit LoopbackClient(EWrapper* wrapper)
+      : EClientSocketBase(wrapper), ok_(true), in_(NULL), in_size_(0) {}
+
+  bool eConnect(const char*, unsigned int, int) { return false; }
+  void eDisconnect() { ok_ = false; eDisconnectBase(); }
+  bool isSocketOK() const { return ok_; }
+
+  void Handshake(int server_version)
+  {
+    onConnectBase();
+    std::ostringstream ack;
+    ack << server_version << '\0' << "20110114 09:30:00 EST" << '\0';
+    Feed(ack.str());
+    sent.clear();
+  }
+
+  void Feed(const std::string& bytes)
+  {
+    in_ = bytes.data();
+    in_size_ = bytes.size();
+    while (in_size_ > 0 && checkMessages()) {}
+  }
+
+  std::string sent;
+
+ private:
+  int send(const char* buf, size_t sz)
+  {
+    sent.append(buf, sz);
+    return sz;
+  }
+
+  int receive(char* buf, size_t sz)
+  {
+    size_t n = std::min(sz, in_size_);
+    memcpy(buf, in_, n);
+    in_ += n;
+    in_size_ -= n;
+    return n;
+  }
+
+  bool ok_;
+  const char* in_;
+  size_t in_size_;
+};
+
+} // namespace testing
+} // namespace ib
+
+#endif // IB_TEST_LOOPBACK_CLIENT_H_
@@ -0,0 +1,98 @@
+#ifndef IB_TEST_NTP_RESPONDER_H_
+#define IB_TEST_NTP_RESPONDER_H_
+
+// An SNTP server on localhost whose clock runs a given offset ahead of
+// this host's.  The stand-in for a real NTP server in tests.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "common.hpp"
+#include "utils.hpp"
+#include "ib/clock_discipline.hpp"
+
+namespace ib {
+namespace testing {
+
+class NtpResponder : NoCopyAndAssign
+{
+ public:
+  NtpResponder(int port, int64_t offset)
+      : offset_(offset), delay_(0), replies_(0), stop_(false)
+  {
+    socket_ = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(socket_, reinterpret_cast<struct sockaddr*>(&address),
+         sizeof(address));
+    struct timeval timeout = { 0, 20000 };  // To see stop_.
+    setsockopt(socket_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    thread_.reset(new boost::thread(boost::bind(&NtpResponder::Run, this)));
+  }
+
+  ~NtpResponder()
+  {
+    stop_ = true;
+    thread_->join();
+    close(socket_);
+  }
+
+  // Micros a request waits before it is stamped, as if it had queued
+  // on the way: the round trip grows and the offset is off by half.
+  void set_delay(int micros) { delay_ = micros; }
+
+  int replies() const { return replies_; }
+
+ private:
+  static void PutNtp(uint64_t ntp, unsigned char* p)
+  {
+    for (int i = 0; i < 8; ++i) p[i] = ntp >> (56 - 8 * i);
+  }
+
+  void Run()
+  {
+    unsigned char packet[48];
+    struct sockaddr_in from;
+    while (!stop_) {
+      socklen_t size = sizeof(from);
+      if (recvfrom(socket_, packet, sizeof(packet), 0,
+                   reinterpret_cast<struct sockaddr*>(&from), &size) != 48) {
+        continue;
+      }
+      if (delay_) lab616::utils::sleep_micros(delay_);
+      const int64_t received = lab616::utils::now_micros() + offset_;
+      memcpy(packet + 24, packet + 40, 8);  // Originate: their transmit.
+      packet[0] = 0x24;                     // Version 4, server.
+      packet[1] = 1;                        // Stratum: a reference clock.
+      PutNtp(MicrosToNtp(received), packet + 32);
+      PutNtp(MicrosToNtp(lab616::utils::now_micros() + offset_), packet + 40);
+      sendto(socket_, packet, sizeof(packet), 0,
+             reinterpret_cast<struct sockaddr*>(&from), size);
+      replies_++;
+    }
+  }
+
+  const int64_t offset_;
+  volatile int delay_;
+  volatile int replies_;
+  volatile bool stop_;
+  int socket_;
+  boost::scoped_ptr<boost::thread> thread_;
+};
+
+} // namespace testing
+} // namespace ib
+
+#endif // IB_TEST_NTP_RESPONDER_H_
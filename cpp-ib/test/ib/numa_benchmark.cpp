@@ -0,0 +1,144 @@
+
+// Cost of remote memory for the feed thread, and what placement saves:
+//
+//   Remote     state first touched by a thread of another node, as
+//              when the session was built there and malloc put it
+//              wherever that thread ran;
+//   Local      the same state as NodeMemory on the worker's node;
+//   Hugepages  local, on 2MB pages when the pool has them.
+//
+// The worker, bound to node 0, chases pointers through 64MB of cache
+// lines in a random cycle, so every access misses the caches and pays
+// the latency of where the line is.  Each run reports ns per access
+// and the share of pages on the worker's node.  On a box of one node
+// Remote is local too; the report says so.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+#include <gtest/gtest.h>
+
+#include "utils.hpp"
+#include "ib/numa.hpp"
+
+using namespace std;
+using ib::numa::NodeMemory;
+using ib::numa::Topology;
+using lab616::utils::now_micros;
+
+namespace {
+
+const size_t kBytes = 64 << 20;
+const size_t kLine = 64;
+const int kAccesses = 10000000;
+
+// A random cycle through the lines of the buffer.
+void Link(char* memory, size_t size)
+{
+  const size_t lines = size / kLine;
+  vector<size_t> order(lines);
+  for (size_t i = 0; i < lines; ++i) order[i] = i;
+  srand(616);
+  random_shuffle(order.begin(), order.end());
+  for (size_t i = 0; i < lines; ++i) {
+    *reinterpret_cast<char**>(memory + order[i] * kLine) =
+        memory + order[(i + 1) % lines] * kLine;
+  }
+}
+
+void Chase(char* memory, int64_t* elapsed)
+{
+  char* p = memory;
+  int64_t start = now_micros();
+  for (int i = 0; i < kAccesses; ++i) p = *reinterpret_cast<char**>(p);
+  *elapsed = now_micros() - start;
+  // Keeps the loop.
+  if (p == NULL) cout << "";
+}
+
+// Share of the pages of the buffer on the node.
+double Local(const char* memory, size_t size, int node)
+{
+  const size_t page = sysconf(_SC_PAGESIZE);
+  size_t local = 0, known = 0;
+  for (size_t offset = 0; offset < size; offset += page * 64) {
+    const int at = ib::numa::NodeOfAddress(memory + offset);
+    if (at < 0) continue;
+    ++known;
+    if (at == node) ++local;
+  }
+  return known ? static_cast<double>(local) / known : -1;
+}
+
+void Bound(const Topology* topology, int node,
+           const boost::function<void()>& work)
+{
+  ib::numa::BindThread(*topology, node);
+  work();
+}
+
+void RunOn(const Topology& topology, int node,
+           const boost::function<void()>& work)
+{
+  boost::thread thread(boost::bind(&Bound, &topology, node, work));
+  thread.join();
+}
+
+void Report(const char* name, char* memory, size_t size, int node,
+            const Topology& topology)
+{
+  int64_t elapsed = 0;
+  RunOn(topology, topology.id(0), boost::bind(&Chase, memory, &elapsed));
+  const double local = Local(memory, size, node);
+  cout << name << ": " << elapsed * 1000. / kAccesses << " ns/access, ";
+  if (local < 0) {
+    cout << "placement unknown" << endl;
+  } else {
+    cout << local * 100 << "% of pages on node " << node << endl;
+  }
+}
+
+void Touch(char* memory, size_t size)
+{
+  memset(memory, 0, size);
+  Link(memory, size);
+}
+
+TEST(NumaBenchmark, Placement)
+{
+  Topology topology;
+  cout << topology.Report();
+  const int worker = topology.id(0);
+  const int other = topology.id(topology.nodes() - 1);
+  if (other == worker) {
+    cout << "One node: Remote is local." << endl;
+  }
+
+  // Malloc'd, first touched from the other node.
+  char* remote = static_cast<char*>(malloc(kBytes));
+  RunOn(topology, other, boost::bind(&Touch, remote, kBytes));
+  Report("Remote", remote, kBytes, worker, topology);
+  free(remote);
+
+  NodeMemory local(kBytes, worker, false);
+  Link(static_cast<char*>(local.data()), kBytes);
+  Report("Local", static_cast<char*>(local.data()), kBytes, worker,
+         topology);
+
+  NodeMemory huge(kBytes, worker, true);
+  Link(static_cast<char*>(huge.data()), kBytes);
+  Report(huge.huge() ? "Hugepages" : "Hugepages (transparent)",
+         static_cast<char*>(huge.data()), kBytes, worker, topology);
+}
+
+} // namespace
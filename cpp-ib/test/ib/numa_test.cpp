@@ -0,0 +1,127 @@
+
+#include <dirent.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <gtest/gtest.h>
+
+#include "ib/numa.hpp"
+
+using namespace std;
+using ib::numa::NodeMemory;
+using ib::numa::Topology;
+
+namespace {
+
+static void WriteFile(const string& path, const string& contents)
+{
+  FILE* file = fopen(path.c_str(), "w");
+  ASSERT_TRUE(file != NULL) << path;
+  fputs(contents.c_str(), file);
+  fclose(file);
+}
+
+// A sysfs of two nodes, the second without hugepages.
+static string FakeSysfs()
+{
+  ostringstream root;
+  root << "/tmp/numa_test." << getpid();
+  const string dir = root.str();
+  const char* dirs[] = {
+    "", "/node", "/node/node0", "/node/node0/hugepages",
+    "/node/node0/hugepages/hugepages-2048kB", "/node/node1"
+  };
+  for (size_t i = 0; i < sizeof(dirs) / sizeof(dirs[0]); ++i) {
+    mkdir((dir + dirs[i]).c_str(), 0755);
+  }
+  WriteFile(dir + "/node/possible", "0-1\n");
+  WriteFile(dir + "/node/node0/cpulist", "0-3,8-11\n");
+  WriteFile(dir + "/node/node0/meminfo",
+            "Node 0 MemTotal:       16777216 kB\n"
+            "Node 0 MemFree:         8388608 kB\n"
+            "Node 0 MemUsed:         8388608 kB\n");
+  WriteFile(dir + "/node/node0/hugepages/hugepages-2048kB/nr_hugepages",
+            "16\n");
+  WriteFile(dir + "/node/node0/hugepages/hugepages-2048kB/free_hugepages",
+            "10\n");
+  WriteFile(dir + "/node/node1/cpulist", "4-7,12-15\n");
+  return dir;
+}
+
+TEST(NumaTest, ParsesCpuLists)
+{
+  vector<int> cpus;
+  ASSERT_TRUE(Topology::ParseCpuList("0-2,5,7-8\n", &cpus));
+  const int expected[] = { 0, 1, 2, 5, 7, 8 };
+  EXPECT_EQ(vector<int>(expected, expected + 6), cpus);
+  ASSERT_TRUE(Topology::ParseCpuList("3", &cpus));
+  EXPECT_EQ(1U, cpus.size());
+  ASSERT_TRUE(Topology::ParseCpuList("\n", &cpus));
+  EXPECT_TRUE(cpus.empty());
+  EXPECT_FALSE(Topology::ParseCpuList("3-1", &cpus));
+  EXPECT_FALSE(Topology::ParseCpuList("0;1", &cpus));
+}
+
+TEST(NumaTest, ReadsTheTopology)
+{
+  Topology topology(FakeSysfs());
+  ASSERT_EQ(2U, topology.nodes());
+  EXPECT_EQ(0, topology.id(0));
+  EXPECT_EQ(8U, topology.cpus(0).size());
+  EXPECT_EQ(1, topology.Find(1));
+  EXPECT_EQ(-1, topology.Find(2));
+  EXPECT_EQ(0, topology.NodeOfCpu(9));
+  EXPECT_EQ(1, topology.NodeOfCpu(12));
+  EXPECT_EQ(-1, topology.NodeOfCpu(16));
+  EXPECT_EQ("node 0: cpus 0-3,8-11, 16384 MB (8192 free), "
+            "2MB hugepages 10 free of 16\n"
+            "node 1: cpus 4-7,12-15\n", topology.Report());
+
+  // Without nodes, the online cpus are one.
+  Topology flat("/nonexistent");
+  ASSERT_EQ(1U, flat.nodes());
+  EXPECT_LT(0U, flat.cpus(0).size());
+}
+
+static void RunOn(const Topology* topology, int node, int* ran_on)
+{
+  if (ib::numa::BindThread(*topology, node)) {
+    *ran_on = ib::numa::CurrentNode(*topology);
+  }
+}
+
+TEST(NumaTest, BindsThreadsAndMemory)
+{
+  Topology topology;
+  const int node = topology.id(0);
+  int ran_on = node;
+  boost::thread thread(boost::bind(&RunOn, &topology, node, &ran_on));
+  thread.join();
+  EXPECT_EQ(node, ran_on);
+
+  NodeMemory memory(100000, node, false);
+  ASSERT_TRUE(memory.data() != NULL);
+  EXPECT_EQ(0U, memory.size() % sysconf(_SC_PAGESIZE));
+  EXPECT_LE(100000U, memory.size());
+  const char* bytes = static_cast<const char*>(memory.data());
+  EXPECT_EQ(0, bytes[0]);
+  EXPECT_EQ(0, bytes[memory.size() - 1]);
+  // Where the kernel tells.
+  const int placed = ib::numa::NodeOfAddress(bytes);
+  EXPECT_TRUE(placed == node || placed == -1) << placed;
+
+  // Hugepages if the pool has them, normal pages otherwise.
+  NodeMemory huge(100000, node, true);
+  EXPECT_EQ(0U, huge.size() % (huge.huge() ? 2 << 20 : 4096));
+  static_cast<char*>(huge.data())[huge.size() - 1] = 1;
+}
+
+} // namespace
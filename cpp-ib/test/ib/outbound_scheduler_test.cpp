@@ -0,0 +1,175 @@
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <Shared/Contract.h>
+#include <Shared/Order.h>
+
+#include "utils.hpp"
+#include "ib/outbound_scheduler.hpp"
+#include "loopback_client.hpp"
+
+using namespace std;
+using ib::OutboundScheduler;
+using ib::testing::LoopbackClient;
+using lab616::utils::now_micros;
+
+namespace {
+
+// Records the requests that reach the client.
+class RecordingClient : public LoopbackClient
+{
+ public:
+  RecordingClient() : LoopbackClient(NULL) {}
+
+  void reqMktData(TickerId id, const Contract& contract,
+                  const IBString& genericTicks, bool snapshot)
+  {
+    Record("reqMktData", id, contract.symbol);
+  }
+  void cancelMktData(TickerId id) { Record("cancelMktData", id); }
+  void placeOrder(OrderId id, const Contract& contract, const Order& order)
+  {
+    Record("placeOrder", id, contract.symbol);
+  }
+  void cancelOrder(OrderId id) { Record("cancelOrder", id); }
+  void reqContractDetails(int reqId, const Contract& contract)
+  {
+    Record("reqContractDetails", reqId, contract.symbol);
+  }
+
+  vector<string> calls;
+
+ private:
+  void Record(const char* call, long id, const string& symbol = "")
+  {
+    ostringstream s;
+    s << call << " " << id;
+    if (!symbol.empty()) s << " " << symbol;
+    calls.push_back(s.str());
+  }
+};
+
+Contract Stock(const string& symbol)
+{
+  Contract contract;
+  contract.symbol = symbol;
+  contract.secType = "STK";
+  return contract;
+}
+
+TEST(OutboundSchedulerTest, SendsByLaneWithinTheRate)
+{
+  // 10 a second, 2 at once.
+  OutboundScheduler scheduler(10, 2);
+  RecordingClient client;
+  scheduler.SetClient(&client);
+
+  scheduler.reqContractDetails(1, Stock("IBM"));
+  for (int i = 0; i < 5; ++i) {
+    ostringstream symbol;
+    symbol << "S" << i;
+    scheduler.reqMktData(100 + i, Stock(symbol.str()), "", false);
+  }
+  scheduler.cancelOrder(7);
+
+  int64_t now = now_micros();
+  EXPECT_EQ(100000, scheduler.Dispatch(now));
+  ASSERT_EQ(2U, client.calls.size());
+  EXPECT_EQ("cancelOrder 7", client.calls[0]);
+  EXPECT_EQ("reqMktData 100 S0", client.calls[1]);
+
+  // Canceled before it went out: neither is sent.
+  scheduler.cancelMktData(103);
+
+  EXPECT_EQ(50000, scheduler.Dispatch(now + 50000));
+  EXPECT_EQ(2U, client.calls.size());
+  scheduler.Dispatch(now + 200000);
+  ASSERT_EQ(4U, client.calls.size());
+  EXPECT_EQ("reqMktData 101 S1", client.calls[2]);
+  EXPECT_EQ("reqMktData 102 S2", client.calls[3]);
+  EXPECT_EQ(-1, scheduler.Dispatch(now + 1000000));
+  ASSERT_EQ(6U, client.calls.size());
+  EXPECT_EQ("reqMktData 104 S4", client.calls[4]);
+  EXPECT_EQ("reqContractDetails 1 IBM", client.calls[5]);
+
+  OutboundScheduler::LaneStats stats =
+      scheduler.GetStats(OutboundScheduler::MARKET_DATA);
+  EXPECT_EQ(5U, stats.submitted);
+  EXPECT_EQ(4U, stats.sent);
+  EXPECT_EQ(1U, stats.dropped);
+  EXPECT_EQ(0U, stats.queued);
+  EXPECT_GE(stats.max_delay_micros, 1000000 - 1000);
+  EXPECT_EQ(1U, scheduler.GetStats(OutboundScheduler::ORDERS).sent);
+
+  // Sent already, so the cancel goes out.
+  scheduler.cancelMktData(100);
+  scheduler.Dispatch(now + 2000000);
+  EXPECT_EQ("cancelMktData 100", client.calls.back());
+}
+
+TEST(OutboundSchedulerTest, CancelOrderDropsItsQueuedOrder)
+{
+  OutboundScheduler scheduler(10, 1);
+  RecordingClient client;
+
+  // Held without a client.
+  scheduler.placeOrder(5, Stock("IBM"), Order());
+  scheduler.placeOrder(6, Stock("MSFT"), Order());
+  EXPECT_EQ(-1, scheduler.Dispatch(now_micros()));
+  scheduler.cancelOrder(5);
+
+  scheduler.SetClient(&client);
+  int64_t now = now_micros();
+  for (int i = 1; i <= 3; ++i) scheduler.Dispatch(now + i * 100000);
+  ASSERT_EQ(2U, client.calls.size());
+  EXPECT_EQ("placeOrder 6 MSFT", client.calls[0]);
+  EXPECT_EQ("cancelOrder 5", client.calls[1]);
+  EXPECT_EQ(1U, scheduler.GetStats(OutboundScheduler::ORDERS).dropped);
+}
+
+TEST(OutboundSchedulerTest, DisconnectDropsTheRequestsAskedAgain)
+{
+  OutboundScheduler scheduler(10, 1);
+  RecordingClient client;
+
+  scheduler.placeOrder(5, Stock("IBM"), Order());
+  scheduler.reqMktData(100, Stock("IBM"), "", false);
+  scheduler.reqContractDetails(1, Stock("IBM"));
+  scheduler.OnDisconnect();
+
+  // Only the order reaches the next connection.
+  scheduler.SetClient(&client);
+  int64_t now = now_micros();
+  for (int i = 1; i <= 3; ++i) scheduler.Dispatch(now + i * 100000);
+  ASSERT_EQ(1U, client.calls.size());
+  EXPECT_EQ("placeOrder 5 IBM", client.calls[0]);
+  OutboundScheduler::LaneStats stats =
+      scheduler.GetStats(OutboundScheduler::MARKET_DATA);
+  EXPECT_EQ(1U, stats.dropped);
+  EXPECT_EQ(0U, stats.queued);
+  EXPECT_EQ(1U, scheduler.GetStats(OutboundScheduler::REFERENCE).dropped);
+}
+
+TEST(OutboundSchedulerTest, SendsFromItsThread)
+{
+  OutboundScheduler scheduler(1000, 100);
+  RecordingClient client;
+  scheduler.SetClient(&client);
+  scheduler.Start();
+  for (int i = 0; i < 150; ++i) {
+    scheduler.reqMktData(i, Stock("IBM"), "", false);
+  }
+  for (int i = 0; i < 100 &&
+           scheduler.GetStats(OutboundScheduler::MARKET_DATA).queued; ++i) {
+    lab616::utils::sleep_micros(10000);
+  }
+  scheduler.Stop();
+  EXPECT_EQ(150U, client.calls.size());
+}
+
+} // namespace
@@ -0,0 +1,542 @@
+
+// Performance regression suite: the hot paths from the wire to the
+// subscribers, measured on fixed inputs and checked against the
+// baselines in perf_baselines.txt (see perf_suite.hpp).
+//
+//   Decode        the 9.64 codec over a market data mix, to an EWrapper;
+//   Dispatch      BackPlane::OnBid to four receivers;
+//   Logging       LoggingEWrapper::tickPrice with the events logged
+//                 (disabled, no baseline yet);
+//   Parse         logger lines into TickEvents, as the logreader does;
+//   Replay        a strategy capture into a fresh strategy;
+//   Publish       TickEvents as the logreader's frames over a ZMQ PUB
+//                 socket, to a subscriber.
+//
+// The inputs are synthetic and fixed, so runs compare; --perf_tick_log
+// and --perf_capture measure parsing and replay on captured ones
+// instead.  Every result is appended to --perf_results as JSON, and a
+// test fails when its path regressed, or has no baseline.  Baselines
+// are scaled to the box by the calibration loop of perf_suite.hpp:
+// after a deliberate change, run with --perf_record to rewrite them,
+// and commit the file.
+//
+// The calibration loop is integer multiplies in registers, so it
+// tracks the clock and the core and nothing else.  Decode, Dispatch
+// and Replay are mostly that; Parse allocates a string and a message
+// per line and Publish is bound by the ZMQ I/O thread and the kernel,
+// so their scaled baselines are only as good as the box's memory and
+// kernel are like the recording one's.  Compare those two on the box
+// that recorded them, or record again when it changes.
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+#include <zmq.hpp>
+
+#include "messaging.hpp"
+#include "utils.hpp"
+#include "ib/adapters.hpp"
+#include "ib/backplane.hpp"
+#include "ib/perf_constants.h"
+#include "ib/strategy_capture.hpp"
+#include "ib/tick_log.hpp"
+#include "ib/ticker_id.hpp"
+#include "ib/wire/api_traits.hpp"
+#include "ib/wire/decoder.hpp"
+#include "perf_suite.hpp"
+
+DEFINE_string(perf_baselines, PERF_BASELINES,
+              "Baselines to compare with, or to rewrite with --perf_record.");
+DEFINE_string(perf_results, "perf_results.json",
+              "File the results are written to, one JSON object per line.");
+DEFINE_bool(perf_record, false,
+            "Records the results as the baselines instead of failing.");
+DEFINE_int32(perf_runs, 9, "Measured runs of each benchmark.");
+DEFINE_double(perf_tolerance, 0.15,
+              "Slowdown over the baseline always allowed, as a fraction.");
+DEFINE_double(perf_noise, 3.0,
+              "Spreads of the runs allowed on top of the tolerance.");
+DEFINE_string(perf_tick_log, "",
+              "Logger output to parse instead of synthetic lines.");
+DEFINE_string(perf_capture, "",
+              "Strategy capture to replay instead of a synthetic one.");
+
+using namespace std;
+using ib::testing::CalibrationLoop;
+using ib::testing::Measure;
+using ib::testing::PerfResult;
+using ib::testing::PerfSuite;
+using lab616::utils::now_micros;
+
+namespace {
+
+const char* kSymbols[] = {
+  "AAPL", "GOOG", "MSFT", "IBM", "INTC", "CSCO", "ORCL", "AMZN"
+};
+const int kSymbolCount = sizeof(kSymbols) / sizeof(kSymbols[0]);
+
+const char kBaselinesHeader[] =
+    "# Written by perf_regression --perf_record; per operation, in ns.\n"
+    "# name median_ns spread_ns; the others scale with calibrate.\n";
+
+PerfSuite* Suite()
+{
+  static PerfSuite* suite = NULL;
+  if (!suite) {
+    suite = new PerfSuite(FLAGS_perf_tolerance, FLAGS_perf_noise);
+    if (!suite->LoadBaselines(FLAGS_perf_baselines)) {
+      LOG(WARNING) << "No baselines in " << FLAGS_perf_baselines;
+    }
+  }
+  return suite;
+}
+
+void Check(const PerfResult& result)
+{
+  PerfSuite::Status status = Suite()->Check(result);
+  cout << result.name << ": " << result.median_ns << " ns/op +- "
+       << result.spread_ns << " (" << PerfSuite::StatusName(status) << ")"
+       << endl;
+  if (FLAGS_perf_record) return;
+  EXPECT_NE(PerfSuite::NEW, status)
+      << result.name << " has no baseline in " << FLAGS_perf_baselines
+      << "; record one with --perf_record.";
+  EXPECT_NE(PerfSuite::REGRESSED, status)
+      << result.name << " regressed: " << result.median_ns
+      << " ns/op over a limit of " << Suite()->limit_ns();
+}
+
+// Calibrates before the first benchmark, and writes the report, and
+// the baselines when recording, once every benchmark ran.
+class PerfEnvironment : public ::testing::Environment
+{
+ public:
+  void SetUp()
+  {
+    CalibrationLoop loop(1 << 24);
+    if (Suite()->Calibrate(Measure(PerfSuite::Calibration(), loop.ops,
+                                   FLAGS_perf_runs, loop))) {
+      cout << "This box takes " << Suite()->scale()
+           << " times the baselines'." << endl;
+    } else {
+      LOG(WARNING) << "No calibration in " << FLAGS_perf_baselines
+                   << ", baselines are not scaled.";
+    }
+  }
+
+  void TearDown()
+  {
+    const string report = Suite()->Report();
+    if (!FLAGS_perf_results.empty()) {
+      ofstream out(FLAGS_perf_results.c_str());
+      out << report;
+      if (!out.good()) {
+        LOG(ERROR) << "Cannot write " << FLAGS_perf_results;
+      }
+    }
+    if (FLAGS_perf_record &&
+        !Suite()->WriteBaselines(FLAGS_perf_baselines, kBaselinesHeader)) {
+      LOG(ERROR) << "Cannot write " << FLAGS_perf_baselines;
+    }
+  }
+};
+
+::testing::Environment* const perf_environment =
+    ::testing::AddGlobalTestEnvironment(new PerfEnvironment);
+
+string TempPath(const string& name)
+{
+  ostringstream path;
+  path << "/tmp/" << name << "." << getpid();
+  return path.str();
+}
+
+////////////////////////////////////////////////////////////////////
+// Decode
+
+class CountingEWrapper : public ib::adapter::LoggingEWrapper
+{
+ public:
+  CountingEWrapper() : LoggingEWrapper("127.0.0.1", 0, 0), count(0), sum(0) {}
+
+  void tickPrice(TickerId, TickType, double price, int)
+  {
+    count++;
+    sum += price;
+  }
+  void tickSize(TickerId, TickType, int size) { count++; sum += size; }
+  void tickGeneric(TickerId, TickType, double value) { count++; sum += value; }
+  void tickString(TickerId, TickType, const IBString&) { count++; }
+
+  long count;
+  double sum;
+};
+
+void Field(const string& value, string* out)
+{
+  out->append(value);
+  out->push_back('\0');
+}
+
+// Quotes with their sizes, trades, volume and last-trade timestamps.
+string MarketDataStream(int messages)
+{
+  string out;
+  char id[16], price[32], volume[32];
+  for (int i = 0; i < messages; ++i) {
+    snprintf(id, sizeof(id), "%d", 1000 + i % 50);
+    snprintf(price, sizeof(price), "%.2f", 100 + (i % 1000) / 100.);
+    switch (i % 5) {
+      case 0:  // BID
+      case 1:  // ASK
+      case 2:  // LAST
+        Field("1", &out); Field("6", &out); Field(id, &out);
+        Field(i % 5 == 0 ? "1" : i % 5 == 1 ? "2" : "4", &out);
+        Field(price, &out); Field("300", &out); Field("1", &out);
+        break;
+      case 3:  // VOLUME
+        snprintf(volume, sizeof(volume), "%d", 100000 + i);
+        Field("2", &out); Field("6", &out); Field(id, &out); Field("8", &out);
+        Field(volume, &out);
+        break;
+      case 4:  // LAST_TIMESTAMP
+        Field("46", &out); Field("6", &out); Field(id, &out); Field("45", &out);
+        Field("1294932600", &out);
+        break;
+    }
+  }
+  return out;
+}
+
+struct DecodeBenchmark
+{
+  explicit DecodeBenchmark(const string& s) : stream(s), decoder(&wrapper) {}
+
+  void operator()()
+  {
+    bool unhandled;
+    decoder.DecodeAll(stream.data(), stream.data() + stream.size(),
+                      &unhandled);
+  }
+
+  const string stream;
+  CountingEWrapper wrapper;
+  ib::wire::Decoder<ib::wire::Api964, CountingEWrapper> decoder;
+};
+
+TEST(PerfRegression, Decode)
+{
+  const int messages = 200000;
+  DecodeBenchmark benchmark(MarketDataStream(messages));
+  Check(Measure("decode", messages, FLAGS_perf_runs, benchmark));
+  // A price with its size is two callbacks.
+  EXPECT_EQ((FLAGS_perf_runs + 1) * 8L * messages / 5,
+            benchmark.wrapper.count);
+}
+
+////////////////////////////////////////////////////////////////////
+// Dispatch
+
+struct SumReceiver : public ib::Receiver<BidAsk>
+{
+  SumReceiver() : sum(0) {}
+  virtual void operator()(const BidAsk& bid_ask)
+  {
+    sum += bid_ask.bid().price();
+  }
+  double sum;
+};
+
+struct DispatchBenchmark
+{
+  DispatchBenchmark(ib::BackPlane* b, int n) : backplane(b), events(n) {}
+
+  void operator()()
+  {
+    for (int i = 0; i < events; ++i) {
+      backplane->OnBid(i, 1000 + i % 50, 100 + (i % 1000) / 100.);
+    }
+  }
+
+  ib::BackPlane* backplane;
+  const int events;
+};
+
+TEST(PerfRegression, Dispatch)
+{
+  const int events = 1000000;
+  boost::scoped_ptr<ib::BackPlane> backplane(ib::BackPlane::Create());
+  SumReceiver receivers[4];
+  for (int i = 0; i < 4; ++i) backplane->Register(&receivers[i]);
+  DispatchBenchmark benchmark(backplane.get(), events);
+  Check(Measure("dispatch", events, FLAGS_perf_runs, benchmark));
+  EXPECT_LT(0, receivers[3].sum);
+}
+
+////////////////////////////////////////////////////////////////////
+// Logging
+
+struct LoggingBenchmark
+{
+  explicit LoggingBenchmark(int n) : wrapper("127.0.0.1", 0, 0), events(n) {}
+
+  void operator()()
+  {
+    for (int i = 0; i < events; ++i) {
+      wrapper.tickPrice(1000 + i % 50, i % 2 ? ASK : BID,
+                        100 + (i % 1000) / 100., 1);
+    }
+  }
+
+  ib::adapter::LoggingEWrapper wrapper;
+  const int events;
+};
+
+// Disabled until a baseline is recorded against a glog that writes
+// the log files: a build without one measures nothing, and a test
+// without a baseline fails.
+TEST(PerfRegression, DISABLED_Logging)
+{
+  // The events are logged at the level a logger runs with, to the log
+  // files only.
+  const int v = FLAGS_v;
+  const bool logtostderr = FLAGS_logtostderr;
+  const bool alsologtostderr = FLAGS_alsologtostderr;
+  FLAGS_v = 1;
+  FLAGS_logtostderr = false;
+  FLAGS_alsologtostderr = false;
+  const int events = 50000;
+  LoggingBenchmark benchmark(events);
+  PerfResult result = Measure("logging", events, FLAGS_perf_runs, benchmark);
+  FLAGS_v = v;
+  FLAGS_logtostderr = logtostderr;
+  FLAGS_alsologtostderr = alsologtostderr;
+  Check(result);
+}
+
+////////////////////////////////////////////////////////////////////
+// Parse
+
+// Lines as LoggingEWrapper writes them, with some that are not
+// market data.
+void LoggerLines(int n, vector<string>* lines)
+{
+  const int64_t open = 1295015400000000LL;
+  for (int i = 0; i < n; ++i) {
+    ostringstream line;
+    line << "I0114 09:30:00.123456  1234 adapters.cpp:100] "
+         << "cid=0,ts_utc=" << open + i * 100 << ",ts=" << open + i * 100 + 4;
+    const int id = ib::internal::SymbolToTickerId(kSymbols[i % kSymbolCount]);
+    switch (i % 4) {
+      case 0:
+        line << ",event=tickPrice,tickerId=" << id << ",field=BID,price="
+             << 100 + (i % 1000) / 100. << ",canAutoExecute=1";
+        break;
+      case 1:
+        line << ",event=tickSize,tickerId=" << id << ",field=ASK_SIZE,size="
+             << 100 * (i % 10);
+        break;
+      case 2:
+        line << ",event=tickPrice,tickerId=" << id << ",field=LAST,price="
+             << 100 + (i % 1000) / 100. << ",canAutoExecute=0";
+        break;
+      case 3:
+        line << ",event=tickString,tickerId=" << id
+             << ",tickType=45,value=1294932600";
+        break;
+    }
+    lines->push_back(line.str());
+  }
+}
+
+bool ReadLines(const string& path, vector<string>* lines)
+{
+  ifstream in(path.c_str());
+  if (!in) return false;
+  string line;
+  while (getline(in, line)) lines->push_back(line);
+  return true;
+}
+
+struct ParseBenchmark
+{
+  explicit ParseBenchmark(const vector<string>& l) : lines(l), parsed(0) {}
+
+  void operator()()
+  {
+    ib::internal::TickEvent event;
+    for (size_t i = 0; i < lines.size(); ++i) {
+      if (ib::internal::ParseTickLine(lines[i], &event)) parsed++;
+    }
+  }
+
+  const vector<string>& lines;
+  long parsed;
+};
+
+TEST(PerfRegression, Parse)
+{
+  vector<string> lines;
+  if (FLAGS_perf_tick_log.empty()) {
+    LoggerLines(20000, &lines);
+  } else {
+    ASSERT_TRUE(ReadLines(FLAGS_perf_tick_log, &lines))
+        << "Cannot read " << FLAGS_perf_tick_log;
+    ASSERT_FALSE(lines.empty());
+  }
+  ParseBenchmark benchmark(lines);
+  Check(Measure("parse", lines.size(), FLAGS_perf_runs, benchmark));
+  EXPECT_LT(0, benchmark.parsed);
+}
+
+////////////////////////////////////////////////////////////////////
+// Replay
+
+struct SumStrategy : public ib::Receiver<BidAsk>, public ib::Receiver<Last>
+{
+  SumStrategy() : sum(0) {}
+
+  void operator()(const BidAsk& bid_ask) { sum += bid_ask.bid().price(); }
+  void operator()(const Last& last) { sum += last.price(); }
+
+  ib::StrategyReceivers receivers()
+  {
+    ib::StrategyReceivers receivers;
+    receivers.bid_ask = this;
+    receivers.last = this;
+    return receivers;
+  }
+
+  double sum;
+};
+
+// Captures a session of quotes and trades handed to a strategy.
+bool WriteCapture(const string& path, int events)
+{
+  SumStrategy strategy;
+  ib::StrategyCapture capture(path, strategy.receivers(), 1 << 17);
+  if (!capture.Start()) return false;
+  BidAsk bid_ask;
+  Last last;
+  for (int i = 0; i < events; ++i) {
+    const double price = 100 + (i % 1000) / 100.;
+    if (i % 3 == 2) {
+      last.set_time_stamp(i);
+      last.set_id(1000 + i % 50);
+      last.set_price(price);
+      last.set_size(100);
+      capture(last);
+    } else {
+      bid_ask.Clear();
+      bid_ask.set_time_stamp(i);
+      bid_ask.set_id(1000 + i % 50);
+      bid_ask.mutable_bid()->set_price(price);
+      bid_ask.mutable_bid()->set_size(300);
+      capture(bid_ask);
+    }
+  }
+  capture.Stop();
+  return capture.dropped() == 0;
+}
+
+struct ReplayBenchmark
+{
+  explicit ReplayBenchmark(const ib::CaptureReplay& r) : replay(r) {}
+
+  void operator()() { replay.Replay(strategy.receivers()); }
+
+  const ib::CaptureReplay& replay;
+  SumStrategy strategy;
+};
+
+TEST(PerfRegression, Replay)
+{
+  string path = FLAGS_perf_capture;
+  if (path.empty()) {
+    path = TempPath("perf_regression_capture");
+    ASSERT_TRUE(WriteCapture(path, 100000));
+  }
+  ib::CaptureReplay replay;
+  ASSERT_TRUE(replay.Load(path));
+  if (FLAGS_perf_capture.empty()) unlink(path.c_str());
+  ASSERT_FALSE(replay.events().empty());
+  ReplayBenchmark benchmark(replay);
+  Check(Measure("replay", replay.events().size(), FLAGS_perf_runs,
+                benchmark));
+  EXPECT_LT(0, benchmark.strategy.sum);
+}
+
+////////////////////////////////////////////////////////////////////
+// Publish
+
+struct PublishBenchmark
+{
+  PublishBenchmark(zmq::socket_t* p, zmq::socket_t* s,
+                   const vector<ib::internal::TickEvent>& e)
+      : publisher(p), subscriber(s), events(e), received(0) {}
+
+  void operator()()
+  {
+    for (size_t i = 0; i < events.size(); ++i) {
+      const ib::internal::TickEvent& event = events[i];
+      lab616::messaging::Message message;
+      message.add(event.symbol);
+      message.add(event.event);
+      message.add(event.ts);
+      message.add(event.value);
+      message.send(*publisher);
+
+      // Drained as it goes, so the pipe does not grow.
+      string symbol, field;
+      uint64_t ts;
+      double value;
+      lab616::messaging::receive(*subscriber, &symbol);
+      lab616::messaging::receive(*subscriber, &field);
+      lab616::messaging::receive(*subscriber, ts);
+      lab616::messaging::receive(*subscriber, value);
+      received++;
+    }
+  }
+
+  zmq::socket_t* publisher;
+  zmq::socket_t* subscriber;
+  const vector<ib::internal::TickEvent>& events;
+  long received;
+};
+
+TEST(PerfRegression, Publish)
+{
+  vector<string> lines;
+  LoggerLines(20000, &lines);
+  vector<ib::internal::TickEvent> events;
+  ib::internal::TickEvent event;
+  for (size_t i = 0; i < lines.size(); ++i) {
+    if (ib::internal::ParseTickLine(lines[i], &event)) events.push_back(event);
+  }
+
+  zmq::context_t context(1);
+  zmq::socket_t publisher(context, ZMQ_PUB);
+  publisher.bind("inproc://perf_regression");
+  zmq::socket_t subscriber(context, ZMQ_SUB);
+  subscriber.setsockopt(ZMQ_SUBSCRIBE, "", 0);
+  subscriber.connect("inproc://perf_regression");
+
+  PublishBenchmark benchmark(&publisher, &subscriber, events);
+  Check(Measure("publish", events.size(), FLAGS_perf_runs, benchmark));
+  EXPECT_EQ(static_cast<long>((FLAGS_perf_runs + 1) * events.size()),
+            benchmark.received);
+}
+
+} // namespace
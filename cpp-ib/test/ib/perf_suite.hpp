@@ -0,0 +1,278 @@
+#ifndef IB_TEST_PERF_SUITE_H_
+#define IB_TEST_PERF_SUITE_H_
+
+// Measurement of hot paths against stored baselines, for the
+// performance regression suite.
+//
+// A benchmark is run a number of times after a warmup; its result is
+// the median time per operation over the runs, and the median
+// absolute deviation of the runs is its noise.  It regresses when
+//
+//   median > baseline * (1 + tolerance) + noise * max(spread, baseline spread)
+//
+// so a noisy path needs a larger slowdown to fail than a steady one,
+// and a steady one still has the tolerance for what the runs do not
+// see, e.g. another box of the same kind.
+//
+// Baselines are in the ns of the box that recorded them, which also
+// recorded the time of a fixed loop of integer work, "calibrate".
+// The loop is timed again before the checks and the baselines are
+// scaled by the ratio, so a box twice as fast is held to half the
+// times.  The loop follows the clock and the core only; paths bound
+// by memory or the kernel scale less well, and the tolerance is for
+// the rest.
+//
+// Baselines are one line per benchmark, "name median_ns spread_ns",
+// with # comments.  Results are written one JSON object per line.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "utils.hpp"
+
+namespace ib {
+namespace testing {
+
+struct PerfResult
+{
+  PerfResult() : ops(0), median_ns(0), spread_ns(0), min_ns(0) {}
+
+  std::string name;
+  int64_t ops;          // Per run.
+  double median_ns;     // Per operation, over the runs.
+  double spread_ns;     // Median absolute deviation of the runs.
+  double min_ns;
+};
+
+struct PerfBaseline
+{
+  PerfBaseline() : median_ns(0), spread_ns(0) {}
+  PerfBaseline(double median, double spread)
+      : median_ns(median), spread_ns(spread) {}
+
+  double median_ns;
+  double spread_ns;
+};
+
+inline double Median(std::vector<double> values)
+{
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  const size_t mid = values.size() / 2;
+  return values.size() % 2 ? values[mid] :
+      (values[mid - 1] + values[mid]) / 2;
+}
+
+// The loop baselines are scaled by: a chain of dependent multiplies
+// and adds, which no compiler or core shortens.
+struct CalibrationLoop
+{
+  explicit CalibrationLoop(int64_t n) : ops(n), state(1) {}
+
+  void operator()()
+  {
+    uint64_t x = state;
+    for (int64_t i = 0; i < ops; ++i) {
+      x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    }
+    state = x;
+  }
+
+  const int64_t ops;
+  volatile uint64_t state;
+};
+
+// Runs the benchmark, which does ops operations per call, once to
+// warm up and then runs times.
+template <typename Benchmark>
+PerfResult Measure(const std::string& name, int64_t ops, int runs,
+                   Benchmark& benchmark)
+{
+  benchmark();
+  std::vector<double> ns;
+  for (int i = 0; i < runs; ++i) {
+    const int64_t start = lab616::utils::now_micros();
+    benchmark();
+    ns.push_back((lab616::utils::now_micros() - start) * 1000. / ops);
+  }
+  PerfResult result;
+  result.name = name;
+  result.ops = ops;
+  result.median_ns = Median(ns);
+  result.min_ns = *std::min_element(ns.begin(), ns.end());
+  std::vector<double> deviations;
+  for (size_t i = 0; i < ns.size(); ++i) {
+    deviations.push_back(ns[i] > result.median_ns ?
+                         ns[i] - result.median_ns : result.median_ns - ns[i]);
+  }
+  result.spread_ns = Median(deviations);
+  return result;
+}
+
+class PerfSuite
+{
+ public:
+  enum Status { NEW, OK, IMPROVED, REGRESSED };
+
+  // Name of the calibration in the baselines.
+  static const char* Calibration() { return "calibrate"; }
+
+  PerfSuite(double tolerance, double noise)
+      : tolerance_(tolerance), noise_(noise), scale_(1) {}
+
+  // Returns false if the file cannot be read; a malformed line is
+  // skipped.
+  bool LoadBaselines(const std::string& path)
+  {
+    std::ifstream in(path.c_str());
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+      if (line.empty() || line[0] == '#') continue;
+      std::istringstream fields(line);
+      std::string name;
+      PerfBaseline baseline;
+      if (fields >> name >> baseline.median_ns >> baseline.spread_ns) {
+        baselines_[name] = baseline;
+      }
+    }
+    return true;
+  }
+
+  // Takes the time of the CalibrationLoop on this box, against the
+  // one of the baselines.  Returns false if they have none; they are
+  // then compared unscaled.
+  bool Calibrate(const PerfResult& result)
+  {
+    Entry entry;
+    entry.result = result;
+    entry.status = NEW;
+    std::map<std::string, PerfBaseline>::const_iterator found =
+        baselines_.find(result.name);
+    if (found != baselines_.end() && found->second.median_ns > 0 &&
+        result.median_ns > 0) {
+      scale_ = result.median_ns / found->second.median_ns;
+      entry.baseline = found->second;
+      entry.status = OK;
+    }
+    entries_.push_back(entry);
+    return entry.status == OK;
+  }
+
+  // This box over the one of the baselines, 1 if not calibrated.
+  double scale() const { return scale_; }
+
+  // Compares the result with its baseline, scaled, and keeps both for
+  // the report.
+  Status Check(const PerfResult& result)
+  {
+    Entry entry;
+    entry.result = result;
+    entry.status = NEW;
+    std::map<std::string, PerfBaseline>::const_iterator found =
+        baselines_.find(result.name);
+    if (found != baselines_.end()) {
+      entry.baseline = PerfBaseline(found->second.median_ns * scale_,
+                                    found->second.spread_ns * scale_);
+      const double slack = noise_ *
+          std::max(result.spread_ns, entry.baseline.spread_ns);
+      entry.limit_ns = entry.baseline.median_ns * (1 + tolerance_) + slack;
+      if (result.median_ns > entry.limit_ns) {
+        entry.status = REGRESSED;
+      } else if (result.median_ns <
+                 entry.baseline.median_ns * (1 - tolerance_) - slack) {
+        entry.status = IMPROVED;
+      } else {
+        entry.status = OK;
+      }
+    }
+    entries_.push_back(entry);
+    return entry.status;
+  }
+
+  // Upper bound of the last result checked, 0 if it had no baseline.
+  double limit_ns() const
+  {
+    return entries_.empty() ? 0 : entries_.back().limit_ns;
+  }
+
+  // One JSON object per result checked.
+  std::string Report() const
+  {
+    std::ostringstream out;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      const Entry& entry = entries_[i];
+      out << "{\"name\":\"" << entry.result.name << "\""
+          << ",\"ops\":" << entry.result.ops
+          << ",\"median_ns\":" << entry.result.median_ns
+          << ",\"spread_ns\":" << entry.result.spread_ns
+          << ",\"min_ns\":" << entry.result.min_ns;
+      if (entry.status != NEW) {
+        out << ",\"baseline_ns\":" << entry.baseline.median_ns;
+        if (entry.limit_ns > 0) out << ",\"limit_ns\":" << entry.limit_ns;
+      }
+      out << ",\"status\":\"" << StatusName(entry.status) << "\"}\n";
+    }
+    return out.str();
+  }
+
+  // The baselines loaded, scaled to this box, with the results
+  // checked and the calibration in their place.
+  bool WriteBaselines(const std::string& path, const std::string& header)
+  {
+    for (std::map<std::string, PerfBaseline>::iterator itr =
+             baselines_.begin(); itr != baselines_.end(); ++itr) {
+      itr->second.median_ns *= scale_;
+      itr->second.spread_ns *= scale_;
+    }
+    scale_ = 1;
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      const PerfResult& result = entries_[i].result;
+      baselines_[result.name] = PerfBaseline(result.median_ns,
+                                             result.spread_ns);
+    }
+    std::ofstream out(path.c_str());
+    if (!out) return false;
+    out << header;
+    for (std::map<std::string, PerfBaseline>::const_iterator itr =
+             baselines_.begin(); itr != baselines_.end(); ++itr) {
+      out << itr->first << ' ' << itr->second.median_ns << ' '
+          << itr->second.spread_ns << '\n';
+    }
+    return out.good();
+  }
+
+  static const char* StatusName(Status status)
+  {
+    static const char* kNames[] = { "new", "ok", "improved", "regressed" };
+    return kNames[status];
+  }
+
+ private:
+  struct Entry
+  {
+    Entry() : limit_ns(0), status(NEW) {}
+
+    PerfResult result;
+    PerfBaseline baseline;
+    double limit_ns;
+    Status status;
+  };
+
+  const double tolerance_;
+  const double noise_;
+  double scale_;
+  std::map<std::string, PerfBaseline> baselines_;
+  std::vector<Entry> entries_;
+};
+
+} // namespace testing
+} // namespace ib
+
+#endif // IB_TEST_PERF_SUITE_H_
@@ -0,0 +1,163 @@
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "utils.hpp"
+#include "ib/backplane.hpp"
+#include "ib/quote_stream.hpp"
+
+using namespace std;
+using ib::ConflatedQuotes;
+using ib::QuoteSender;
+using ib::QuoteTable;
+
+namespace {
+
+TEST(QuoteStreamTest, HandshakeKey)
+{
+  // The example of RFC 6455.
+  EXPECT_EQ("s3pPLMBiTxaQ9kYGzzhZRbK+xOo=",
+            ib::websocket::AcceptKey("dGhlIHNhbXBsZSBub25jZQ=="));
+}
+
+TEST(QuoteStreamTest, TextFrameLengths)
+{
+  string frame;
+  ib::websocket::TextFrame("Hello", &frame);
+  EXPECT_EQ(string("\x81\x05Hello"), frame);
+
+  frame.clear();
+  ib::websocket::TextFrame(string(300, 'x'), &frame);
+  ASSERT_EQ(4U + 300, frame.size());
+  EXPECT_EQ(126, frame[1]);
+  EXPECT_EQ(1, frame[2]);
+  EXPECT_EQ(44, frame[3]);
+
+  frame.clear();
+  ib::websocket::TextFrame(string(70000, 'x'), &frame);
+  ASSERT_EQ(10U + 70000, frame.size());
+  EXPECT_EQ(127, frame[1]);
+  EXPECT_EQ(string("\0\0\0\0\0\x01\x11\x70", 8), frame.substr(2, 8));
+}
+
+TEST(QuoteStreamTest, SendsLatestChangesOnce)
+{
+  QuoteTable table(64);
+  const int ibm = ib::signal::GetTickerId("IBM");
+  const int msft = ib::signal::GetTickerId("MSFT");
+  ConflatedQuotes quotes(&table);
+  quotes.Subscribe("IBM");
+  quotes.Subscribe("AAPL");  // Not in the table yet.
+  quotes.Subscribe("IBM");
+  EXPECT_EQ(2U, quotes.size());
+
+  table.Update(1, ibm, QuoteTable::BID, 100.25);
+  table.Update(2, ibm, QuoteTable::BID, 100.5);
+  table.Update(3, ibm, QuoteTable::BID_SIZE, 300);
+  table.Update(4, msft, QuoteTable::ASK, 25.5);  // Not subscribed.
+
+  string json;
+  EXPECT_EQ(1U, quotes.Delta(&json));
+  EXPECT_EQ("[{\"s\":\"IBM\",\"b\":100.5,\"bs\":300,\"a\":0,\"as\":0,"
+            "\"l\":0,\"ls\":0,\"t\":3}]", json);
+
+  json.clear();
+  EXPECT_EQ(0U, quotes.Delta(&json));
+  EXPECT_EQ("[]", json);
+
+  table.Update(5, ib::signal::GetTickerId("AAPL"), QuoteTable::LAST, 320);
+  table.Update(6, ibm, QuoteTable::ASK, 100.75);
+  json.clear();
+  EXPECT_EQ(2U, quotes.Delta(&json));
+  EXPECT_NE(string::npos, json.find("\"s\":\"IBM\",\"b\":100.5,\"bs\":300,"
+                                    "\"a\":100.75"));
+  EXPECT_NE(string::npos, json.find("\"s\":\"AAPL\""));
+}
+
+TEST(QuoteStreamTest, ParsesUpgrade)
+{
+  string target, key;
+  EXPECT_TRUE(ib::websocket::ParseUpgrade(
+      "GET /quotes?symbols=IBM,AAPL HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "Upgrade: websocket\r\n"
+      "sec-websocket-key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n",
+      &target, &key));
+  EXPECT_EQ("/quotes?symbols=IBM,AAPL", target);
+  EXPECT_EQ("dGhlIHNhbXBsZSBub25jZQ==", key);
+  EXPECT_FALSE(ib::websocket::ParseUpgrade(
+      "GET /quotes HTTP/1.1\r\nHost: localhost\r\n\r\n", &target, &key));
+  EXPECT_FALSE(ib::websocket::ParseUpgrade("POST / HTTP/1.1\r\n\r\n",
+                                           &target, &key));
+}
+
+// Reads what is there without blocking.
+string ReadAll(int fd)
+{
+  string out;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+    out.append(buffer, n);
+  }
+  return out;
+}
+
+TEST(QuoteStreamTest, SenderDoesNotWaitForSlowClients)
+{
+  QuoteTable table(64);
+  const int ibm = ib::signal::GetTickerId("IBM");
+  QuoteSender sender(100);
+  int fast[2], slow[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fast));
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, slow));
+  ConflatedQuotes* quotes = new ConflatedQuotes(&table);
+  quotes->Subscribe("IBM");
+  sender.Add(fast[0], quotes);
+  quotes = new ConflatedQuotes(&table);
+  quotes->Subscribe("IBM");
+  sender.Add(slow[0], quotes);
+  EXPECT_EQ(2U, sender.clients());
+
+  // The slow client has not read anything yet.
+  const string junk(4096, 'x');
+  size_t filled = 0;
+  while (send(slow[0], junk.data(), junk.size(), MSG_DONTWAIT) > 0) {
+    filled += junk.size();
+  }
+
+  table.Update(1, ibm, QuoteTable::BID, 100.25);
+  sender.SendRound();
+  string frame = ReadAll(fast[1]);
+  ASSERT_FALSE(frame.empty());
+  EXPECT_EQ('\x81', frame[0]);
+  EXPECT_NE(string::npos, frame.find("\"b\":100.25"));
+
+  // The fast client keeps getting frames.  The slow one finishes the
+  // frame it had started and then gets the latest quotes.
+  table.Update(2, ibm, QuoteTable::BID, 100.5);
+  sender.SendRound();
+  EXPECT_NE(string::npos, ReadAll(fast[1]).find("\"b\":100.5"));
+  string received = ReadAll(slow[1]);
+  for (int i = 0; i < 2; ++i) {
+    sender.SendRound();
+    received += ReadAll(slow[1]);
+  }
+  ASSERT_LT(filled, received.size());
+  EXPECT_EQ(filled, received.find_first_not_of('x'));
+  EXPECT_NE(string::npos, received.find("\"b\":100.5", filled));
+
+  // A client gone is dropped.
+  close(fast[1]);
+  sender.SendRound();
+  EXPECT_EQ(1U, sender.clients());
+  close(slow[1]);
+}
+
+} // namespace
@@ -0,0 +1,156 @@
+
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "ib/monitor/quote_grid.hpp"
+#include "ib/quote_table.hpp"
+#include "ib/ticker_id.hpp"
+
+using namespace std;
+using ib::Quote;
+using ib::QuoteTable;
+using ib::monitor::QuoteGrid;
+using ib::internal::SymbolToTickerId;
+
+namespace {
+
+TEST(QuoteTableTest, KeepsLatestValuesPerId)
+{
+  QuoteTable table(8);
+  int aapl = SymbolToTickerId("AAPL");
+  int goog = SymbolToTickerId("GOOG");
+
+  EXPECT_EQ(-1, table.Find(aapl));
+  EXPECT_TRUE(table.Update(1, aapl, QuoteTable::BID, 345.10));
+  EXPECT_TRUE(table.Update(2, goog, QuoteTable::ASK, 620.50));
+  EXPECT_TRUE(table.Update(3, aapl, QuoteTable::BID, 345.11));
+  EXPECT_TRUE(table.Update(4, aapl, QuoteTable::LAST_SIZE, 300));
+  EXPECT_EQ(2U, table.size());
+
+  int slot = table.Find(aapl);
+  ASSERT_EQ(0, slot);
+  Quote quote;
+  uint64_t version = table.Read(slot, &quote);
+  EXPECT_EQ(0U, version % 2);
+  EXPECT_EQ(aapl, quote.id);
+  EXPECT_EQ(345.11, quote.bid);
+  EXPECT_EQ(300, quote.last_size);
+  EXPECT_EQ(4, quote.ts);
+  EXPECT_EQ(3U, quote.updates);
+
+  EXPECT_EQ(version, table.version(slot));
+  table.Update(5, aapl, QuoteTable::ASK, 345.20);
+  EXPECT_NE(version, table.version(slot));
+}
+
+TEST(QuoteTableTest, RejectsNewIdsWhenFull)
+{
+  QuoteTable table(2);
+  EXPECT_TRUE(table.Update(1, 1, QuoteTable::BID, 1.));
+  EXPECT_TRUE(table.Update(1, 2, QuoteTable::BID, 1.));
+  EXPECT_FALSE(table.Update(1, 3, QuoteTable::BID, 1.));
+  EXPECT_TRUE(table.Update(1, 2, QuoteTable::ASK, 2.));
+}
+
+// The writer keeps bid == ask; a torn read would see them differ.
+struct Writer
+{
+  Writer(QuoteTable* t, int n) : table(t), n(n) {}
+  QuoteTable* table;
+  int n;
+  void operator()()
+  {
+    for (int i = 1; i <= n; ++i) {
+      table->Update(i, 42, QuoteTable::BID, i);
+      table->Update(i, 42, QuoteTable::ASK, i);
+    }
+  }
+};
+
+TEST(QuoteTableTest, ReadersSeeConsistentSnapshots)
+{
+  QuoteTable table(16);
+  table.Update(0, 42, QuoteTable::BID, 0);
+  table.Update(0, 42, QuoteTable::ASK, 0);
+
+  const int n = 200000;
+  boost::thread writer(Writer(&table, n));
+  Quote quote;
+  int torn = 0;
+  do {
+    table.Read(0, &quote);
+    // Between the two updates only the bid has moved.
+    if (quote.bid != quote.ask && quote.bid != quote.ask + 1) ++torn;
+  } while (quote.ask < n);
+  writer.join();
+  EXPECT_EQ(0, torn);
+}
+
+TEST(QuoteGridTest, RedrawsOnlyChangedCells)
+{
+  QuoteTable table(8);
+  vector<string> symbols;
+  symbols.push_back("AAPL");
+  symbols.push_back("GOOG");
+  QuoteGrid grid(&table, symbols, 500000);
+
+  // First frame draws everything.
+  vector<QuoteGrid::Cell> cells;
+  grid.Frame(0, &cells);
+  EXPECT_EQ(2U * QuoteGrid::NUM_COLUMNS, cells.size());
+  EXPECT_EQ("AAPL    ", cells[0].text);
+
+  // Nothing changed, nothing to draw.
+  cells.clear();
+  grid.Frame(100000, &cells);
+  EXPECT_EQ(0U, cells.size());
+
+  int aapl = SymbolToTickerId("AAPL");
+  table.Update(1, aapl, QuoteTable::BID, 345.10);
+  cells.clear();
+  grid.Frame(200000, &cells);
+  ASSERT_EQ(1U, cells.size());
+  EXPECT_EQ(0, cells[0].row);
+  EXPECT_EQ(QuoteGrid::BID, cells[0].column);
+  EXPECT_EQ(QuoteGrid::NORMAL, cells[0].style);
+  EXPECT_EQ("    345.10", cells[0].text);
+
+  // A move up flashes, then reverts once the flash expires.
+  table.Update(2, aapl, QuoteTable::BID, 345.12);
+  cells.clear();
+  grid.Frame(300000, &cells);
+  ASSERT_EQ(1U, cells.size());
+  EXPECT_EQ(QuoteGrid::UP, cells[0].style);
+  EXPECT_EQ("    345.12", cells[0].text);
+
+  cells.clear();
+  grid.Frame(700000, &cells);
+  EXPECT_EQ(0U, cells.size());
+
+  cells.clear();
+  grid.Frame(800000, &cells);
+  ASSERT_EQ(1U, cells.size());
+  EXPECT_EQ(QuoteGrid::NORMAL, cells[0].style);
+
+  // Rates are sampled once a second.
+  for (int i = 0; i < 10; ++i) {
+    table.Update(3 + i, aapl, QuoteTable::BID_SIZE, 100 + i);
+  }
+  cells.clear();
+  grid.Frame(1200000, &cells);
+  bool rate = false;
+  for (size_t i = 0; i < cells.size(); ++i) {
+    if (cells[i].column == QuoteGrid::RATE) {
+      rate = true;
+      EXPECT_EQ("    12.0", cells[i].text);
+    }
+  }
+  EXPECT_TRUE(rate);
+}
+
+} // namespace
@@ -0,0 +1,360 @@
+
+#include <dirent.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "ib/reference_data.hpp"
+#include "ib/xml_scanner.hpp"
+#include "loopback_client.hpp"
+
+using namespace std;
+using ib::ReferenceData;
+using ib::XmlAttributes;
+using ib::XmlScanner;
+using ib::testing::LoopbackClient;
+
+namespace {
+
+static string TempDir(const string& name)
+{
+  ostringstream path;
+  path << "/tmp/" << name << "." << getpid();
+  DIR* dir = opendir(path.str().c_str());
+  if (dir) {
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+      unlink((path.str() + "/" + entry->d_name).c_str());
+    }
+    closedir(dir);
+  }
+  mkdir(path.str().c_str(), 0755);
+  return path.str();
+}
+
+// Writes every event as a line.
+class RecordingHandler : public ib::XmlHandler
+{
+ public:
+  void StartElement(const string& name, const XmlAttributes& attributes)
+  {
+    out << "<" << name;
+    for (size_t i = 0; i < attributes.size(); ++i) {
+      out << " " << attributes.name(i) << "=" << attributes.value(i);
+    }
+    out << ">\n";
+  }
+  void EndElement(const string& name) { out << "</" << name << ">\n"; }
+  void Text(const string& text) { out << "[" << text << "]\n"; }
+
+  ostringstream out;
+};
+
+const char kSnapshot[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<ReportSnapshot Major=\"1\" Minor=\"0\" Revision=\"1\">\n"
+    "  <CoIDs>\n"
+    "    <CoID Type=\"RepNo\">05680</CoID>\n"
+    "    <CoID Type=\"CompanyName\">Apple Inc.</CoID>\n"
+    "  </CoIDs>\n"
+    "  <Issues>\n"
+    "    <Issue ID=\"1\" Type=\"C\" Desc=\"Common Stock\" Order=\"1\">\n"
+    "      <IssueID Type=\"Name\">Ordinary Shares</IssueID>\n"
+    "      <IssueID Type=\"Ticker\">AAPL</IssueID>\n"
+    "      <Exchange Code=\"NASD\" Country=\"USA\">NASDAQ</Exchange>\n"
+    "    </Issue>\n"
+    "  </Issues>\n"
+    "  <peerInfo><IndustryInfo>\n"
+    "    <Industry type=\"TRBC\" order=\"1\">Computer Hardware</Industry>\n"
+    "  </IndustryInfo></peerInfo>\n"
+    "  <Ratios PriceCurrency=\"USD\" ReportingCurrency=\"USD\">\n"
+    "    <Group ID=\"Price and Volume\">\n"
+    "      <Ratio FieldName=\"NPRICE\" Type=\"N\">345.25000</Ratio>\n"
+    "      <Ratio FieldName=\"PDATE\" Type=\"D\">2011-01-14T00:00:00</Ratio>\n"
+    "    </Group>\n"
+    "  </Ratios>\n"
+    "</ReportSnapshot>\n";
+
+const char kFinSummary[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<FinancialSummary>\n"
+    "  <EPSs currency=\"USD\">\n"
+    "    <EPS asofDate=\"2010-12-31\" reportType=\"TTM\" period=\"12M\">"
+    "15.15</EPS>\n"
+    "  </EPSs>\n"
+    "  <TotalRevenues currency=\"USD\">\n"
+    "    <TotalRevenue asofDate=\"2010-12-31\" reportType=\"R\" "
+    "period=\"3M\">26741000000.0</TotalRevenue>\n"
+    "  </TotalRevenues>\n"
+    "</FinancialSummary>\n";
+
+const char kScannerParameters[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<ScanParameterResponse>\n"
+    "  <InstrumentList varName=\"fullInstrumentList\">\n"
+    "    <Instrument><name>US Stocks</name><type>STK</type>"
+    "<filters>PRICE,VOLUME</filters></Instrument>\n"
+    "    <Instrument><name>US Futures</name><type>FUT.US</type>"
+    "</Instrument>\n"
+    "  </InstrumentList>\n"
+    "  <LocationTree>\n"
+    "    <Location>\n"
+    "      <displayName>US Stocks</displayName>\n"
+    "      <locationCode>STK.US</locationCode>\n"
+    "      <instruments>STK</instruments>\n"
+    "      <LocationTree>\n"
+    "        <Location><displayName>NASDAQ</displayName>"
+    "<locationCode>STK.NASDAQ</locationCode></Location>\n"
+    "      </LocationTree>\n"
+    "    </Location>\n"
+    "  </LocationTree>\n"
+    "  <ScanTypeList>\n"
+    "    <ScanType><displayName>Top % Gainers</displayName>"
+    "<scanCode>TOP_PERC_GAIN</scanCode><instruments>STK,STOCK.EU"
+    "</instruments></ScanType>\n"
+    "  </ScanTypeList>\n"
+    "</ScanParameterResponse>\n";
+
+TEST(XmlScannerTest, ScansWithoutATree)
+{
+  const string xml =
+      "<?xml version=\"1.0\"?>\n"
+      "<!DOCTYPE a>\n"
+      "<a x=\"1 &amp; 2\" y='&lt;&#65;&#x42;&gt;'>\n"
+      "  <!-- <b>not an element</b> -->\n"
+      "  <b/>\n"
+      "  one <![CDATA[<two>]]> &quot;three&quot;\n"
+      "</a>\n";
+  RecordingHandler handler;
+  XmlScanner scanner(&handler);
+  ASSERT_TRUE(scanner.Scan(xml));
+  EXPECT_EQ("<a x=1 & 2 y=<AB>>\n"
+            "<b>\n"
+            "</b>\n"
+            "[\n  one <two> \"three\"\n]\n"
+            "</a>\n", handler.out.str());
+
+  EXPECT_FALSE(scanner.Scan("<a><b></a></b>"));
+  EXPECT_FALSE(scanner.Scan("<a>&nbsp;</a>"));
+  EXPECT_FALSE(scanner.Scan("<a>&#x;</a>"));
+  EXPECT_FALSE(scanner.Scan("<a>&#;</a>"));
+  EXPECT_FALSE(scanner.Scan("<a>&#-65;</a>"));
+  EXPECT_FALSE(scanner.Scan("<a>&#0;</a>"));
+  EXPECT_FALSE(scanner.Scan("<a>"));
+  EXPECT_FALSE(scanner.Scan("<a x=1></a>"));
+}
+
+TEST(ReferenceDataTest, ParsesFundamentals)
+{
+  ib::reference::Fundamentals snapshot;
+  ASSERT_TRUE(ib::ParseFundamentals(kSnapshot, &snapshot));
+  EXPECT_EQ("Apple Inc.", snapshot.company_name());
+  EXPECT_EQ("AAPL", snapshot.ticker());
+  EXPECT_EQ("NASD", snapshot.exchange());
+  EXPECT_EQ("USD", snapshot.currency());
+  EXPECT_EQ("Computer Hardware", snapshot.industry());
+  ASSERT_EQ(2, snapshot.ratios_size());
+  EXPECT_EQ("NPRICE", snapshot.ratios(0).name());
+  EXPECT_EQ(345.25, snapshot.ratios(0).value());
+  EXPECT_EQ("2011-01-14T00:00:00", snapshot.ratios(1).text());
+
+  ib::reference::Fundamentals summary;
+  ASSERT_TRUE(ib::ParseFundamentals(kFinSummary, &summary));
+  ASSERT_EQ(2, summary.figures_size());
+  EXPECT_EQ("EPS", summary.figures(0).kind());
+  EXPECT_EQ("2010-12-31", summary.figures(0).as_of_date());
+  EXPECT_EQ("TTM", summary.figures(0).report_type());
+  EXPECT_EQ(15.15, summary.figures(0).value());
+  EXPECT_EQ("TotalRevenue", summary.figures(1).kind());
+  EXPECT_EQ("3M", summary.figures(1).period());
+  EXPECT_EQ(26741000000.0, summary.figures(1).value());
+}
+
+TEST(ReferenceDataTest, ParsesScannerParameters)
+{
+  ib::reference::ScannerParameters parameters;
+  ASSERT_TRUE(ib::ParseScannerParameters(kScannerParameters, &parameters));
+  ASSERT_EQ(2, parameters.instruments_size());
+  EXPECT_EQ("STK", parameters.instruments(0).type());
+  EXPECT_EQ("US Futures", parameters.instruments(1).name());
+  ASSERT_EQ(2, parameters.locations_size());
+  EXPECT_EQ("STK.US", parameters.locations(0).code());
+  EXPECT_EQ("STK", parameters.locations(0).instruments());
+  EXPECT_EQ("STK.NASDAQ", parameters.locations(1).code());
+  EXPECT_EQ("NASDAQ", parameters.locations(1).display_name());
+  ASSERT_EQ(1, parameters.scan_types_size());
+  EXPECT_EQ("TOP_PERC_GAIN", parameters.scan_types(0).code());
+  EXPECT_EQ("Top % Gainers", parameters.scan_types(0).display_name());
+}
+
+// Counts the requests that reach the gateway.
+class RecordingClient : public LoopbackClient
+{
+ public:
+  RecordingClient() : LoopbackClient(NULL), fundamentals(0), scanner(0) {}
+
+  void reqFundamentalData(TickerId, const Contract&, const IBString&)
+  {
+    fundamentals++;
+  }
+  void reqScannerParameters() { scanner++; }
+
+  int fundamentals;
+  int scanner;
+};
+
+struct Answers
+{
+  void OnFundamentals(TickerId id, const ib::reference::Fundamentals& f)
+  {
+    threads.push_back(boost::this_thread::get_id());
+    ids.push_back(id);
+    tickers.push_back(f.ticker());
+  }
+  void OnScannerParameters(const ib::reference::ScannerParameters& p)
+  {
+    scan_types.push_back(p.scan_types_size());
+  }
+
+  vector<boost::thread::id> threads;
+  vector<TickerId> ids;
+  vector<string> tickers;
+  vector<int> scan_types;
+};
+
+TEST(ReferenceDataTest, CachesByRequestAndDate)
+{
+  const string dir = TempDir("reference_data_test");
+  Contract aapl;
+  aapl.conId = 265598;
+  RecordingClient client;
+  Answers answers;
+  {
+    ReferenceData reference(dir, &client);
+    reference.Start();
+    EXPECT_FALSE(reference.RequestFundamentals(
+        7, aapl, "ReportSnapshot",
+        boost::bind(&Answers::OnFundamentals, &answers, _1, _2)));
+    EXPECT_FALSE(reference.RequestScannerParameters(
+        boost::bind(&Answers::OnScannerParameters, &answers, _1)));
+    EXPECT_FALSE(reference.RequestScannerParameters(
+        boost::bind(&Answers::OnScannerParameters, &answers, _1)));
+    EXPECT_EQ(1, client.fundamentals);
+    EXPECT_EQ(1, client.scanner);
+
+    reference.OnFundamentalData(7, kSnapshot);
+    reference.OnFundamentalData(8, kSnapshot);  // Not asked for here.
+    reference.OnScannerParameters(kScannerParameters);
+    reference.Flush();
+    ASSERT_EQ(1U, answers.ids.size());
+    EXPECT_EQ("AAPL", answers.tickers[0]);
+    EXPECT_NE(boost::this_thread::get_id(), answers.threads[0]);
+    EXPECT_EQ(2U, answers.scan_types.size());
+
+    // An error drops the request.
+    Contract msft;
+    msft.symbol = "MSFT";
+    reference.RequestFundamentals(
+        9, msft, "ReportSnapshot",
+        boost::bind(&Answers::OnFundamentals, &answers, _1, _2));
+    reference.OnError(9, 200);
+    reference.OnFundamentalData(9, kSnapshot);
+    reference.Flush();
+    EXPECT_EQ(1U, answers.ids.size());
+  }
+
+  // After a restart, the same day: answered on the caller's thread.
+  ReferenceData reference(dir, &client);
+  EXPECT_TRUE(reference.RequestFundamentals(
+      11, aapl, "ReportSnapshot",
+      boost::bind(&Answers::OnFundamentals, &answers, _1, _2)));
+  EXPECT_TRUE(reference.RequestScannerParameters(
+      boost::bind(&Answers::OnScannerParameters, &answers, _1)));
+  EXPECT_EQ(2, client.fundamentals);  // Only msft's.
+  EXPECT_EQ(1, client.scanner);
+  ASSERT_EQ(2U, answers.ids.size());
+  EXPECT_EQ(11, answers.ids[1]);
+  EXPECT_EQ(boost::this_thread::get_id(), answers.threads[1]);
+  EXPECT_EQ("AAPL", answers.tickers[1]);
+  EXPECT_EQ(1, answers.scan_types[2]);
+
+  // Another report, or another day, is not in the cache.
+  ib::reference::Fundamentals cached;
+  EXPECT_FALSE(reference.Load(
+      ReferenceData::FundamentalsKey(aapl, "ReportsFinSummary"),
+      ReferenceData::Today(), &cached));
+  EXPECT_FALSE(reference.Load(
+      ReferenceData::FundamentalsKey(aapl, "ReportSnapshot"), 20110114,
+      &cached));
+}
+
+TEST(ReferenceDataTest, DropsRequestsThatGoUnanswered)
+{
+  Contract aapl;
+  aapl.conId = 265598;
+  RecordingClient client;
+  Answers answers;
+  ReferenceData reference("", &client);
+  reference.Start();
+  reference.RequestScannerParameters(
+      boost::bind(&Answers::OnScannerParameters, &answers, _1));
+  EXPECT_EQ(1, client.scanner);
+
+  // A warning is not the reply; an error for no id is.
+  reference.OnError(-1, 2104);
+  reference.RequestScannerParameters(
+      boost::bind(&Answers::OnScannerParameters, &answers, _1));
+  EXPECT_EQ(1, client.scanner);
+  reference.OnError(-1, 504);
+  reference.RequestScannerParameters(
+      boost::bind(&Answers::OnScannerParameters, &answers, _1));
+  EXPECT_EQ(2, client.scanner);
+
+  // Nothing pending survives a disconnect.
+  reference.RequestFundamentals(
+      7, aapl, "ReportSnapshot",
+      boost::bind(&Answers::OnFundamentals, &answers, _1, _2));
+  reference.OnDisconnect();
+  reference.OnFundamentalData(7, kSnapshot);
+  reference.OnScannerParameters(kScannerParameters);
+  reference.Flush();
+  EXPECT_TRUE(answers.ids.empty());
+  EXPECT_TRUE(answers.scan_types.empty());
+  reference.RequestScannerParameters(
+      boost::bind(&Answers::OnScannerParameters, &answers, _1));
+  EXPECT_EQ(3, client.scanner);
+
+  // Without a reply in time, the request is sent again.
+  ReferenceData impatient("", &client, 0);
+  impatient.Start();
+  impatient.RequestScannerParameters(
+      boost::bind(&Answers::OnScannerParameters, &answers, _1));
+  impatient.RequestScannerParameters(
+      boost::bind(&Answers::OnScannerParameters, &answers, _1));
+  EXPECT_EQ(5, client.scanner);
+  impatient.OnScannerParameters(kScannerParameters);
+  impatient.Stop();  // Answers what is queued.
+  EXPECT_EQ(2U, answers.scan_types.size());
+
+  // A warning for the id leaves its request open.
+  reference.RequestFundamentals(
+      12, aapl, "ReportSnapshot",
+      boost::bind(&Answers::OnFundamentals, &answers, _1, _2));
+  reference.OnError(12, 10167);
+  reference.OnFundamentalData(12, kSnapshot);
+  reference.Flush();
+  ASSERT_EQ(1U, answers.ids.size());
+  EXPECT_EQ(12, answers.ids[0]);
+}
+
+} // namespace
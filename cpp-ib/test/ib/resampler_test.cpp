@@ -0,0 +1,137 @@
+
+#include <math.h>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "ib/backplane.hpp"
+#include "ib/resampler.hpp"
+
+using namespace std;
+using ib::BackPlane;
+using ib::QuoteTable;
+using ib::Receiver;
+using ib::history::GridChunk;
+using ib::history::JoinColumns;
+using ib::history::Resampler;
+using ib::signal::GetTickerId;
+
+namespace {
+
+// Keeps a copy of the chunks.
+struct Chunks : public Receiver<GridChunk>
+{
+  void operator()(const GridChunk& chunk)
+  {
+    starts.push_back(chunk.start);
+    rows.push_back(chunk.rows);
+    size_t cells = chunk.rows * chunk.columns;
+    values.insert(values.end(), chunk.values, chunk.values + cells);
+    valid.insert(valid.end(), chunk.valid, chunk.valid + cells);
+  }
+  vector<int64_t> starts;
+  vector<size_t> rows;
+  vector<double> values;  // All rows, two columns.
+  vector<uint8_t> valid;
+};
+
+class ResamplerTest : public ::testing::Test
+{
+ protected:
+  ResamplerTest() : a_(GetTickerId("AAA")), b_(GetTickerId("BBB"))
+  {
+    columns_.Add(a_, QuoteTable::LAST);
+    columns_.Add(b_, QuoteTable::LAST);
+  }
+
+  // Ticks on a grid of 100, in chunks of 4 rows.
+  void Feed(Resampler* resampler)
+  {
+    resampler->OnField(0, a_, QuoteTable::LAST, 100);
+    resampler->OnField(150, b_, QuoteTable::LAST, 5);
+    resampler->OnField(160, b_, QuoteTable::BID, 4);  // Not a column.
+    resampler->OnField(200, a_, QuoteTable::LAST, 101);
+    resampler->OnField(210, a_, QuoteTable::LAST, 102);
+    resampler->OnField(650, b_, QuoteTable::LAST, 6);
+    resampler->Flush(700);
+  }
+
+  const int a_, b_;
+  JoinColumns columns_;
+  Chunks chunks_;
+};
+
+TEST_F(ResamplerTest, CarriesValuesForward)
+{
+  Resampler resampler(columns_, 100, 4, 0, &chunks_);
+  Feed(&resampler);
+
+  ASSERT_EQ(2U, chunks_.starts.size());
+  EXPECT_EQ(0, chunks_.starts[0]);
+  EXPECT_EQ(400, chunks_.starts[1]);
+  EXPECT_EQ(8U, resampler.rows());
+
+  const double a[] = { 100, 100, 101, 102, 102, 102, 102, 102 };
+  const double b[] = { NAN, NAN, 5, 5, 5, 5, 5, 6 };
+  ASSERT_EQ(16U, chunks_.values.size());
+  for (int r = 0; r < 8; ++r) {
+    EXPECT_EQ(a[r], chunks_.values[r * 2]) << r;
+    if (isnan(b[r])) {
+      EXPECT_TRUE(isnan(chunks_.values[r * 2 + 1])) << r;
+      EXPECT_EQ(0, chunks_.valid[r * 2 + 1]) << r;
+    } else {
+      EXPECT_EQ(b[r], chunks_.values[r * 2 + 1]) << r;
+      EXPECT_EQ(1, chunks_.valid[r * 2 + 1]) << r;
+    }
+  }
+}
+
+TEST_F(ResamplerTest, MasksStaleAndHaltedValues)
+{
+  Resampler resampler(columns_, 100, 4, 250, &chunks_);
+  resampler.SetHalted(1, true);
+  resampler.OnField(0, a_, QuoteTable::LAST, 100);
+  resampler.OnField(150, b_, QuoteTable::LAST, 5);
+  resampler.SetHalted(1, false);  // From the row at 200.
+  resampler.OnField(200, a_, QuoteTable::LAST, 101);
+  resampler.OnField(210, a_, QuoteTable::LAST, 102);
+  resampler.OnField(650, b_, QuoteTable::LAST, 6);
+  resampler.Flush(700);
+
+  const uint8_t a[] = { 1, 1, 1, 1, 1, 0, 0, 0 };
+  const uint8_t b[] = { 0, 0, 1, 1, 1, 0, 0, 1 };
+  ASSERT_EQ(16U, chunks_.valid.size());
+  for (int r = 0; r < 8; ++r) {
+    EXPECT_EQ(a[r], chunks_.valid[r * 2]) << r;
+    EXPECT_EQ(b[r], chunks_.valid[r * 2 + 1]) << r;
+  }
+  // Still carried.
+  EXPECT_EQ(102, chunks_.values[7 * 2]);
+}
+
+TEST_F(ResamplerTest, SamplesTheBackPlane)
+{
+  Resampler resampler(columns_, 1000, 100, 0, &chunks_);
+  boost::scoped_ptr<BackPlane> backplane(BackPlane::Create());
+  backplane->Register(static_cast<Receiver<BidAsk>*>(&resampler));
+  backplane->Register(static_cast<Receiver<Last>*>(&resampler));
+
+  backplane->OnLast(1000500, a_, 10.0);
+  backplane->OnLast(1002500, b_, 20.0);
+  backplane->OnLast(1003000, a_, 11.0);
+  resampler.Flush(1003000);
+
+  ASSERT_EQ(1U, chunks_.starts.size());
+  EXPECT_EQ(1000000, chunks_.starts[0]);
+  ASSERT_EQ(4U, chunks_.rows[0]);
+  EXPECT_TRUE(isnan(chunks_.values[0]));
+  EXPECT_EQ(10.0, chunks_.values[2]);
+  EXPECT_EQ(10.0, chunks_.values[4]);
+  EXPECT_EQ(11.0, chunks_.values[6]);
+  EXPECT_EQ(20.0, chunks_.values[7]);
+}
+
+} // namespace
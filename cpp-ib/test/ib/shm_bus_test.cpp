@@ -0,0 +1,138 @@
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <sstream>
+#include <string>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "ib/shm_bus.hpp"
+
+using namespace std;
+using ib::Quote;
+using ib::QuoteTable;
+using ib::ShmBus;
+using ib::ShmBusReader;
+using ib::ShmTick;
+
+namespace {
+
+// One segment per test process, so parallel runs do not collide.
+string BusName()
+{
+  ostringstream name;
+  name << "ib_shm_bus_test." << getpid();
+  return name.str();
+}
+
+TEST(ShmBusTest, ReadersSeeTicksInOrder)
+{
+  boost::scoped_ptr<ShmBus> bus(ShmBus::Create(BusName(), 16, 8));
+  ASSERT_TRUE(bus.get());
+  bus->Publish(1, 42, QuoteTable::BID, 99.5);  // Before the reader.
+
+  boost::scoped_ptr<ShmBusReader> reader(ShmBusReader::Open(BusName()));
+  ASSERT_TRUE(reader.get());
+  ShmTick tick;
+  EXPECT_FALSE(reader->Next(&tick));
+
+  for (int i = 0; i < 10; ++i) {
+    bus->Publish(2 + i, 42, QuoteTable::ASK, 100 + i);
+  }
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(reader->Next(&tick));
+    EXPECT_EQ(2 + i, tick.ts);
+    EXPECT_EQ(42, tick.id);
+    EXPECT_EQ(QuoteTable::ASK, tick.field);
+    EXPECT_EQ(100 + i, tick.value);
+  }
+  EXPECT_FALSE(reader->Next(&tick));
+  EXPECT_EQ(0U, reader->overruns());
+
+  // The book has everything, including what came before the reader.
+  const QuoteTable& book = reader->book();
+  ASSERT_EQ(0, book.Find(42));
+  Quote quote;
+  book.Read(0, &quote);
+  EXPECT_EQ(99.5, quote.bid);
+  EXPECT_EQ(109, quote.ask);
+  EXPECT_EQ(11U, quote.updates);
+}
+
+TEST(ShmBusTest, SlowReadersDetectOverruns)
+{
+  boost::scoped_ptr<ShmBus> bus(ShmBus::Create(BusName(), 8, 8));
+  ASSERT_TRUE(bus.get());
+  boost::scoped_ptr<ShmBusReader> reader(ShmBusReader::Open(BusName()));
+  ASSERT_TRUE(reader.get());
+
+  for (int i = 0; i < 20; ++i) bus->Publish(i, 1, QuoteTable::LAST, i);
+  ShmTick tick;
+  EXPECT_FALSE(reader->Next(&tick));
+  EXPECT_EQ(1U, reader->overruns());
+  EXPECT_EQ(20U, reader->lost());
+
+  // Back in step from the newest tick on.
+  bus->Publish(20, 1, QuoteTable::LAST, 20);
+  ASSERT_TRUE(reader->Next(&tick));
+  EXPECT_EQ(20, tick.value);
+  EXPECT_EQ(1U, reader->overruns());
+}
+
+TEST(ShmBusTest, ReadersSeeTheWriterGo)
+{
+  boost::scoped_ptr<ShmBus> bus(ShmBus::Create(BusName(), 8, 8));
+  ASSERT_TRUE(bus.get());
+  boost::scoped_ptr<ShmBusReader> reader(ShmBusReader::Open(BusName()));
+  ASSERT_TRUE(reader.get());
+  EXPECT_FALSE(reader->closed());
+
+  bus.reset();
+  EXPECT_TRUE(reader->closed());
+  EXPECT_FALSE(ShmBusReader::Open(BusName()));
+}
+
+// The writer keeps ts == value; a torn read would see them differ.
+TEST(ShmBusTest, AnotherProcessReadsWhileTheWriterRuns)
+{
+  const int n = 200000;
+  const string name = BusName();  // The child has another pid.
+  boost::scoped_ptr<ShmBus> bus(ShmBus::Create(name, 1024, 8));
+  ASSERT_TRUE(bus.get());
+
+  pid_t child = fork();
+  ASSERT_GE(child, 0);
+  if (child == 0) {
+    ShmBusReader* reader = ShmBusReader::Open(name);
+    if (!reader) _exit(2);
+    int64_t last = -1;
+    int torn = 0, out_of_order = 0;
+    ShmTick tick;
+    while (last < n - 1) {
+      if (!reader->Next(&tick)) {
+        if (reader->closed()) break;
+        continue;
+      }
+      if (tick.ts != tick.value) ++torn;
+      if (tick.ts <= last) ++out_of_order;
+      last = tick.ts;
+    }
+    _exit(torn || out_of_order ? 1 : 0);
+  }
+
+  // The child starts after the newest tick when it attaches, so give
+  // it time to attach first.
+  usleep(100000);
+  for (int i = 0; i < n; ++i) bus->Publish(i, 7, QuoteTable::BID, i);
+  bus.reset();
+
+  int status;
+  ASSERT_EQ(child, waitpid(child, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+}
+
+} // namespace
@@ -0,0 +1,186 @@
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <Shared/Contract.h>
+
+#include "ib/snapshot_sampler.hpp"
+#include "loopback_client.hpp"
+
+using namespace std;
+using ib::SnapshotSampler;
+using ib::testing::LoopbackClient;
+
+namespace {
+
+static const TickerId FIRST_ID = 1000;
+static const int64_t CYCLE = 60000000;
+static const int64_t TIMEOUT = 10000000;
+
+// Records the requests that reach the client.
+class RecordingClient : public LoopbackClient
+{
+ public:
+  RecordingClient() : LoopbackClient(NULL) {}
+
+  void reqMktData(TickerId id, const Contract& contract,
+                  const IBString& genericTicks, bool snapshot)
+  {
+    ostringstream s;
+    s << "reqMktData " << id << " " << contract.symbol
+        << (snapshot ? " snapshot" : "");
+    calls.push_back(s.str());
+  }
+  void cancelMktData(TickerId id)
+  {
+    ostringstream s;
+    s << "cancelMktData " << id;
+    calls.push_back(s.str());
+  }
+
+  vector<string> calls;
+};
+
+Contract Stock(const string& symbol)
+{
+  Contract contract;
+  contract.symbol = symbol;
+  contract.secType = "STK";
+  contract.exchange = "SMART";
+  contract.currency = "USD";
+  return contract;
+}
+
+void AddUniverse(SnapshotSampler* sampler, int n)
+{
+  for (int i = 0; i < n; ++i) {
+    ostringstream symbol;
+    symbol << "S" << i;
+    EXPECT_EQ(FIRST_ID + i, sampler->Add(Stock(symbol.str())));
+  }
+}
+
+TEST(SnapshotSamplerTest, CyclesTheUniverseInWaves)
+{
+  RecordingClient client;
+  SnapshotSampler sampler(&client, FIRST_ID, 8, 2, CYCLE, TIMEOUT);
+  EXPECT_EQ(-1, sampler.Dispatch(1));
+  AddUniverse(&sampler, 5);
+  EXPECT_EQ(FIRST_ID + 1, sampler.Add(Stock("S1")));
+  EXPECT_EQ(5U, sampler.size());
+  EXPECT_EQ(FIRST_ID + 3, sampler.Find("S3"));
+  EXPECT_EQ(-1, sampler.Find("IBM"));
+
+  int64_t now = 1000000;
+  EXPECT_EQ(TIMEOUT, sampler.Dispatch(now));
+  ASSERT_EQ(2U, client.calls.size());
+  EXPECT_EQ("reqMktData 1000 S0 snapshot", client.calls[0]);
+  EXPECT_EQ("reqMktData 1001 S1 snapshot", client.calls[1]);
+
+  // Not before the whole wave ended.
+  sampler.OnSnapshotEnd(now + 1000, FIRST_ID);
+  EXPECT_EQ(TIMEOUT - 2000, sampler.Dispatch(now + 2000));
+  EXPECT_EQ(2U, client.calls.size());
+  sampler.OnSnapshotEnd(now + 3000, FIRST_ID + 1);
+  sampler.Dispatch(now + 4000);
+  ASSERT_EQ(4U, client.calls.size());
+  EXPECT_EQ("reqMktData 1002 S2 snapshot", client.calls[2]);
+  EXPECT_EQ("reqMktData 1003 S3 snapshot", client.calls[3]);
+
+  sampler.OnSnapshotEnd(now + 5000, FIRST_ID + 2);
+  sampler.OnSnapshotEnd(now + 5000, FIRST_ID + 3);
+  sampler.Dispatch(now + 6000);
+  ASSERT_EQ(5U, client.calls.size());
+  EXPECT_EQ("reqMktData 1004 S4 snapshot", client.calls[4]);
+  sampler.OnSnapshotEnd(now + 7000, FIRST_ID + 4);
+
+  // The cycle ended; the next one starts a cycle after this one did.
+  EXPECT_EQ(CYCLE - 8000, sampler.Dispatch(now + 8000));
+  EXPECT_EQ(5U, client.calls.size());
+  SnapshotSampler::Stats stats = sampler.GetStats();
+  EXPECT_EQ(1U, stats.cycles);
+  EXPECT_EQ(5U, stats.requested);
+  EXPECT_EQ(5U, stats.completed);
+  EXPECT_EQ(8000, stats.cycle_micros);
+
+  sampler.Dispatch(now + CYCLE);
+  ASSERT_EQ(7U, client.calls.size());
+  EXPECT_EQ("reqMktData 1000 S0 snapshot", client.calls[5]);
+  EXPECT_EQ(2U, sampler.GetStats().cycles);
+}
+
+TEST(SnapshotSamplerTest, EndsWavesOnErrorsAndTimeouts)
+{
+  RecordingClient client;
+  SnapshotSampler sampler(&client, FIRST_ID, 8, 2, CYCLE, TIMEOUT);
+  AddUniverse(&sampler, 3);
+
+  int64_t now = 1000000;
+  sampler.Dispatch(now);
+  // A warning leaves the request open.
+  sampler.OnError(FIRST_ID, 10167);
+  EXPECT_EQ(0U, sampler.GetStats().failed);
+  sampler.OnError(FIRST_ID, 200);
+  EXPECT_EQ(TIMEOUT - 1000, sampler.Dispatch(now + 1000));
+
+  // The other one never ends.
+  sampler.Dispatch(now + TIMEOUT);
+  ASSERT_EQ(4U, client.calls.size());
+  EXPECT_EQ("cancelMktData 1001", client.calls[2]);
+  EXPECT_EQ("reqMktData 1002 S2 snapshot", client.calls[3]);
+
+  SnapshotSampler::Stats stats = sampler.GetStats();
+  EXPECT_EQ(1U, stats.failed);
+  EXPECT_EQ(1U, stats.timed_out);
+  EXPECT_EQ(0U, stats.completed);
+
+  // Errors of other ids change nothing.
+  sampler.OnError(FIRST_ID + 1, 200);
+  EXPECT_EQ(1U, sampler.GetStats().failed);
+}
+
+TEST(SnapshotSamplerTest, KeepsLatestValuesAndWhenSampled)
+{
+  RecordingClient client;
+  SnapshotSampler sampler(&client, FIRST_ID, 8, 10, CYCLE, TIMEOUT);
+  AddUniverse(&sampler, 3);
+  EXPECT_TRUE(sampler.Owns(FIRST_ID + 7));
+  EXPECT_FALSE(sampler.Owns(FIRST_ID + 8));
+  EXPECT_FALSE(sampler.Owns(FIRST_ID - 1));
+
+  int64_t now = 1000000;
+  sampler.Dispatch(now);
+  sampler.OnTickPrice(now + 10, FIRST_ID, BID, 10.5);
+  sampler.OnTickPrice(now + 10, FIRST_ID, ASK, 10.75);
+  sampler.OnTickPrice(now + 10, FIRST_ID, LAST, -1);  // None.
+  sampler.OnTickSize(now + 20, FIRST_ID, BID_SIZE, 300);
+  sampler.OnSnapshotEnd(now + 30, FIRST_ID);
+  sampler.OnSnapshotEnd(now + 40, FIRST_ID + 1);
+
+  SnapshotSampler::Sample sample;
+  ASSERT_TRUE(sampler.Get(FIRST_ID, &sample));
+  EXPECT_EQ("S0", sample.symbol);
+  EXPECT_EQ(10.5, sample.quote.bid);
+  EXPECT_EQ(10.75, sample.quote.ask);
+  EXPECT_EQ(0, sample.quote.last);
+  EXPECT_EQ(300, sample.quote.bid_size);
+  EXPECT_EQ(now + 20, sample.quote.ts);
+  EXPECT_EQ(now + 30, sample.sampled_at);
+
+  // Sampled, without a value.
+  ASSERT_TRUE(sampler.Get(FIRST_ID + 1, &sample));
+  EXPECT_EQ(0U, sample.quote.updates);
+  EXPECT_EQ(now + 40, sample.sampled_at);
+  ASSERT_TRUE(sampler.Get(FIRST_ID + 2, &sample));
+  EXPECT_EQ(0, sample.sampled_at);
+  EXPECT_FALSE(sampler.Get(FIRST_ID + 3, &sample));
+
+  EXPECT_EQ(1U, sampler.CountStale(now + 40, 10));
+  EXPECT_EQ(2U, sampler.CountStale(now + 40, 5));
+  EXPECT_EQ(3U, sampler.CountStale(now + CYCLE, CYCLE / 2));
+}
+
+} // namespace
@@ -0,0 +1,197 @@
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+#include <gtest/gtest.h>
+
+#include "ib/strategy_capture.hpp"
+
+using namespace std;
+using ib::CaptureReplay;
+using ib::CapturedEvent;
+using ib::StrategyCapture;
+using ib::StrategyReceivers;
+
+namespace {
+
+static string TempPath(const string& name)
+{
+  ostringstream path;
+  path << "/tmp/" << name << "." << getpid();
+  return path.str();
+}
+
+// A strategy that writes down what it is handed.
+class RecordingStrategy : public ib::Receiver<Connect>,
+                          public ib::Receiver<Disconnect>,
+                          public ib::Receiver<BidAsk>,
+                          public ib::Receiver<Last>
+{
+ public:
+  StrategyReceivers receivers()
+  {
+    StrategyReceivers receivers;
+    receivers.connect = this;
+    receivers.disconnect = this;
+    receivers.bid_ask = this;
+    receivers.last = this;
+    return receivers;
+  }
+
+  void operator()(const Connect& connect)
+  {
+    Record(connect.GetTypeName(), connect.SerializeAsString());
+  }
+  void operator()(const Disconnect& disconnect)
+  {
+    Record(disconnect.GetTypeName(), disconnect.SerializeAsString());
+  }
+  void operator()(const BidAsk& bid_ask)
+  {
+    Record(bid_ask.GetTypeName(), bid_ask.SerializeAsString());
+  }
+  void operator()(const Last& last)
+  {
+    Record(last.GetTypeName(), last.SerializeAsString());
+  }
+
+  vector<string> seen;
+
+ private:
+  void Record(const string& type, const string& bytes)
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    seen.push_back(type + ":" + bytes);
+  }
+
+  boost::mutex mutex_;
+};
+
+BidAsk Bid(int64_t ts, int id, double price)
+{
+  BidAsk bid_ask;
+  bid_ask.set_time_stamp(ts);
+  bid_ask.set_id(id);
+  bid_ask.mutable_bid()->set_price(price);
+  return bid_ask;
+}
+
+TEST(StrategyCaptureTest, ReplaysWhatTheStrategySaw)
+{
+  const string path = TempPath("strategy_capture_test");
+  RecordingStrategy strategy;
+  StrategyCapture capture(path, strategy.receivers());
+  ASSERT_TRUE(capture.Start());
+
+  Connect connect;
+  connect.set_time_stamp(1);
+  connect.set_id(7);
+  capture(connect);
+  capture(Bid(2, 7, 10.5));
+  BidAsk ask;
+  ask.set_time_stamp(3);
+  ask.set_id(7);
+  ask.mutable_ask()->set_size(300);
+  ask.mutable_bid();  // Present, but empty.
+  capture(ask);
+  Last last;
+  last.set_time_stamp(4);
+  last.set_id(7);
+  last.set_price(10.25);
+  last.set_size(100);
+  capture(last);
+  Disconnect disconnect;
+  disconnect.set_time_stamp(5);
+  disconnect.set_id(7);
+  capture(disconnect);
+  capture.Stop();
+  EXPECT_EQ(5, capture.written());
+  EXPECT_EQ(0, capture.dropped());
+  ASSERT_EQ(5U, strategy.seen.size());
+
+  CaptureReplay replay;
+  ASSERT_TRUE(replay.Load(path));
+  ASSERT_EQ(5U, replay.events().size());
+  EXPECT_EQ(0U, replay.missing());
+  for (size_t i = 0; i < replay.events().size(); ++i) {
+    EXPECT_EQ(i, replay.events()[i].seq);
+    EXPECT_EQ(replay.events()[0].thread, replay.events()[i].thread);
+  }
+  EXPECT_EQ(CapturedEvent::LAST, replay.events()[3].kind);
+
+  // A fresh strategy sees the same events, up to empty groups.
+  RecordingStrategy fresh;
+  EXPECT_EQ(5U, replay.Replay(fresh.receivers()));
+  ASSERT_EQ(5U, fresh.seen.size());
+  for (size_t i = 0; i < 5; ++i) {
+    if (i == 2) continue;
+    EXPECT_EQ(strategy.seen[i], fresh.seen[i]) << i;
+  }
+
+  // Only what the strategy takes.
+  RecordingStrategy partial;
+  StrategyReceivers receivers;
+  receivers.bid_ask = &partial;
+  EXPECT_EQ(2U, replay.Replay(receivers));
+  unlink(path.c_str());
+}
+
+static void Deliver(StrategyCapture* capture, int id, int n)
+{
+  for (int i = 0; i < n; ++i) (*capture)(Bid(i, id, i));
+}
+
+TEST(StrategyCaptureTest, KeepsTheOrderOfEachThread)
+{
+  const string path = TempPath("strategy_capture_threads");
+  const int n = 10000;
+  RecordingStrategy strategy;
+  StrategyCapture capture(path, strategy.receivers(), 1 << 16);
+  ASSERT_TRUE(capture.Start());
+  boost::thread first(boost::bind(&Deliver, &capture, 1, n));
+  boost::thread second(boost::bind(&Deliver, &capture, 2, n));
+  first.join();
+  second.join();
+  capture.Flush();
+  EXPECT_EQ(2 * n, capture.written());
+  capture.Stop();
+
+  CaptureReplay replay;
+  ASSERT_TRUE(replay.Load(path));
+  ASSERT_EQ(2U * n, replay.events().size());
+  EXPECT_EQ(0U, replay.missing());
+
+  // Each id came from one thread, in order.
+  double next[3] = { 0, 0, 0 };
+  int thread[3] = { -1, -1, -1 };
+  for (size_t i = 0; i < replay.events().size(); ++i) {
+    const CapturedEvent& event = replay.events()[i];
+    ASSERT_EQ(next[event.id], event.price);
+    next[event.id]++;
+    if (thread[event.id] < 0) thread[event.id] = event.thread;
+    ASSERT_EQ(thread[event.id], event.thread);
+  }
+  EXPECT_NE(thread[1], thread[2]);
+  unlink(path.c_str());
+}
+
+TEST(StrategyCaptureTest, RejectsOtherFiles)
+{
+  const string path = TempPath("strategy_capture_other");
+  FILE* file = fopen(path.c_str(), "w");
+  fputs("not a capture, just text", file);
+  fclose(file);
+  CaptureReplay replay;
+  EXPECT_FALSE(replay.Load(path));
+  EXPECT_FALSE(replay.Load(path + ".none"));
+  unlink(path.c_str());
+}
+
+} // namespace
@@ -0,0 +1,200 @@
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "ib/backplane.hpp"
+#include "ib/symbol_set.hpp"
+
+using namespace std;
+using ib::signal::Exclusion;
+using ib::signal::Selection;
+using ib::signal::SymbolSet;
+using ib::signal::TickerIndex;
+
+namespace {
+
+// Ids of their own so the indexes span several words.
+int Id(int i)
+{
+  return (1000000 + i) << 11;
+}
+
+TEST(SymbolSetTest, MatchesStdSetOperations)
+{
+  SymbolSet a, b;
+  set<int> sa, sb;
+  for (int i = 0; i < 1000; ++i) {
+    if (i % 3 == 0) { a.Add(Id(i)); sa.insert(Id(i)); }
+    // Shorter than a, so the tails differ in length.
+    if (i % 5 == 0 && i < 700) { b.Add(Id(i)); sb.insert(Id(i)); }
+  }
+  EXPECT_EQ(sa.size(), a.count());
+
+  SymbolSet u = a, n = a, d = a, d2 = b;
+  u |= b;
+  n &= b;
+  d -= b;
+  d2 -= a;
+  for (int i = 0; i < 1000; ++i) {
+    bool in_a = sa.count(Id(i)), in_b = sb.count(Id(i));
+    EXPECT_EQ(in_a || in_b, u.Contains(Id(i))) << i;
+    EXPECT_EQ(in_a && in_b, n.Contains(Id(i))) << i;
+    EXPECT_EQ(in_a && !in_b, d.Contains(Id(i))) << i;
+    EXPECT_EQ(in_b && !in_a, d2.Contains(Id(i))) << i;
+  }
+
+  vector<int> ids;
+  n.GetIds(&ids);
+  ASSERT_EQ(n.count(), ids.size());
+  EXPECT_EQ(Id(0), ids[0]);
+  EXPECT_EQ(Id(15), ids[1]);
+
+  EXPECT_FALSE(a.Contains(Id(5000)));  // Never indexed.
+  a.Remove(Id(3));
+  EXPECT_FALSE(a.Contains(Id(3)));
+  EXPECT_TRUE(SymbolSet() == SymbolSet());
+  EXPECT_FALSE(a == b);
+}
+
+TEST(SymbolSetTest, IndexesAreDenseAndStable)
+{
+  TickerIndex& index = TickerIndex::Instance();
+  int first = index.Index(Id(2000));
+  EXPECT_EQ(first, index.Index(Id(2000)));
+  EXPECT_EQ(first + 1, index.Index(Id(2001)));
+  EXPECT_EQ(first, index.Find(Id(2000)));
+  EXPECT_EQ(Id(2001), index.id(first + 1));
+  EXPECT_EQ(-1, index.Find(Id(2002)));
+}
+
+TEST(SelectionTest, ComposesUniverses)
+{
+  Selection index, halted, watchlist;
+  index << "AAPL" << "GOOG" << "MSFT";
+  halted << "GOOG";
+  watchlist << "NFLX";
+
+  Selection universe = index;
+  (universe -= halted) |= watchlist;
+
+  BidAsk bid_ask;
+  const char* in[] = { "AAPL", "MSFT", "NFLX" };
+  for (int i = 0; i < 3; ++i) {
+    bid_ask.set_id(ib::signal::GetTickerId(in[i]));
+    EXPECT_TRUE(universe(bid_ask)) << in[i];
+  }
+  bid_ask.set_id(ib::signal::GetTickerId("GOOG"));
+  EXPECT_FALSE(universe(bid_ask));
+  EXPECT_EQ(3U, universe.symbols().count());
+
+  // The sources are untouched.
+  EXPECT_TRUE(index(bid_ask));
+
+  Exclusion not_halted;
+  not_halted |= halted;
+  EXPECT_FALSE(not_halted(bid_ask));
+  bid_ask.set_id(ib::signal::GetTickerId("AAPL"));
+  EXPECT_TRUE(not_halted(bid_ask));
+}
+
+TEST(SelectionTest, AddsAListInOneChange)
+{
+  vector<string> symbols;
+  symbols.push_back("AAPL");
+  symbols.push_back("GOOG");
+  symbols.push_back("AAPL");
+  Selection universe;
+  universe << "MSFT";
+  universe.Add(symbols);
+  EXPECT_EQ(3U, universe.symbols().count());
+
+  Last last;
+  last.set_id(ib::signal::GetTickerId("GOOG"));
+  EXPECT_TRUE(universe(last));
+  universe.Remove(last.id());
+  EXPECT_FALSE(universe(last));
+}
+
+struct CountingReceiver : public ib::Receiver<Last>
+{
+  CountingReceiver() : count(0) {}
+  virtual void operator()(const Last& last) { count++; }
+  int count;
+};
+
+TEST(SelectionTest, TestsTheIndexTheBackPlaneSets)
+{
+  Selection universe;
+  universe << "AAPL";
+  const int aapl = ib::signal::GetTickerId("AAPL");
+  const int msft = ib::signal::GetTickerId("MSFT");
+  Last last;
+  last.set_id(msft);
+  last.set_index(TickerIndex::Instance().Find(aapl));
+  EXPECT_TRUE(universe(last));  // By the index, not the id.
+  last.set_index(-1);
+  EXPECT_FALSE(universe(last));
+
+  boost::scoped_ptr<ib::BackPlane> backplane(ib::BackPlane::Create());
+  CountingReceiver receiver;
+  backplane->Register(&receiver, &universe);
+  backplane->OnLast(1, aapl, 10.5);
+  backplane->OnLast(2, msft, 20.5);
+  EXPECT_EQ(1, receiver.count);
+
+  // A change in place is seen by the next tick.
+  universe << msft;
+  backplane->OnLast(3, msft, 20.5);
+  universe.Remove(aapl);
+  backplane->OnLast(4, aapl, 10.5);
+  EXPECT_EQ(2, receiver.count);
+}
+
+// Swaps between two universes that share AAPL while a reader tests
+// ticks; the reader must always see one universe or the other.
+struct Swapper
+{
+  Swapper(Selection* s, const SymbolSet* a, const SymbolSet* b, int n)
+      : selection(s), a(a), b(b), n(n) {}
+  Selection* selection;
+  const SymbolSet* a;
+  const SymbolSet* b;
+  int n;
+  void operator()()
+  {
+    for (int i = 0; i < n; ++i) selection->Assign(i % 2 ? *a : *b);
+  }
+};
+
+TEST(SelectionTest, ReadersSeeWholeUniverses)
+{
+  SymbolSet a, b;
+  a.Add("AAPL");
+  a.Add("IBM");
+  b.Add("AAPL");
+  b.Add("INTC");
+  Selection selection;
+  selection.Assign(a);
+
+  boost::thread swapper(Swapper(&selection, &a, &b, 10000));
+  Last aapl, ibm, intc;
+  aapl.set_id(ib::signal::GetTickerId("AAPL"));
+  ibm.set_id(ib::signal::GetTickerId("IBM"));
+  intc.set_id(ib::signal::GetTickerId("INTC"));
+  int missing = 0;
+  for (int i = 0; i < 100000; ++i) {
+    if (!selection(aapl)) ++missing;
+  }
+  swapper.join();
+  EXPECT_EQ(0, missing);
+  EXPECT_TRUE(selection(ibm) != selection(intc));
+}
+
+} // namespace
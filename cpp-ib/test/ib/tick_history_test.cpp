@@ -0,0 +1,142 @@
+
+#include <stdlib.h>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "ib/backplane.hpp"
+#include "ib/tick_history.hpp"
+
+using namespace std;
+using ib::BackPlane;
+using ib::QuoteTable;
+using ib::Receiver;
+using ib::history::Tick;
+using ib::history::TickHistory;
+using ib::history::TickSeries;
+
+namespace {
+
+// A random walk in cent ticks at irregular intervals, over several
+// blocks.
+void MakeTicks(size_t n, vector<Tick>* ticks)
+{
+  srand(616);
+  int64_t ts = 1262304000000000LL;
+  int cents = 3000;
+  for (size_t i = 0; i < n; ++i) {
+    ts += (rand() % 4 == 0) ? 1000 + rand() % 50000 : 1000;
+    cents += rand() % 5 - 2;
+    Tick tick = { ts, cents / 100.0 };
+    ticks->push_back(tick);
+  }
+}
+
+void ExpectSame(const vector<Tick>& expected, size_t from,
+                const vector<Tick>& actual)
+{
+  ASSERT_EQ(expected.size() - from, actual.size());
+  for (size_t i = 0; i < actual.size(); ++i) {
+    EXPECT_EQ(expected[from + i].ts, actual[i].ts) << i;
+    EXPECT_EQ(expected[from + i].value, actual[i].value) << i;
+  }
+}
+
+TEST(TickSeriesTest, RoundTripsPrices)
+{
+  vector<Tick> ticks;
+  MakeTicks(5000, &ticks);
+  TickSeries series(100);
+  for (size_t i = 0; i < ticks.size(); ++i) {
+    series.Append(ticks[i].ts, ticks[i].value);
+  }
+  EXPECT_EQ(ticks.size(), series.size());
+  EXPECT_EQ(ticks.back().ts, series.back().ts);
+  EXPECT_EQ(ticks.back().value, series.back().value);
+
+  vector<Tick> all;
+  series.Last(ticks.size() + 10, &all);
+  ExpectSame(ticks, 0, all);
+
+  // Across a block boundary.
+  vector<Tick> last;
+  series.Last(1500, &last);
+  ExpectSame(ticks, ticks.size() - 1500, last);
+
+  vector<Tick> since;
+  series.Since(ticks[2500].ts, &since);
+  ExpectSame(ticks, 2500, since);
+
+  // Against 16 bytes a tick uncompressed.
+  EXPECT_LT(series.bytes(), ticks.size() * 3);
+}
+
+TEST(TickSeriesTest, StoresValuesOffTheGridRaw)
+{
+  const double values[] = { 10.25, 10.255, 10.26, 1e300, 10.26, 10.25 };
+  TickSeries series(100);
+  for (int i = 0; i < 6; ++i) series.Append(i, values[i]);
+  vector<Tick> all;
+  series.Last(6, &all);
+  ASSERT_EQ(6U, all.size());
+  for (int i = 0; i < 6; ++i) EXPECT_EQ(values[i], all[i].value) << i;
+  EXPECT_EQ(10.25, series.back().value);
+}
+
+TEST(TickSeriesTest, RoundTripsSizesAndOddValues)
+{
+  const double values[] = {
+    100, 100, 200, 100, 0, -1, 1e300, 1e-300, 0.1, 0.2, 12345678, 100
+  };
+  const int64_t times[] = {
+    0, 0, 1, 2, 1000000, 1000001, 1000001, 999000, 5, 1LL << 40, 1LL << 41, 0
+  };
+  const size_t n = sizeof(values) / sizeof(values[0]);
+  TickSeries series;
+  for (size_t i = 0; i < n; ++i) series.Append(times[i], values[i]);
+
+  vector<Tick> all;
+  series.Last(n, &all);
+  ASSERT_EQ(n, all.size());
+  for (size_t i = 0; i < n; ++i) {
+    EXPECT_EQ(times[i], all[i].ts) << i;
+    EXPECT_EQ(values[i], all[i].value) << i;
+  }
+
+  TickSeries empty;
+  vector<Tick> none;
+  empty.Last(10, &none);
+  empty.Since(0, &none);
+  EXPECT_TRUE(none.empty());
+}
+
+TEST(TickHistoryTest, RecordsTheBackPlane)
+{
+  boost::scoped_ptr<BackPlane> backplane(BackPlane::Create());
+  TickHistory history;
+  backplane->Register(static_cast<Receiver<BidAsk>*>(&history));
+  backplane->Register(static_cast<Receiver<Last>*>(&history));
+
+  backplane->OnBid(100, 7, 10.5);
+  backplane->OnBid(110, 7, 300);
+  backplane->OnBid(120, 7, 10.51);
+  backplane->OnLast(130, 8, 99.5);
+  backplane->OnLast(130, 8, 200);
+
+  EXPECT_EQ(5U, history.ticks());
+  EXPECT_TRUE(history.Find(7, QuoteTable::ASK) == NULL);
+  const TickSeries* bids = history.Find(7, QuoteTable::BID);
+  ASSERT_TRUE(bids != NULL);
+  vector<Tick> ticks;
+  bids->Last(10, &ticks);
+  ASSERT_EQ(2U, ticks.size());
+  EXPECT_EQ(100, ticks[0].ts);
+  EXPECT_EQ(10.51, ticks[1].value);
+  EXPECT_EQ(300, history.Find(7, QuoteTable::BID_SIZE)->back().value);
+  EXPECT_EQ(200, history.Find(8, QuoteTable::LAST_SIZE)->back().value);
+}
+
+} // namespace
@@ -0,0 +1,232 @@
+
+#include <dirent.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "utils.hpp"
+#include "ib/warm_state.hpp"
+
+using namespace std;
+using ib::QuoteTable;
+using ib::WarmState;
+
+namespace {
+
+static string TempDir(const string& name)
+{
+  ostringstream path;
+  path << "/tmp/" << name << "." << getpid();
+  DIR* dir = opendir(path.str().c_str());
+  if (dir) {
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+      unlink((path.str() + "/" + entry->d_name).c_str());
+    }
+    closedir(dir);
+  }
+  mkdir(path.str().c_str(), 0755);
+  return path.str();
+}
+
+static ib::state::OpenOrder Order(int64_t id, const string& status,
+                                  int filled)
+{
+  ib::state::OpenOrder order;
+  order.set_id(id);
+  order.set_status(status);
+  order.set_filled(filled);
+  return order;
+}
+
+static ib::state::Position Position(const string& symbol, int position)
+{
+  ib::state::Position p;
+  p.set_symbol(symbol);
+  p.set_account("DU1");
+  p.set_position(position);
+  p.set_avg_cost(100.5);
+  return p;
+}
+
+// Runs work on a state in a child process that then exits without
+// destructors, as if it crashed: no Stop and no last snapshot.
+static void RunAndCrash(void (*work)(WarmState*, QuoteTable*),
+                        const string& dir, size_t capacity)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    QuoteTable quotes(capacity);
+    WarmState state(dir, &quotes);
+    work(&state, &quotes);
+    _exit(0);
+  }
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+}
+
+// A state as the logger keeps it, changed before and after snapshots.
+static void Fill(WarmState* state, QuoteTable* quotes)
+{
+  state->Subscribe("IBM", true);
+  state->Subscribe("AAPL", false);
+  ib::state::OpenOrder order = Order(100, "Submitted", 0);
+  order.set_symbol("IBM");
+  order.set_quantity(300);
+  state->UpdateOrder(order);
+  state->UpdateOrder(Order(101, "Submitted", 0));
+  state->UpdatePosition(Position("IBM", 200));
+  quotes->Update(1000, 7, QuoteTable::BID, 100.25);
+  quotes->Update(1001, 7, QuoteTable::ASK_SIZE, 300);
+}
+
+static void FillAndUpdate(WarmState* state, QuoteTable* quotes)
+{
+  state->Load();
+  Fill(state, quotes);
+  state->Start(3600);
+
+  // Only in the log.
+  state->Unsubscribe("AAPL");
+  state->UpdateOrder(Order(100, "Submitted", 100));
+  state->UpdateOrder(Order(101, "Cancelled", 0));
+  state->UpdatePosition(Position("MSFT", -50));
+}
+
+TEST(WarmStateTest, RestoresSnapshotAndLog)
+{
+  const string dir = TempDir("warm_state_test");
+  RunAndCrash(&FillAndUpdate, dir, 64);
+
+  QuoteTable quotes(64);
+  WarmState state(dir, &quotes);
+  ASSERT_TRUE(state.Load());
+  EXPECT_EQ(4, state.replayed());
+
+  vector<ib::state::Subscription> subscriptions;
+  state.GetSubscriptions(&subscriptions);
+  ASSERT_EQ(1U, subscriptions.size());
+  EXPECT_EQ("IBM", subscriptions[0].symbol());
+  EXPECT_TRUE(subscriptions[0].book());
+
+  vector<ib::state::OpenOrder> orders;
+  state.GetOpenOrders(&orders);
+  ASSERT_EQ(1U, orders.size());
+  EXPECT_EQ(100, orders[0].id());
+  EXPECT_EQ("IBM", orders[0].symbol());
+  EXPECT_EQ(300, orders[0].quantity());
+  EXPECT_EQ(100, orders[0].filled());
+
+  vector<ib::state::Position> positions;
+  state.GetPositions(&positions);
+  ASSERT_EQ(2U, positions.size());
+  EXPECT_EQ("IBM", positions[0].symbol());
+  EXPECT_EQ(200, positions[0].position());
+  EXPECT_EQ(-50, positions[1].position());
+
+  int slot = quotes.Find(7);
+  ASSERT_LE(0, slot);
+  ib::Quote quote;
+  quotes.Read(slot, &quote);
+  EXPECT_EQ(100.25, quote.bid);
+  EXPECT_EQ(300, quote.ask_size);
+  EXPECT_EQ(1001, quote.ts);
+}
+
+TEST(WarmStateTest, SnapshotStartsNewGeneration)
+{
+  const string dir = TempDir("warm_state_gen_test");
+  QuoteTable quotes(64);
+  {
+    WarmState state(dir, &quotes);
+    Fill(&state, &quotes);
+    ASSERT_TRUE(state.Start(3600));
+    EXPECT_EQ(1, state.generation());
+    state.Unsubscribe("IBM");
+    ASSERT_TRUE(state.Snapshot());
+    EXPECT_EQ(2, state.generation());
+    state.Stop();
+    EXPECT_EQ(3, state.generation());
+  }
+  // Only the last generation is kept.
+  FILE* file = fopen((dir + "/snapshot.2").c_str(), "r");
+  EXPECT_TRUE(file == NULL);
+  if (file) fclose(file);
+
+  QuoteTable restored(64);
+  WarmState state(dir, &restored);
+  ASSERT_TRUE(state.Load());
+  EXPECT_EQ(0, state.replayed());
+  EXPECT_EQ(3, state.generation());
+  vector<ib::state::Subscription> subscriptions;
+  state.GetSubscriptions(&subscriptions);
+  ASSERT_EQ(1U, subscriptions.size());
+  EXPECT_EQ("AAPL", subscriptions[0].symbol());
+}
+
+static void Subscribe(WarmState* state, QuoteTable* quotes)
+{
+  state->Start(3600);
+  state->Subscribe("IBM", false);
+  state->Subscribe("AAPL", false);
+}
+
+TEST(WarmStateTest, StopsAtTornRecord)
+{
+  const string dir = TempDir("warm_state_torn_test");
+  RunAndCrash(&Subscribe, dir, 64);
+  // Cut the last record short.
+  const string log = dir + "/updates.1";
+  struct stat info;
+  ASSERT_EQ(0, stat(log.c_str(), &info));
+  ASSERT_EQ(0, truncate(log.c_str(), info.st_size - 2));
+
+  QuoteTable quotes(64);
+  WarmState state(dir, &quotes);
+  ASSERT_TRUE(state.Load());
+  EXPECT_EQ(1, state.replayed());
+  vector<ib::state::Subscription> subscriptions;
+  state.GetSubscriptions(&subscriptions);
+  ASSERT_EQ(1U, subscriptions.size());
+  EXPECT_EQ("IBM", subscriptions[0].symbol());
+}
+
+const int kQuotes = 4096;
+const int kUpdates = 20000;
+
+static void FillLarge(WarmState* state, QuoteTable* quotes)
+{
+  for (int id = 0; id < kQuotes; ++id) {
+    quotes->Update(id, id, QuoteTable::BID, id + 0.5);
+  }
+  state->Start(3600);
+  for (int i = 0; i < kUpdates; ++i) {
+    state->UpdateOrder(Order(i % 500, "Submitted", i));
+  }
+}
+
+// A full table and a busy log are back well within a second.
+TEST(WarmStateTest, LoadsQuickly)
+{
+  const string dir = TempDir("warm_state_load_test");
+  RunAndCrash(&FillLarge, dir, kQuotes);
+
+  QuoteTable quotes(kQuotes);
+  WarmState state(dir, &quotes);
+  const int64_t start = lab616::utils::now_micros();
+  ASSERT_TRUE(state.Load());
+  const int64_t elapsed = lab616::utils::now_micros() - start;
+  EXPECT_EQ(kUpdates, state.replayed());
+  EXPECT_EQ(static_cast<size_t>(kQuotes), quotes.size());
+  EXPECT_GT(500000, elapsed);
+}
+
+} // namespace
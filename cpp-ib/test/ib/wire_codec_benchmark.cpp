@@ -0,0 +1,210 @@
+
+// Decode throughput of the wire codec, instantiated for every vendored
+// API release, against the vendored EClientSocketBase::processMsg.
+// The stream is a typical market data mix: quotes with their sizes,
+// trades, volume and last-trade timestamps.  Level II depth, whose
+// market makers repeat, is decoded with copied and with interned
+// strings.
+
+#include <stdio.h>
+#include <iostream>
+#include <string>
+
+#include <boost/lexical_cast.hpp>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "utils.hpp"
+#include "ib/adapters.hpp"
+#include "ib/wire/api_traits.hpp"
+#include "ib/wire/decoder.hpp"
+#include "loopback_client.hpp"
+
+using namespace std;
+using namespace ib::wire;
+using ib::testing::LoopbackClient;
+using lab616::utils::now_micros;
+
+namespace {
+
+const int kMessages = 1000000;
+
+// Static dispatch: everything inlines into the decoder.
+struct CountingHandler
+{
+  CountingHandler() : count(0), sum(0) {}
+
+  void tickPrice(TickerId, TickType, double price, int) { count++; sum += price; }
+  void tickSize(TickerId, TickType, int size) { count++; sum += size; }
+  void tickOptionComputation(TickerId, TickType, double, double, double,
+                             double) { count++; }
+  void tickOptionComputation(TickerId, TickType, double, double, double,
+                             double, double, double, double, double)
+  {
+    count++;
+  }
+  void tickGeneric(TickerId, TickType, double value) { count++; sum += value; }
+  void tickString(TickerId, TickType, const IBString&) { count++; }
+  void orderStatus(OrderId, const IBString&, int, int, double, int, int,
+                   double, int, const IBString&) { count++; }
+  void error(const int, const int, const IBString) { count++; }
+  void nextValidId(OrderId) { count++; }
+  void updateMktDepth(TickerId, int, int, int, double, int) { count++; }
+  void updateMktDepthL2(TickerId, int, IBString, int, int, double, int)
+  {
+    count++;
+  }
+  void currentTime(long) { count++; }
+  void realtimeBar(TickerId, long, double, double, double, double, long,
+                   double, int) { count++; }
+  void tickSnapshotEnd(int) { count++; }
+
+  long count;
+  double sum;
+};
+
+// The same with the callbacks of ViewStrings.
+struct CountingViews : CountingHandler
+{
+  void tickString(TickerId, TickType, const StringRef&) { count++; }
+  void orderStatus(OrderId, const StringRef&, int, int, double, int, int,
+                   double, int, const StringRef&) { count++; }
+  void error(int, int, const StringRef&) { count++; }
+  void updateMktDepthL2(TickerId, int, int market_maker, int, int,
+                        double price, int)
+  {
+    count++;
+    sum += market_maker + price;
+  }
+  void contractDetails(int, const ContractDetailsView&) { count++; }
+  void contractDetailsEnd(int) { count++; }
+};
+
+class CountingEWrapper : public ib::adapter::LoggingEWrapper
+{
+ public:
+  CountingEWrapper() : LoggingEWrapper("127.0.0.1", 0, 0), count(0), sum(0) {}
+
+  void tickPrice(TickerId, TickType, double price, int) { count++; sum += price; }
+  void tickSize(TickerId, TickType, int size) { count++; sum += size; }
+  void tickGeneric(TickerId, TickType, double value) { count++; sum += value; }
+  void tickString(TickerId, TickType, const IBString&) { count++; }
+
+  long count;
+  double sum;
+};
+
+void Field(const string& value, string* out)
+{
+  out->append(value);
+  out->push_back('\0');
+}
+
+string MarketDataStream()
+{
+  string out;
+  char price[32];
+  for (int i = 0; i < kMessages; ++i) {
+    string id = boost::lexical_cast<string>(1000 + i % 50);
+    snprintf(price, sizeof(price), "%.2f", 100 + (i % 1000) / 100.);
+    switch (i % 5) {
+      case 0:  // BID
+      case 1:  // ASK
+      case 2:  // LAST
+        Field("1", &out); Field("6", &out); Field(id, &out);
+        Field(i % 5 == 0 ? "1" : i % 5 == 1 ? "2" : "4", &out);
+        Field(price, &out); Field("300", &out); Field("1", &out);
+        break;
+      case 3:  // VOLUME
+        Field("2", &out); Field("6", &out); Field(id, &out); Field("8", &out);
+        Field(boost::lexical_cast<string>(100000 + i), &out);
+        break;
+      case 4:  // LAST_TIMESTAMP
+        Field("46", &out); Field("6", &out); Field(id, &out); Field("45", &out);
+        Field("1294932600", &out);
+        break;
+    }
+  }
+  return out;
+}
+
+string DepthStream()
+{
+  static const char* kMarketMakers[] = {
+    "ARCA", "BATS", "EDGX", "ISLAND", "NSDQ", "CSFB", "GSCO", "MLCO"
+  };
+  string out;
+  char price[32];
+  for (int i = 0; i < kMessages; ++i) {
+    snprintf(price, sizeof(price), "%.2f", 100 + (i % 100) / 100.);
+    Field("13", &out); Field("1", &out);
+    Field(boost::lexical_cast<string>(1000 + i % 50), &out);
+    Field(boost::lexical_cast<string>(i % 10), &out);
+    Field(kMarketMakers[i % 8], &out);
+    Field("1", &out); Field(i % 2 ? "1" : "0", &out);
+    Field(price, &out); Field("100", &out);
+  }
+  return out;
+}
+
+template <typename Handler, typename Strings>
+void BenchmarkDepth(const char* name, const string& stream)
+{
+  Handler handler;
+  Decoder<Api964, Handler, Strings> decoder(&handler);
+  bool unhandled;
+  int64_t start = now_micros();
+  size_t n = decoder.DecodeAll(stream.data(), stream.data() + stream.size(),
+                               &unhandled);
+  int64_t elapsed = now_micros() - start;
+  EXPECT_EQ(stream.size(), n);
+  EXPECT_EQ(kMessages, handler.count);
+  cout << "depth " << name << ": " << kMessages * 1e6 / elapsed
+       << " msgs/s" << endl;
+}
+
+template <typename Api>
+void BenchmarkDecoder(const string& stream)
+{
+  CountingHandler handler;
+  Decoder<Api, CountingHandler> decoder(&handler);
+  bool unhandled;
+  int64_t start = now_micros();
+  size_t n = decoder.DecodeAll(stream.data(), stream.data() + stream.size(),
+                               &unhandled);
+  int64_t elapsed = now_micros() - start;
+  EXPECT_EQ(stream.size(), n);
+  cout << "codec " << Api::name() << ": " << kMessages * 1e6 / elapsed
+       << " msgs/s, " << stream.size() / (double)elapsed << " MB/s ("
+       << handler.count << " callbacks)" << endl;
+}
+
+TEST(WireCodecBenchmark, DecodeEveryRelease)
+{
+  string stream = MarketDataStream();
+
+  CountingEWrapper wrapper;
+  LoopbackClient client(&wrapper);
+  client.Handshake(47);
+  int64_t start = now_micros();
+  client.Feed(stream);
+  int64_t elapsed = now_micros() - start;
+  cout << "vendored 9.64: " << kMessages * 1e6 / elapsed << " msgs/s, "
+       << stream.size() / (double)elapsed << " MB/s (" << wrapper.count
+       << " callbacks)" << endl;
+
+  BenchmarkDecoder<Api962>(stream);
+  BenchmarkDecoder<Api963>(stream);
+  BenchmarkDecoder<Api964Beta>(stream);
+  BenchmarkDecoder<Api964>(stream);
+}
+
+TEST(WireCodecBenchmark, DecodeDepth)
+{
+  string stream = DepthStream();
+  BenchmarkDepth<CountingHandler, CopyStrings>("copied", stream);
+  BenchmarkDepth<CountingViews, ViewStrings>("interned", stream);
+}
+
+} // namespace
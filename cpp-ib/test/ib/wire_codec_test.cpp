@@ -0,0 +1,462 @@
+
+#include <stdarg.h>
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "ib/adapters.hpp"
+#include "ib/wire/api_traits.hpp"
+#include "ib/wire/decoder.hpp"
+#include "ib/wire/encoder.hpp"
+#include "ib/wire/field_codec.hpp"
+#include "ib/wire/interner.hpp"
+#include "loopback_client.hpp"
+
+using namespace std;
+using namespace ib::wire;
+using ib::testing::LoopbackClient;
+
+namespace {
+
+// Writes every callback the codec can make as a line of text.
+class RecordingEWrapper : public ib::adapter::LoggingEWrapper
+{
+ public:
+  RecordingEWrapper() : LoggingEWrapper("127.0.0.1", 0, 0)
+  {
+    out.precision(17);
+  }
+
+  void tickPrice(TickerId id, TickType type, double price, int auto_execute)
+  {
+    out << "tickPrice " << id << " " << type << " " << price << " "
+        << auto_execute << "\n";
+  }
+  void tickSize(TickerId id, TickType type, int size)
+  {
+    out << "tickSize " << id << " " << type << " " << size << "\n";
+  }
+  void tickOptionComputation(TickerId id, TickType type, double iv,
+                             double delta, double opt_price, double pv,
+                             double gamma, double vega, double theta,
+                             double und)
+  {
+    out << "tickOptionComputation " << id << " " << type << " " << iv << " "
+        << delta << " " << opt_price << " " << pv << " " << gamma << " "
+        << vega << " " << theta << " " << und << "\n";
+  }
+  void tickGeneric(TickerId id, TickType type, double value)
+  {
+    out << "tickGeneric " << id << " " << type << " " << value << "\n";
+  }
+  void tickString(TickerId id, TickType type, const IBString& value)
+  {
+    out << "tickString " << id << " " << type << " " << value << "\n";
+  }
+  void orderStatus(OrderId id, const IBString& status, int filled,
+                   int remaining, double avg, int perm_id, int parent_id,
+                   double last, int client_id, const IBString& why)
+  {
+    out << "orderStatus " << id << " " << status << " " << filled << " "
+        << remaining << " " << avg << " " << perm_id << " " << parent_id
+        << " " << last << " " << client_id << " " << why << "\n";
+  }
+  void error(const int id, const int code, const IBString message)
+  {
+    out << "error " << id << " " << code << " " << message << "\n";
+  }
+  void nextValidId(OrderId id)
+  {
+    out << "nextValidId " << id << "\n";
+  }
+  void updateMktDepth(TickerId id, int position, int operation, int side,
+                      double price, int size)
+  {
+    out << "updateMktDepth " << id << " " << position << " " << operation
+        << " " << side << " " << price << " " << size << "\n";
+  }
+  void updateMktDepthL2(TickerId id, int position, IBString mm, int operation,
+                        int side, double price, int size)
+  {
+    out << "updateMktDepthL2 " << id << " " << position << " " << mm << " "
+        << operation << " " << side << " " << price << " " << size << "\n";
+  }
+  void currentTime(long time)
+  {
+    out << "currentTime " << time << "\n";
+  }
+  void realtimeBar(TickerId id, long time, double open, double high,
+                   double low, double close, long volume, double wap,
+                   int count)
+  {
+    out << "realtimeBar " << id << " " << time << " " << open << " " << high
+        << " " << low << " " << close << " " << volume << " " << wap << " "
+        << count << "\n";
+  }
+  void tickSnapshotEnd(int id)
+  {
+    out << "tickSnapshotEnd " << id << "\n";
+  }
+
+  ostringstream out;
+};
+
+// The fields up to the NULL, each NUL-terminated.
+string Message(const char* field, ...)
+{
+  string out;
+  va_list fields;
+  va_start(fields, field);
+  for (; field; field = va_arg(fields, const char*)) {
+    out.append(field);
+    out.push_back('\0');
+  }
+  va_end(fields);
+  return out;
+}
+
+string Stream()
+{
+  return
+      Message("1", "6", "7", "1", "345.25", "300", "1", NULL) +
+      Message("1", "6", "7", "4", "345.3", "100", "0", NULL) +
+      Message("1", "6", "7", "6", "350", "0", "0", NULL) +  // HIGH: no size.
+      Message("2", "6", "7", "8", "123456", NULL) +
+      Message("21", "6", "7", "13", "0.25", "0.5", "3.1", "-1", "0.01",
+              "-2", "-0.05", "345.1", NULL) +
+      Message("21", "5", "7", "10", "-1", "0.4", NULL) +
+      Message("45", "1", "7", "49", "1e-3", NULL) +
+      Message("46", "1", "7", "45", "1294932600", NULL) +
+      Message("3", "6", "11", "Filled", "100", "0", "345.2512345678901", "9",
+              "0", "345.25", "1", "", NULL) +
+      Message("4", "2", "7", "200", "No security definition", NULL) +
+      Message("9", "1", "42", NULL) +
+      Message("12", "1", "8", "0", "1", "1", "99.5", "200", NULL) +
+      Message("13", "1", "8", "2", "ARCA", "0", "0", "99.49", "100", NULL) +
+      Message("49", "1", "1294932600", NULL) +
+      Message("50", "3", "9", "1294932605", "1.1", "1.3", "1.0", "1.2",
+              "1500", "1.15", "12", NULL) +
+      Message("57", "1", "7", NULL);
+}
+
+TEST(FieldCodecTest, ParsesLikeTheVendoredDecoder)
+{
+  const char* ints[] = { "0", "42", "-17", "", "12abc", "2147483647" };
+  for (size_t i = 0; i < sizeof(ints) / sizeof(ints[0]); ++i) {
+    string field(ints[i], strlen(ints[i]) + 1);
+    FieldReader in(field.data(), field.data() + field.size());
+    int value;
+    ASSERT_TRUE(in.Read(&value));
+    EXPECT_EQ(atoi(ints[i]), value) << ints[i];
+    EXPECT_EQ(field.data() + field.size(), in.position());
+  }
+
+  const char* doubles[] = {
+    "0", "345.25", "-0.05", "1.7976931348623157e308", "1234567890.12345",
+    "0.1234567890123456789", "", ".5", "1e-3", "inf", "99.49"
+  };
+  for (size_t i = 0; i < sizeof(doubles) / sizeof(doubles[0]); ++i) {
+    string field(doubles[i], strlen(doubles[i]) + 1);
+    FieldReader in(field.data(), field.data() + field.size());
+    double value;
+    ASSERT_TRUE(in.Read(&value));
+    EXPECT_EQ(atof(doubles[i]), value) << doubles[i];
+  }
+
+  // No terminator yet.
+  string partial("123");
+  FieldReader in(partial.data(), partial.data() + partial.size());
+  int value;
+  EXPECT_FALSE(in.Read(&value));
+  EXPECT_EQ(partial.data(), in.position());
+}
+
+TEST(DecoderTest, MatchesVendoredProcessMsg)
+{
+  string stream = Stream();
+
+  RecordingEWrapper expected;
+  LoopbackClient client(&expected);
+  client.Handshake(45);
+  client.Feed(stream);
+  ASSERT_TRUE(client.isConnected());
+
+  RecordingEWrapper actual;
+  Decoder<Api964, RecordingEWrapper> decoder(&actual);
+  bool unhandled;
+  EXPECT_EQ(stream.size(),
+            decoder.DecodeAll(stream.data(), stream.data() + stream.size(),
+                              &unhandled));
+  EXPECT_FALSE(unhandled);
+  EXPECT_EQ(expected.out.str(), actual.out.str());
+}
+
+TEST(DecoderTest, WaitsForCompleteMessages)
+{
+  string stream = Stream();
+  RecordingEWrapper actual;
+  Decoder<Api964, RecordingEWrapper> decoder(&actual);
+
+  // Byte at a time: nothing is delivered until a message is complete.
+  size_t consumed = 0;
+  for (size_t end = 1; end <= stream.size(); ++end) {
+    int n = decoder.Decode(stream.data() + consumed, stream.data() + end);
+    ASSERT_GE(n, 0);
+    consumed += n;
+  }
+  EXPECT_EQ(stream.size(), consumed);
+
+  RecordingEWrapper expected;
+  Decoder<Api964, RecordingEWrapper> whole(&expected);
+  bool unhandled;
+  whole.DecodeAll(stream.data(), stream.data() + stream.size(), &unhandled);
+  EXPECT_EQ(expected.out.str(), actual.out.str());
+}
+
+TEST(DecoderTest, LeavesOtherMessagesAlone)
+{
+  string stream = Message("9", "1", "42", NULL) +
+      Message("15", "1", "DU12345", NULL);  // MANAGED_ACCTS
+  RecordingEWrapper actual;
+  Decoder<Api964, RecordingEWrapper> decoder(&actual);
+  bool unhandled;
+  size_t n = decoder.DecodeAll(stream.data(), stream.data() + stream.size(),
+                               &unhandled);
+  EXPECT_TRUE(unhandled);
+  EXPECT_EQ(Message("9", "1", "42", NULL).size(), n);
+  EXPECT_EQ("nextValidId 42\n", actual.out.str());
+}
+
+// Before 9.64 the option computation callback has six arguments.
+struct OldOptionHandler : RecordingEWrapper
+{
+  OldOptionHandler() : calls(0), price(0) {}
+  void tickOptionComputation(TickerId, TickType, double, double,
+                             double opt_price, double)
+  {
+    calls++;
+    price = opt_price;
+  }
+  int calls;
+  double price;
+};
+
+TEST(DecoderTest, OlderReleasesUseTheirCallbacks)
+{
+  string stream =
+      Message("21", "5", "7", "13", "0.25", "0.5", "3.1", "-1", NULL);
+  OldOptionHandler handler;
+  Decoder<Api962, OldOptionHandler> decoder(&handler);
+  EXPECT_EQ(static_cast<int>(stream.size()),
+            decoder.Decode(stream.data(), stream.data() + stream.size()));
+  EXPECT_EQ(1, handler.calls);
+  EXPECT_EQ(3.1, handler.price);
+}
+
+TEST(InternerTest, NamesSmallVocabularies)
+{
+  Interner names(100);
+  EXPECT_EQ(Interner::NONE, names.Find(StringRef("ARCA", 4)));
+  EXPECT_EQ(0, names.Intern(StringRef("ARCA", 4)));
+  EXPECT_EQ(1, names.Intern(StringRef("ISLAND", 6)));
+  EXPECT_EQ(0, names.Intern(StringRef("ARCA\0x", 4)));
+  EXPECT_EQ(1, names.Find(StringRef("ISLAND", 6)));
+  EXPECT_EQ(2, names.Intern(StringRef()));
+  EXPECT_STREQ("ISLAND", names.Name(1).data);
+
+  // Names outlive the table's growth; past the limit there are no ids.
+  string long_name(3000, 'x');
+  EXPECT_EQ(3, names.Intern(StringRef(long_name.data(), long_name.size())));
+  for (int i = names.size(); i < 100; ++i) {
+    string name = "MM" + string(1, 'A' + i % 26) + string(1, 'A' + i / 26);
+    ASSERT_EQ(i, names.Intern(StringRef(name.data(), name.size())));
+  }
+  EXPECT_EQ(Interner::NONE, names.Intern(StringRef("NYSE", 4)));
+  EXPECT_EQ(100, names.size());
+  EXPECT_EQ(long_name, names.Name(3).str());
+  EXPECT_TRUE(names.Name(0) == "ARCA");
+  EXPECT_TRUE(names.Name(99) == "MMVD");
+}
+
+// The callbacks of ViewStrings, written as RecordingEWrapper writes the
+// copying ones.
+struct RecordingViews : RecordingEWrapper
+{
+  RecordingViews() : names(NULL) {}
+
+  void tickString(TickerId id, TickType type, const StringRef& value)
+  {
+    RecordingEWrapper::tickString(id, type, value.str());
+  }
+  void orderStatus(OrderId id, const StringRef& status, int filled,
+                   int remaining, double avg, int perm_id, int parent_id,
+                   double last, int client_id, const StringRef& why)
+  {
+    RecordingEWrapper::orderStatus(id, status.str(), filled, remaining, avg,
+                                   perm_id, parent_id, last, client_id,
+                                   why.str());
+  }
+  void error(int id, int code, const StringRef& message)
+  {
+    RecordingEWrapper::error(id, code, message.str());
+  }
+  void updateMktDepthL2(TickerId id, int position, int mm, int operation,
+                        int side, double price, int size)
+  {
+    RecordingEWrapper::updateMktDepthL2(id, position, names->Name(mm).str(),
+                                        operation, side, price, size);
+  }
+  void contractDetails(int req_id, const ContractDetailsView& details)
+  {
+    out << "contractDetails " << req_id << " " << details.symbol.data << " "
+        << names->Name(details.exchange).data << "\n";
+    contracts.push_back(details);
+  }
+  void contractDetailsEnd(int req_id)
+  {
+    out << "contractDetailsEnd " << req_id << "\n";
+  }
+
+  Interner* names;
+  vector<ContractDetailsView> contracts;
+};
+
+TEST(DecoderTest, ViewsMatchCopies)
+{
+  string stream = Stream() +
+      Message("13", "1", "8", "0", "ARCA", "1", "1", "99.5", "300", NULL) +
+      Message("13", "1", "8", "1", "BATS", "0", "1", "99.5", "100", NULL);
+
+  RecordingEWrapper expected;
+  Decoder<Api964, RecordingEWrapper> copies(&expected);
+  bool unhandled;
+  copies.DecodeAll(stream.data(), stream.data() + stream.size(), &unhandled);
+
+  RecordingViews actual;
+  Decoder<Api964, RecordingViews, ViewStrings> views(&actual);
+  actual.names = views.names();
+  EXPECT_EQ(stream.size(),
+            views.DecodeAll(stream.data(), stream.data() + stream.size(),
+                            &unhandled));
+  EXPECT_FALSE(unhandled);
+  EXPECT_EQ(expected.out.str(), actual.out.str());
+  EXPECT_EQ(2, views.names()->size());
+}
+
+TEST(DecoderTest, ViewsDecodeContractDetails)
+{
+  const string contract = Message(
+      "10", "6", "3", "AAPL", "STK", "", "0", "", "SMART", "USD", "AAPL",
+      "NMS", "NMS", "265598", "0.01", "", "ACTIVETIM,ADJUST,ALERT",
+      "SMART,ISLAND,ARCA", "1", "0", "APPLE INC", "NASDAQ", "",
+      "Technology", "Computers", "Computers", "EST",
+      "20110114:0400-2000", "20110114:0930-1600", NULL);
+  const string old = Message(
+      "10", "3", "4", "MSFT", "STK", "", "0", "", "SMART", "USD", "MSFT",
+      "NMS", "NMS", "272093", "0.01", "", "LMT", "SMART", "1", NULL);
+  string stream = contract + old + Message("52", "1", "3", NULL);
+
+  // Copying, they are left to processMsg.
+  typedef Decoder<Api964, RecordingEWrapper> CopyingDecoder;
+  RecordingEWrapper copying;
+  CopyingDecoder copies(&copying);
+  EXPECT_EQ(CopyingDecoder::UNHANDLED,
+            copies.Decode(stream.data(), stream.data() + stream.size()));
+
+  RecordingViews actual;
+  Decoder<Api964, RecordingViews, ViewStrings> views(&actual);
+  actual.names = views.names();
+  bool unhandled;
+  EXPECT_EQ(stream.size(),
+            views.DecodeAll(stream.data(), stream.data() + stream.size(),
+                            &unhandled));
+  EXPECT_EQ("contractDetails 3 AAPL SMART\n"
+            "contractDetails 4 MSFT SMART\n"
+            "contractDetailsEnd 3\n", actual.out.str());
+
+  ASSERT_EQ(2U, actual.contracts.size());
+  const ContractDetailsView& aapl = actual.contracts[0];
+  const Interner& names = *views.names();
+  EXPECT_TRUE(names.Name(aapl.sec_type) == "STK");
+  EXPECT_TRUE(names.Name(aapl.currency) == "USD");
+  EXPECT_TRUE(names.Name(aapl.primary_exchange) == "NASDAQ");
+  EXPECT_TRUE(names.Name(aapl.time_zone_id) == "EST");
+  EXPECT_EQ(265598, aapl.con_id);
+  EXPECT_EQ(0.01, aapl.min_tick);
+  EXPECT_TRUE(aapl.long_name == "APPLE INC");
+  EXPECT_TRUE(aapl.liquid_hours == "20110114:0930-1600");
+
+  // Both name the same exchange with the same id; the older version
+  // sends no primary exchange.
+  const ContractDetailsView& msft = actual.contracts[1];
+  EXPECT_EQ(aapl.exchange, msft.exchange);
+  EXPECT_EQ(aapl.sec_type, msft.sec_type);
+  EXPECT_TRUE(names.Name(msft.primary_exchange) == "");
+  EXPECT_EQ(0, msft.under_con_id);
+  EXPECT_EQ(0U, msft.industry.size);
+}
+
+Contract MakeContract()
+{
+  Contract contract;
+  contract.symbol = "AAPL";
+  contract.secType = "STK";
+  contract.exchange = "SMART";
+  contract.primaryExchange = "ISLAND";
+  contract.currency = "USD";
+  contract.strike = 0.1;
+  return contract;
+}
+
+TEST(EncoderTest, MatchesVendoredClient)
+{
+  RecordingEWrapper wrapper;
+  LoopbackClient client(&wrapper);
+  client.Handshake(47);
+
+  Contract contract = MakeContract();
+  contract.conId = 265598;
+  UnderComp under_comp;
+  under_comp.conId = 1;
+  under_comp.delta = 0.5;
+  under_comp.price = 100.25;
+  contract.underComp = &under_comp;
+
+  client.reqMktData(7, contract, "100,101", false);
+  client.cancelMktData(7);
+  client.reqMktDepth(8, contract, 10);
+  client.cancelMktDepth(8);
+  client.reqCurrentTime();
+
+  Encoder<Api964> encoder(47);
+  string out;
+  EXPECT_TRUE(encoder.ReqMktData(7, contract, "100,101", false, &out));
+  encoder.CancelMktData(7, &out);
+  encoder.ReqMktDepth(8, contract, 10, &out);
+  encoder.CancelMktDepth(8, &out);
+  encoder.ReqCurrentTime(&out);
+  EXPECT_EQ(client.sent, out);
+}
+
+TEST(EncoderTest, FollowsServerAndReleaseVersions)
+{
+  Contract contract = MakeContract();
+  contract.conId = 265598;
+
+  // 9.64 will not send a conId to a server that does not take it.
+  string out;
+  EXPECT_FALSE(Encoder<Api964>(45).ReqMktData(7, contract, "", false, &out));
+  EXPECT_TRUE(out.empty());
+
+  // 9.62 never sends it, and says it is version 8.
+  EXPECT_TRUE(Encoder<Api962>(47).ReqMktData(7, contract, "", true, &out));
+  EXPECT_EQ(Message("1", "8", "7", "AAPL", "STK", "", "0.1", "", "", "SMART",
+                    "ISLAND", "USD", "", "0", "", "1", NULL), out);
+}
+
+} // namespace